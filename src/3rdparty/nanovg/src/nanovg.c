@@ -2575,6 +2575,35 @@ void nvgFill(NVGcontext* ctx)
 	}
 }
 
+void nvgTriangles(NVGcontext* ctx, const float* vertices, const float* uvs, const unsigned int* indices, int nindices)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpaint paint = state->fill;
+	NVGvertex* verts;
+	int i;
+
+	if (nindices < 3 || ctx->params.renderTriangles == NULL)
+		return;
+	verts = nvg__allocTempVerts(ctx, nindices);
+	if (verts == NULL)
+		return;
+	for (i = 0; i < nindices; i++) {
+		unsigned int idx = indices[i];
+		nvgTransformPoint(&verts[i].x, &verts[i].y, state->xform, vertices[idx*2], vertices[idx*2+1]);
+		verts[i].u = uvs[idx*2];
+		verts[i].v = uvs[idx*2+1];
+	}
+
+	// Apply global alpha
+	paint.innerColor.a *= state->alpha;
+	paint.outerColor.a *= state->alpha;
+
+	ctx->params.renderTriangles(ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nindices, ctx->fringeWidth);
+
+	ctx->drawCallCount++;
+	ctx->fillTriCount += nindices/3;
+}
+
 void nvgStroke(NVGcontext* ctx)
 {
 	NVGstate* state = nvg__getState(ctx);
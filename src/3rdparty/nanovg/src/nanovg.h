@@ -582,6 +582,11 @@ void nvgFill(NVGcontext* ctx);
 // Fills the current path with current stroke style.
 void nvgStroke(NVGcontext* ctx);
 
+// Draws indexed textured triangles with the image of the current fill paint in a single draw call.
+// The vertices and uvs arrays contain x/y and u/v pairs, uvs are normalized to the image size.
+// The triangles are not clipped by clip paths.
+void nvgTriangles(NVGcontext* ctx, const float* vertices, const float* uvs, const unsigned int* indices, int nindices);
+
 // Marks the fill of the current path as pickable with the specified id.
 void nvgFillHitRegion(NVGcontext* ctx, int id);
 
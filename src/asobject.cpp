@@ -2677,6 +2677,7 @@ ASObject::ASObject(ASWorker* wrk, Class_base* c, SWFOBJECT_TYPE t, CLASS_SUBTYPE
 	,storedmembercountstatic(0)
 	,type(t)
 	,subtype(st)
+	,samplerId(0)
 	,traitsInitialized(false)
 	,constructIndicator(false)
 	,constructorCallComplete(false)
@@ -2699,6 +2700,8 @@ ASObject::ASObject(ASWorker* wrk, Class_base* c, SWFOBJECT_TYPE t, CLASS_SUBTYPE
 		objectcounter[c] = x;
 	}
 #endif
+	if (USUALLY_FALSE(activeSamplerCount.load(std::memory_order_relaxed)))
+		samplerObjectCreated(this,false);
 }
 ASObject::ASObject(const ASObject& o)
 	:objfreelist(o.objfreelist)
@@ -2715,6 +2718,7 @@ ASObject::ASObject(const ASObject& o)
 	,storedmembercountstatic(0)
 	,type(o.type)
 	,subtype(o.subtype)
+	,samplerId(0)
 	,traitsInitialized(false)
 	,constructIndicator(false)
 	,constructorCallComplete(false)
@@ -2732,6 +2736,8 @@ ASObject::ASObject(const ASObject& o)
 	memcheckmutex.unlock();
 #endif
 	assert(o.Variables.size()==0);
+	if (USUALLY_FALSE(activeSamplerCount.load(std::memory_order_relaxed)))
+		samplerObjectCreated(this,false);
 }
 
 ASObject::ASObject(MemoryAccount* m)
@@ -2749,6 +2755,7 @@ ASObject::ASObject(MemoryAccount* m)
 	,storedmembercountstatic(0)
 	,type(T_OBJECT)
 	,subtype(SUBTYPE_NOT_SET)
+	,samplerId(0)
 	,traitsInitialized(false)
 	,constructIndicator(false)
 	,constructorCallComplete(false)
@@ -2769,6 +2776,8 @@ ASObject::ASObject(MemoryAccount* m)
 
 ASObject::~ASObject()
 {
+	if (USUALLY_FALSE(samplerId))
+		samplerObjectDeleted(this,samplerId,false);
 #ifndef NDEBUG
 	memcheckmutex.lock();
 	memcheckset.erase(this);
@@ -4923,9 +4932,15 @@ bool asAtomHandler::add(asAtom& a, asAtom &v2, ASWorker* wrk, bool forceint)
 	}
 	else if(isString(a) || isString(v2))
 	{
+		LOG_CALL("add " << toDebugString(a) << '+' << toDebugString(v2));
+		ASObject* concatenated = forceint ? nullptr : ASString::concatenate(wrk,a,v2);
+		if (concatenated)
+		{
+			a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(concatenated)|ATOM_STRINGPTR;
+			return true;
+		}
 		tiny_string sa = toString(a,wrk);
 		sa += toString(v2,wrk);
-		LOG_CALL("add " << toDebugString(a) << '+' << toDebugString(v2));
 		if (forceint)
 			setInt(a,Integer::stringToASInteger(sa.raw_buf(),0));
 		else
@@ -5057,9 +5072,16 @@ void asAtomHandler::addreplace(asAtom& ret, ASWorker* wrk, asAtom& v1, asAtom &v
 	}
 	else if(isString(v1) || isString(v2))
 	{
+		LOG_CALL("add replace " << toString(v1,wrk) << '+' << toString(v2,wrk));
+		ASObject* concatenated = forceint ? nullptr : ASString::concatenate(wrk,v1,v2);
+		if (concatenated)
+		{
+			ASATOM_DECREF(ret);
+			ret.uintval = (LIGHTSPARK_ATOM_VALTYPE)(concatenated)|ATOM_STRINGPTR;
+			return;
+		}
 		tiny_string sa = toString(v1,wrk);
 		sa += toString(v2,wrk);
-		LOG_CALL("add replace " << toString(v1,wrk) << '+' << toString(v2,wrk));
 		ASATOM_DECREF(ret);
 		if (forceint)
 			setInt(ret,Integer::stringToASInteger(sa.raw_buf(),0));
@@ -870,8 +870,15 @@ class ASWorker;
 
 extern ASWorker* getWorker();
 
+// number of active flash.sampler samplers, see ObjectSampler
+extern ATOMIC_INT32(activeSamplerCount);
+void samplerObjectCreated(ASObject* o, bool computesize);
+void samplerObjectDeleted(ASObject* o, uint32_t id, bool computesize);
+void samplerFunctionEntered(ASWorker* w);
+
 class ASObject: public memory_reporter, public RefCountable
 {
+friend class ObjectSampler;
 friend class ABCVm;
 friend class ABCContext;
 friend class Class_base; //Needed for forced cleanup
@@ -924,6 +931,7 @@ protected:
 	ATOMIC_INT32(storedmembercountstatic); // count how often this object is stored as a member of another static object (needed for cyclic reference detection)
 	SWFOBJECT_TYPE type;
 	CLASS_SUBTYPE subtype;
+	uint32_t samplerId; // id of the NewObjectSample recorded for this object, 0 if it wasn't sampled
 
 	bool traitsInitialized:1;
 	bool constructIndicator:1;
@@ -971,6 +979,11 @@ protected:
 
 	FORCE_INLINE bool destructIntern()
 	{
+		if (USUALLY_FALSE(samplerId))
+		{
+			samplerObjectDeleted(this,samplerId,true);
+			samplerId=0;
+		}
 		destroyContents();
 		for (auto it = ownedObjects.begin(); it != ownedObjects.end(); it++)
 		{
@@ -3181,6 +3194,8 @@ inline ASObject* asfreelist::getObjectFromFreeList()
 	assert(freelistsize>=0);
 	ASObject* o = freelistsize ? freelist[--freelistsize] :nullptr;
 	LOG_CALL("getfromfreelist:"<<freelistsize<<" "<<o<<" "<<this);
+	if (USUALLY_FALSE(activeSamplerCount.load(std::memory_order_relaxed)) && o)
+		samplerObjectCreated(o,true);
 	return o;
 }
 inline bool asfreelist::pushObjectToFreeList(ASObject *obj)
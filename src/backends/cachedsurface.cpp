@@ -659,6 +659,7 @@ void CachedSurface::renderImpl(SystemState* sys, RenderContext& ctxt, RenderDisp
 			bool instroke = false;
 			bool infill = false;
 			bool renderneeded=false;
+			const FILLSTYLE* currentfillstyle=nullptr;
 			int tokentype = 1;
 			tokensVector* tk = &state->tokens;
 			while (tokentype)
@@ -798,6 +799,7 @@ void CachedSurface::renderImpl(SystemState* sys, RenderContext& ctxt, RenderDisp
 								strokescaley = 1.0;
 							}
 							infill=true;
+							currentfillstyle=p1.fillStyle;
 							nanoVGFillStyle(nvgctxt, *p1.fillStyle, ct, state->scaling, true,sys);
 							break;
 						}
@@ -887,7 +889,81 @@ void CachedSurface::renderImpl(SystemState* sys, RenderContext& ctxt, RenderDisp
 							}
 							infill=false;
 							if(p.type==CLEAR_FILL)
+							{
 								nvgFillColor(nvgctxt,startcolor);
+								currentfillstyle=nullptr;
+							}
+							break;
+						}
+						case TRIANGLE_MESH:
+						{
+							// the fill style is kept after the FILL_KEEP_SOURCE token in front of the mesh
+							GeomToken p1(*(++it),false);
+							const TriangleMesh* mesh = p1.mesh;
+							if (!currentfillstyle || !mesh->triangleCount())
+								break;
+							if (renderneeded)
+							{
+								if (ctxt.isDrawingMask())
+									nvgEndClip(nvgctxt);
+								if (instroke)
+									nvgStroke(nvgctxt);
+								if (infill)
+									nvgFill(nvgctxt);
+								renderneeded=false;
+								nvgClosePath(nvgctxt);
+								nvgBeginPath(nvgctxt);
+								if (ctxt.isDrawingMask())
+									nvgBeginClip(nvgctxt);
+							}
+							bool isbitmapfill = !currentfillstyle->bitmap.isNull() &&
+									(currentfillstyle->FillStyleType == REPEATING_BITMAP ||
+									 currentfillstyle->FillStyleType == CLIPPED_BITMAP ||
+									 currentfillstyle->FillStyleType == NON_SMOOTHED_REPEATING_BITMAP ||
+									 currentfillstyle->FillStyleType == NON_SMOOTHED_CLIPPED_BITMAP);
+							int img = -1;
+							if (mesh->isTextured() && isbitmapfill && !ctxt.isDrawingMask())
+								img = setNanoVGImage(nvgctxt,currentfillstyle,sys);
+							if (img == -1)
+							{
+								// texture coordinates are not used, so the triangles are filled like any other path
+								mesh->addNanoVGPath(nvgctxt);
+								if (ctxt.isDrawingMask())
+									nvgEndClip(nvgctxt);
+								nvgFill(nvgctxt);
+								nvgClosePath(nvgctxt);
+								nvgBeginPath(nvgctxt);
+								if (ctxt.isDrawingMask())
+									nvgBeginClip(nvgctxt);
+								break;
+							}
+							if (!ctxt.isMaskActive())
+							{
+								// the fill paint already references the texture, so all triangles are drawn at once
+								nvgTriangles(nvgctxt,mesh->vertices.data(),mesh->uvs.data(),mesh->indices.data(),mesh->indices.size());
+								break;
+							}
+							// nvgTriangles ignores clip paths, so every triangle is filled as a path with its own texture transformation
+							float texturewidth = currentfillstyle->bitmap->getWidth();
+							float textureheight = currentfillstyle->bitmap->getHeight();
+							float r,g,b,a;
+							ct.applyTransformation(RGBA(255,255,255,255),r,g,b,a);
+							for (uint32_t i = 0; i < mesh->triangleCount(); i++)
+							{
+								NVGpaint pattern = nvgImagePattern(nvgctxt,0,0,texturewidth,textureheight,0,img,1.0);
+								if (!mesh->getTextureTransform(i,texturewidth,textureheight,pattern.xform))
+									continue;
+								pattern.innerColor = pattern.outerColor = nvgRGBAf(r,g,b,a);
+								nvgFillPaint(nvgctxt,pattern);
+								const uint32_t* idx = &mesh->indices[i*3];
+								nvgMoveTo(nvgctxt,mesh->vertices[idx[0]*2],mesh->vertices[idx[0]*2+1]);
+								nvgLineTo(nvgctxt,mesh->vertices[idx[1]*2],mesh->vertices[idx[1]*2+1]);
+								nvgLineTo(nvgctxt,mesh->vertices[idx[2]*2],mesh->vertices[idx[2]*2+1]);
+								nvgClosePath(nvgctxt);
+								nvgFill(nvgctxt);
+								nvgBeginPath(nvgctxt);
+							}
+							nanoVGFillStyle(nvgctxt, *currentfillstyle, ct, state->scaling, true,sys);
 							break;
 						}
 						case CLEAR_STROKE:
@@ -83,7 +83,7 @@ Config::Config()
 	,userConfigDirectory(SpecialFolder::get_user_config_dir())
 	//DEFAULT SETTINGS
 	,defaultCacheDirectory((Path(SpecialFolder::get_user_cache_dir()) / Path("lightspark")).getStr())
-	,cacheDirectory(defaultCacheDirectory),cachePrefix("cache")
+	,cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),httpCacheSize(0),ioEventBudget(32)
 	,userDataDirectory((Path( SpecialFolder::get_user_data_dir()) / Path("lightspark")).getStr())
 	,renderingEnabled(true)
 {
@@ -176,6 +176,12 @@ void Config::handleEntries(ini::IniFile& parser)
 			//Cache prefix
 			else if(group == "cache" && key == "prefix")
 				cachePrefix = value;
+			//Size of the HTTP cache in megabytes
+			else if(group == "cache" && key == "http_size")
+				httpCacheSize = strtoull(value.c_str(),nullptr,10)*1024*1024;
+			//Number of I/O events handled before waiting frame events
+			else if(group == "events" && key == "io_budget")
+				ioEventBudget = strtoul(value.c_str(),nullptr,10);
 			else
 				LOG(LOG_ERROR,"Invalid entry encountered in configuration file" << ": '" << group << "/" << key << "'='" << value << "'");
 		}
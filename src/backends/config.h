@@ -41,6 +41,10 @@ namespace lightspark
 		std::string cacheDirectory;
 		//Specifies what prefix the cache files should have, default="cache"
 		std::string cachePrefix;
+		//Maximum size in bytes of the persistent HTTP cache, 0 disables it
+		uint64_t httpCacheSize;
+		//Number of I/O events (loaders, sockets) handled before waiting frame events, default=32
+		uint32_t ioEventBudget;
 		//Specifies the directory where the app can store files
 		std::string dataDirectory;
 		std::string userDataDirectory;
@@ -55,6 +59,8 @@ namespace lightspark
 
 		const std::string& getCacheDirectory() const { return cacheDirectory; }
 		const std::string& getCachePrefix() const { return cachePrefix; }
+		uint64_t getHTTPCacheSize() const { return httpCacheSize; }
+		uint32_t getIOEventBudget() const { return ioEventBudget; }
 		const std::string& getDataDirectory() const { return dataDirectory; }
 		const std::string& getUserDataDirectory() const { return userDataDirectory; }
 		
@@ -0,0 +1,176 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifdef ENABLE_CURL
+#include "backends/curlmulti.h"
+#include "backends/netutils.h"
+#include "swf.h"
+#include "logger.h"
+#include "tracing.h"
+#include <SDL.h>
+#include <curl/curl.h>
+
+using namespace std;
+using namespace lightspark;
+
+// maximum number of parallel connections to a single host, like browsers do
+#define CURL_MAX_HOST_CONNECTIONS 6
+// maximum number of parallel connections of all transfers
+#define CURL_MAX_TOTAL_CONNECTIONS 64
+// maximum time in milliseconds the driver waits for network activity before checking for stopped downloads
+#define CURL_WAIT_TIMEOUT 100
+
+CurlMultiDriver::CurlMultiDriver(SystemState* s):t(nullptr),m_sys(s),stopped(false)
+{
+	CURLM* m = curl_multi_init();
+	multi = m;
+#if LIBCURL_VERSION_NUM >= 0x071e00
+	curl_multi_setopt(m, CURLMOPT_MAX_HOST_CONNECTIONS, (long)CURL_MAX_HOST_CONNECTIONS);
+	curl_multi_setopt(m, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)CURL_MAX_TOTAL_CONNECTIONS);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	curl_multi_setopt(m, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#endif
+	// the connection cache is shared by all handles of the multi handle,
+	// the share handle adds DNS results and TLS sessions. It is only used in the driver thread, so it needs no locking
+	CURLSH* sh = curl_share_init();
+	share = sh;
+	curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	t = SDL_CreateThread(&CurlMultiDriver::worker,"CurlMultiDriver",this);
+}
+
+CurlMultiDriver::~CurlMultiDriver()
+{
+	stopped = true;
+	wakeup();
+	SDL_WaitThread(t,nullptr);
+	curl_share_cleanup((CURLSH*)share);
+	curl_multi_cleanup((CURLM*)multi);
+}
+
+int CurlMultiDriver::worker(void* d)
+{
+	CurlMultiDriver* th = (CurlMultiDriver*)d;
+	setTLSSys(th->m_sys);
+	setTLSWorker(th->m_sys->worker);
+	Tracer::setThreadName("CurlMultiDriver");
+	th->run();
+	return 0;
+}
+
+void CurlMultiDriver::wakeup()
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup((CURLM*)multi);
+#endif
+	// older versions of curl notice new transfers after CURL_WAIT_TIMEOUT
+}
+
+void CurlMultiDriver::addTransfer(CurlDownloader* d)
+{
+	{
+		Locker l(mutex);
+		newTransfers.push_back(d);
+	}
+	wakeup();
+}
+
+void CurlMultiDriver::addNewTransfers()
+{
+	vector<CurlDownloader*> added;
+	{
+		Locker l(mutex);
+		added.swap(newTransfers);
+	}
+	for (auto d : added)
+	{
+		CURL* curl = (CURL*)d->curlHandle;
+		curl_easy_setopt(curl, CURLOPT_PRIVATE, d);
+		curl_easy_setopt(curl, CURLOPT_SHARE, (CURLSH*)share);
+#if LIBCURL_VERSION_NUM >= 0x072f00
+		curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+		// prefer waiting for a connection that can be multiplexed over opening a new one
+		curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+#endif
+		transfers.insert(d);
+		CURLMcode res = curl_multi_add_handle((CURLM*)multi, curl);
+		if (res != CURLM_OK)
+		{
+			LOG(LOG_ERROR,"NET: CurlMultiDriver: could not add transfer:" << curl_multi_strerror(res));
+			finishTransfer(d,CURLE_FAILED_INIT);
+		}
+	}
+}
+
+void CurlMultiDriver::finishTransfer(CurlDownloader* d, int result)
+{
+	curl_multi_remove_handle((CURLM*)multi, (CURL*)d->curlHandle);
+	transfers.erase(d);
+	d->transferDone(result);
+	// the downloader may be destroyed after this
+	d->jobFence();
+}
+
+void CurlMultiDriver::run()
+{
+	CURLM* m = (CURLM*)multi;
+	vector<CurlDownloader*> done;
+	while (!stopped)
+	{
+		addNewTransfers();
+		// stopped downloads are also aborted by the progress callback, but that isn't called while the connection is idle
+		for (auto d : transfers)
+		{
+			if (d->cache->hasTerminated())
+				done.push_back(d);
+		}
+		for (auto d : done)
+			finishTransfer(d,CURLE_ABORTED_BY_CALLBACK);
+		done.clear();
+
+		int running = 0;
+		curl_multi_perform(m, &running);
+		CURLMsg* msg;
+		int left;
+		while ((msg = curl_multi_info_read(m, &left)))
+		{
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			CurlDownloader* d = nullptr;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&d);
+			// msg is invalid after the handle is removed
+			CURLcode res = msg->data.result;
+			finishTransfer(d,res);
+		}
+		if (stopped)
+			break;
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_poll(m, nullptr, 0, CURL_WAIT_TIMEOUT, nullptr);
+#else
+		curl_multi_wait(m, nullptr, 0, CURL_WAIT_TIMEOUT, nullptr);
+#endif
+	}
+	addNewTransfers();
+	while (!transfers.empty())
+		finishTransfer(*transfers.begin(),CURLE_ABORTED_BY_CALLBACK);
+}
+#endif
@@ -0,0 +1,70 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_CURLMULTI_H
+#define BACKENDS_CURLMULTI_H 1
+
+#include "compat.h"
+#include "threading.h"
+#include <vector>
+#include <unordered_set>
+
+struct SDL_Thread;
+
+namespace lightspark
+{
+class SystemState;
+class CurlDownloader;
+
+/*
+ * Runs the transfers of all CurlDownloaders of a SystemState in a single thread with a curl multi handle.
+ * Connections, DNS results and TLS sessions are reused between transfers,
+ * HTTP/2 requests to the same host are multiplexed over one connection and
+ * the number of connections per host is limited, further transfers wait in the queue of curl.
+ * The curl headers are only included in the implementation, so the handles are stored as void*
+ */
+class CurlMultiDriver
+{
+private:
+	Mutex mutex;
+	SDL_Thread* t;
+	SystemState* m_sys;
+	void* multi; // CURLM*
+	void* share; // CURLSH*
+	volatile bool stopped;
+	// protected by mutex
+	std::vector<CurlDownloader*> newTransfers;
+	// only accessed in the driver thread
+	std::unordered_set<CurlDownloader*> transfers;
+	static int worker(void* d);
+	void run();
+	void wakeup();
+	void addNewTransfers();
+	// removes the transfer from the multi handle and finishes the download
+	void finishTransfer(CurlDownloader* d, int result);
+public:
+	CurlMultiDriver(SystemState* s);
+	// stops the driver thread and aborts all remaining transfers
+	~CurlMultiDriver();
+	// the easy handle of the downloader must be fully set up, the driver finishes and fences the downloader
+	void addTransfer(CurlDownloader* d);
+};
+
+}
+#endif /* BACKENDS_CURLMULTI_H */
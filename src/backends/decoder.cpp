@@ -29,6 +29,7 @@
 #include "scripting/flash/net/flashnet.h"
 #include "scripting/flash/media/flashmedia.h"
 #include "parsing/tags.h"
+#include "scripting/flash/display/BitmapContainer.h"
 
 #ifdef ENABLE_LIBAVCODEC
 #if LIBAVUTIL_VERSION_MAJOR < 51
@@ -56,17 +57,20 @@ bool VideoDecoder::setSize(uint32_t w, uint32_t h)
 		frameHeight=h;
 		LOG(LOG_INFO,"VIDEO DEC: Video frame size " << frameWidth << 'x' << frameHeight);
 		resizeGLBuffers=true;
+		frameAvailable=false;
+		//Rows are stored with the width aligned to 16, see sizeNeeded
+		uint32_t bufferSize=((frameWidth+15)&0xfffffff0)*frameHeight*4;
 #ifdef _WIN32
 		if (decodedframebuffer)
 			_aligned_free(decodedframebuffer);
-		decodedframebuffer = (uint8_t*)_aligned_malloc(frameWidth*frameHeight*4, 16);
+		decodedframebuffer = (uint8_t*)_aligned_malloc(bufferSize, 16);
 		if (!decodedframebuffer) {
 			LOG(LOG_ERROR, "posix_memalign could not allocate memory");
 		}
 #else
 		if (decodedframebuffer)
 			free(decodedframebuffer);
-		if(posix_memalign((void **)&decodedframebuffer, 16, frameWidth*frameHeight*4)) {
+		if(posix_memalign((void **)&decodedframebuffer, 16, bufferSize)) {
 			LOG(LOG_ERROR, "posix_memalign could not allocate memory");
 		}
 #endif
@@ -120,9 +124,10 @@ void VideoDecoder::markForDestruction()
 void VideoDecoder::clearFrameBuffer()
 {
 	if (decodedframebuffer)
-		memset(decodedframebuffer,0,frameWidth*frameHeight*4);
+		memset(decodedframebuffer,0,((frameWidth+15)&0xfffffff0)*frameHeight*4);
+	frameAvailable=false;
 }
-VideoDecoder::VideoDecoder():decodedframebuffer(nullptr),frameRate(0),framesdecoded(0),framesdropped(0),frameWidth(0),frameHeight(0),lastframe(UINT32_MAX),currentframe(UINT32_MAX),fenceCount(0),resizeGLBuffers(false),markedForDeletion(false)
+VideoDecoder::VideoDecoder():decodedframebuffer(nullptr),frameAvailable(false),frameRate(0),framesdecoded(0),framesdropped(0),frameWidth(0),frameHeight(0),lastframe(UINT32_MAX),currentframe(UINT32_MAX),fenceCount(0),colorSpace(YUV_BT601),resizeGLBuffers(false),markedForDeletion(false)
 {
 }
 
@@ -149,6 +154,27 @@ void VideoDecoder::waitForFencing()
 }
 
 #ifdef ENABLE_LIBAVCODEC
+
+void FFMpegVideoDecoder::setupThreading(const AVCodec* codec)
+{
+	// Threaded decoding is opt-in, LIGHTSPARK_VIDEO_THREADS sets the number of threads (0 lets ffmpeg decide)
+	char* envvar = getenv("LIGHTSPARK_VIDEO_THREADS");
+	if (!envvar || !codec)
+		return;
+	codecContext->thread_count=atoi(envvar);
+	codecContext->thread_type=0;
+#if defined(FF_THREAD_SLICE) && defined(AV_CODEC_CAP_SLICE_THREADS)
+	if (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)
+		codecContext->thread_type|=FF_THREAD_SLICE;
+#endif
+#if defined(FF_THREAD_FRAME) && defined(AV_CODEC_CAP_FRAME_THREADS)
+	// frame threading delays the output of frames, embedded video needs to get the frame for every tag immediately
+	if (!embeddedvideotag && (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS))
+		codecContext->thread_type|=FF_THREAD_FRAME;
+#endif
+	LOG(LOG_INFO,"VIDEO DEC: using "<<codecContext->thread_count<<" threads, thread type "<<codecContext->thread_type);
+}
+
 bool FFMpegVideoDecoder::fillDataAndCheckValidity()
 {
 	if(frameRate==0 && codecContext->time_base.num!=0)
@@ -161,6 +187,7 @@ bool FFMpegVideoDecoder::fillDataAndCheckValidity()
 	else if(frameRate==0)
 		return false;
 
+	colorSpace=codecContext->colorspace==AVCOL_SPC_BT709 ? YUV_BT709 : YUV_BT601;
 	if(codecContext->width!=0 && codecContext->height!=0)
 		setSize(codecContext->width, codecContext->height);
 	else
@@ -170,7 +197,7 @@ bool FFMpegVideoDecoder::fillDataAndCheckValidity()
 }
 
 FFMpegVideoDecoder::FFMpegVideoDecoder(LS_VIDEO_CODEC codecId, uint8_t* initdata, uint32_t datalen, double frameRateHint, DefineVideoStreamTag *tag):
-	ownedContext(true),curBuffer(0),codecContext(nullptr),streamingbuffers(FFMPEGVIDEODECODERBUFFERSIZE),embeddedbuffers(2),curBufferOffset(0),embeddedvideotag(tag)
+	ownedContext(true),curBuffer(0),codecContext(nullptr),streamingbuffers(FFMPEGVIDEODECODERBUFFERSIZE),embeddedbuffers(2),timeBase({1,1000}),curBufferOffset(0),embeddedvideotag(tag)
 {
 	//The tag is the header, initialize decoding
 	switchCodec(codecId, initdata, datalen, frameRateHint);
@@ -255,6 +282,7 @@ void FFMpegVideoDecoder::switchCodec(LS_VIDEO_CODEC codecId, uint8_t *initdata,
 		codecContext->extradata=initdata;
 		codecContext->extradata_size=datalen;
 	}
+	setupThreading(codec);
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(53,8,0)
 	if(avcodec_open2(codecContext, codec, nullptr)<0)
 #else
@@ -269,7 +297,7 @@ void FFMpegVideoDecoder::switchCodec(LS_VIDEO_CODEC codecId, uint8_t *initdata,
 }
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 40, 101)
 FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frameRateHint):
-	ownedContext(true),curBuffer(0),codecContext(nullptr),streamingbuffers(FFMPEGVIDEODECODERBUFFERSIZE),embeddedbuffers(2),curBufferOffset(0),embeddedvideotag(nullptr)
+	ownedContext(true),curBuffer(0),codecContext(nullptr),streamingbuffers(FFMPEGVIDEODECODERBUFFERSIZE),embeddedbuffers(2),timeBase({1,1000}),curBufferOffset(0),embeddedvideotag(nullptr)
 {
 	status=INIT;
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(53,8,0)
@@ -298,6 +326,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frame
 	}
 	avcodec_parameters_to_context(codecContext,codecPar);
 	const AVCodec* codec=avcodec_find_decoder(codecPar->codec_id);
+	setupThreading(codec);
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(53,8,0)
 	if(avcodec_open2(codecContext, codec, nullptr)<0)
 #else
@@ -313,7 +342,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frame
 }
 #else
 FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint):
-	ownedContext(false),curBuffer(0),codecContext(_c),curBufferOffset(0),embeddedvideotag(nullptr)
+	ownedContext(false),curBuffer(0),codecContext(_c),streamingbuffers(FFMPEGVIDEODECODERBUFFERSIZE),embeddedbuffers(2),timeBase({1,1000}),curBufferOffset(0),embeddedvideotag(nullptr)
 {
 	frameIn=av_frame_alloc();
 	status=INIT;
@@ -333,6 +362,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint)
 			return;
 	}
 	const AVCodec* codec=avcodec_find_decoder(codecContext->codec_id);
+	setupThreading(codec);
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(53,8,0)
 	if(avcodec_open2(codecContext, codec, nullptr)<0)
 #else
@@ -351,6 +381,9 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint)
 FFMpegVideoDecoder::~FFMpegVideoDecoder()
 {
 	while(fenceCount);
+	// release the frame references before the codec context that owns their buffers
+	streamingbuffers.regen(YUVBufferGenerator());
+	embeddedbuffers.regen(YUVBufferGenerator());
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55,63,100)
 	avcodec_free_context(&codecContext);
 #else
@@ -368,17 +401,18 @@ FFMpegVideoDecoder::~FFMpegVideoDecoder()
 //setSize is called from the routine that inserts new frames
 void FFMpegVideoDecoder::setSize(uint32_t w, uint32_t h)
 {
+	//decodedframebuffer is reallocated, it may be read by drawFrameToBitmap at the same time
+	Locker l(frameMutex);
 	if(VideoDecoder::setSize(w,h))
 	{
 		//Discard all the frames
 		while(discardFrame());
 	
-		//As the size changed, reset the buffer
-		uint32_t bufferSize=frameWidth*frameHeight/**4*/;
+		//As the size changed, release the buffers, they are reallocated on demand
 		if (embeddedvideotag)
-			embeddedbuffers.regen(YUVBufferGenerator(bufferSize,this->codecContext->pix_fmt==AV_PIX_FMT_YUVA420P, this->codecContext->pix_fmt!=AV_PIX_FMT_BGRA));
+			embeddedbuffers.regen(YUVBufferGenerator());
 		else
-			streamingbuffers.regen(YUVBufferGenerator(bufferSize,this->codecContext->pix_fmt==AV_PIX_FMT_YUVA420P, this->codecContext->pix_fmt!=AV_PIX_FMT_BGRA));
+			streamingbuffers.regen(YUVBufferGenerator());
 	}
 }
 
@@ -458,6 +492,8 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 		return 0;
 	pkt->data=data;
 	pkt->size=datalen;
+	//The decoder may return the frames of earlier packets (frame threading, reordering), so it has to carry the time
+	pkt->pts=time==UINT32_MAX ? AV_NOPTS_VALUE : time;
 	int ret = avcodec_send_packet(codecContext, pkt);
 	while (ret == 0)
 	{
@@ -480,9 +516,9 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 			if(status==INIT && fillDataAndCheckValidity())
 				status=VALID;
 	
-			assert(frameIn->pts==(int64_t)AV_NOPTS_VALUE || frameIn->pts==0);
-			if (time != UINT32_MAX)
-				copyFrameToBuffers(frameIn, time);
+			uint32_t frametime=getFrameTime(frameIn, time);
+			if (frametime != UINT32_MAX)
+				copyFrameToBuffers(frameIn, frametime);
 		}
 	}
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,12,100)
@@ -555,7 +591,7 @@ bool FFMpegVideoDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 					LOG(LOG_NOT_IMPLEMENTED,"sending metadata from stream:"<<entry->key<<" "<<entry->value);
 				}
 			}
-			copyFrameToBuffers(frameIn, time);
+			copyFrameToBuffers(frameIn, getFrameTime(frameIn, time));
 		}
 	}
 #else
@@ -588,16 +624,105 @@ bool FFMpegVideoDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 	return true;
 }
 
+uint32_t FFMpegVideoDecoder::getFrameTime(const AVFrame* frame, uint32_t fallback) const
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,106,102)
+	int64_t ts=frame->best_effort_timestamp;
+	if (ts==(int64_t)AV_NOPTS_VALUE)
+		ts=frame->pts;
+	if (ts==(int64_t)AV_NOPTS_VALUE || timeBase.num==0)
+		return fallback;
+	return (uint32_t)av_rescale_q(ts,timeBase,AVRational{1,1000});
+#else
+	return fallback;
+#endif
+}
+
+void FFMpegVideoDecoder::drainFrames()
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57,106,102)
+	if (embeddedvideotag || status==INIT)
+		return;
+	if (avcodec_send_packet(codecContext, nullptr) != 0)
+		return;
+	while (avcodec_receive_frame(codecContext,frameIn) == 0)
+	{
+		uint32_t frametime=getFrameTime(frameIn, UINT32_MAX);
+		if (frametime != UINT32_MAX)
+			copyFrameToBuffers(frameIn, frametime);
+	}
+	//Leave the end of stream state, so decoding can continue after a seek
+	avcodec_flush_buffers(codecContext);
+#endif
+}
+
+void FFMpegVideoDecoder::allocatePlanes(YUVBuffer& buf)
+{
+	if (buf.planes[0])
+		return;
+	uint32_t bufferSize=frameWidth*frameHeight;
+	if (codecContext->pix_fmt==AV_PIX_FMT_BGRA)
+	{
+		aligned_malloc((void**)&buf.planes[0], 16, bufferSize*4);
+		return;
+	}
+	aligned_malloc((void**)&buf.planes[0], 16, bufferSize);
+	aligned_malloc((void**)&buf.planes[1], 16, bufferSize/4);
+	aligned_malloc((void**)&buf.planes[2], 16, bufferSize/4);
+	if (codecContext->pix_fmt==AV_PIX_FMT_YUVA420P)
+		aligned_malloc((void**)&buf.planes[3], 16, bufferSize);
+}
+
 void FFMpegVideoDecoder::copyFrameToBuffers(const AVFrame* frameIn, uint32_t time)
 {
 	YUVBuffer* curTail=nullptr;
 	curTail=embeddedvideotag ?  &embeddedbuffers.acquireLast() : &streamingbuffers.acquireLast();
 	//Only one thread may access the tail
+	{
+		Locker l(frameMutex);
+		curTail->releaseFrame();
+		fillBuffer(*curTail,frameIn);
+		curTail->time=time;
+	}
+	if (embeddedvideotag)
+		embeddedbuffers.commitLast();
+	else
+		streamingbuffers.commitLast();
+}
+
+void FFMpegVideoDecoder::fillBuffer(YUVBuffer& buf, const AVFrame* frameIn)
+{
+	YUVBuffer* curTail=&buf;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55,45,101)
+	// Planar frames with refcounted buffers are kept as they are, the planes are packed during upload
+	if (codecContext->pix_fmt!=AV_PIX_FMT_BGRA && frameIn->buf[0] &&
+		(uint32_t)frameIn->width==frameWidth && (uint32_t)frameIn->height==frameHeight)
+	{
+		if (!curTail->frame)
+			curTail->frame=av_frame_alloc();
+		if (curTail->frame && av_frame_ref(curTail->frame,frameIn)==0)
+		{
+			curTail->releasePlanes();
+			for(int i=0;i<4;i++)
+			{
+				curTail->ch[i]=curTail->frame->data[i];
+				curTail->linesize[i]=curTail->frame->linesize[i];
+			}
+			if (codecContext->pix_fmt!=AV_PIX_FMT_YUVA420P)
+				curTail->ch[3]=nullptr;
+			return;
+		}
+	}
+#endif
+	allocatePlanes(*curTail);
+	for(int i=0;i<4;i++)
+		curTail->ch[i]=curTail->planes[i];
 	int offset[3]={0,0,0};
 	// ffmpeg seems to decode GIFs in AV_PIX_FMT_BGRA format and puts all data in first channel
 	if (codecContext->pix_fmt==AV_PIX_FMT_BGRA)
 	{
 		uint32_t fw = frameWidth*4;
+		curTail->linesize[0]=fw;
 		for(uint32_t y=0;y<frameHeight;y++)
 		{
 			for(uint32_t x=0;x<frameWidth;x++)
@@ -612,29 +737,25 @@ void FFMpegVideoDecoder::copyFrameToBuffers(const AVFrame* frameIn, uint32_t tim
 	}
 	else
 	{
+		curTail->linesize[0]=frameWidth;
+		curTail->linesize[1]=frameWidth/2;
+		curTail->linesize[2]=frameWidth/2;
+		curTail->linesize[3]=frameWidth;
 		for(uint32_t y=0;y<frameHeight;y++)
 		{
 			memcpy(curTail->ch[0]+offset[0],frameIn->data[0]+(y*frameIn->linesize[0]),frameWidth);
 			if (codecContext->pix_fmt==AV_PIX_FMT_YUVA420P)
-				memcpy(curTail->ch[3]+offset[0],frameIn->data[3]+(y*frameIn->linesize[0]),frameWidth);
+				memcpy(curTail->ch[3]+offset[0],frameIn->data[3]+(y*frameIn->linesize[3]),frameWidth);
 			offset[0]+=frameWidth;
 		}
-		if (codecContext->pix_fmt!=AV_PIX_FMT_BGRA)
+		for(uint32_t y=0;y<frameHeight/2;y++)
 		{
-			for(uint32_t y=0;y<frameHeight/2;y++)
-			{
-				memcpy(curTail->ch[1]+offset[1],frameIn->data[1]+(y*frameIn->linesize[1]),frameWidth/2);
-				memcpy(curTail->ch[2]+offset[2],frameIn->data[2]+(y*frameIn->linesize[2]),frameWidth/2);
-				offset[1]+=frameWidth/2;
-				offset[2]+=frameWidth/2;
-			}
+			memcpy(curTail->ch[1]+offset[1],frameIn->data[1]+(y*frameIn->linesize[1]),frameWidth/2);
+			memcpy(curTail->ch[2]+offset[2],frameIn->data[2]+(y*frameIn->linesize[2]),frameWidth/2);
+			offset[1]+=frameWidth/2;
+			offset[2]+=frameWidth/2;
 		}
 	}
-	curTail->time=time;
-	if (embeddedvideotag)
-		embeddedbuffers.commitLast();
-	else
-		streamingbuffers.commitLast();
 }
 
 uint8_t* FFMpegVideoDecoder::upload(bool refresh)
@@ -669,53 +790,112 @@ uint8_t* FFMpegVideoDecoder::upload(bool refresh)
 	}
 	//At least a frame is available
 	YUVBuffer* cur=embeddedvideotag ? &embeddedbuffers.front() : &streamingbuffers.front();
+	Locker l(frameMutex);
+	if (!cur->ch[0])
+		return decodedframebuffer;
+	uint32_t texw= (frameWidth+15)&0xfffffff0;
 	if (codecContext->pix_fmt==AV_PIX_FMT_BGRA)
 	{
 		memcpy(decodedframebuffer,cur->ch[0],frameWidth*frameHeight*4);
 	}
-	else
+	else if ((uint32_t)cur->linesize[0]==frameWidth && (uint32_t)cur->linesize[1]==frameWidth/2 && (uint32_t)cur->linesize[2]==frameWidth/2)
 	{
 		fastYUV420ChannelsToYUV0Buffer(cur->ch[0],cur->ch[1],cur->ch[2],decodedframebuffer,frameWidth,frameHeight);
-		if (codecContext->pix_fmt==AV_PIX_FMT_YUVA420P)
+	}
+	else if (((uintptr_t)cur->ch[0]|(uintptr_t)cur->ch[1]|(uintptr_t)cur->ch[2]|cur->linesize[0]|cur->linesize[1]|cur->linesize[2])%16==0)
+	{
+		// planes of a referenced frame with padded lines, pack them row by row.
+		// The packer may read up to the next 16 bytes of every line, which are part of the padding
+		for(uint32_t i=0;i<frameHeight;i++)
+			fastYUV420ChannelsToYUV0Buffer(cur->ch[0]+i*cur->linesize[0],cur->ch[1]+(i/2)*cur->linesize[1],cur->ch[2]+(i/2)*cur->linesize[2],decodedframebuffer+i*texw*4,frameWidth,1);
+	}
+	else
+	{
+		// unaligned planes
+		for(uint32_t i=0;i<frameHeight;i++)
 		{
-			uint32_t texw= (frameWidth+15)&0xfffffff0;
-			for(uint32_t i=0;i<frameHeight;i++)
+			const uint8_t* y=cur->ch[0]+i*cur->linesize[0];
+			const uint8_t* u=cur->ch[1]+(i/2)*cur->linesize[1];
+			const uint8_t* v=cur->ch[2]+(i/2)*cur->linesize[2];
+			uint8_t* out=decodedframebuffer+i*texw*4;
+			for(uint32_t j=0;j<frameWidth;j++)
 			{
-				for(uint32_t j=0;j<frameWidth;j++)
-				{
-					uint32_t pixelCoordFull=i*texw+j;
-					decodedframebuffer[pixelCoordFull*4+3]=cur->ch[3][i*frameWidth+j];
-				}
+				out[j*4+0]=y[j];
+				out[j*4+1]=u[j/2];
+				out[j*4+2]=v[j/2];
+				out[j*4+3]=0xff;
 			}
 		}
 	}
+	if (codecContext->pix_fmt==AV_PIX_FMT_YUVA420P && cur->ch[3])
+	{
+		for(uint32_t i=0;i<frameHeight;i++)
+		{
+			for(uint32_t j=0;j<frameWidth;j++)
+			{
+				uint32_t pixelCoordFull=i*texw+j;
+				decodedframebuffer[pixelCoordFull*4+3]=cur->ch[3][i*cur->linesize[3]+j];
+			}
+		}
+	}
+	frameAvailable=true;
 	return decodedframebuffer;
 }
 
-void FFMpegVideoDecoder::YUVBufferGenerator::init(YUVBuffer& buf) const
+bool FFMpegVideoDecoder::drawFrameToBitmap(BitmapContainer* bc, int32_t x, int32_t y)
 {
-	if(buf.ch[0])
+	// GIFs are decoded to BGRA and have no YUV data
+	if (codecContext->pix_fmt==AV_PIX_FMT_BGRA)
+		return false;
+	//upload() and setSize() write decodedframebuffer on other threads
+	Locker l(frameMutex);
+	//The buffer is not initialized before the first frame is uploaded
+	if (!decodedframebuffer || !frameAvailable)
+		return false;
+	uint32_t texw= (frameWidth+15)&0xfffffff0;
+	bc->drawYUVAFrame(decodedframebuffer,texw*4,frameWidth,frameHeight,x,y,codecContext->pix_fmt==AV_PIX_FMT_YUVA420P,colorSpace);
+	return true;
+}
+
+void FFMpegVideoDecoder::YUVBuffer::releaseFrame()
+{
+	if(frame)
+		av_frame_unref(frame);
+}
+
+void FFMpegVideoDecoder::YUVBuffer::releasePlanes()
+{
+	for(int i=0;i<4;i++)
 	{
-		aligned_free(buf.ch[0]);
-		if (hasChannels)
-		{
-			aligned_free(buf.ch[1]);
-			aligned_free(buf.ch[2]);
-			if (buf.ch[3])
-				aligned_free(buf.ch[3]);
-		}
+		if(planes[i])
+			aligned_free(planes[i]);
+		planes[i]=nullptr;
 	}
-	if (hasChannels)
+}
+
+void FFMpegVideoDecoder::YUVBuffer::cleanup()
+{
+	releaseFrame();
+	releasePlanes();
+	if(frame)
 	{
-		aligned_malloc((void**)&buf.ch[0], 16, bufferSize);
-		aligned_malloc((void**)&buf.ch[1], 16, bufferSize/4);
-		aligned_malloc((void**)&buf.ch[2], 16, bufferSize/4);
-		if (hasAlpha)
-			aligned_malloc((void**)&buf.ch[3], 16, bufferSize);
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 0, 0)
+		av_frame_free(&frame);
+#else
+		av_free(frame);
+#endif
 	}
-	else
+	frame=nullptr;
+}
+
+void FFMpegVideoDecoder::YUVBufferGenerator::init(YUVBuffer& buf) const
+{
+	buf.releaseFrame();
+	buf.releasePlanes();
+	for(int i=0;i<4;i++)
 	{
-		aligned_malloc((void**)&buf.ch[0], 16, bufferSize*4);
+		buf.ch[i]=nullptr;
+		buf.linesize[i]=0;
 	}
 }
 #endif //ENABLE_LIBAVCODEC
@@ -1885,6 +2065,7 @@ FFMpegStreamDecoder::FFMpegStreamDecoder(NetStream *ns, EngineData *eng, std::is
 		double frameRate=av_q2d(rateRational);
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 40, 101)
 		customVideoDecoder=new FFMpegVideoDecoder(formatCtx->streams[videoIndex]->codecpar,frameRate);
+		customVideoDecoder->setTimeBase(formatCtx->streams[videoIndex]->time_base);
 #else
 		customVideoDecoder=new FFMpegVideoDecoder(formatCtx->streams[videoIndex]->codec,frameRate);
 #endif
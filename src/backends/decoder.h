@@ -23,6 +23,7 @@
 #include "compat.h"
 #include "threading.h"
 #include "backends/graphics.h"
+#include "platforms/fastpaths.h"
 #ifdef ENABLE_LIBAVCODEC
 extern "C"
 {
@@ -77,6 +78,7 @@ public:
 };
 class NetStream;
 class EngineData;
+class BitmapContainer;
 
 class Decoder
 {
@@ -109,6 +111,8 @@ class VideoDecoder: public Decoder, public ITextureUploadable
 {
 protected:
 	uint8_t* decodedframebuffer;
+	// set when a frame has been written to decodedframebuffer
+	bool frameAvailable;
 public:
 	VideoDecoder();
 	virtual ~VideoDecoder();
@@ -117,6 +121,11 @@ public:
 	virtual bool discardFrame()=0;
 	virtual uint32_t skipUntil(uint32_t time)=0;
 	virtual void skipAll()=0;
+	/*
+		Decodes the frames that are still buffered in the decoder at the end of the stream,
+		must be called from the decoding thread
+	*/
+	virtual void drainFrames() {}
 	uint32_t getWidth()
 	{
 		return frameWidth;
@@ -140,6 +149,10 @@ public:
 	bool isUploading() { return fenceCount; }
 	void setVideoFrameToDecode(uint32_t frame) { currentframe=frame; }
 	void clearFrameBuffer();
+	/*
+		Converts the last uploaded frame into the bitmap at x/y, returns false if the frame is not available as YUV data
+	*/
+	virtual bool drawFrameToBitmap(BitmapContainer* bc, int32_t x, int32_t y) { return false; }
 protected:
 	TextureChunk videoTexture;
 	uint32_t frameWidth;
@@ -153,6 +166,7 @@ protected:
 	bool setSize(uint32_t w, uint32_t h);
 	bool resizeIfNeeded(TextureChunk& tex);
 	LS_VIDEO_CODEC videoCodec;
+	YUV_COLORSPACE colorSpace;
 private:
 	bool resizeGLBuffers;
 	bool markedForDeletion;
@@ -183,53 +197,43 @@ public:
 class FFMpegVideoDecoder: public VideoDecoder
 {
 private:
+	/*
+	 * A decoded frame. If the decoder hands out refcounted frames a reference to the AVFrame
+	 * is kept and the planes are read in place, otherwise the frame is copied into planes
+	 * allocated once per stream size
+	 */
 	class YUVBuffer
 	{
 	YUVBuffer(const YUVBuffer&); /* no impl */
 	YUVBuffer& operator=(const YUVBuffer&); /* no impl */
 	public:
 		uint8_t* ch[4];
+		int linesize[4];
+		uint8_t* planes[4];
+		AVFrame* frame;
 		uint32_t time;
-		YUVBuffer():time(0){ch[0]=nullptr;ch[1]=nullptr;ch[2]=nullptr;ch[3]=nullptr;}
+		YUVBuffer():frame(nullptr),time(0){init();}
 		~YUVBuffer()
 		{
-			setDecodedData(nullptr);
-		}
-		void setDecodedData(uint8_t* data)
-		{
-			if(ch[0])
-				aligned_free(ch[0]);
-			if(ch[1])
-				aligned_free(ch[1]);
-			if(ch[2])
-				aligned_free(ch[2]);
-			if(ch[3])
-				aligned_free(ch[3]);
-			ch[0]=data;
-			ch[1]=nullptr;
-			ch[2]=nullptr;
-			ch[3]=nullptr;
+			cleanup();
 		}
+		void releaseFrame();
+		void releasePlanes();
 		void init()
 		{
-			ch[0]=nullptr;
-			ch[1]=nullptr;
-			ch[2]=nullptr;
-			ch[3]=nullptr;
-		}
-		void cleanup()
-		{
-			setDecodedData(nullptr);
+			for(int i=0;i<4;i++)
+			{
+				ch[i]=nullptr;
+				linesize[i]=0;
+				planes[i]=nullptr;
+			}
+			frame=nullptr;
 		}
+		void cleanup();
 	};
 	class YUVBufferGenerator
 	{
-	private:
-		uint32_t bufferSize;
-		bool hasAlpha;
-		bool hasChannels;
 	public:
-		YUVBufferGenerator(uint32_t b, bool _hasalpha, bool _haschannels):bufferSize(b),hasAlpha(_hasalpha),hasChannels(_haschannels){}
 		void init(YUVBuffer& buf) const;
 	};
 	bool ownedContext;
@@ -239,7 +243,15 @@ private:
 	BlockingCircularQueue<YUVBuffer> embeddedbuffers;
 	AVFrame* frameIn;
 	void copyFrameToBuffers(const AVFrame* frameIn, uint32_t time);
+	void allocatePlanes(YUVBuffer& buf);
+	void fillBuffer(YUVBuffer& buf, const AVFrame* frameIn);
 	void setSize(uint32_t w, uint32_t h);
+	void setupThreading(const AVCodec* codec);
+	// protects the frames referenced by the buffers while they are uploaded
+	Mutex frameMutex;
+	// time base of the packet timestamps, milliseconds unless set by FFMpegStreamDecoder
+	AVRational timeBase;
+	uint32_t getFrameTime(const AVFrame* frame, uint32_t fallback) const;
 	bool fillDataAndCheckValidity();
 	uint32_t curBufferOffset;
 	DefineVideoStreamTag* embeddedvideotag;
@@ -258,6 +270,8 @@ public:
 	   Specialized decoding used by FFMpegStreamDecoder
 	*/
 	bool decodePacket(AVPacket* pkt, uint32_t time);
+	void setTimeBase(AVRational tb) { timeBase=tb; }
+	void drainFrames() override;
 	void switchCodec(LS_VIDEO_CODEC codecId, uint8_t* initdata, uint32_t datalen, double frameRateHint) override;
 	bool decodeData(uint8_t* data, uint32_t datalen, uint32_t time) override;
 	bool discardFrame() override;
@@ -283,6 +297,7 @@ public:
 			}
 		}
 	}
+	bool drawFrameToBitmap(BitmapContainer* bc, int32_t x, int32_t y) override;
 	//ITextureUploadable interface
 	uint8_t* upload(bool refresh) override;
 };
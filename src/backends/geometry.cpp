@@ -302,6 +302,28 @@ bool tokensVector::hitTest(SystemState* sys, const Vector2f& point, float scalin
 					infill=false;
 					break;
 				}
+				case TRIANGLE_MESH:
+				{
+					GeomToken p1(*(++it),false);
+					if (!p1.mesh->triangleCount())
+						break;
+					if (renderneeded)
+					{
+						if (instroke)
+							nvgStrokeHitRegion(nvgctxt, hitregionid);
+						if (infill)
+							nvgFillHitRegion(nvgctxt, hitregionid);
+						renderneeded=false;
+						nvgClosePath(nvgctxt);
+						nvgBeginPath(nvgctxt);
+					}
+					firstmove=false;
+					p1.mesh->addNanoVGPath(nvgctxt);
+					nvgFillHitRegion(nvgctxt, hitregionid);
+					nvgClosePath(nvgctxt);
+					nvgBeginPath(nvgctxt);
+					break;
+				}
 				case CLEAR_STROKE:
 					if (renderneeded)
 					{
@@ -369,9 +391,17 @@ LINESTYLE2& tokenListRef::addLineStyle(const LINESTYLE2& ls)
 	return cacheentry->style;
 }
 
+TriangleMesh& tokenListRef::addTriangleMesh()
+{
+	meshes.push_back(_MR(new TriangleMesh()));
+	return *meshes.back().getPtr();
+}
+
 void tokenListRef::clone(tokenListRef* source)
 {
 	tokens.assign(source->tokens.begin(),source->tokens.end());
+	// meshes are not modified after creation, so the tokens can point to the meshes of the source
+	meshes = source->meshes;
 	fillstylecache* fs = source->fillStyles;
 	while (fs)
 	{
@@ -385,3 +415,48 @@ void tokenListRef::clone(tokenListRef* source)
 		ls = ls->next;
 	}
 }
+
+bool TriangleMesh::getTextureTransform(uint32_t triangle, float texturewidth, float textureheight, float* xform) const
+{
+	uint32_t i0=indices[triangle*3];
+	uint32_t i1=indices[triangle*3+1];
+	uint32_t i2=indices[triangle*3+2];
+	double s0=uvs[i0*2]*texturewidth;
+	double t0=uvs[i0*2+1]*textureheight;
+	double ds1=uvs[i1*2]*texturewidth-s0;
+	double dt1=uvs[i1*2+1]*textureheight-t0;
+	double ds2=uvs[i2*2]*texturewidth-s0;
+	double dt2=uvs[i2*2+1]*textureheight-t0;
+	double det=ds1*dt2-ds2*dt1;
+	if (det==0)
+		return false;
+	double x0=vertices[i0*2];
+	double y0=vertices[i0*2+1];
+	double dx1=vertices[i1*2]-x0;
+	double dy1=vertices[i1*2+1]-y0;
+	double dx2=vertices[i2*2]-x0;
+	double dy2=vertices[i2*2+1]-y0;
+	// solve the linear part so that (ds1,dt1) maps to (dx1,dy1) and (ds2,dt2) maps to (dx2,dy2)
+	double a=(dx1*dt2-dx2*dt1)/det;
+	double b=(dy1*dt2-dy2*dt1)/det;
+	double c=(dx2*ds1-dx1*ds2)/det;
+	double d=(dy2*ds1-dy1*ds2)/det;
+	xform[0]=a;
+	xform[1]=b;
+	xform[2]=c;
+	xform[3]=d;
+	xform[4]=x0-a*s0-c*t0;
+	xform[5]=y0-b*s0-d*t0;
+	return true;
+}
+
+void TriangleMesh::addNanoVGPath(NVGcontext* nvgctxt) const
+{
+	for (uint32_t i = 0; i < indices.size(); i+=3)
+	{
+		nvgMoveTo(nvgctxt,vertices[indices[i]*2],vertices[indices[i]*2+1]);
+		nvgLineTo(nvgctxt,vertices[indices[i+1]*2],vertices[indices[i+1]*2+1]);
+		nvgLineTo(nvgctxt,vertices[indices[i+2]*2],vertices[indices[i+2]*2+1]);
+		nvgClosePath(nvgctxt);
+	}
+}
@@ -137,7 +137,9 @@ struct RectF
 	RectF& operator/=(const T& value) { return *this = *this / value; }
 };
 
-enum GEOM_TOKEN_TYPE { STRAIGHT=0, CURVE_QUADRATIC, MOVE, SET_FILL, SET_STROKE, CLEAR_FILL, CLEAR_STROKE, CURVE_CUBIC, FILL_KEEP_SOURCE, FILL_TRANSFORM_TEXTURE };
+enum GEOM_TOKEN_TYPE { STRAIGHT=0, CURVE_QUADRATIC, MOVE, SET_FILL, SET_STROKE, CLEAR_FILL, CLEAR_STROKE, CURVE_CUBIC, FILL_KEEP_SOURCE, TRIANGLE_MESH };
+
+class TriangleMesh;
 
 union floatVec
 {
@@ -161,6 +163,7 @@ struct GeomToken
 		} vec;
 		const FILLSTYLE*  fillStyle; // make sure the pointer is valid until rendering is done
 		const LINESTYLE2* lineStyle; // make sure the pointer is valid until rendering is done
+		const TriangleMesh* mesh; // make sure the pointer is valid until rendering is done
 		number_t value;
 		uint64_t uval;// this is used to have direct access to the value as it is stored in a vector<uint64_t> for performance
 	};
@@ -176,6 +179,7 @@ struct GeomToken
 	}
 	GeomToken(const FILLSTYLE& fs):fillStyle(&fs) {}
 	GeomToken(const LINESTYLE2& ls):lineStyle(&ls) {}
+	GeomToken(const TriangleMesh& m):mesh(&m) {}
 	GeomToken(number_t val):value(val) {}
 	GeomToken(const Vector2& _vec)
 	{
@@ -209,10 +213,33 @@ struct linestylecache
 			delete next;
 	}
 };
+/*
+ * Triangles generated by Graphics.drawTriangles, referenced by a TRIANGLE_MESH token.
+ * The mesh is filled with the current fill style, for textured meshes this has to be a bitmap fill.
+ * Culled triangles are not added to the index buffer.
+ * The mesh is not modified after the token was added, so it can be shared between token lists
+ */
+class TriangleMesh : public RefCountable
+{
+public:
+	std::vector<float> vertices; // x/y pairs in twips
+	std::vector<float> uvs; // u/v pairs normalized to the texture size, empty for meshes without texture coordinates
+	std::vector<uint32_t> indices; // 3 indices for every triangle
+	float xmin, xmax, ymin, ymax;
+	TriangleMesh():xmin(0),xmax(0),ymin(0),ymax(0) {}
+	bool isTextured() const { return !uvs.empty(); }
+	uint32_t triangleCount() const { return indices.size()/3; }
+	// computes the nanoVG style transformation from texture pixels to mesh coordinates for a triangle, returns false for degenerate triangles
+	bool getTextureTransform(uint32_t triangle, float texturewidth, float textureheight, float* xform) const;
+	// adds every triangle as a closed sub path to the current nanoVG path
+	void addNanoVGPath(NVGcontext* nvgctxt) const;
+};
+
 class tokenListRef : public RefCountable
 {
 	fillstylecache* fillStyles;
 	linestylecache* lineStyles;
+	std::vector<_R<TriangleMesh>> meshes;
 public:
 	TokenList tokens;
 	tokenListRef():fillStyles(nullptr),lineStyles(nullptr)
@@ -221,6 +248,7 @@ public:
 	~tokenListRef();
 	FILLSTYLE& addFillStyle(const FILLSTYLE& fs);
 	LINESTYLE2& addLineStyle(const LINESTYLE2& ls);
+	TriangleMesh& addTriangleMesh();
 	void clone(tokenListRef* source);
 };
 
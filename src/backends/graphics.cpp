@@ -18,6 +18,7 @@
 **************************************************************************/
 
 #include <cassert>
+#include <cfloat>
 
 #include "swf.h"
 #include "abc.h"
@@ -367,6 +368,216 @@ void CairoTokenRenderer::executefill(cairo_t* cr, const FILLSTYLE* style, cairo_
 	cairo_set_matrix(cr,&origmat);
 }
 
+void CairoTokenRenderer::triangleMeshPath(cairo_t* cr, const TriangleMesh* mesh)
+{
+	for (uint32_t i = 0; i < mesh->indices.size(); i+=3)
+	{
+		const float* v0 = &mesh->vertices[mesh->indices[i]*2];
+		const float* v1 = &mesh->vertices[mesh->indices[i+1]*2];
+		const float* v2 = &mesh->vertices[mesh->indices[i+2]*2];
+		cairo_move_to(cr, v0[0], v0[1]);
+		cairo_line_to(cr, v1[0], v1[1]);
+		cairo_line_to(cr, v2[0], v2[1]);
+		cairo_close_path(cr);
+	}
+}
+
+static inline uint32_t textureCoordinate(int32_t c, int32_t size, bool repeat)
+{
+	if (repeat)
+	{
+		c %= size;
+		return c < 0 ? c+size : c;
+	}
+	return c < 0 ? 0 : (c >= size ? size-1 : c);
+}
+
+static inline uint32_t sampleTexture(const uint32_t* texture, int32_t width, int32_t height, double s, double t, bool repeat, bool smooth)
+{
+	if (!smooth)
+		return texture[textureCoordinate(floor(t),height,repeat)*width+textureCoordinate(floor(s),width,repeat)];
+	// bilinear filtering with 8 bit weights, the texels are premultiplied so the channels can be interpolated independently
+	s -= 0.5;
+	t -= 0.5;
+	double sf = floor(s);
+	double tf = floor(t);
+	uint32_t fx = (s-sf)*256;
+	uint32_t fy = (t-tf)*256;
+	uint32_t x0 = textureCoordinate(sf,width,repeat);
+	uint32_t x1 = textureCoordinate(sf+1,width,repeat);
+	uint32_t y0 = textureCoordinate(tf,height,repeat)*width;
+	uint32_t y1 = textureCoordinate(tf+1,height,repeat)*width;
+	uint32_t p00 = texture[y0+x0];
+	uint32_t p01 = texture[y0+x1];
+	uint32_t p10 = texture[y1+x0];
+	uint32_t p11 = texture[y1+x1];
+	uint32_t res = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t top = ((p00>>shift)&0xff)*(256-fx) + ((p01>>shift)&0xff)*fx;
+		uint32_t bottom = ((p10>>shift)&0xff)*(256-fx) + ((p11>>shift)&0xff)*fx;
+		res |= (((top*(256-fy) + bottom*fy)>>16)&0xff)<<shift;
+	}
+	return res;
+}
+
+bool CairoTokenRenderer::rasterizeTriangleMesh(cairo_t* cr, const TriangleMesh* mesh, const FILLSTYLE* style)
+{
+	if (style->bitmap.isNull())
+		return false;
+	bool repeat;
+	bool smooth;
+	switch (style->FillStyleType)
+	{
+		case REPEATING_BITMAP:
+			repeat = true;
+			smooth = true;
+			break;
+		case CLIPPED_BITMAP:
+			repeat = false;
+			smooth = true;
+			break;
+		case NON_SMOOTHED_REPEATING_BITMAP:
+			repeat = true;
+			smooth = false;
+			break;
+		case NON_SMOOTHED_CLIPPED_BITMAP:
+			repeat = false;
+			smooth = false;
+			break;
+		default:
+			return false;
+	}
+	const uint32_t* texture = (const uint32_t*)style->bitmap->getData();
+	int32_t texturewidth = style->bitmap->getWidth();
+	int32_t textureheight = style->bitmap->getHeight();
+	if (!texture || texturewidth <= 0 || textureheight <= 0)
+		return true;
+
+	// the mesh is rasterized into an image covering its device space bounds, which is then painted through the context,
+	// so the clip and pushed groups are respected
+	cairo_matrix_t m;
+	cairo_get_matrix(cr, &m);
+	double minx = DBL_MAX, miny = DBL_MAX, maxx = -DBL_MAX, maxy = -DBL_MAX;
+	for (uint32_t i = 0; i < mesh->indices.size(); i++)
+	{
+		double vx = mesh->vertices[mesh->indices[i]*2];
+		double vy = mesh->vertices[mesh->indices[i]*2+1];
+		cairo_matrix_transform_point(&m, &vx, &vy);
+		minx = std::min(minx, vx);
+		miny = std::min(miny, vy);
+		maxx = std::max(maxx, vx);
+		maxy = std::max(maxy, vy);
+	}
+	cairo_identity_matrix(cr);
+	double clipx1, clipy1, clipx2, clipy2;
+	cairo_clip_extents(cr, &clipx1, &clipy1, &clipx2, &clipy2);
+	double left = floor(std::max(minx, clipx1));
+	double top = floor(std::max(miny, clipy1));
+	double right = ceil(std::min(maxx, clipx2));
+	double bottom = ceil(std::min(maxy, clipy2));
+	if (right <= left || bottom <= top)
+	{
+		cairo_set_matrix(cr, &m);
+		return true;
+	}
+	int32_t width = right-left;
+	int32_t height = bottom-top;
+	cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+	{
+		cairo_surface_destroy(surface);
+		cairo_set_matrix(cr, &m);
+		return false;
+	}
+	uint8_t* data = cairo_image_surface_get_data(surface);
+	int32_t stride = cairo_image_surface_get_stride(surface);
+	for (uint32_t i = 0; i < mesh->triangleCount(); i++)
+	{
+		double x[3], y[3], s[3], t[3];
+		for (uint32_t j = 0; j < 3; j++)
+		{
+			uint32_t idx = mesh->indices[i*3+j];
+			x[j] = mesh->vertices[idx*2];
+			y[j] = mesh->vertices[idx*2+1];
+			cairo_matrix_transform_point(&m, &x[j], &y[j]);
+			x[j] -= left;
+			y[j] -= top;
+			s[j] = mesh->uvs[idx*2]*texturewidth;
+			t[j] = mesh->uvs[idx*2+1]*textureheight;
+		}
+		double area = (x[1]-x[0])*(y[2]-y[0])-(x[2]-x[0])*(y[1]-y[0]);
+		if (fabs(area) < 1e-9)
+			continue;
+		// the texture coordinates are affine in device space
+		double dsdx = ((s[1]-s[0])*(y[2]-y[0])-(s[2]-s[0])*(y[1]-y[0]))/area;
+		double dsdy = ((s[2]-s[0])*(x[1]-x[0])-(s[1]-s[0])*(x[2]-x[0]))/area;
+		double dtdx = ((t[1]-t[0])*(y[2]-y[0])-(t[2]-t[0])*(y[1]-y[0]))/area;
+		double dtdy = ((t[2]-t[0])*(x[1]-x[0])-(t[1]-t[0])*(x[2]-x[0]))/area;
+		double orientation = area > 0 ? 1 : -1;
+		double ymin = ceil(std::min(y[0],std::min(y[1],y[2]))-0.5);
+		double ymax = floor(std::max(y[0],std::max(y[1],y[2]))-0.5);
+		if (ymax < 0 || ymin >= height)
+			continue;
+		int32_t ystart = std::max(0.0, ymin);
+		int32_t yend = std::min(double(height-1), ymax);
+		for (int32_t py = ystart; py <= yend; py++)
+		{
+			// find the span of pixel centers inside all three edges
+			double cy = py+0.5;
+			double xl = -1.0;
+			double xr = width;
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				uint32_t n = e == 2 ? 0 : e+1;
+				// edge function (x[n]-x[e])*(cy-y[e]) - (y[n]-y[e])*(cx-x[e]) >= 0
+				double a = orientation*((x[n]-x[e])*(cy-y[e]) + (y[n]-y[e])*x[e]);
+				double b = -orientation*(y[n]-y[e]);
+				if (b > 0)
+					xl = std::max(xl, -a/b);
+				else if (b < 0)
+					xr = std::min(xr, -a/b);
+				else if (a < 0)
+					xr = xl-1;
+			}
+			if (xl > xr)
+				continue;
+			int32_t xstart = std::max(0.0, ceil(xl-0.5));
+			int32_t xend = std::min(double(width-1), floor(xr-0.5));
+			if (xstart > xend)
+				continue;
+			double cs = s[0] + dsdx*(xstart+0.5-x[0]) + dsdy*(cy-y[0]);
+			double ct = t[0] + dtdx*(xstart+0.5-x[0]) + dtdy*(cy-y[0]);
+			uint32_t* dst = (uint32_t*)(data + py*stride) + xstart;
+			for (int32_t px = xstart; px <= xend; px++, dst++, cs += dsdx, ct += dtdx)
+			{
+				uint32_t src = sampleTexture(texture, texturewidth, textureheight, cs, ct, repeat, smooth);
+				uint32_t alpha = src>>24;
+				if (alpha == 0xff)
+					*dst = src;
+				else if (alpha)
+				{
+					// OVER operator on premultiplied pixels
+					uint32_t inv = 0xff-alpha;
+					uint32_t d = *dst;
+					uint32_t rb = (d&0xff00ff)*inv;
+					rb = ((rb + ((rb>>8)&0xff00ff) + 0x800080)>>8)&0xff00ff;
+					uint32_t ag = ((d>>8)&0xff00ff)*inv;
+					ag = (ag + ((ag>>8)&0xff00ff) + 0x800080)&0xff00ff00;
+					*dst = src + rb + ag;
+				}
+			}
+		}
+	}
+	cairo_surface_mark_dirty(surface);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+	cairo_set_source_surface(cr, surface, left, top);
+	cairo_paint(cr);
+	cairo_set_matrix(cr, &m);
+	cairo_surface_destroy(surface);
+	return true;
+}
+
 void CairoTokenRenderer::executestroke(cairo_t* cr, const LINESTYLE2* style, cairo_pattern_t* pattern, double scaleCorrection, bool isMask, CairoTokenRenderer* th, bool skippaint)
 {
 	if (!style)
@@ -585,10 +796,10 @@ bool CairoTokenRenderer::cairoPathFromTokens(cairo_t* cr, _NR<tokenListRef> toke
 				}
 				cairo_close_path(cr);
 				executefill(cr,currentfillstyle,currentfillpattern,scaleCorrection);
-				if (currentfillpattern)
-					cairo_pattern_destroy(currentfillpattern);
 				if(p.type==CLEAR_FILL)
 				{
+					if (currentfillpattern)
+						cairo_pattern_destroy(currentfillpattern);
 					// Clear source.
 					cairo_set_operator(cr, CAIRO_OPERATOR_DEST);
 					currentfillstyle=nullptr;
@@ -616,26 +827,25 @@ bool CairoTokenRenderer::cairoPathFromTokens(cairo_t* cr, _NR<tokenListRef> toke
 				// Clear source.
 				cairo_set_operator(cr, CAIRO_OPERATOR_DEST);
 				break;
-			case FILL_TRANSFORM_TEXTURE:
+			case TRIANGLE_MESH:
 			{
+				// the fill style is kept after the FILL_KEEP_SOURCE token in front of the mesh
 				GeomToken p1(*(++it),false);
-				GeomToken p2(*(++it),false);
-				GeomToken p3(*(++it),false);
-				GeomToken p4(*(++it),false);
-				GeomToken p5(*(++it),false);
-				GeomToken p6(*(++it),false);
+				const TriangleMesh* mesh = p1.mesh;
+				if (!mesh->triangleCount())
+					break;
+				empty = false;
 				if(skipPaint)
+				{
+					triangleMeshPath(cr, mesh);
 					break;
-				cairo_matrix_t origmat;
-				cairo_pattern_t* pattern;
-				pattern=cairo_get_source(cr);
-				cairo_pattern_get_matrix(pattern, &origmat);
-				MATRIX m1(p1.value,p2.value,p3.value,p4.value,p5.value,p6.value);
-				cairo_matrix_t m;
-				fillFromMATRIX(&m,m1);
-				cairo_pattern_set_matrix(pattern, &m);
+				}
+				if (!currentfillstyle)
+					break;
+				if (mesh->isTextured() && rasterizeTriangleMesh(cr, mesh, currentfillstyle))
+					break;
+				triangleMeshPath(cr, mesh);
 				executefill(cr,currentfillstyle,currentfillpattern,scaleCorrection);
-				cairo_pattern_set_matrix(pattern, &origmat);
 				break;
 			}
 			default:
@@ -196,6 +196,12 @@ private:
 	static cairo_pattern_t* FILLSTYLEToCairo(const FILLSTYLE& style, double scaleCorrection, bool isMask);
 	static bool cairoPathFromTokens(cairo_t* cr, NullableRef<tokenListRef> tokens, double scaleCorrection, bool skipFill, bool isMask, number_t xstart, number_t ystart, CairoTokenRenderer* th=nullptr, int* starttoken=nullptr,bool* hasFillTokens=nullptr);
 	static void quadraticBezier(cairo_t* cr, double control_x, double control_y, double end_x, double end_y);
+	static void triangleMeshPath(cairo_t* cr, const TriangleMesh* mesh);
+	/*
+	 * Draws a textured triangle mesh directly into the image surface of cr using the bitmap of style.
+	 * Returns false if the target surface can't be accessed directly
+	 */
+	static bool rasterizeTriangleMesh(cairo_t* cr, const TriangleMesh* mesh, const FILLSTYLE* style);
 	/*
 	   The tokens to be drawn
 	*/
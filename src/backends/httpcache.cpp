@@ -0,0 +1,340 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "backends/httpcache.h"
+#include "backends/config.h"
+#include "utils/filesystem.h"
+#include "logger.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <cinttypes>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+using namespace lightspark;
+
+// increase if the format of the index changes
+#define HTTP_CACHE_INDEX_VERSION 1
+
+namespace
+{
+// FNV-1a
+uint64_t hashBytes(uint64_t h, const uint8_t* data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= data[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+bool sameContent(const string& file1, const string& file2)
+{
+	ifstream f1(file1.c_str(), ios::binary);
+	ifstream f2(file2.c_str(), ios::binary);
+	if (!f1 || !f2)
+		return false;
+	char buf1[4096];
+	char buf2[4096];
+	while (f1 && f2)
+	{
+		f1.read(buf1,4096);
+		f2.read(buf2,4096);
+		if (f1.gcount() != f2.gcount() || memcmp(buf1,buf2,f1.gcount()) != 0)
+			return false;
+	}
+	return f1.eof() && f2.eof();
+}
+
+// fields are separated by tabs, which can't occur in URLs or header values
+bool readField(istringstream& s, string& field)
+{
+	return (bool)getline(s,field,'\t');
+}
+}
+
+void HTTPCacheWriter::write(const uint8_t* data, size_t len)
+{
+	if (failed)
+		return;
+	hash = hashBytes(hash,data,len);
+	size += len;
+	file.write((const char*)data,len);
+	failed = file.fail();
+}
+
+HTTPCache::HTTPCache(const string& dir, uint64_t maxsize):directory(dir),maxSize(maxsize),totalSize(0)
+{
+	removeTemporaryFiles();
+	load();
+	evict();
+}
+
+HTTPCache::~HTTPCache()
+{
+	Locker l(mutex);
+	save();
+}
+
+HTTPCache* HTTPCache::create()
+{
+	uint64_t size = Config::getConfig()->getHTTPCacheSize();
+	if (size == 0)
+		return nullptr;
+	Path p = Path(Config::getConfig()->getCacheDirectory()) / "http";
+	try
+	{
+		FileSystem::createDirs(p / "objects",FileSystem::Perms::OwnerAll);
+	}
+	catch (std::exception& e)
+	{
+		LOG(LOG_ERROR,"could not create HTTP cache directory:"<<e.what());
+		return nullptr;
+	}
+	return new HTTPCache(p.getStr().raw_buf(),size);
+}
+
+string HTTPCache::getObjectPath(const string& object) const
+{
+	return directory + "/objects/" + object;
+}
+
+// downloads and index updates that were interrupted leave their temporary files behind
+void HTTPCache::removeTemporaryFiles()
+{
+	try
+	{
+		for (auto entry : FileSystem::DirIter(Path(directory)))
+		{
+			tiny_string name = entry.getPath().getFilename().getStr();
+			if (entry.isFile() && (name.startsWith("tmp") || name == "index.tmp"))
+				FileSystem::remove(entry.getPath());
+		}
+	}
+	catch (std::exception& e)
+	{
+		LOG(LOG_ERROR,"HTTP cache: could not remove temporary files:"<<e.what());
+	}
+}
+
+void HTTPCache::load()
+{
+	ifstream f((directory + "/index").c_str());
+	if (!f)
+		return;
+	string line;
+	if (!getline(f,line) || line != "lightspark-httpcache " + to_string(HTTP_CACHE_INDEX_VERSION))
+	{
+		LOG(LOG_INFO,"HTTP cache: ignoring index with unknown version");
+		return;
+	}
+	while (getline(f,line))
+	{
+		istringstream s(line);
+		HTTPCacheEntry e;
+		string size, expires, lastused;
+		if (!readField(s,e.object) || !readField(s,size) || !readField(s,expires) || !readField(s,lastused)
+			|| !readField(s,e.etag) || !readField(s,e.lastModified) || !readField(s,e.contentType) || !readField(s,e.url))
+			continue;
+		e.size = strtoull(size.c_str(),nullptr,10);
+		e.expires = strtoll(expires.c_str(),nullptr,10);
+		e.lastUsed = strtoll(lastused.c_str(),nullptr,10);
+		// the object may have been deleted by hand
+		if (!FileSystem::isFile(Path(getObjectPath(e.object))))
+			continue;
+		addEntry(e);
+	}
+}
+
+// the index is written to a temporary file first, so it is never left half written
+void HTTPCache::save()
+{
+	string filename = directory + "/index";
+	string tmpname = filename + ".tmp";
+	{
+		ofstream f(tmpname.c_str(), ios::out | ios::trunc);
+		if (!f)
+		{
+			LOG(LOG_ERROR,"HTTP cache: could not write index");
+			return;
+		}
+		f << "lightspark-httpcache " << HTTP_CACHE_INDEX_VERSION << "\n";
+		for (auto it = entries.begin(); it != entries.end(); it++)
+		{
+			const HTTPCacheEntry& e = it->second;
+			f << e.object << '\t' << e.size << '\t' << e.expires << '\t' << e.lastUsed << '\t'
+			  << e.etag << '\t' << e.lastModified << '\t' << e.contentType << '\t' << e.url << '\n';
+		}
+		if (f.fail())
+		{
+			f.close();
+			std::remove(tmpname.c_str());
+			return;
+		}
+	}
+	std::rename(tmpname.c_str(),filename.c_str());
+}
+
+void HTTPCache::addEntry(const HTTPCacheEntry& e)
+{
+	// reference the new object first, the old entry may use the same object
+	if (objectRefs[e.object]++ == 0)
+		totalSize += e.size;
+	auto it = entries.find(e.url);
+	if (it != entries.end())
+		removeEntry(it);
+	entries.insert(make_pair(e.url,e));
+}
+
+void HTTPCache::removeEntry(unordered_map<string,HTTPCacheEntry>::iterator it)
+{
+	auto itobj = objectRefs.find(it->second.object);
+	assert(itobj != objectRefs.end());
+	if (--itobj->second == 0)
+	{
+		// streams using the content keep it through a mapping or their own hard link, see StreamCache::useCachedFile
+		unlink(getObjectPath(it->second.object).c_str());
+		totalSize -= it->second.size;
+		objectRefs.erase(itobj);
+	}
+	entries.erase(it);
+}
+
+void HTTPCache::evict()
+{
+	while (totalSize > maxSize && !entries.empty())
+	{
+		auto oldest = entries.begin();
+		for (auto it = entries.begin(); it != entries.end(); it++)
+		{
+			if (it->second.lastUsed < oldest->second.lastUsed)
+				oldest = it;
+		}
+		LOG(LOG_INFO,"HTTP cache: evicting " << oldest->first);
+		removeEntry(oldest);
+	}
+}
+
+bool HTTPCache::lookup(const string& url, HTTPCacheEntry& e)
+{
+	Locker l(mutex);
+	auto it = entries.find(url);
+	if (it == entries.end())
+		return false;
+	it->second.lastUsed = time(nullptr);
+	e = it->second;
+	return true;
+}
+
+void HTTPCache::refresh(const string& url, int64_t expires)
+{
+	Locker l(mutex);
+	auto it = entries.find(url);
+	if (it == entries.end())
+		return;
+	it->second.expires = expires;
+	save();
+}
+
+void HTTPCache::remove(const string& url)
+{
+	Locker l(mutex);
+	auto it = entries.find(url);
+	if (it == entries.end())
+		return;
+	removeEntry(it);
+	save();
+}
+
+HTTPCacheWriter* HTTPCache::createWriter()
+{
+	string name = directory + "/tmpXXXXXX";
+	char* filename = LS_STACKALLOC(char,name.length()+1);
+	strcpy(filename,name.c_str());
+	int fd = mkstemp(filename);
+	if (fd == -1)
+		return nullptr;
+	close(fd);
+	HTTPCacheWriter* w = new HTTPCacheWriter();
+	w->filename = filename;
+	w->hash = 0xcbf29ce484222325ULL;
+	w->size = 0;
+	w->file.open(filename, ios::binary | ios::out | ios::trunc);
+	w->failed = !w->file.is_open();
+	return w;
+}
+
+void HTTPCache::commit(HTTPCacheWriter* w, HTTPCacheEntry& e)
+{
+	w->file.close();
+	if (w->failed || w->file.fail() || w->size == 0 || w->size > maxSize)
+	{
+		abort(w);
+		return;
+	}
+	char buf[40];
+	sprintf(buf,"%016" PRIx64 "-%" PRIx64,w->hash,w->size);
+	e.object = buf;
+	e.size = w->size;
+	e.lastUsed = time(nullptr);
+	string path = getObjectPath(e.object);
+	bool stored;
+	{
+		Locker l(mutex);
+		stored = objectRefs.find(e.object) != objectRefs.end();
+	}
+	// reading both files takes a while, so the content is compared without holding the lock
+	bool samecontent = stored && sameContent(path,w->filename);
+	Locker l(mutex);
+	if (objectRefs.find(e.object) != objectRefs.end())
+	{
+		if (!samecontent)
+		{
+			// hash collision, or the object was stored while comparing, don't cache this content
+			LOG(LOG_INFO,"HTTP cache: content hash collision for " << e.url);
+			std::remove(w->filename.c_str());
+			delete w;
+			return;
+		}
+		// the content is already stored
+		std::remove(w->filename.c_str());
+	}
+	else if (std::rename(w->filename.c_str(),path.c_str()) != 0)
+	{
+		LOG(LOG_ERROR,"HTTP cache: could not store " << e.url);
+		std::remove(w->filename.c_str());
+		delete w;
+		return;
+	}
+	delete w;
+	addEntry(e);
+	evict();
+	save();
+}
+
+void HTTPCache::abort(HTTPCacheWriter* w)
+{
+	if (w->file.is_open())
+		w->file.close();
+	std::remove(w->filename.c_str());
+	delete w;
+}
@@ -0,0 +1,109 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_HTTPCACHE_H
+#define BACKENDS_HTTPCACHE_H 1
+
+#include "compat.h"
+#include "threading.h"
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+namespace lightspark
+{
+
+struct HTTPCacheEntry
+{
+	std::string url;
+	// name of the content file, derived from the hash and size of the content
+	std::string object;
+	std::string etag;
+	std::string lastModified;
+	std::string contentType;
+	uint64_t size;
+	// time (seconds since the epoch) until the entry may be used without revalidation
+	int64_t expires;
+	// time of the last use, for LRU eviction
+	int64_t lastUsed;
+	HTTPCacheEntry():size(0),expires(0),lastUsed(0) {}
+};
+
+// collects a response body into a temporary file of the cache
+class HTTPCacheWriter
+{
+friend class HTTPCache;
+private:
+	std::ofstream file;
+	std::string filename;
+	uint64_t hash;
+	uint64_t size;
+	bool failed;
+public:
+	void write(const uint8_t* data, size_t len);
+};
+
+/*
+ * Persistent cache for HTTP downloads.
+ * The content is stored content-addressed in the "objects" directory, so identical files
+ * downloaded from different URLs are only stored once.
+ * The index maps URLs to objects and keeps the validators for revalidation.
+ * When the cache grows larger than its size limit the least recently used entries are evicted.
+ * All methods are thread-safe.
+ */
+class DLL_PUBLIC HTTPCache
+{
+private:
+	Mutex mutex;
+	std::string directory;
+	uint64_t maxSize;
+	// size of all objects
+	uint64_t totalSize;
+	std::unordered_map<std::string,HTTPCacheEntry> entries;
+	// number of entries using each object
+	std::unordered_map<std::string,uint32_t> objectRefs;
+	std::string getObjectPath(const std::string& object) const;
+	void removeTemporaryFiles();
+	void load();
+	void save();
+	void addEntry(const HTTPCacheEntry& e);
+	void removeEntry(std::unordered_map<std::string,HTTPCacheEntry>::iterator it);
+	void evict();
+public:
+	HTTPCache(const std::string& dir, uint64_t maxsize);
+	~HTTPCache();
+	// creates the cache in the configured cache directory, returns nullptr if it is disabled
+	static HTTPCache* create();
+	// returns false if there is no entry for the url, marks the entry as used
+	bool lookup(const std::string& url, HTTPCacheEntry& e);
+	// full path of the content file of an entry
+	std::string getPath(const HTTPCacheEntry& e) const { return getObjectPath(e.object); }
+	// updates the expiration time after a successful revalidation
+	void refresh(const std::string& url, int64_t expires);
+	void remove(const std::string& url);
+	// returns nullptr if no temporary file can be created
+	HTTPCacheWriter* createWriter();
+	// stores the content of the writer as the entry for e.url and deletes the writer
+	void commit(HTTPCacheWriter* w, HTTPCacheEntry& e);
+	// discards the content of the writer and deletes the writer
+	void abort(HTTPCacheWriter* w);
+};
+
+}
+#endif /* BACKENDS_HTTPCACHE_H */
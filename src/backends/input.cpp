@@ -453,7 +453,7 @@ void InputThread::handleMouseMove(const LSMouseMoveEvent& event)
 	if(currentMouseOver == selected)
 	{
 		m_sys->currentVm->addIdleEvent(selected,
-			_MR(Class<MouseEvent>::getInstanceS(m_sys->worker,"mouseMove",local.x,local.y,true,event.modifiers,event.pressed)),true);
+			m_sys->eventPool->getMouseEvent("mouseMove",local.x,local.y,true,event.modifiers,event.pressed),true);
 	}
 	else
 	{
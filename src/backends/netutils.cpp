@@ -29,6 +29,7 @@
 #include "backends/netutils.h"
 #include "backends/rtmputils.h"
 #include "backends/streamcache.h"
+#include "backends/curlmulti.h"
 #include "utils/filesystem.h"
 #include "compat.h"
 #include <string>
@@ -36,6 +37,7 @@
 #include <cctype>
 #include <iostream>
 #include <fstream>
+#include <ctime>
 #ifdef ENABLE_CURL
 #include <curl/curl.h>
 #endif
@@ -155,11 +157,32 @@ bool DownloadManager::removeDownloader(Downloader* downloader)
 StandaloneDownloadManager::StandaloneDownloadManager()
 {
 	type = STANDALONE;
+	httpCache = HTTPCache::create();
+#ifdef ENABLE_CURL
+	curlDriver = nullptr;
+#endif
 }
 
 StandaloneDownloadManager::~StandaloneDownloadManager()
 {
 	cleanUp();
+#ifdef ENABLE_CURL
+	// all transfers are finished after cleanUp
+	delete curlDriver;
+#endif
+	delete httpCache;
+}
+
+CurlMultiDriver* StandaloneDownloadManager::getCurlDriver()
+{
+#ifdef ENABLE_CURL
+	Locker l(driverMutex);
+	if(curlDriver == nullptr)
+		curlDriver = new CurlMultiDriver(getSys());
+	return curlDriver;
+#else
+	return nullptr;
+#endif
 }
 
 /**
@@ -196,7 +219,7 @@ Downloader* StandaloneDownloadManager::download(const URLInfo& url, _R<StreamCac
 	else
 	{
 		LOG(LOG_INFO, "NET: STANDALONE: DownloadManager: remote file");
-		downloader=new CurlDownloader(url.getParsedURL(), cache, owner);
+		downloader=new CurlDownloader(url.getParsedURL(), cache, owner, url.getProtocol().startsWith("http") ? httpCache : nullptr, getCurlDriver());
 	}
 	downloader->enableFencingWaiting();
 	addDownloader(downloader);
@@ -230,7 +253,7 @@ Downloader* StandaloneDownloadManager::downloadWithData(const URLInfo& url, _R<S
 	else
 	{
 		LOG(LOG_INFO, "NET: STANDALONE: DownloadManager: remote file");
-		downloader=new CurlDownloader(url.getParsedURL(), cache, data, headers, owner);
+		downloader=new CurlDownloader(url.getParsedURL(), cache, data, headers, owner, getCurlDriver());
 	}
 	downloader->enableFencingWaiting();
 	addDownloader(downloader);
@@ -542,8 +565,9 @@ ThreadedDownloader::~ThreadedDownloader()
  * \param[in] _url The URL for the Downloader.
  * \param[in] _cached Whether or not to cache this download.
  */
-CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadable* o):
-	ThreadedDownloader(_url, _cache, o)
+CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadable* o, HTTPCache* _httpCache, CurlMultiDriver* _driver):
+	ThreadedDownloader(_url, _cache, o),httpCache(_httpCache),cacheWriter(nullptr),hasCacheEntry(false),cacheWriterCreated(false),
+	driver(_driver),curlHandle(nullptr),curlHeaderList(nullptr),fenceCount(1)
 {
 }
 
@@ -555,8 +579,9 @@ CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache,
  */
 CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache,
 			       const std::vector<uint8_t>& _data,
-			       const std::list<tiny_string>& _headers, ILoadable* o):
-	ThreadedDownloader(_url, _cache, _data, _headers, o)
+			       const std::list<tiny_string>& _headers, ILoadable* o, CurlMultiDriver* _driver):
+	ThreadedDownloader(_url, _cache, _data, _headers, o),httpCache(nullptr),cacheWriter(nullptr),hasCacheEntry(false),cacheWriterCreated(false),
+	driver(_driver),curlHandle(nullptr),curlHeaderList(nullptr),fenceCount(1)
 {
 }
 
@@ -582,6 +607,15 @@ void CurlDownloader::execute()
 	}
 	LOG(LOG_INFO, "NET: CurlDownloader::execute: reading remote file: " << url.raw_buf());
 #ifdef ENABLE_CURL
+	if(httpCache && httpCache->lookup(originalURL.raw_buf(), cacheEntry))
+	{
+		hasCacheEntry = true;
+		if(cacheEntry.expires > time(nullptr) && useHTTPCacheEntry())
+		{
+			LOG(LOG_INFO, "NET: CurlDownloader::execute: using HTTP cache for " << url);
+			return;
+		}
+	}
 	CURL *curl;
 	CURLcode res;
 	curl = curl_easy_init();
@@ -632,6 +666,14 @@ void CurlDownloader::execute()
 				hasContentType |= it->lowercase().startsWith("content-type:");
 			}
 		}
+		if(hasCacheEntry)
+		{
+			// revalidate the cached content
+			if(!cacheEntry.etag.empty())
+				headerList=curl_slist_append(headerList, ("If-None-Match: "+cacheEntry.etag).c_str());
+			if(!cacheEntry.lastModified.empty())
+				headerList=curl_slist_append(headerList, ("If-Modified-Since: "+cacheEntry.lastModified).c_str());
+		}
 
 		if(!data.empty())
 		{
@@ -645,32 +687,165 @@ void CurlDownloader::execute()
 			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
 
 		//curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
-		res = curl_easy_perform(curl);
-
-		curl_slist_free_all(headerList);
-
-		curl_easy_cleanup(curl);
-		if(res!=0)
+		curlHandle = curl;
+		curlHeaderList = headerList;
+		if(driver)
 		{
-			setFailed();
+			// the transfer is run by the driver thread, so this thread is free for other jobs
+			fenceCount = 2;
+			driver->addTransfer(this);
 			return;
 		}
+		res = curl_easy_perform(curl);
+		transferDone(res);
 	}
 	else
-	{
 		setFailed();
-		return;
-	}
 #else
 	//ENABLE_CURL not defined
 	LOG(LOG_ERROR,"NET: CURL not enabled in this build. Downloader will always fail.");
 	setFailed();
-	return;
 #endif
+}
+
+/**
+ * \brief The jobFence for CurlDownloader.
+ *
+ * If the transfer is run by a \c CurlMultiDriver, both the \c ThreadPool and the driver call this
+ * and the downloader is only fenced after the second call.
+ */
+void CurlDownloader::jobFence()
+{
+	if(--fenceCount == 0)
+		ThreadedDownloader::jobFence();
+}
+
+#ifdef ENABLE_CURL
+/**
+ * \brief Called when the transfer of the easy handle is complete
+ *
+ * Frees the easy handle and marks the download as finished or failed.
+ */
+void CurlDownloader::transferDone(int result)
+{
+	CURL* curl = (CURL*)curlHandle;
+	long responsecode = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responsecode);
+	curl_slist_free_all((curl_slist*)curlHeaderList);
+	curl_easy_cleanup(curl);
+	curlHandle = nullptr;
+	curlHeaderList = nullptr;
+	if(result!=CURLE_OK)
+	{
+		if(cacheWriter)
+			httpCache->abort(cacheWriter);
+		cacheWriter = nullptr;
+		setFailed();
+		return;
+	}
+	if(httpCache)
+	{
+		finishHTTPCache(responsecode);
+		if(hasFinished())
+			return;
+	}
 	//Notify the downloader no more data should be expected
 	setFinished();
 }
 
+/**
+ * \brief Computes until when a response may be used from the HTTP cache without revalidation
+ *
+ * \return The expiration time in seconds since the epoch, 0 if the response must always be revalidated
+ */
+int64_t CurlDownloader::getExpirationTime() const
+{
+	tiny_string cc = tiny_string(cacheControl).lowercase();
+	if(cc.find("no-cache") != tiny_string::npos)
+		return 0;
+	uint32_t pos = cc.find("max-age=");
+	if(pos != tiny_string::npos)
+		return time(nullptr) + atoll(cc.raw_buf()+pos+8);
+	if(!expires.empty())
+	{
+		time_t t = curl_getdate(expires.c_str(), nullptr);
+		if(t > 0)
+			return t;
+	}
+	return 0;
+}
+
+/**
+ * \brief Stores a completed response in the HTTP cache or answers a revalidated request from the HTTP cache
+ *
+ * Marks the download as finished if the content was taken from the HTTP cache.
+ */
+void CurlDownloader::finishHTTPCache(long responsecode)
+{
+	if(responsecode == 304 && hasCacheEntry)
+	{
+		httpCache->refresh(originalURL.raw_buf(), getExpirationTime());
+		if(useHTTPCacheEntry())
+			LOG(LOG_INFO, "NET: CurlDownloader::execute: cached content is still valid for " << url);
+		else
+		{
+			httpCache->remove(originalURL.raw_buf());
+			setFailed();
+		}
+		return;
+	}
+	if(!cacheWriter)
+		return;
+	HTTPCacheEntry e;
+	e.url = originalURL.raw_buf();
+	e.etag = etag;
+	e.lastModified = lastModified;
+	e.contentType = contentType;
+	e.expires = getExpirationTime();
+	// content that can neither be revalidated nor is fresh for some time would be downloaded again anyway
+	if(responsecode == 200 && !(etag.empty() && lastModified.empty() && e.expires <= time(nullptr)))
+		httpCache->commit(cacheWriter, e);
+	else
+		httpCache->abort(cacheWriter);
+	cacheWriter = nullptr;
+}
+
+/**
+ * \brief Uses the content of the HTTP cache entry found for this download
+ *
+ * Memory and file caches use the content file without copying it, other caches get a copy of the content.
+ * \return false if the content file could not be read
+ */
+bool CurlDownloader::useHTTPCacheEntry()
+{
+	std::string path = httpCache->getPath(cacheEntry);
+	if(!cache->useCachedFile(path))
+	{
+		std::ifstream f(path.c_str(), std::ios::binary);
+		if(!f || cache->getReceivedLength())
+			return false;
+		uint8_t buf[65536];
+		while(f)
+		{
+			f.read((char*)buf, sizeof(buf));
+			if(f.gcount() > 0)
+				cache->append(buf, f.gcount());
+		}
+	}
+	requestStatus = 200;
+	if(!cacheEntry.contentType.empty())
+		headers[tiny_string("content-type")] = tiny_string(cacheEntry.contentType);
+	length = cache->getReceivedLength();
+	if(cache->getNotifyLoader())
+	{
+		notifyOwnerAboutBytesTotal();
+		notifyOwnerAboutBytesLoaded();
+	}
+	setFinished();
+	return true;
+}
+#endif
+
 /**
  * \brief Progress callback for CURL
  *
@@ -694,6 +869,18 @@ size_t CurlDownloader::write_data(void *buffer, size_t size, size_t nmemb, void
 	size_t added=size*nmemb;
 	if(th->getRequestStatus()/100 == 2 || th->getRequestStatus()/100 == 3)
 		th->append((uint8_t*)buffer,added);
+	if(th->httpCache && th->getRequestStatus() == 200)
+	{
+		// the headers are complete when the first data arrives
+		if(!th->cacheWriterCreated)
+		{
+			th->cacheWriterCreated = true;
+			if(tiny_string(th->cacheControl).lowercase().find("no-store") == tiny_string::npos)
+				th->cacheWriter = th->httpCache->createWriter();
+		}
+		if(th->cacheWriter)
+			th->cacheWriter->write((uint8_t*)buffer,added);
+	}
 	return added;
 }
 
@@ -713,6 +900,32 @@ size_t CurlDownloader::write_header(void *buffer, size_t size, size_t nmemb, voi
 	header = header.substr(0, header.find("\n"));
 	//We haven't set the length of the download uet, so set it from the headers
 	th->parseHeader(header, true);
+	if(th->httpCache)
+	{
+		std::string lower = header.substr(0, header.find(":"));
+		std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+		size_t valuepos = header.find_first_not_of(' ', lower.length()+1);
+		std::string value = valuepos == std::string::npos ? "" : header.substr(valuepos);
+		if(header.substr(0, 5) == "HTTP/")
+		{
+			// a new response starts after a redirect
+			th->etag.clear();
+			th->lastModified.clear();
+			th->cacheControl.clear();
+			th->expires.clear();
+			th->contentType.clear();
+		}
+		else if(lower == "etag")
+			th->etag = value;
+		else if(lower == "last-modified")
+			th->lastModified = value;
+		else if(lower == "cache-control")
+			th->cacheControl = value;
+		else if(lower == "expires")
+			th->expires = value;
+		else if(lower == "content-type")
+			th->contentType = value;
+	}
 
 	return size*nmemb;
 }
@@ -30,13 +30,16 @@
 #include <fstream>
 #include <list>
 #include <map>
+#include <atomic>
 #include "swftypes.h"
 #include "backends/urlutils.h"
 #include "backends/streamcache.h"
+#include "backends/httpcache.h"
 #include "smartrefs.h"
 
 namespace lightspark
 {
+class CurlMultiDriver;
 
 class DLL_PUBLIC DownloadManager
 {
@@ -63,6 +66,16 @@ public:
 
 class DLL_PUBLIC StandaloneDownloadManager:public DownloadManager
 {
+private:
+	// persistent cache for remote files, nullptr if disabled
+	HTTPCache* httpCache;
+#ifdef ENABLE_CURL
+	Mutex driverMutex;
+	// runs all transfers of CurlDownloaders, created on first use
+	CurlMultiDriver* curlDriver;
+#endif
+	// returns nullptr if curl is disabled
+	CurlMultiDriver* getCurlDriver();
 public:
 	StandaloneDownloadManager();
 	~StandaloneDownloadManager();
@@ -169,6 +182,7 @@ private:
 public:
 	void enableFencingWaiting();
 	void jobFence();
+	bool isBlocking() const { return true; }
 	void waitFencing();
 protected:
 	//Abstract base class, can not be constructed
@@ -183,16 +197,45 @@ protected:
 //CurlDownloader can be used as a thread job, standalone or as a streambuf
 class CurlDownloader: public ThreadedDownloader
 {
+friend class CurlMultiDriver;
 private:
 	static size_t write_data(void *buffer, size_t size, size_t nmemb, void *userp);
 	static size_t write_header(void *buffer, size_t size, size_t nmemb, void *userp);
 	static int progress_callback(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow);
 	void execute();
 	void threadAbort();
+
+	//-- HTTP CACHE
+	HTTPCache* httpCache;
+	// the response body is written here if it can be cached
+	HTTPCacheWriter* cacheWriter;
+	HTTPCacheEntry cacheEntry;
+	bool hasCacheEntry;
+	bool cacheWriterCreated;
+	// headers of the last response relevant for caching
+	std::string etag;
+	std::string lastModified;
+	std::string cacheControl;
+	std::string expires;
+	std::string contentType;
+	int64_t getExpirationTime() const;
+	// uses the content of the HTTP cache as the result of the download
+	bool useHTTPCacheEntry();
+	void finishHTTPCache(long responsecode);
+
+	//-- TRANSFER
+	// runs the transfer if set, otherwise it is run in the thread of the job
+	CurlMultiDriver* driver;
+	void* curlHandle; // CURL*
+	void* curlHeaderList; // curl_slist*
+	// number of jobFence() calls until the downloader is fenced
+	std::atomic<int> fenceCount;
+	void transferDone(int result);
 public:
-	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, ILoadable* o);
+	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, ILoadable* o, HTTPCache* _httpCache=nullptr, CurlMultiDriver* _driver=nullptr);
 	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, const std::vector<uint8_t>& data,
-		       const std::list<tiny_string>& headers, ILoadable* o);
+		       const std::list<tiny_string>& headers, ILoadable* o, CurlMultiDriver* _driver=nullptr);
+	void jobFence() override;
 };
 
 //LocalDownloader can be used as a thread job, standalone or as a streambuf
@@ -232,6 +275,7 @@ protected:
 			      ILoadable* owner=nullptr,
 			      bool checkPolicyFile=true);
 	void jobFence();
+	bool isBlocking() const { return true; }
 public:
 	DownloaderThreadBase(_NR<URLRequest> request, IDownloaderThreadListener* _listener);
 	void execute()=0;
@@ -30,6 +30,7 @@
 #include "backends/rendering.h"
 #include "backends/input.h"
 #include "compat.h"
+#include "tracing.h"
 #include <sstream>
 #include <unistd.h>
 #include "3rdparty/nanovg/src/nanovg.h"
@@ -152,6 +153,7 @@ void RenderThread::finalizeUpload()
 
 void RenderThread::handleUpload()
 {
+	TraceScope tracescope(TRACE_RENDER,"upload");
 	ITextureUploadable* u=getUploadJob();
 	assert(u);
 	uint32_t w,h;
@@ -188,6 +190,7 @@ int RenderThread::worker(void* d)
 	setTLSWorker(th->m_sys->worker);
 	/* set TLS variable for getRenderThread() */
 	tls_set(renderThread, th);
+	Tracer::setThreadName("Render");
 
 	ThreadProfile* profile=th->m_sys->allocateProfiler(RGB(200,0,0));
 	profile->setTag("Render");
@@ -296,6 +299,7 @@ bool RenderThread::doRender(ThreadProfile* profile,Chronometer* chronometer)
 		finalizeUpload();
 	if (refreshNeeded)
 	{
+		TraceScope tracescope(TRACE_RENDER,"refreshSurfaces");
 		Locker l(mutexRefreshSurfaces);
 		auto it = surfacesToRefresh.begin();
 		while (it != surfacesToRefresh.end())
@@ -631,7 +635,10 @@ bool RenderThread::doRender(ThreadProfile* profile,Chronometer* chronometer)
 		renderSettingsPage();
 	if (screenshotneeded)
 		generateScreenshot();
-	engineData->DoSwapBuffers();
+	{
+		TraceScope tracescope(TRACE_RENDER,"swapBuffers");
+		engineData->DoSwapBuffers();
+	}
 
 	if (Log::getLevel() >= LOG_INFO)
 	{
@@ -1573,6 +1580,7 @@ void RenderThread::removeDebugRect()
 
 void RenderThread::coreRendering()
 {
+	TraceScope tracescope(TRACE_RENDER,"draw");
 	Locker l(mutexRendering);
 	baseFramebuffer=0;
 	baseRenderbuffer=0;
@@ -0,0 +1,658 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2011-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "backends/socketreactor.h"
+#include "swf.h"
+#include "logger.h"
+#include <SDL.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#	include <winsock2.h>
+#else
+#	include <sys/socket.h>
+#	include <sys/select.h>
+#	include <sys/uio.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+#ifdef __linux__
+#	include <sys/epoll.h>
+#	define LS_SOCKETREACTOR_EPOLL 1
+#endif
+#ifndef MSG_NOSIGNAL
+#	define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+using namespace lightspark;
+
+// initial size of the receive buffers, has to be a power of 2
+#define SOCKET_RECEIVEBUFFER_MIN_SIZE 16384
+// maximum number of bytes read from a socket before other sockets are served
+#define SOCKET_RECEIVE_MAX_PER_EVENT (1024*1024)
+// maximum number of buffers sent with a single system call
+#define SOCKET_MAX_IOV 64
+// maximum number of events handled per wait
+#define SOCKET_MAX_EVENTS 64
+
+namespace
+{
+enum READY_FLAGS { READY_READ=1, READY_WRITE=2 };
+
+#ifdef _WIN32
+struct iovec
+{
+	void* iov_base;
+	size_t iov_len;
+};
+bool wouldBlock()
+{
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+ssize_t readBuffers(int fd, iovec* iov, int count)
+{
+	WSABUF bufs[SOCKET_MAX_IOV];
+	for (int i = 0; i < count; i++)
+	{
+		bufs[i].buf = (char*)iov[i].iov_base;
+		bufs[i].len = iov[i].iov_len;
+	}
+	DWORD received = 0;
+	DWORD flags = 0;
+	if (WSARecv(fd,bufs,count,&received,&flags,nullptr,nullptr) == SOCKET_ERROR)
+		return -1;
+	return received;
+}
+ssize_t sendBuffers(int fd, iovec* iov, int count)
+{
+	WSABUF bufs[SOCKET_MAX_IOV];
+	for (int i = 0; i < count; i++)
+	{
+		bufs[i].buf = (char*)iov[i].iov_base;
+		bufs[i].len = iov[i].iov_len;
+	}
+	DWORD sent = 0;
+	if (WSASend(fd,bufs,count,&sent,0,nullptr,nullptr) == SOCKET_ERROR)
+		return -1;
+	return sent;
+}
+void setNonBlocking(int fd)
+{
+	u_long mode = 1;
+	ioctlsocket(fd,FIONBIO,&mode);
+}
+// select() only accepts sockets, so the reactor is woken up through a connected loopback socket pair
+bool createWakeupPair(int& listener, int& emitter)
+{
+	SOCKET server = socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+	if (server == INVALID_SOCKET)
+		return false;
+	sockaddr_in addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	int addrlen = sizeof(addr);
+	SOCKET client = INVALID_SOCKET;
+	SOCKET accepted = INVALID_SOCKET;
+	if (bind(server,(sockaddr*)&addr,sizeof(addr)) == 0
+			&& getsockname(server,(sockaddr*)&addr,&addrlen) == 0
+			&& listen(server,1) == 0)
+	{
+		client = socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+		if (client != INVALID_SOCKET && connect(client,(sockaddr*)&addr,sizeof(addr)) == 0)
+			accepted = accept(server,nullptr,nullptr);
+	}
+	closesocket(server);
+	if (accepted == INVALID_SOCKET)
+	{
+		if (client != INVALID_SOCKET)
+			closesocket(client);
+		return false;
+	}
+	listener = (int)accepted;
+	emitter = (int)client;
+	return true;
+}
+ssize_t readDescriptor(int fd, char* buf, size_t len)
+{
+	return recv(fd,buf,len,0);
+}
+ssize_t writeDescriptor(int fd, const char* buf, size_t len)
+{
+	return ::send(fd,buf,len,0);
+}
+void closeDescriptor(int fd)
+{
+	closesocket(fd);
+}
+#else
+bool wouldBlock()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+ssize_t readBuffers(int fd, iovec* iov, int count)
+{
+	return readv(fd,iov,count);
+}
+ssize_t sendBuffers(int fd, iovec* iov, int count)
+{
+	msghdr msg;
+	memset(&msg,0,sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	// don't get killed by SIGPIPE if the remote side closed the connection
+	return sendmsg(fd,&msg,MSG_NOSIGNAL);
+}
+void setNonBlocking(int fd)
+{
+	int flags = fcntl(fd,F_GETFL,0);
+	if (flags != -1)
+		fcntl(fd,F_SETFL,flags|O_NONBLOCK);
+}
+bool createWakeupPair(int& listener, int& emitter)
+{
+	int pipefd[2];
+	if (pipe(pipefd) != 0)
+		return false;
+	listener = pipefd[0];
+	emitter = pipefd[1];
+	return true;
+}
+ssize_t readDescriptor(int fd, char* buf, size_t len)
+{
+	return read(fd,buf,len);
+}
+ssize_t writeDescriptor(int fd, const char* buf, size_t len)
+{
+	return write(fd,buf,len);
+}
+void closeDescriptor(int fd)
+{
+	::close(fd);
+}
+#endif
+}
+
+SocketReceiveBuffer::SocketReceiveBuffer():start(0),used(0)
+{
+	buf.resize(SOCKET_RECEIVEBUFFER_MIN_SIZE);
+}
+
+uint32_t SocketReceiveBuffer::size()
+{
+	Locker l(mutex);
+	return used;
+}
+
+void SocketReceiveBuffer::grow(uint32_t minsize)
+{
+	uint32_t newsize = buf.size();
+	while (newsize < minsize)
+		newsize *= 2;
+	if (newsize == buf.size())
+		return;
+	vector<uint8_t> newbuf(newsize);
+	uint32_t first = min(used,uint32_t(buf.size())-start);
+	memcpy(newbuf.data(),buf.data()+start,first);
+	memcpy(newbuf.data()+first,buf.data(),used-first);
+	buf.swap(newbuf);
+	start = 0;
+}
+
+ssize_t SocketReceiveBuffer::receive(int fd, bool& eof)
+{
+	ssize_t total = 0;
+	eof = false;
+	while (total < SOCKET_RECEIVE_MAX_PER_EVENT)
+	{
+		iovec iov[2];
+		{
+			Locker l(mutex);
+			if (used == buf.size())
+				grow(buf.size()*2);
+			uint32_t size = buf.size();
+			uint32_t end = (start+used)&(size-1);
+			uint32_t freebytes = size-used;
+			iov[0].iov_base = buf.data()+end;
+			iov[0].iov_len = min(freebytes,size-end);
+			iov[1].iov_base = buf.data();
+			iov[1].iov_len = freebytes-iov[0].iov_len;
+		}
+		// the reader only removes data, so the free space can be filled without holding the lock
+		ssize_t n = readBuffers(fd,iov,iov[1].iov_len ? 2 : 1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (wouldBlock())
+				break;
+			return -1;
+		}
+		if (n == 0)
+		{
+			eof = true;
+			break;
+		}
+		{
+			Locker l(mutex);
+			used += n;
+		}
+		total += n;
+		if (size_t(n) < iov[0].iov_len+iov[1].iov_len)
+			break;
+	}
+	return total;
+}
+
+int32_t SocketReceiveBuffer::find(uint8_t c)
+{
+	Locker l(mutex);
+	uint32_t size = buf.size();
+	uint32_t first = min(used,size-start);
+	const uint8_t* p = (const uint8_t*)memchr(buf.data()+start,c,first);
+	if (p)
+		return p-(buf.data()+start);
+	p = (const uint8_t*)memchr(buf.data(),c,used-first);
+	if (p)
+		return first+(p-buf.data());
+	return -1;
+}
+
+uint32_t SocketReceiveBuffer::read(uint8_t* data, uint32_t len)
+{
+	Locker l(mutex);
+	len = min(len,used);
+	uint32_t size = buf.size();
+	uint32_t first = min(len,size-start);
+	memcpy(data,buf.data()+start,first);
+	memcpy(data+first,buf.data(),len-first);
+	start = (start+len)&(size-1);
+	used -= len;
+	return len;
+}
+
+SocketConnection::SocketConnection(ASWorker* w):sendOffset(0),closeRequested(false),waitingForWrite(false),reactor(nullptr),connectionWorker(w)
+{
+}
+
+void SocketConnection::startReactor(SystemState* sys)
+{
+	sendMutex.lock();
+	if (closeRequested)
+	{
+		sendMutex.unlock();
+		connectionClosed(CLOSE_REQUESTED);
+		return;
+	}
+	reactor = sys->getSocketReactor();
+	sendMutex.unlock();
+	reactor->addConnection(this);
+}
+
+void SocketConnection::send(vector<uint8_t>& data)
+{
+	if (data.empty())
+		return;
+	SocketReactor* r;
+	{
+		Locker l(sendMutex);
+		if (closeRequested)
+			return;
+		sendQueue.emplace_back();
+		sendQueue.back().swap(data);
+		r = reactor;
+	}
+	// data queued before the connection is added to the reactor is sent when it is added
+	if (r)
+		r->notify(this);
+}
+
+void SocketConnection::requestClose()
+{
+	SocketReactor* r;
+	{
+		Locker l(sendMutex);
+		closeRequested = true;
+		r = reactor;
+	}
+	if (r)
+		r->notify(this);
+}
+
+bool SocketConnection::sendQueued()
+{
+	Locker l(sendMutex);
+	while (!sendQueue.empty())
+	{
+		iovec iov[SOCKET_MAX_IOV];
+		int count = 0;
+		size_t total = 0;
+		for (auto it = sendQueue.begin(); it != sendQueue.end() && count < SOCKET_MAX_IOV; it++, count++)
+		{
+			size_t offset = count == 0 ? sendOffset : 0;
+			iov[count].iov_base = it->data()+offset;
+			iov[count].iov_len = it->size()-offset;
+			total += iov[count].iov_len;
+		}
+		ssize_t n = sendBuffers(fileDescriptor(),iov,count);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return wouldBlock();
+		}
+		// remove the buffers that have been sent completely
+		size_t remaining = n;
+		while (remaining)
+		{
+			size_t left = sendQueue.front().size()-sendOffset;
+			if (remaining < left)
+			{
+				sendOffset += remaining;
+				break;
+			}
+			remaining -= left;
+			sendOffset = 0;
+			sendQueue.pop_front();
+		}
+		if (size_t(n) < total)
+			break;
+	}
+	return true;
+}
+
+SocketReactor::SocketReactor(SystemState* s):m_sys(s),wakeupListener(-1),wakeupEmitter(-1),epollfd(-1),stopped(false)
+{
+	if (createWakeupPair(wakeupListener,wakeupEmitter))
+	{
+		setNonBlocking(wakeupListener);
+		setNonBlocking(wakeupEmitter);
+	}
+	else
+		LOG(LOG_ERROR,"SocketReactor: could not create wakeup pipe");
+#ifdef LS_SOCKETREACTOR_EPOLL
+	epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epollfd == -1)
+		LOG(LOG_ERROR,"SocketReactor: epoll_create1 failed:"<<strerror(errno));
+	else
+	{
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = nullptr;
+		epoll_ctl(epollfd,EPOLL_CTL_ADD,wakeupListener,&ev);
+	}
+#endif
+	t = SDL_CreateThread(&SocketReactor::worker,"SocketReactor",this);
+}
+
+SocketReactor::~SocketReactor()
+{
+	stopped = true;
+	wakeup();
+	SDL_WaitThread(t,nullptr);
+	for (auto c : newConnections)
+		connections.insert(c);
+	newConnections.clear();
+	while (!connections.empty())
+		removeConnection(*connections.begin(),SocketConnection::CLOSE_SHUTDOWN);
+	if (epollfd != -1)
+		::close(epollfd);
+	if (wakeupListener != -1)
+		closeDescriptor(wakeupListener);
+	if (wakeupEmitter != -1)
+		closeDescriptor(wakeupEmitter);
+}
+
+int SocketReactor::worker(void* d)
+{
+	SocketReactor* th = (SocketReactor*)d;
+	setTLSSys(th->m_sys);
+	setTLSWorker(th->m_sys->worker);
+	th->run();
+	return 0;
+}
+
+void SocketReactor::wakeup()
+{
+	char c = 0;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-result"
+	// if the pipe is full the reactor will wake up anyway
+	writeDescriptor(wakeupEmitter,&c,1);
+#pragma GCC diagnostic pop
+}
+
+void SocketReactor::addConnection(SocketConnection* c)
+{
+	{
+		Locker l(mutex);
+		newConnections.push_back(c);
+	}
+	wakeup();
+}
+
+void SocketReactor::notify(SocketConnection* c)
+{
+	{
+		Locker l(mutex);
+		notifiedConnections.insert(c);
+	}
+	wakeup();
+}
+
+void SocketReactor::stopWorker(ASWorker* w)
+{
+	{
+		Locker l(mutex);
+		stoppedWorkers.insert(w);
+	}
+	wakeup();
+}
+
+void SocketReactor::waitForEvents(vector<pair<SocketConnection*,uint32_t>>& ready, bool& wakeupreceived)
+{
+#ifdef LS_SOCKETREACTOR_EPOLL
+	epoll_event events[SOCKET_MAX_EVENTS];
+	int n = epoll_wait(epollfd,events,SOCKET_MAX_EVENTS,-1);
+	if (n < 0)
+	{
+		if (errno != EINTR)
+			LOG(LOG_ERROR,"SocketReactor: epoll_wait failed:"<<strerror(errno));
+		return;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		if (events[i].data.ptr == nullptr)
+		{
+			wakeupreceived = true;
+			continue;
+		}
+		uint32_t flags = 0;
+		if (events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR))
+			flags |= READY_READ;
+		if (events[i].events & EPOLLOUT)
+			flags |= READY_WRITE;
+		ready.push_back(make_pair((SocketConnection*)events[i].data.ptr,flags));
+	}
+#else
+	fd_set readfds;
+	fd_set writefds;
+	FD_ZERO(&readfds);
+	FD_ZERO(&writefds);
+	FD_SET(wakeupListener,&readfds);
+	int maxfd = wakeupListener;
+	for (auto c : connections)
+	{
+		int fd = c->fileDescriptor();
+		FD_SET(fd,&readfds);
+		if (c->waitingForWrite)
+			FD_SET(fd,&writefds);
+		maxfd = max(maxfd,fd);
+	}
+	int n = select(maxfd+1,&readfds,&writefds,nullptr,nullptr);
+	if (n < 0)
+	{
+		if (errno != EINTR)
+			LOG(LOG_ERROR,"SocketReactor: select failed:"<<strerror(errno));
+		return;
+	}
+	if (FD_ISSET(wakeupListener,&readfds))
+		wakeupreceived = true;
+	for (auto c : connections)
+	{
+		int fd = c->fileDescriptor();
+		uint32_t flags = (FD_ISSET(fd,&readfds) ? READY_READ : 0) | (FD_ISSET(fd,&writefds) ? READY_WRITE : 0);
+		if (flags)
+			ready.push_back(make_pair(c,flags));
+	}
+#endif
+	if (wakeupreceived)
+	{
+		char buf[256];
+		while (readDescriptor(wakeupListener,buf,sizeof(buf)) == sizeof(buf))
+		{
+		}
+	}
+}
+
+void SocketReactor::updateWriteInterest(SocketConnection* c, bool wantwrite)
+{
+	if (c->waitingForWrite == wantwrite)
+		return;
+	c->waitingForWrite = wantwrite;
+#ifdef LS_SOCKETREACTOR_EPOLL
+	epoll_event ev;
+	ev.events = EPOLLIN | (wantwrite ? EPOLLOUT : 0);
+	ev.data.ptr = c;
+	epoll_ctl(epollfd,EPOLL_CTL_MOD,c->fileDescriptor(),&ev);
+#endif
+}
+
+void SocketReactor::sendData(SocketConnection* c)
+{
+	if (!c->sendQueued())
+	{
+		removeConnection(c,SocketConnection::CLOSE_ERROR);
+		return;
+	}
+	bool pending;
+	bool closing;
+	{
+		Locker l(c->sendMutex);
+		pending = !c->sendQueue.empty();
+		closing = c->closeRequested;
+	}
+	if (closing && !pending)
+		removeConnection(c,SocketConnection::CLOSE_REQUESTED);
+	else
+		updateWriteInterest(c,pending);
+}
+
+void SocketReactor::removeConnection(SocketConnection* c, SocketConnection::CLOSE_REASON reason)
+{
+#ifdef LS_SOCKETREACTOR_EPOLL
+	epoll_ctl(epollfd,EPOLL_CTL_DEL,c->fileDescriptor(),nullptr);
+#endif
+	connections.erase(c);
+	{
+		Locker l(mutex);
+		notifiedConnections.erase(c);
+	}
+	// this may delete the connection, so the reactor mutex must not be held
+	c->connectionClosed(reason);
+}
+
+void SocketReactor::run()
+{
+	vector<pair<SocketConnection*,uint32_t>> ready;
+	vector<SocketConnection*> added;
+	unordered_set<SocketConnection*> notified;
+	unordered_set<ASWorker*> workers;
+	while (!stopped)
+	{
+		bool wakeupreceived = false;
+		ready.clear();
+		waitForEvents(ready,wakeupreceived);
+		if (stopped)
+			break;
+		if (wakeupreceived)
+		{
+			Locker l(mutex);
+			added.swap(newConnections);
+			notified.swap(notifiedConnections);
+			workers.swap(stoppedWorkers);
+		}
+		for (auto c : added)
+		{
+			setNonBlocking(c->fileDescriptor());
+#ifdef LS_SOCKETREACTOR_EPOLL
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = c;
+			epoll_ctl(epollfd,EPOLL_CTL_ADD,c->fileDescriptor(),&ev);
+#endif
+			connections.insert(c);
+			// send data that was queued while connecting
+			notified.insert(c);
+		}
+		added.clear();
+		if (!workers.empty())
+		{
+			vector<SocketConnection*> stoppedconnections;
+			for (auto c : connections)
+			{
+				if (workers.count(c->connectionWorker))
+					stoppedconnections.push_back(c);
+			}
+			for (auto c : stoppedconnections)
+				removeConnection(c,SocketConnection::CLOSE_SHUTDOWN);
+			workers.clear();
+		}
+		for (auto c : notified)
+		{
+			if (connections.count(c))
+				sendData(c);
+		}
+		notified.clear();
+		for (auto it = ready.begin(); it != ready.end(); it++)
+		{
+			SocketConnection* c = it->first;
+			// the connection may have been removed while handling earlier events
+			if (!connections.count(c))
+				continue;
+			if (it->second & READY_WRITE)
+			{
+				sendData(c);
+				if (!connections.count(c))
+					continue;
+			}
+			if (it->second & READY_READ)
+			{
+				bool eof;
+				ssize_t n = c->receive(eof);
+				if (n < 0)
+					removeConnection(c,SocketConnection::CLOSE_ERROR);
+				else if (eof)
+					removeConnection(c,SocketConnection::CLOSE_REMOTE);
+			}
+		}
+	}
+}
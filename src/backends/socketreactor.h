@@ -0,0 +1,138 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2011-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_SOCKETREACTOR_H
+#define BACKENDS_SOCKETREACTOR_H 1
+
+#include "compat.h"
+#include "threading.h"
+#include <deque>
+#include <vector>
+#include <unordered_set>
+
+struct SDL_Thread;
+
+namespace lightspark
+{
+class ASWorker;
+class SystemState;
+class SocketReactor;
+
+/*
+ * Growable ring buffer for data received from a socket.
+ * It is filled by the reactor thread and read by the vm, so all accesses are locked
+ */
+class SocketReceiveBuffer
+{
+private:
+	Mutex mutex;
+	std::vector<uint8_t> buf; // the size is always a power of 2
+	uint32_t start;
+	uint32_t used;
+	void grow(uint32_t minsize);
+public:
+	SocketReceiveBuffer();
+	uint32_t size();
+	// reads the data available on the non-blocking socket fd,
+	// returns the number of bytes read or -1 on errors, eof is set if the remote side closed the connection
+	ssize_t receive(int fd, bool& eof);
+	// returns the position of the first byte c in the buffer or -1 if there is none
+	int32_t find(uint8_t c);
+	// removes up to len bytes from the front of the buffer and returns the number of bytes copied to data
+	uint32_t read(uint8_t* data, uint32_t len);
+};
+
+/*
+ * A connected socket served by the SocketReactor.
+ * The reactor takes ownership of the connection when it is added and calls connectionClosed() after removing it
+ */
+class SocketConnection
+{
+friend class SocketReactor;
+public:
+	enum CLOSE_REASON { CLOSE_REQUESTED, CLOSE_REMOTE, CLOSE_ERROR, CLOSE_SHUTDOWN };
+private:
+	Mutex sendMutex;
+	std::deque<std::vector<uint8_t>> sendQueue;
+	size_t sendOffset; // number of bytes of the first buffer in sendQueue that are already sent
+	bool closeRequested;
+	bool waitingForWrite; // only accessed in the reactor thread
+	SocketReactor* reactor;
+	ASWorker* connectionWorker;
+	// sends as much of the queued data as possible without blocking, returns false on errors
+	bool sendQueued();
+protected:
+	SocketConnection(ASWorker* w);
+	// hands the connected socket over to the reactor of sys, the connection may already be deleted when this returns
+	void startReactor(SystemState* sys);
+	virtual int fileDescriptor() const=0;
+	// called in the reactor thread when data is available, same return values as SocketReceiveBuffer::receive()
+	virtual ssize_t receive(bool& eof)=0;
+	// called after the connection was removed from the reactor, or from startReactor() if it was closed before being added
+	// the connection is not accessed anymore after this call
+	virtual void connectionClosed(CLOSE_REASON reason)=0;
+public:
+	virtual ~SocketConnection() {}
+	// queues the data for sending, data is empty afterwards
+	void send(std::vector<uint8_t>& data);
+	// closes the socket after all queued data has been sent
+	void requestClose();
+};
+
+/*
+ * Serves all script sockets of a SystemState in a single thread.
+ * Uses epoll on linux and select() on other platforms.
+ * Sends are batched with writev, so many small flushes only need a single system call
+ */
+class SocketReactor
+{
+private:
+	Mutex mutex;
+	SDL_Thread* t;
+	SystemState* m_sys;
+	int wakeupListener;
+	int wakeupEmitter;
+	int epollfd;
+	volatile bool stopped;
+	// protected by mutex
+	std::vector<SocketConnection*> newConnections;
+	std::unordered_set<SocketConnection*> notifiedConnections;
+	std::unordered_set<ASWorker*> stoppedWorkers;
+	// only accessed in the reactor thread
+	std::unordered_set<SocketConnection*> connections;
+	static int worker(void* d);
+	void run();
+	void wakeup();
+	void waitForEvents(std::vector<std::pair<SocketConnection*,uint32_t>>& ready, bool& wakeupreceived);
+	void updateWriteInterest(SocketConnection* c, bool wantwrite);
+	void sendData(SocketConnection* c);
+	void removeConnection(SocketConnection* c, SocketConnection::CLOSE_REASON reason);
+public:
+	SocketReactor(SystemState* s);
+	// stops the reactor thread and closes all connections without sending events
+	~SocketReactor();
+	void addConnection(SocketConnection* c);
+	// called when data was queued for sending or the connection should be closed
+	void notify(SocketConnection* c);
+	// closes all connections of the worker without sending events
+	void stopWorker(ASWorker* w);
+};
+
+}
+#endif /* BACKENDS_SOCKETREACTOR_H */
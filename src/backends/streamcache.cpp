@@ -27,6 +27,11 @@
 #include "swf.h"
 #include "utils/filesystem.h"
 #include <SDL.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 using namespace lightspark;
@@ -87,48 +92,88 @@ void StreamCache::append(const unsigned char* buffer, size_t length)
 	}
 }
 
-class lightspark::MemoryChunk {
-public:
-	MemoryChunk(size_t len);
-	~MemoryChunk();
-	unsigned char * const buffer;
-	const size_t capacity;
-	ACQUIRE_RELEASE_VARIABLE(size_t, used);
+namespace
+{
+// Unused buffers of MEMORY_CHUNK_SIZE, so streams don't allocate and free their memory again and again
+struct MemoryChunkPool
+{
+	Mutex mutex;
+	std::vector<unsigned char*> buffers;
+	~MemoryChunkPool()
+	{
+		for (auto it=buffers.begin(); it!=buffers.end(); ++it)
+			delete[] *it;
+	}
+	unsigned char* get(size_t len)
+	{
+		if (len == MEMORY_CHUNK_SIZE)
+		{
+			Locker l(mutex);
+			if (!buffers.empty())
+			{
+				unsigned char* b = buffers.back();
+				buffers.pop_back();
+				return b;
+			}
+		}
+		return new unsigned char[len];
+	}
+	void put(unsigned char* b, size_t len)
+	{
+		if (len == MEMORY_CHUNK_SIZE)
+		{
+			Locker l(mutex);
+			if (buffers.size() < MEMORY_CHUNK_POOL_SIZE)
+			{
+				buffers.push_back(b);
+				return;
+			}
+		}
+		delete[] b;
+	}
 };
+MemoryChunkPool chunkPool;
+}
 
 MemoryChunk::MemoryChunk(size_t len) :
-	buffer(new unsigned char[len]), capacity(len), used(0)
+	buffer(chunkPool.get(len)), capacity(len), mapped(false), used(0)
+{
+}
+
+MemoryChunk::MemoryChunk(unsigned char* mapping, size_t len) :
+	buffer(mapping), capacity(len), mapped(true), used(len)
 {
 }
 
 MemoryChunk::~MemoryChunk()
 {
-	delete[] buffer;
+#ifndef _WIN32
+	if (mapped)
+	{
+		munmap(buffer,capacity);
+		return;
+	}
+#endif
+	chunkPool.put(buffer,capacity);
 }
 
 MemoryStreamCache::MemoryStreamCache(SystemState* _sys):StreamCache(_sys),
-	writeChunk(nullptr), nextChunkSize(0)
+	writeChunk(nullptr), expectedLength(0)
 {
 }
 
 MemoryStreamCache::~MemoryStreamCache()
 {
+	// spans may still reference the chunks
 	for (auto it=chunks.begin(); it!=chunks.end(); ++it)
-		delete *it;
-}
-
-// Rounds val up to the next multiple of pow(2, s).
-static size_t nextMultipleOf2Pow(size_t val, size_t s)
-{
-	return ((size_t)((double)(val-1) / (1 << s)) + 1) << s;
+		(*it)->decRef();
 }
 
-void MemoryStreamCache::allocateChunk(size_t minLength)
+void MemoryStreamCache::allocateChunk()
 {
-	size_t len = imax(imax(minLength, minChunkSize), nextChunkSize);
-	len = nextMultipleOf2Pow(len, 12);
-	assert(len >= minLength);
-	nextChunkSize = len;
+	size_t len = MEMORY_CHUNK_SIZE;
+	if (chunks.empty() && expectedLength > 0 && expectedLength < MEMORY_CHUNK_SIZE)
+		len = expectedLength;
 
 	writeChunk = new MemoryChunk(len);
 	chunks.push_back(writeChunk);
@@ -139,45 +184,28 @@ void MemoryStreamCache::handleAppend(const unsigned char* data, size_t length)
 	Locker locker(chunkListMutex);
 	assert(length > 0);
 
-	if (!writeChunk || (ACQUIRE_READ(writeChunk->used) >= writeChunk->capacity))
-		allocateChunk(length);
-
-	assert(writeChunk);
-
-	size_t used = ACQUIRE_READ(writeChunk->used);
-	if (writeChunk->capacity >= used + length)
+	while (length > 0)
 	{
-		// Data fits in to the current chunk
-		memcpy(writeChunk->buffer + used, data, length);
-		RELEASE_WRITE(writeChunk->used, used + length);
-	}
-	else
-	{
-		// Write as much as possible to the current buffer
-		size_t unused = writeChunk->capacity - used;
-		memcpy(writeChunk->buffer + used, data, unused);
-		RELEASE_WRITE(writeChunk->used, writeChunk->capacity);
-
-		// allocate a new chunk by a recursive call
-		handleAppend(data + unused, length - unused);
+		if (!writeChunk || (ACQUIRE_READ(writeChunk->used) >= writeChunk->capacity))
+			allocateChunk();
+
+		// Write as much as possible to the current chunk
+		size_t used = ACQUIRE_READ(writeChunk->used);
+		size_t len = std::min(writeChunk->capacity - used, length);
+		memcpy(writeChunk->buffer + used, data, len);
+		RELEASE_WRITE(writeChunk->used, used + len);
+		data += len;
+		length -= len;
 	}
 }
 
-void MemoryStreamCache::reserve(size_t expectedLength)
+void MemoryStreamCache::reserve(size_t _expectedLength)
 {
-	if (expectedLength <= receivedLength)
-		return;
-
-	// Set the next chunk to be large enough to hold the remaining
-	// of the stream. The memory will be actually allocated in
-	// append().
-	size_t unused = 0;
-	if (writeChunk)
-		unused = writeChunk->capacity - ACQUIRE_READ(writeChunk->used);
-
-	size_t allocated = receivedLength + unused;
-	if (expectedLength > allocated)
-		nextChunkSize = expectedLength - allocated;
+	// Only used to size the first chunk, the memory will be
+	// actually allocated in append().
+	Locker locker(chunkListMutex);
+	if (chunks.empty())
+		expectedLength = _expectedLength;
 }
 
 std::streambuf *MemoryStreamCache::createReader()
@@ -191,6 +219,47 @@ void MemoryStreamCache::openForWriting()
 	LOG(LOG_ERROR,"openForWriting not implemented in MemoryStreamCache");
 }
 
+bool MemoryStreamCache::useCachedFile(const tiny_string& filename)
+{
+#ifndef _WIN32
+	if (receivedLength || terminated)
+		return false;
+	int fd = open(filename.raw_buf(),O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd,&st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* p = mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	{
+		Locker locker(chunkListMutex);
+		// the mapping is full, so any following append would allocate a new chunk
+		writeChunk = new MemoryChunk((unsigned char*)p,st.st_size);
+		chunks.push_back(writeChunk);
+	}
+	stateMutex.lock();
+	receivedLength = st.st_size;
+	stateMutex.unlock();
+	// We already have the whole file
+	markFinished();
+	return true;
+#else
+	return false;
+#endif
+}
+
+MemoryStreamCache::SpanReader MemoryStreamCache::createSpanReader()
+{
+	incRef();
+	return SpanReader(_MR(this));
+}
+
 MemoryStreamCache::Reader::Reader(_R<MemoryStreamCache> b) :
 	buffer(b), chunkIndex(0), chunkStartOffset(0)
 {
@@ -287,10 +356,15 @@ streampos MemoryStreamCache::Reader::seekoff(streamoff off, std::ios_base::seekd
 			seekpos(off, mode);
 			break;
 		case std::ios_base::cur:
-			// TODO: optimize by checking if the new
-			// offset is in the current chunk
-			seekpos(getOffset() + off, mode);
+		{
+			// Stay in the current chunk if possible
+			streamoff chunkpos = (gptr() - eback()) + off;
+			if (gptr() != nullptr && chunkpos >= 0 && chunkpos < egptr() - eback())
+				gbump(off);
+			else
+				seekpos(getOffset() + off, mode);
 			break;
+		}
 		case std::ios_base::end:
 			buffer->waitForTermination();
 			if (buffer->hasFailed())
@@ -320,18 +394,21 @@ streampos MemoryStreamCache::Reader::seekpos(streampos pos, std::ios_base::openm
 
 	Locker locker(buffer->chunkListMutex);
 	streampos offset = 0;
-	for (auto it=buffer->chunks.begin(); it!=buffer->chunks.end(); ++it)
+	for (unsigned int i=0; i<buffer->chunks.size(); i++)
 	{
-		streampos used = (streampos)ACQUIRE_READ((*it)->used);
+		MemoryChunk* chunk = buffer->chunks[i];
+		streampos used = (streampos)ACQUIRE_READ(chunk->used);
 		if (pos >= offset + used)
 		{
 			offset += used;
 		}
 		else
 		{
-			setg((char *)(*it)->buffer,
-			     (char *)((*it)->buffer + (pos - offset)),
-			     (char *)((*it)->buffer + used));
+			chunkIndex = i;
+			chunkStartOffset = offset;
+			setg((char *)chunk->buffer,
+			     (char *)(chunk->buffer + (pos - offset)),
+			     (char *)(chunk->buffer + used));
 			return pos;
 		}
 	}
@@ -347,6 +424,54 @@ streampos MemoryStreamCache::Reader::getOffset() const
 	return chunkStartOffset + (size_t)(gptr() - eback());
 }
 
+MemoryStreamCache::SpanReader::SpanReader(_R<MemoryStreamCache> b) :
+	buffer(b), chunkIndex(0), chunkOffset(0), position(0)
+{
+}
+
+/**
+ * Returns the next range of received data, waits until some data is
+ * available. The returned span is empty only at the end of the stream.
+ */
+StreamSpan MemoryStreamCache::SpanReader::next(size_t maxlen)
+{
+	StreamSpan span;
+	if (maxlen == 0)
+		return span;
+	while (true)
+	{
+		// Check termination before looking for data, so no data
+		// written before termination can be missed
+		bool terminated = buffer->hasTerminated();
+		{
+			Locker locker(buffer->chunkListMutex);
+			while (chunkIndex < buffer->chunks.size())
+			{
+				MemoryChunk* chunk = buffer->chunks[chunkIndex];
+				size_t used = ACQUIRE_READ(chunk->used);
+				if (chunkOffset < used)
+				{
+					span.size = std::min(used - chunkOffset, maxlen);
+					span.data = chunk->buffer + chunkOffset;
+					chunk->incRef();
+					span.chunk = _MNR(chunk);
+					chunkOffset += span.size;
+					position += span.size;
+					return span;
+				}
+				// Chunks are full when the next one is started
+				if (chunkIndex+1 == buffer->chunks.size())
+					break;
+				chunkIndex++;
+				chunkOffset = 0;
+			}
+		}
+		if (terminated)
+			return span;
+		buffer->waitForData(position);
+	}
+}
+
 FileStreamCache::FileStreamCache(SystemState* _sys):StreamCache(_sys),
   keepCache(false)
 {
@@ -386,7 +511,24 @@ void FileStreamCache::openCache()
 		throw RunTimeException("FileStreamCache::openCache called twice");
 	}
 
-	//Create a temporary file(name)
+	tiny_string cacheFilenameT = createTemporaryFile();
+	if(cacheFilenameT.empty())
+	{
+		markFinished(true);
+		throw RunTimeException("FileStreamCache::openCache: cannot create temporary file");
+	}
+
+	//Let the openExistingCache function handle the rest
+	openExistingCache(cacheFilenameT);
+}
+
+/**
+ * \brief Creates an empty temporary file in the cache directory
+ *
+ * \return The name of the file, or an empty string if it could not be created
+ */
+tiny_string FileStreamCache::createTemporaryFile()
+{
 	Path p(Config::getConfig()->getCacheDirectory());
 	std::string s = Config::getConfig()->getCachePrefix() + "XXXXXX";
 	p /= s;
@@ -396,16 +538,11 @@ void FileStreamCache::openCache()
 	cacheFilenameC[cacheFilenameS.length()] = '\0';
 	int fd = mkstemp(cacheFilenameC);
 	if(fd == -1)
-	{
-		markFinished(true);
-		throw RunTimeException("FileStreamCache::openCache: cannot create temporary file");
-	}
+		return tiny_string();
 
 	//We are using fstream to read/write to the cache, so we don't need this FD
 	close(fd);
-
-	//Let the openExistingCache function handle the rest
-	openExistingCache(tiny_string(cacheFilenameC, true));
+	return tiny_string(cacheFilenameC, true);
 }
 
 /**
@@ -458,6 +595,45 @@ void FileStreamCache::useExistingFile(const tiny_string& filename)
 	markFinished();
 }
 
+bool FileStreamCache::useCachedFile(const tiny_string& filename)
+{
+	// a failure in openExistingCache marks the stream as failed, so check the file first
+	if (cache.is_open() || receivedLength || !FileSystem::isFile(Path(filename)))
+		return false;
+	// Readers open the cache file by name, so the stream uses its own hard link of the file.
+	// It stays readable when the HTTP cache evicts the file and is deleted with the stream.
+	tiny_string linkname = createTemporaryFile();
+	if (linkname.empty())
+		return false;
+	try
+	{
+		FileSystem::remove(Path(linkname));
+		FileSystem::createHardLink(Path(filename),Path(linkname));
+	}
+	catch(std::exception& e)
+	{
+		LOG(LOG_INFO,"could not link cached file "<<filename<<":"<<e.what());
+		unlink(linkname.raw_buf());
+		return false;
+	}
+	try
+	{
+		openExistingCache(linkname, false);
+	}
+	catch(std::exception& e)
+	{
+		LOG(LOG_ERROR,"could not use cached file "<<filename<<":"<<e.what());
+		unlink(linkname.raw_buf());
+		return false;
+	}
+	cache.seekg(0, std::ios::end);
+	receivedLength = cache.tellg();
+
+	// We already have the whole file
+	markFinished();
+	return true;
+}
+
 void FileStreamCache::openForWriting()
 {
 	if (cache.is_open())
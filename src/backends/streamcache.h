@@ -100,14 +100,67 @@ public:
 	virtual std::streambuf *createReader()=0;
 	
 	virtual void openForWriting() = 0;
+
+	// Use the content of a file as the whole stream, the file must not be modified afterwards.
+	// Must be called before append(). Returns false if the file can't be used.
+	virtual bool useCachedFile(const tiny_string& filename) { return false; }
 };
 
-class MemoryChunk;
+// size of the pooled chunks of MemoryStreamCache
+#define MEMORY_CHUNK_SIZE (64*1024)
+// maximum number of unused chunks kept in the pool
+#define MEMORY_CHUNK_POOL_SIZE 64
+
+/*
+ * A part of a MemoryStreamCache. Chunks are filled completely before the next chunk is started
+ * and their data is never moved. They are refcounted, so spans of received data stay valid
+ * independent of the readers and the cache.
+ * Buffers of MEMORY_CHUNK_SIZE are recycled in a global pool.
+ */
+class MemoryChunk : public RefCountable {
+public:
+	MemoryChunk(size_t len);
+	// chunk containing a read-only memory mapping of a file
+	MemoryChunk(unsigned char* mapping, size_t len);
+	~MemoryChunk();
+	unsigned char * const buffer;
+	const size_t capacity;
+	const bool mapped;
+	ACQUIRE_RELEASE_VARIABLE(size_t, used);
+};
+
+// a contiguous range of data of a MemoryStreamCache, the reference keeps the data alive
+struct StreamSpan
+{
+	NullableRef<MemoryChunk> chunk;
+	const unsigned char* data;
+	size_t size;
+	StreamSpan():data(nullptr),size(0) {}
+	bool empty() const { return size == 0; }
+};
 
 /*
  * MemoryStreamCache buffers the stream in memory.
  */
 class DLL_PUBLIC MemoryStreamCache : public StreamCache {
+public:
+	/*
+	 * Reads the stream in place: every call to next() returns the next contiguous range
+	 * of received data without copying it. Like the streambuf readers it waits for the writer
+	 */
+	class DLL_PUBLIC SpanReader {
+	private:
+		_R<MemoryStreamCache> buffer;
+		unsigned int chunkIndex;
+		// bytes of the current chunk already returned
+		size_t chunkOffset;
+		size_t position;
+	public:
+		SpanReader(_R<MemoryStreamCache> b);
+		// returns up to maxlen bytes, an empty span at the end of the stream
+		StreamSpan next(size_t maxlen=SIZE_MAX);
+		size_t getPosition() const { return position; }
+	};
 private:
 	class DLL_LOCAL Reader : public std::streambuf {
 	private:
@@ -130,21 +183,20 @@ private:
 	};
 
 	// Stream is stored into a sequence of memory chunks. The
-	// chunks can grow, but they are never moved, so both readers
-	// and writer can safely use them. However, the mutex must be
-	// held when the container is accessed.
+	// chunks are never moved, so both readers and writer can
+	// safely use them. However, the mutex must be held when the
+	// container is accessed. The cache owns a reference to each chunk.
 	Mutex chunkListMutex;
 	std::vector<MemoryChunk *> chunks;
 
 	// The last chunk, the next write will happen here (writer thread)
 	MemoryChunk *writeChunk;
 
-	// Variables controlling the memory allocation
-	size_t nextChunkSize;
-	static const size_t minChunkSize = 4*4096;
+	// Small streams of known length get a single chunk of exactly that size instead of a pooled one
+	size_t expectedLength;
 
 	// Allocate a new chunk, append it to chunks, update writeChunk
-	void allocateChunk(size_t minLength) DLL_LOCAL;
+	void allocateChunk() DLL_LOCAL;
 
 	void handleAppend(const unsigned char* buffer, size_t length) override DLL_LOCAL;
 
@@ -155,8 +207,12 @@ public:
 	void reserve(size_t expectedLength) override;
 
 	std::streambuf *createReader() override;
+	SpanReader createSpanReader();
 	
 	void openForWriting() override;
+
+	// maps the file into memory instead of copying it
+	bool useCachedFile(const tiny_string& filename) override;
 };
 
 /*
@@ -185,6 +241,7 @@ private:
 	bool keepCache:1;
 
 	void openCache() DLL_LOCAL;
+	static tiny_string createTemporaryFile() DLL_LOCAL;
 	void openExistingCache(const tiny_string& filename, bool forWriting=true) DLL_LOCAL;
 
 	// Block until the cache file is opened by the writer stream
@@ -201,6 +258,7 @@ public:
 	// Use an existing file as cache. Must be called before append().
 	void useExistingFile(const tiny_string& filename);
 	void openForWriting() override;
+	bool useCachedFile(const tiny_string& filename) override;
 };
 
 // simple wrapper to use SDL_RWops as input for istream
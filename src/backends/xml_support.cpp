@@ -26,19 +26,20 @@
 using namespace lightspark;
 using namespace std;
 
-const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
+const pugi::xml_node XMLBase::buildFromString(pugi::xml_document& doc,
+										const tiny_string& str,
 										unsigned int xmlparsemode,
 										pugi::xml_parse_result* parseresult)
 {
 	tiny_string buf = str.removeWhitespace().encodeNull();
 	if (buf.numBytes() > 0 && buf.charAt(0) == '<')
 	{
-		pugi::xml_parse_result res = xmldoc.load_buffer((void*)buf.raw_buf(),buf.numBytes(),xmlparsemode);
+		pugi::xml_parse_result res = doc.load_buffer((void*)buf.raw_buf(),buf.numBytes(),xmlparsemode);
 		if (parseresult)
 		{
 			// error handling is done in the caller
 			*parseresult = res;
-			return xmldoc.root();
+			return doc.root();
 		}
 		switch (res.status)
 		{
@@ -81,10 +82,10 @@ const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
 	}
 	else
 	{
-		pugi::xml_node n = xmldoc.append_child(pugi::node_pcdata);
+		pugi::xml_node n = doc.append_child(pugi::node_pcdata);
 		n.set_value(str.raw_buf());
 	}
-	return xmldoc.root();
+	return doc.root();
 }
 const tiny_string XMLBase::encodeToXML(const tiny_string value, bool bIsAttribute)
 {
@@ -21,10 +21,27 @@
 #define BACKENDS_XML_SUPPORT_H 1
 
 #include "tiny_string.h"
+#include "smartrefs.h"
 #include <3rdparty/pugixml/src/pugixml.hpp>
 namespace lightspark
 {
 
+/*
+ * A parsed document shared by all XML objects created from it.
+ * Nodes that are not yet materialized keep a reference to it,
+ * so their pugi::xml_node handles stay valid
+ */
+class XMLSharedDocument: public RefCountable
+{
+public:
+	XMLSharedDocument(bool _ignoreWhitespace, uint32_t _defaultNamespaceID)
+		:ignoreWhitespace(_ignoreWhitespace),defaultNamespaceID(_defaultNamespaceID) {}
+	pugi::xml_document doc;
+	// settings at parse time, used when nodes are materialized later
+	bool ignoreWhitespace;
+	uint32_t defaultNamespaceID;
+};
+
 
 /*
  * Base class for both XML and XMLNode
@@ -36,6 +53,14 @@ protected:
 	pugi::xml_document xmldoc;
 	// if parseresult is not null, this method will not throw an exception on invalid xml
 	const pugi::xml_node buildFromString(const tiny_string& str,
+										unsigned int xmlparsemode,
+										pugi::xml_parse_result* parseresult=nullptr)
+	{
+		return buildFromString(xmldoc,str,xmlparsemode,parseresult);
+	}
+	// same as above, but parses into the provided document
+	static const pugi::xml_node buildFromString(pugi::xml_document& doc,
+										const tiny_string& str,
 										unsigned int xmlparsemode,
 										pugi::xml_parse_result* parseresult=nullptr);
 
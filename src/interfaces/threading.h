@@ -20,6 +20,7 @@
 #ifndef INTERFACES_THREADING_H
 #define INTERFACES_THREADING_H 1
 
+#include <cstdint>
 
 namespace lightspark
 {
@@ -29,6 +30,8 @@ class IThreadJob
 friend class ThreadPool;
 private:
 	ASWorker* fromWorker;
+	// time (in nanoseconds) the job was added to the ThreadPool
+	uint64_t queueTime;
 public:
 	/*
 	 * Set to true by the ThreadPool just before threadAbort()
@@ -59,7 +62,14 @@ public:
 	 * 'delete this'.
 	 */
 	virtual void jobFence()=0;
-	IThreadJob() : fromWorker(nullptr),threadAborting(false) {}
+	/*
+	 * Jobs that wait for other threads or for I/O
+	 * (downloads, sockets, streams, workers) have to return true,
+	 * they get a thread of their own. All other jobs are run
+	 * by the fixed number of work-stealing workers of the ThreadPool.
+	 */
+	virtual bool isBlocking() const { return false; }
+	IThreadJob() : fromWorker(nullptr),queueTime(0),threadAborting(false) {}
 	virtual ~IThreadJob() {}
 	void setWorker(ASWorker* w) { fromWorker = w;}
 };
@@ -413,6 +413,7 @@ int main(int argc, char* argv[])
 #ifdef PROFILING_SUPPORT
 	char* profilingFileName=nullptr;
 #endif
+	char* traceFileName=nullptr;
 	char *HTTPcookie=nullptr;
 	SecurityManager::SANDBOXTYPE sandboxType=SecurityManager::LOCAL_WITH_FILE;
 	bool useInterpreter=true;
@@ -514,6 +515,17 @@ int main(int argc, char* argv[])
 			profilingFileName=argv[i];
 		}
 #endif
+		else if(strcmp(argv[i],"-t")==0 || 
+			strcmp(argv[i],"--trace-output")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				fileName.clear();
+				break;
+			}
+			traceFileName=argv[i];
+		}
 		else if(strcmp(argv[i],"-s")==0 || 
 			strcmp(argv[i],"--security-sandbox")==0)
 		{
@@ -579,6 +591,7 @@ int main(int argc, char* argv[])
 #ifdef PROFILING_SUPPORT
 							   " [--profiling-output|-o profiling-file]" <<
 #endif
+							   " [--trace-output|-t trace-file]" <<
 							   " [--ignore-unhandled-exceptions|-ne]"
 							   " [--fullscreen|-fs]"
 							   " [--scale|-sc]"
@@ -710,6 +723,8 @@ int main(int argc, char* argv[])
 	if(profilingFileName)
 		sys->setProfilingOutput(profilingFileName);
 #endif
+	if(traceFileName)
+		sys->setTracingOutput(traceFileName);
 	if(HTTPcookie)
 		sys->setCookies(HTTPcookie);
 
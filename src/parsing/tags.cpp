@@ -34,6 +34,7 @@
 #include "swftypes.h"
 #include "logger.h"
 #include "compat.h"
+#include "tracing.h"
 #include "parsing/streams.h"
 #include "scripting/class.h"
 #include "scripting/flash/display/BitmapData.h"
@@ -71,6 +72,7 @@ int JPEGTablesTag::tableSize = 0;
 
 Tag* TagFactory::readTag(RootMovieClip* root, DefineSpriteTag *sprite)
 {
+	TraceScope tracescope(TRACE_PARSE,"readTag");
 	RECORDHEADER h;
 
 	bool done = false;
@@ -1395,16 +1397,74 @@ ASObject* DefineFont4Tag::instance(Class_base* c, ASObject* prevInstance, bool t
 	return ret;
 }
 
-BitmapTag::BitmapTag(RECORDHEADER h,RootMovieClip* root):DictionaryTag(h,root),bitmap(_MR(new BitmapContainer(root->getSystemState()->tagsMemory,true)))
+namespace lightspark
+{
+class BitmapDecodeJob: public IThreadJob
+{
+private:
+	BitmapTag* tag;
+public:
+	BitmapDecodeJob(BitmapTag* t):tag(t) {}
+	void execute() override
+	{
+		tag->decodeBitmap();
+	}
+	void jobFence() override
+	{
+		tag->finishDecoding();
+		delete this;
+	}
+};
+}
+
+// images with less encoded data than this are decoded directly in the parser thread
+#define BITMAP_ASYNC_DECODE_THRESHOLD 16384
+
+BitmapTag::BitmapTag(RECORDHEADER h,RootMovieClip* root):DictionaryTag(h,root),bitmap(_MR(new BitmapContainer(root->getSystemState()->tagsMemory,true))),decodePending(false)
 {
 }
 
 BitmapTag::~BitmapTag()
 {
+	// the derived destructor has already waited for the decoding job
+	assert(!decodePending);
 	bitmap.reset();
 }
 
+void BitmapTag::startDecoding(RootMovieClip* root)
+{
+	SystemState* sys = root->getSystemState();
+	if (sys->runSingleThreaded || encodedData.size() < BITMAP_ASYNC_DECODE_THRESHOLD)
+	{
+		decodeBitmap();
+		encodedData.clear();
+		return;
+	}
+	{
+		Locker l(decodeMutex);
+		decodePending=true;
+	}
+	sys->addJob(new BitmapDecodeJob(this));
+}
+
+void BitmapTag::finishDecoding()
+{
+	Locker l(decodeMutex);
+	decodePending=false;
+	encodedData.clear();
+	encodedData.shrink_to_fit();
+	decodeCond.broadcast();
+}
+
+void BitmapTag::waitForDecoding() const
+{
+	Locker l(decodeMutex);
+	while (decodePending)
+		decodeCond.wait(decodeMutex);
+}
+
 _NR<BitmapContainer> BitmapTag::getBitmap() const {
+	waitForDecoding();
 	return bitmap;
 }
 void BitmapTag::loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen)
@@ -1425,7 +1485,7 @@ void BitmapTag::loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesD
 	else
 		LOG(LOG_ERROR,"unknown image format for ID "<<getId());
 }
-DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int version, RootMovieClip* root):BitmapTag(h,root),BitmapColorTableSize(0)
+DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int _version, RootMovieClip* root):BitmapTag(h,root),BitmapColorTableSize(0),version(_version)
 {
 	int dest=in.tellg();
 	dest+=h.getLength();
@@ -1433,10 +1493,15 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 	if(BitmapFormat==LOSSLESS_BITMAP_PALETTE)
 		in >> BitmapColorTableSize;
 
-	string cData;
 	size_t cSize = dest-in.tellg(); //rest of this tag
-	cData.resize(cSize);
-	in.read(&cData[0], cSize);
+	encodedData.resize(cSize);
+	in.read((char*)encodedData.data(), cSize);
+	startDecoding(root);
+}
+
+void DefineBitsLosslessTag::decodeBitmap()
+{
+	string cData((const char*)encodedData.data(),encodedData.size());
 	istringstream cDataStream(cData);
 	zlib_filter zf(cDataStream.rdbuf());
 	istream zfstream(&zf);
@@ -1497,6 +1562,7 @@ ASObject* BitmapTag::instance(Class_base* c, ASObject* prevInstance, bool tempor
 	//Flex imports bitmaps using BitmapAsset as the base class, which is derived from bitmap
 	//Also BitmapData is used in the wild though, so support both cases
 
+	waitForDecoding();
 	Class_base* realClass=(c)?c:bindedTo;
 	Class_base* classRet = nullptr;
 	if (loadedFrom->usesActionScript3)
@@ -3158,10 +3224,14 @@ DefineBitsTag::DefineBitsTag(RECORDHEADER h, std::istream& in,RootMovieClip* roo
 	in >> CharacterId;
 	//Read image data
 	int dataSize=Header.getLength()-2;
-	uint8_t *inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-	loadBitmap(inData,dataSize,JPEGTablesTag::getJPEGTables(),JPEGTablesTag::getJPEGTableSize());
-	delete[] inData;
+	encodedData.resize(dataSize);
+	in.read((char*)encodedData.data(),dataSize);
+	startDecoding(root);
+}
+
+void DefineBitsTag::decodeBitmap()
+{
+	loadBitmap(encodedData.data(),encodedData.size(),JPEGTablesTag::getJPEGTables(),JPEGTablesTag::getJPEGTableSize());
 }
 
 DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root)
@@ -3170,10 +3240,14 @@ DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMov
 	in >> CharacterId;
 	//Read image data
 	int dataSize=Header.getLength()-2;
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-	loadBitmap(inData,dataSize);
-	delete[] inData;
+	encodedData.resize(dataSize);
+	in.read((char*)encodedData.data(),dataSize);
+	startDecoding(root);
+}
+
+void DefineBitsJPEG2Tag::decodeBitmap()
+{
+	loadBitmap(encodedData.data(),encodedData.size());
 }
 
 DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root),alphaData(NULL)
@@ -3181,21 +3255,24 @@ DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMov
 	LOG(LOG_TRACE,"DefineBitsJPEG3Tag Tag");
 	UI32_SWF dataSize;
 	in >> CharacterId >> dataSize;
-	//Read image data
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
+	jpegSize = dataSize;
+	//Read image data and alpha data (if any)
+	int alphaSize=Header.getLength()-dataSize-6;
+	//If less that 0 the consistency check on tag size will stop later
+	encodedData.resize(jpegSize+max(alphaSize,0));
+	in.read((char*)encodedData.data(),encodedData.size());
+	startDecoding(root);
+}
 
-	loadBitmap(inData,dataSize);
-	delete[] inData;
+void DefineBitsJPEG3Tag::decodeBitmap()
+{
+	loadBitmap(encodedData.data(),jpegSize);
 
-	//Read alpha data (if any)
-	int alphaSize=Header.getLength()-dataSize-6;
-	if(alphaSize>0) //If less that 0 the consistency check on tag size will stop later
+	int alphaSize=encodedData.size()-jpegSize;
+	if(alphaSize>0)
 	{
 		//Create a zlib filter
-		string alphaData;
-		alphaData.resize(alphaSize);
-		in.read(&alphaData[0], alphaSize);
+		string alphaData((const char*)encodedData.data()+jpegSize,alphaSize);
 		istringstream alphaStream(alphaData);
 		zlib_filter zf(alphaStream.rdbuf());
 		istream zfstream(&zf);
@@ -3224,6 +3301,7 @@ DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMov
 
 DefineBitsJPEG3Tag::~DefineBitsJPEG3Tag()
 {
+	waitForDecoding();
 	delete[] alphaData;
 }
 
@@ -3687,7 +3765,12 @@ void TagExecutionList::removeAllEntries(uint32_t depth, DisplayListTag* tag)
 			executionList[l.front().second].first=nullptr;
 			l.pop();
 		}
-		if (tag && (!inSkipping || originalDepthMap->find(LEGACY_DEPTH_START+depth) != originalDepthMap->end()))
+		if (tag && inSkipping && !originalDepthMap)
+		{
+			addEntry(depth,tag,false);
+			conditionalEntries.push_back(executionList.size()-1);
+		}
+		else if (tag && (!inSkipping || originalDepthMap->find(LEGACY_DEPTH_START+depth) != originalDepthMap->end()))
 			addEntry(depth,tag,false);
 	}
 }
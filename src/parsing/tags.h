@@ -21,6 +21,7 @@
 #define PARSING_TAGS_H 1
 
 #include "compat.h"
+#include "threading.h"
 #include <vector>
 #include <queue>
 #include <iostream>
@@ -72,8 +73,11 @@ struct TagExecutionList
 {
 	std::vector<std::pair<DisplayListTag*,bool>> executionList;
 	std::map<uint32_t,std::queue<std::pair<DisplayListTag*,uint32_t>>> executionDepthMap;
+	// if originalDepthMap is not set, removals depending on it are recorded in conditionalEntries (see FrameSnapshot)
 	std::map<int32_t,DisplayObject*>* originalDepthMap;
+	std::vector<uint32_t> conditionalEntries;
 	bool inSkipping;
+	TagExecutionList():originalDepthMap(nullptr),inSkipping(false) {}
 	void addEntry(uint32_t depth, DisplayListTag* tag, bool hasCharacter);
 	void removeAllEntries(uint32_t depth, DisplayListTag* tag);
 };
@@ -717,14 +721,34 @@ class BitmapContainer;
 
 class BitmapTag: public DictionaryTag
 {
+friend class BitmapDecodeJob;
 protected:
 	_NR<BitmapContainer> bitmap;
+	// the compressed image data, decoded asynchronously by a BitmapDecodeJob
+	std::vector<uint8_t> encodedData;
+	mutable Mutex decodeMutex;
+	mutable Cond decodeCond;
+	// protected by decodeMutex
+	bool decodePending;
 	void loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData=nullptr, int tablesLen=0);
+	// decodes encodedData into bitmap
+	virtual void decodeBitmap()=0;
+	// starts decoding encodedData, large images are decoded in the ThreadPool while parsing continues
+	void startDecoding(RootMovieClip* root);
+	void finishDecoding();
 public:
 	BitmapTag(RECORDHEADER h,RootMovieClip* root);
 	~BitmapTag();
 	ASObject* instance(Class_base* c=nullptr,ASObject* prevInstance=nullptr, bool temporary=false) override;
 	_NR<BitmapContainer> getBitmap() const;
+	// blocks until the bitmap data is available, the destructors of derived classes must call it,
+	// because the decoding job uses the virtual decodeBitmap()
+	void waitForDecoding() const;
+	bool isDecodePending() const
+	{
+		Locker l(decodeMutex);
+		return decodePending;
+	}
 };
 
 class JPEGTablesTag: public Tag
@@ -746,9 +770,12 @@ private:
 	UI16_SWF BitmapWidth;
 	UI16_SWF BitmapHeight;
 	UI8 BitmapColorTableSize;
+	int version;
 	//ZlibBitmapData;
+	void decodeBitmap() override;
 public:
 	DefineBitsLosslessTag(RECORDHEADER h, std::istream& in, int version, RootMovieClip* root);
+	~DefineBitsLosslessTag() { waitForDecoding(); }
 	int getId() const override { return CharacterId; }
 };
 
@@ -756,8 +783,10 @@ class DefineBitsTag: public BitmapTag
 {
 private:
 	UI16_SWF CharacterId;
+	void decodeBitmap() override;
 public:
 	DefineBitsTag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
+	~DefineBitsTag() { waitForDecoding(); }
 	int getId() const override { return CharacterId; }
 };
 
@@ -765,8 +794,10 @@ class DefineBitsJPEG2Tag: public BitmapTag
 {
 private:
 	UI16_SWF CharacterId;
+	void decodeBitmap() override;
 public:
 	DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
+	~DefineBitsJPEG2Tag() { waitForDecoding(); }
 	int getId() const override { return CharacterId; }
 };
 
@@ -775,6 +806,9 @@ class DefineBitsJPEG3Tag: public BitmapTag
 private:
 	UI16_SWF CharacterId;
 	uint8_t* alphaData;
+	// size of the jpeg data in encodedData, the compressed alpha data follows
+	uint32_t jpegSize;
+	void decodeBitmap() override;
 public:
 	DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
 	~DefineBitsJPEG3Tag();
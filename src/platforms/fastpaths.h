@@ -39,5 +39,39 @@ namespace lightspark
 */
 void fastYUV420ChannelsToYUV0Buffer(uint8_t* y, uint8_t* u, uint8_t* v, uint8_t* out, uint32_t width, uint32_t height);
 
+enum YUV_COLORSPACE { YUV_BT601=0, YUV_BT709 };
+
+/**
+	Conversion of a packed YUVA buffer (the layout produced by fastYUV420ChannelsToYUV0Buffer,
+	limited range) to premultiplied, native-endian 32 bit ARGB, the format of BitmapContainer.
+	Uses SSE2 or AVX2 if the cpu supports it, the results are identical for all code paths.
+
+	@param in Source YUVA buffer
+	@param inStride Bytes per row of the source buffer
+	@param out Destination ARGB buffer
+	@param outStride Bytes per row of the destination buffer
+	@param width Width in pixels
+	@param height Height in pixels
+	@param colorspace The matrix used for the conversion
+*/
+void fastYUVAToPremultipliedARGB(const uint8_t* in, uint32_t inStride, uint8_t* out, uint32_t outStride, uint32_t width, uint32_t height, YUV_COLORSPACE colorspace);
+
+/**
+	Composites premultiplied 32 bit ARGB pixels over dst (normal blending, dst=src+dst*(255-srcalpha)/255).
+	Uses SSE2 or AVX2 if the cpu supports it, the results are identical for all code paths.
+
+	@param src Source pixels
+	@param dst Destination pixels
+	@param count Number of pixels
+*/
+void fastCompositePremultipliedARGB(const uint32_t* src, uint32_t* dst, uint32_t count);
+
+enum FASTPATH_LEVEL { FASTPATH_GENERIC=0, FASTPATH_SSE2, FASTPATH_AVX2 };
+/**
+	Limits the instruction set used by fastYUVAToPremultipliedARGB and fastCompositePremultipliedARGB,
+	so the code paths can be compared. Returns the level that is actually used.
+*/
+FASTPATH_LEVEL setFastPathLevel(FASTPATH_LEVEL maxLevel);
+
 };
 #endif /* PLATFORMS_FASTPATHS_H */
@@ -0,0 +1,301 @@
+/**************************************************************************
+  Lightspark, a free flash player implementation
+
+  Copyright (C) 2010-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **************************************************************************/
+
+#include "platforms/fastpaths.h"
+#include <cinttypes>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LS_YUV_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace lightspark;
+
+namespace
+{
+/*
+ * All code paths use the same 16 bit fixed point arithmetic:
+ * the inputs are scaled by 64, the coefficients by 8192 and the products keep the high 16 bits,
+ * so the results have 3 fractional bits
+ */
+struct YUVCoefficients
+{
+	int16_t y;
+	int16_t rv;
+	int16_t gu;
+	int16_t gv;
+	int16_t bu;
+};
+const YUVCoefficients coefficients[2] =
+{
+	{ 9538, 13075, 3209, 6660, 16525 }, // BT.601
+	{ 9538, 14686, 1747, 4366, 17305 }, // BT.709
+};
+
+inline int32_t mulhi(int32_t a, int32_t b)
+{
+	return (a*b)>>16;
+}
+// (t+(t>>8))>>8 is the exact rounded division by 255 for t=c*a+128
+inline uint32_t mulDiv255(uint32_t c, uint32_t a)
+{
+	uint32_t t = c*a+128;
+	return (t+(t>>8))>>8;
+}
+inline uint32_t clampAndPremultiply(int32_t c, uint32_t a)
+{
+	c = c < 0 ? 0 : (c > 255 ? 255 : c);
+	return mulDiv255(c,a);
+}
+
+void convertRowGeneric(const uint8_t* in, uint32_t* out, uint32_t count, const YUVCoefficients& c)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t y = (int32_t(in[i*4  ])-16)*64;
+		int32_t u = (int32_t(in[i*4+1])-128)*64;
+		int32_t v = (int32_t(in[i*4+2])-128)*64;
+		uint32_t a = in[i*4+3];
+		int32_t yy = mulhi(y,c.y);
+		int32_t r = (yy+mulhi(v,c.rv)+4)>>3;
+		int32_t g = (yy-mulhi(u,c.gu)-mulhi(v,c.gv)+4)>>3;
+		int32_t b = (yy+mulhi(u,c.bu)+4)>>3;
+		out[i] = (a<<24) | (clampAndPremultiply(r,a)<<16) | (clampAndPremultiply(g,a)<<8) | clampAndPremultiply(b,a);
+	}
+}
+
+void compositeGeneric(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t s = src[i];
+		uint32_t inva = 255-(s>>24);
+		uint32_t res = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+		{
+			uint32_t c = ((s>>shift)&0xff) + mulDiv255((dst[i]>>shift)&0xff,inva);
+			res |= (c > 255 ? 255 : c)<<shift;
+		}
+		dst[i] = res;
+	}
+}
+
+#ifdef LS_YUV_X86
+__attribute__((target("sse2")))
+void convertRowSSE2(const uint8_t* in, uint32_t* out, uint32_t count, const YUVCoefficients& c)
+{
+	const __m128i mask = _mm_set1_epi32(0xff);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c16 = _mm_set1_epi16(16);
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i c255 = _mm_set1_epi16(255);
+	const __m128i round = _mm_set1_epi16(4);
+	const __m128i cy = _mm_set1_epi16(c.y);
+	const __m128i crv = _mm_set1_epi16(c.rv);
+	const __m128i cgu = _mm_set1_epi16(c.gu);
+	const __m128i cgv = _mm_set1_epi16(c.gv);
+	const __m128i cbu = _mm_set1_epi16(c.bu);
+	uint32_t i = 0;
+	for (; i+8 <= count; i += 8)
+	{
+		__m128i p0 = _mm_loadu_si128((const __m128i*)(in+i*4));
+		__m128i p1 = _mm_loadu_si128((const __m128i*)(in+i*4+16));
+		__m128i y = _mm_packs_epi32(_mm_and_si128(p0,mask),_mm_and_si128(p1,mask));
+		__m128i u = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0,8),mask),_mm_and_si128(_mm_srli_epi32(p1,8),mask));
+		__m128i v = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0,16),mask),_mm_and_si128(_mm_srli_epi32(p1,16),mask));
+		__m128i a = _mm_packs_epi32(_mm_srli_epi32(p0,24),_mm_srli_epi32(p1,24));
+		y = _mm_slli_epi16(_mm_sub_epi16(y,c16),6);
+		u = _mm_slli_epi16(_mm_sub_epi16(u,c128),6);
+		v = _mm_slli_epi16(_mm_sub_epi16(v,c128),6);
+		__m128i yy = _mm_add_epi16(_mm_mulhi_epi16(y,cy),round);
+		__m128i r = _mm_srai_epi16(_mm_add_epi16(yy,_mm_mulhi_epi16(v,crv)),3);
+		__m128i g = _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(yy,_mm_mulhi_epi16(u,cgu)),_mm_mulhi_epi16(v,cgv)),3);
+		__m128i b = _mm_srai_epi16(_mm_add_epi16(yy,_mm_mulhi_epi16(u,cbu)),3);
+		r = _mm_min_epi16(_mm_max_epi16(r,zero),c255);
+		g = _mm_min_epi16(_mm_max_epi16(g,zero),c255);
+		b = _mm_min_epi16(_mm_max_epi16(b,zero),c255);
+		// premultiply, (t+(t>>8))>>8 is the exact division by 255 for t=c*a+128
+		r = _mm_add_epi16(_mm_mullo_epi16(r,a),c128);
+		g = _mm_add_epi16(_mm_mullo_epi16(g,a),c128);
+		b = _mm_add_epi16(_mm_mullo_epi16(b,a),c128);
+		r = _mm_srli_epi16(_mm_add_epi16(r,_mm_srli_epi16(r,8)),8);
+		g = _mm_srli_epi16(_mm_add_epi16(g,_mm_srli_epi16(g,8)),8);
+		b = _mm_srli_epi16(_mm_add_epi16(b,_mm_srli_epi16(b,8)),8);
+		__m128i bg = _mm_or_si128(b,_mm_slli_epi16(g,8));
+		__m128i ra = _mm_or_si128(r,_mm_slli_epi16(a,8));
+		_mm_storeu_si128((__m128i*)(out+i),_mm_unpacklo_epi16(bg,ra));
+		_mm_storeu_si128((__m128i*)(out+i+4),_mm_unpackhi_epi16(bg,ra));
+	}
+	convertRowGeneric(in+i*4,out+i,count-i,c);
+}
+
+// src+dst*(255-srcalpha)/255 for the 8 channels of two pixels, as 16 bit values
+__attribute__((target("sse2")))
+inline __m128i compositeHalfSSE2(__m128i s, __m128i d)
+{
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i c255 = _mm_set1_epi16(255);
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(d,_mm_sub_epi16(c255,a)),c128);
+	return _mm_srli_epi16(_mm_add_epi16(t,_mm_srli_epi16(t,8)),8);
+}
+
+__attribute__((target("sse2")))
+void compositeSSE2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t i = 0;
+	for (; i+4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst+i));
+		__m128i lo = compositeHalfSSE2(_mm_unpacklo_epi8(s,zero),_mm_unpacklo_epi8(d,zero));
+		__m128i hi = compositeHalfSSE2(_mm_unpackhi_epi8(s,zero),_mm_unpackhi_epi8(d,zero));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_adds_epu8(s,_mm_packus_epi16(lo,hi)));
+	}
+	compositeGeneric(src+i,dst+i,count-i);
+}
+
+__attribute__((target("avx2")))
+void convertRowAVX2(const uint8_t* in, uint32_t* out, uint32_t count, const YUVCoefficients& c)
+{
+	const __m256i mask = _mm256_set1_epi32(0xff);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c16 = _mm256_set1_epi16(16);
+	const __m256i c128 = _mm256_set1_epi16(128);
+	const __m256i c255 = _mm256_set1_epi16(255);
+	const __m256i round = _mm256_set1_epi16(4);
+	const __m256i cy = _mm256_set1_epi16(c.y);
+	const __m256i crv = _mm256_set1_epi16(c.rv);
+	const __m256i cgu = _mm256_set1_epi16(c.gu);
+	const __m256i cgv = _mm256_set1_epi16(c.gv);
+	const __m256i cbu = _mm256_set1_epi16(c.bu);
+	uint32_t i = 0;
+	// packing and unpacking both work on 128 bit lanes, so the pixel order is preserved
+	for (; i+16 <= count; i += 16)
+	{
+		__m256i p0 = _mm256_loadu_si256((const __m256i*)(in+i*4));
+		__m256i p1 = _mm256_loadu_si256((const __m256i*)(in+i*4+32));
+		__m256i y = _mm256_packs_epi32(_mm256_and_si256(p0,mask),_mm256_and_si256(p1,mask));
+		__m256i u = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0,8),mask),_mm256_and_si256(_mm256_srli_epi32(p1,8),mask));
+		__m256i v = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0,16),mask),_mm256_and_si256(_mm256_srli_epi32(p1,16),mask));
+		__m256i a = _mm256_packs_epi32(_mm256_srli_epi32(p0,24),_mm256_srli_epi32(p1,24));
+		y = _mm256_slli_epi16(_mm256_sub_epi16(y,c16),6);
+		u = _mm256_slli_epi16(_mm256_sub_epi16(u,c128),6);
+		v = _mm256_slli_epi16(_mm256_sub_epi16(v,c128),6);
+		__m256i yy = _mm256_add_epi16(_mm256_mulhi_epi16(y,cy),round);
+		__m256i r = _mm256_srai_epi16(_mm256_add_epi16(yy,_mm256_mulhi_epi16(v,crv)),3);
+		__m256i g = _mm256_srai_epi16(_mm256_sub_epi16(_mm256_sub_epi16(yy,_mm256_mulhi_epi16(u,cgu)),_mm256_mulhi_epi16(v,cgv)),3);
+		__m256i b = _mm256_srai_epi16(_mm256_add_epi16(yy,_mm256_mulhi_epi16(u,cbu)),3);
+		r = _mm256_min_epi16(_mm256_max_epi16(r,zero),c255);
+		g = _mm256_min_epi16(_mm256_max_epi16(g,zero),c255);
+		b = _mm256_min_epi16(_mm256_max_epi16(b,zero),c255);
+		r = _mm256_add_epi16(_mm256_mullo_epi16(r,a),c128);
+		g = _mm256_add_epi16(_mm256_mullo_epi16(g,a),c128);
+		b = _mm256_add_epi16(_mm256_mullo_epi16(b,a),c128);
+		r = _mm256_srli_epi16(_mm256_add_epi16(r,_mm256_srli_epi16(r,8)),8);
+		g = _mm256_srli_epi16(_mm256_add_epi16(g,_mm256_srli_epi16(g,8)),8);
+		b = _mm256_srli_epi16(_mm256_add_epi16(b,_mm256_srli_epi16(b,8)),8);
+		__m256i bg = _mm256_or_si256(b,_mm256_slli_epi16(g,8));
+		__m256i ra = _mm256_or_si256(r,_mm256_slli_epi16(a,8));
+		_mm256_storeu_si256((__m256i*)(out+i),_mm256_unpacklo_epi16(bg,ra));
+		_mm256_storeu_si256((__m256i*)(out+i+8),_mm256_unpackhi_epi16(bg,ra));
+	}
+	convertRowSSE2(in+i*4,out+i,count-i,c);
+}
+
+// unpacking and packing work on 128 bit lanes, so the pixel order is preserved
+__attribute__((target("avx2")))
+void compositeAVX2(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c128 = _mm256_set1_epi16(128);
+	const __m256i c255 = _mm256_set1_epi16(255);
+	uint32_t i = 0;
+	for (; i+8 <= count; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src+i));
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dst+i));
+		__m256i half[2];
+		for (int j = 0; j < 2; j++)
+		{
+			__m256i s16 = j ? _mm256_unpackhi_epi8(s,zero) : _mm256_unpacklo_epi8(s,zero);
+			__m256i d16 = j ? _mm256_unpackhi_epi8(d,zero) : _mm256_unpacklo_epi8(d,zero);
+			__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16,_MM_SHUFFLE(3,3,3,3)),_MM_SHUFFLE(3,3,3,3));
+			__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d16,_mm256_sub_epi16(c255,a)),c128);
+			half[j] = _mm256_srli_epi16(_mm256_add_epi16(t,_mm256_srli_epi16(t,8)),8);
+		}
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_adds_epu8(s,_mm256_packus_epi16(half[0],half[1])));
+	}
+	compositeSSE2(src+i,dst+i,count-i);
+}
+#endif
+
+FASTPATH_LEVEL detectLevel()
+{
+#ifdef LS_YUV_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return FASTPATH_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return FASTPATH_SSE2;
+#endif
+	return FASTPATH_GENERIC;
+}
+
+const FASTPATH_LEVEL cpuLevel = detectLevel();
+std::atomic<FASTPATH_LEVEL> currentLevel(cpuLevel);
+}
+
+FASTPATH_LEVEL lightspark::setFastPathLevel(FASTPATH_LEVEL maxLevel)
+{
+	FASTPATH_LEVEL l = maxLevel < cpuLevel ? maxLevel : cpuLevel;
+	currentLevel = l;
+	return l;
+}
+
+void lightspark::fastYUVAToPremultipliedARGB(const uint8_t* in, uint32_t inStride, uint8_t* out, uint32_t outStride, uint32_t width, uint32_t height, YUV_COLORSPACE colorspace)
+{
+	void (*convertRow)(const uint8_t* in, uint32_t* out, uint32_t count, const YUVCoefficients& c) = convertRowGeneric;
+#ifdef LS_YUV_X86
+	switch (currentLevel.load(std::memory_order_relaxed))
+	{
+		case FASTPATH_AVX2: convertRow = convertRowAVX2; break;
+		case FASTPATH_SSE2: convertRow = convertRowSSE2; break;
+		default: break;
+	}
+#endif
+	const YUVCoefficients& c = coefficients[colorspace==YUV_BT709 ? 1 : 0];
+	for (uint32_t i = 0; i < height; i++)
+		convertRow(in+i*inStride,(uint32_t*)(out+i*outStride),width,c);
+}
+
+void lightspark::fastCompositePremultipliedARGB(const uint32_t* src, uint32_t* dst, uint32_t count)
+{
+#ifdef LS_YUV_X86
+	switch (currentLevel.load(std::memory_order_relaxed))
+	{
+		case FASTPATH_AVX2: compositeAVX2(src,dst,count); return;
+		case FASTPATH_SSE2: compositeSSE2(src,dst,count); return;
+		default: break;
+	}
+#endif
+	compositeGeneric(src,dst,count);
+}
@@ -26,6 +26,7 @@
 #include "scripting/flash/display/Stage.h"
 #include "scripting/flash/errors/flasherrors.h"
 #include "scripting/flash/events/LocalConnectionEvent.h"
+#include "scripting/flash/events/flashevents.h"
 #include "scripting/flash/system/ApplicationDomain.h"
 #include "scripting/toplevel/toplevel.h"
 #include <algorithm>
@@ -89,6 +90,7 @@
 #include "scripting/toplevel/Integer.h"
 #include "scripting/toplevel/UInteger.h"
 #include "scripting/flash/system/flashsystem.h"
+#include "scripting/flash/sampler/objectsampler.h"
 #include "scripting/flash/net/flashnet.h"
 #include "scripting/flash/net/Socket.h"
 #include "scripting/flash/display/Loader.h"
@@ -567,8 +569,88 @@ multiname* ABCContext::getMultinameImpl(asAtom& n, ASObject* n2, unsigned int mi
 	}
 	return ret;
 }
+namespace
+{
+// minimum number of strings decoded by a single job
+#define ABC_STRINGS_PER_JOB 4096
+// number of method bodies verified by a single job
+#define ABC_METHODBODIES_PER_JOB 2048
+
+template<class F>
+class ABCParseJob: public IThreadJob
+{
+private:
+	F func;
+	uint32_t start;
+	uint32_t end;
+	Semaphore& done;
+	bool started;
+public:
+	ABCParseJob(F f, uint32_t s, uint32_t e, Semaphore& d):func(f),start(s),end(e),done(d),started(false) {}
+	void execute() override
+	{
+		started=true;
+		func(start,end);
+	}
+	void jobFence() override
+	{
+		// the ThreadPool skipped the job because it is stopping, the waiting thread needs the results anyway
+		if (!started)
+		{
+			try
+			{
+				func(start,end);
+			}
+			catch(std::exception& e)
+			{
+				LOG(LOG_ERROR,"ABC parse job failed:"<<e.what());
+			}
+		}
+		// the parsing thread waits for every job, so always signal
+		done.signal();
+		delete this;
+	}
+};
+
+// runs func for chunks of [start,end) in the ThreadPool, returns the number of jobs that will signal done
+template<class F>
+uint32_t addParseJobs(SystemState* sys, uint32_t start, uint32_t end, uint32_t chunksize, Semaphore& done, F func)
+{
+	uint32_t jobs=0;
+	for (uint32_t i = start; i < end; i += chunksize)
+	{
+		sys->addJob(new ABCParseJob<F>(func,i,min(end,i+chunksize),done));
+		jobs++;
+	}
+	return jobs;
+}
+
+// only checks the code length and the exception handler ranges of a method body,
+// the bytecode itself is checked when the method is preloaded
+uint32_t verifyMethodBody(const method_body_info& body)
+{
+	if (body.code.empty())
+		return kInvalidCodeLengthError;
+	for (auto it = body.exceptions.begin(); it != body.exceptions.end(); it++)
+	{
+		if (it->from > it->to || it->to > body.code.size() || it->target >= body.code.size())
+			return kIllegalExceptionHandlerError;
+	}
+	return 0;
+}
+}
+
+/*
+ * The ABC data, including the constant pool, is parsed sequentially in the parsing thread.
+ * Only the decoding of the constant pool strings and the basic checks of the method bodies
+ * (see verifyMethodBody) are done in the ThreadPool. The unique string ids, the namespaces and
+ * the class linking are still handled in the parsing thread.
+ * The bytecode itself is only preloaded on the first call of a method.
+ */
 ABCContext::ABCContext(ApplicationDomain* appDomain,SecurityDomain* secDomain, istream& in, ABCVm* vm):scriptsdeclared(false),
 	lastGlobalScope(nullptr),
+	verificationdone(0),
+	verificationjobs(0),
 	applicationDomain(appDomain),
 	securityDomain(secDomain),
 	constant_pool(vm->vmDataMemory),
@@ -579,9 +661,32 @@ ABCContext::ABCContext(ApplicationDomain* appDomain,SecurityDomain* secDomain, i
 	scripts(reporter_allocator<script_info>(vm->vmDataMemory)),
 	method_body(reporter_allocator<method_body_info>(vm->vmDataMemory))
 {
+	SystemState* sys = applicationDomain->getSystemState();
+	uint64_t t=compat_usectiming();
 	in >> minor >> major;
 	LOG(LOG_CALLS,"ABCVm version " << major << '.' << minor);
 	in >> constant_pool;
+	uint64_t t2=compat_usectiming();
+	parsetimes.constantpool=t2-t;
+	t=t2;
+
+	std::vector<tiny_string> decodedstrings(constant_pool.strings.size());
+	Semaphore stringsdone(0);
+	uint32_t stringjobs=0;
+	if (constant_pool.strings.size() >= 2*ABC_STRINGS_PER_JOB)
+	{
+		stringjobs=addParseJobs(sys,1,constant_pool.strings.size(),ABC_STRINGS_PER_JOB,stringsdone,
+			[this,&decodedstrings](uint32_t start, uint32_t end)
+			{
+				for (uint32_t i = start; i < end; i++)
+					decodedstrings[i]=constant_pool.decodeString(i);
+			});
+	}
+	else
+	{
+		for (uint32_t i = 1; i < constant_pool.strings.size(); i++)
+			decodedstrings[i]=constant_pool.decodeString(i);
+	}
 
 	constantAtoms_integer.resize(constant_pool.integer.size());
 	for (uint32_t i = 0; i < constant_pool.integer.size(); i++)
@@ -607,6 +712,78 @@ ABCContext::ABCContext(ApplicationDomain* appDomain,SecurityDomain* secDomain, i
 		else
 			constantAtoms_doubles[i] = asAtomHandler::fromNumber(n);
 	}
+	constantAtoms_byte.resize(0x100);
+	for (uint32_t i = 0; i < 0x100; i++)
+		constantAtoms_byte[i] = asAtomHandler::fromInt((int32_t)(int8_t)i);
+	constantAtoms_short.resize(0x10000);
+	for (int32_t i = 0; i < 0x10000; i++)
+		constantAtoms_short[i] = asAtomHandler::fromInt((int32_t)(int16_t)i);
+	atomsCachedMaxID=0;
+
+	namespaceBaseId=vm->getAndIncreaseNamespaceBase(constant_pool.namespaces.size());
+
+	try
+	{
+		in >> method_count;
+		methods.resize(method_count);
+		for(unsigned int i=0;i<method_count;i++)
+		{
+			in >> methods[i];
+			methods[i].context=this;
+		}
+
+		in >> metadata_count;
+		metadata.resize(metadata_count);
+		for(unsigned int i=0;i<metadata_count;i++)
+			in >> metadata[i];
+
+		in >> class_count;
+		instances.resize(class_count);
+		for(unsigned int i=0;i<class_count;i++)
+			in >> instances[i];
+		classes.resize(class_count);
+		for(unsigned int i=0;i<class_count;i++)
+			in >> classes[i];
+
+		in >> script_count;
+		scripts.resize(script_count);
+		for(unsigned int i=0;i<script_count;i++)
+			in >> scripts[i];
+		t2=compat_usectiming();
+		parsetimes.infos=t2-t;
+		t=t2;
+
+		in >> method_body_count;
+		method_body.resize(method_body_count);
+		for(unsigned int i=0;i<method_body_count;i++)
+		{
+			in >> method_body[i];
+
+			//Link method body with method signature
+			if(method_body[i].method >= method_count)
+				throw ParseException("Invalid method index for function body");
+			if(methods[method_body[i].method].body!=nullptr)
+				throw ParseException("Duplicated body for function");
+			else
+				methods[method_body[i].method].body=&method_body[i];
+		}
+		t2=compat_usectiming();
+		parsetimes.methodbodies=t2-t;
+		t=t2;
+	}
+	catch(...)
+	{
+		// the jobs are still using the constant pool
+		for (uint32_t i = 0; i < stringjobs; i++)
+			stringsdone.wait();
+		throw;
+	}
+
+	for (uint32_t i = 0; i < stringjobs; i++)
+		stringsdone.wait();
+	for (uint32_t i = 1; i < constant_pool.strings.size(); i++)
+		constant_pool.setStringId(i,sys->getUniqueStringId(decodedstrings[i]));
+	constant_pool.clearRawStrings();
 	constantAtoms_strings.resize(constant_pool.strings.size());
 	for (uint32_t i = 0; i < constant_pool.strings.size(); i++)
 	{
@@ -621,35 +798,12 @@ ABCContext::ABCContext(ApplicationDomain* appDomain,SecurityDomain* secDomain, i
 		res->setRefConstant();
 		constantAtoms_namespaces[i] = asAtomHandler::fromObject(res);
 	}
-	constantAtoms_byte.resize(0x100);
-	for (uint32_t i = 0; i < 0x100; i++)
-		constantAtoms_byte[i] = asAtomHandler::fromInt((int32_t)(int8_t)i);
-	constantAtoms_short.resize(0x10000);
-	for (int32_t i = 0; i < 0x10000; i++)
-		constantAtoms_short[i] = asAtomHandler::fromInt((int32_t)(int16_t)i);
-	atomsCachedMaxID=0;
-
-	namespaceBaseId=vm->getAndIncreaseNamespaceBase(constant_pool.namespaces.size());
+	t2=compat_usectiming();
+	parsetimes.strings=t2-t;
+	t=t2;
 
-	in >> method_count;
-	methods.resize(method_count);
-	for(unsigned int i=0;i<method_count;i++)
-	{
-		in >> methods[i];
-		methods[i].context=this;
-	}
-
-	in >> metadata_count;
-	metadata.resize(metadata_count);
-	for(unsigned int i=0;i<metadata_count;i++)
-		in >> metadata[i];
-
-	in >> class_count;
-	instances.resize(class_count);
 	for(unsigned int i=0;i<class_count;i++)
 	{
-		in >> instances[i];
-
 		if(instances[i].supername)
 		{
 			multiname* supermname = getMultiname(instances[i].supername,nullptr);
@@ -705,36 +859,37 @@ ABCContext::ABCContext(ApplicationDomain* appDomain,SecurityDomain* secDomain, i
 		}
 		LOG(LOG_TRACE,endl);
 	}
-	classes.resize(class_count);
-	for(unsigned int i=0;i<class_count;i++)
-		in >> classes[i];
-
-	in >> script_count;
-	scripts.resize(script_count);
-	for(unsigned int i=0;i<script_count;i++)
-		in >> scripts[i];
-
-	in >> method_body_count;
-	method_body.resize(method_body_count);
-	for(unsigned int i=0;i<method_body_count;i++)
-	{
-		in >> method_body[i];
-
-		//Link method body with method signature
-		if(methods[method_body[i].method].body!=nullptr)
-			throw ParseException("Duplicated body for function");
-		else
-			methods[method_body[i].method].body=&method_body[i];
-	}
+	parsetimes.linking=compat_usectiming()-t;
 
 	hasRunScriptInit.resize(scripts.size(),false);
+
+	// nothing may throw after this point, the destructor waits for the verification jobs
+	verificationjobs=addParseJobs(sys,0,method_body.size(),ABC_METHODBODIES_PER_JOB,verificationdone,
+		[this](uint32_t start, uint32_t end)
+		{
+			for (uint32_t i = start; i < end; i++)
+				method_body[i].verifyerror=verifyMethodBody(method_body[i]);
+		});
+	LOG(LOG_INFO,"ABC parsing times (us): constant pool " << parsetimes.constantpool << ", infos " << parsetimes.infos
+		<< ", method bodies " << parsetimes.methodbodies << ", strings " << parsetimes.strings << ", linking " << parsetimes.linking
+		<< " (" << constant_pool.strings.size() << " strings, " << method_body.size() << " method bodies)");
 #ifdef PROFILING_SUPPORT
-	root->getSystemState()->contextes.push_back(this);
+	sys->contextes.push_back(this);
 #endif
 }
 
+void ABCContext::waitVerification()
+{
+	while (verificationjobs)
+	{
+		verificationdone.wait();
+		verificationjobs--;
+	}
+}
+
 ABCContext::~ABCContext()
 {
+	waitVerification();
 	while (!multinames_created.empty())
 	{
 		delete multinames_created.front();
@@ -745,6 +900,8 @@ ABCContext::~ABCContext()
 #ifdef PROFILING_SUPPORT
 void ABCContext::dumpProfilingData(ostream& f) const
 {
+	f << "# ABC parsing times (us): constant pool " << parsetimes.constantpool << " infos " << parsetimes.infos
+		<< " method bodies " << parsetimes.methodbodies << " strings " << parsetimes.strings << " linking " << parsetimes.linking << endl;
 	for(uint32_t i=0;i<methods.size();i++)
 	{
 		if(!methods[i].profTime.empty()) //The function was executed at least once
@@ -778,7 +935,7 @@ void ABCContext::dumpProfilingData(ostream& f) const
  * nextNamespaceBase is set to 2 since 0 is the empty namespace and 1 is the AS3 namespace
  */
 ABCVm::ABCVm(SystemState* s, MemoryAccount* m):m_sys(s),status(CREATED),isIdle(true),canFlushInvalidationQueue(true),shuttingdown(false),
-	events_queue(reporter_allocator<eventType>(m)),idleevents_queue(reporter_allocator<eventType>(m)),event_buffer(reporter_allocator<eventType>(m)),nextNamespaceBase(2),
+	events_queue(reporter_allocator<eventType>(m)),idleevents_queue(reporter_allocator<eventType>(m)),event_buffer(reporter_allocator<eventType>(m)),ioEvents(new EventQueueLanes(false)),nextNamespaceBase(2),
 	vmDataMemory(m), halted(false)
 {
 	m_sys=s;
@@ -791,6 +948,7 @@ void ABCVm::start()
 	else
 	{
 		tls_set(is_vm_thread, (void *)(int64_t)1);
+		Tracer::setThreadName("VM");
 		initVM();
 	}
 }
@@ -834,9 +992,10 @@ void ABCVm::clearDeletableObjects()
 void ABCVm::finalize()
 {
 	//The event queue may be not empty if the VM has been been started
-	if(status==CREATED && !events_queue.empty())
+	if(status==CREATED && (!events_queue.empty() || !ioEvents->empty()))
 		LOG(LOG_ERROR, "Events queue is not empty as expected");
-	events_queue.clear();
+	std::vector<eventType> events;
+	clearEventQueues(events);
 	clearDeletableObjects();
 }
 
@@ -859,17 +1018,26 @@ ABCVm::~ABCVm()
 		delete (*it);
 		it++;
 	}
+	delete ioEvents;
 }
 
 int ABCVm::getEventQueueSize()
 {
-	return events_queue.size();
+	return events_queue.size()+ioEvents->size();
+}
+
+void ABCVm::clearEventQueues(std::vector<eventType>& events)
+{
+	events.insert(events.end(),events_queue.begin(),events_queue.end());
+	events_queue.clear();
+	ioEvents->ownerQueueCleared();
+	ioEvents->popAll(events);
 }
 
 void ABCVm::handleQueuedEvents()
 {
 	event_queue_mutex.lock();
-	while (!events_queue.empty())
+	while (!events_queue.empty() || !ioEvents->empty())
 	{
 		handleFrontEvent();
 		event_queue_mutex.lock();
@@ -1140,6 +1308,7 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 			{
 				while (!idleevents_queue.empty())
 				{
+					ioEvents->ownerEventAdded(idleevents_queue.front().first.getPtr());
 					events_queue.push_back(idleevents_queue.front());
 					idleevents_queue.pop_front();
 				}
@@ -1311,6 +1480,7 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 					Locker l(event_queue_mutex);
 					while (!idleevents_queue.empty())
 					{
+						ioEvents->ownerEventAdded(idleevents_queue.front().first.getPtr());
 						events_queue.push_back(idleevents_queue.front());
 						idleevents_queue.pop_front();
 					}
@@ -1337,6 +1507,8 @@ void ABCVm::handleEvent(std::pair<_NR<EventDispatcher>, _R<Event> > e)
 			{
 				FlushEventBufferEvent* ev=static_cast<FlushEventBufferEvent*>(e.second.getPtr());
 				Locker l(event_queue_mutex);
+				for (auto it = event_buffer.begin(); it != event_buffer.end(); it++)
+					ioEvents->ownerEventAdded(it->first.getPtr());
 				events_queue.insert
 					(
 						ev->append ? events_queue.end() : events_queue.begin(),
@@ -1441,6 +1613,7 @@ bool ABCVm::prependEvent(_NR<EventDispatcher> obj ,_R<Event> ev, bool force)
 	if (!obj.isNull())
 		obj->onNewEvent(ev.getPtr());
 
+	ioEvents->ownerEventAdded(obj.getPtr());
 	if (isIdle || force)
 		events_queue.push_front(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
 	else
@@ -1491,7 +1664,12 @@ bool ABCVm::addEvent(_NR<EventDispatcher> obj ,_R<Event> ev, bool isGlobalMessag
 	}
 	if (!obj.isNull())
 		obj->onNewEvent(ev.getPtr());
-	events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
+	ev->queueTime=compat_usectiming();
+	if (!ioEvents->addIOEvent(obj,ev))
+	{
+		ioEvents->ownerEventAdded(obj.getPtr());
+		events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
+	}
 	RELEASE_WRITE(ev->queued,true);
 	sem_event_cond.signal();
 	if (isGlobalMessage)
@@ -1570,14 +1748,30 @@ void ABCVm::checkExternalCallEvent()
 	}
 	pair<_NR<EventDispatcher>,_R<Event>> e=events_queue.front();
 	if (e.first.isNull() && e.second->getEventType() == EXTERNAL_CALL)
-		handleFrontEvent();
+		handleFrontEvent(nullptr,true);
 	else
 		event_queue_mutex.unlock();
 }
-void ABCVm::handleFrontEvent()
+void ABCVm::handleFrontEvent(ThreadProfile* profile, bool mainQueueOnly)
 {
-	pair<_NR<EventDispatcher>,_R<Event>> e=events_queue.front();
-	events_queue.pop_front();
+	bool ioEvent = !mainQueueOnly && ioEvents->nextLane(events_queue.empty())==EVENTLANE_IO;
+	pair<_NR<EventDispatcher>,_R<Event>> e=ioEvent ? ioEvents->pop(EVENTLANE_IO) : events_queue.front();
+	if (!ioEvent)
+	{
+		ioEvents->ownerEventRemoved(e.first.getPtr());
+		events_queue.pop_front();
+	}
+	if (profile)
+	{
+		profile->accountQueueDepth(events_queue.size()+ioEvents->size()+1);
+		// only events added by addEvent() are timestamped
+		if (e.second->queueTime)
+		{
+			uint64_t now=compat_usectiming();
+			profile->accountQueueLatency(now > e.second->queueTime ? now-e.second->queueTime : 0);
+			e.second->queueTime=0;
+		}
+	}
 
 	event_queue_mutex.unlock();
 	if (e.second->getEventType() != SHUTDOWN && !e.second->is<WaitableEvent>() && halted)
@@ -1613,6 +1807,8 @@ void ABCVm::handleFrontEvent()
 				e.first.fakeRelease();
 				o->removeStoredMember();
 			}
+			if (m_sys->worker->sampler)
+				m_sys->worker->sampler->eventHandled();
 		},
 		std::move(e)
 	);
@@ -1688,6 +1884,7 @@ void ABCContext::declareScripts(bool inExtension)
 {
 	if (scriptsdeclared)
 		return;
+	waitVerification();
 	while (!inExtension && !getVm(applicationDomain->getSystemState())->hasEverStarted()) // ensure that all builtin classes are defined
 		applicationDomain->getSystemState()->sleep_ms(10);
 	//Take script entries and declare their traits
@@ -1888,6 +2085,7 @@ int ABCVm::Run(void* d)
 
 	/* set TLS variable for isVmThread() */
 	tls_set(is_vm_thread, (void *)(int64_t)1);
+	Tracer::setThreadName("VM");
 
 	std::string errStr;
 	th->initVM(&errStr);
@@ -1908,25 +2106,25 @@ int ABCVm::Run(void* d)
 	{
 		th->clearDeletableObjects();
 		th->event_queue_mutex.lock();
-		while(th->events_queue.empty() && !th->shuttingdown)
+		while(th->events_queue.empty() && th->ioEvents->empty() && !th->shuttingdown)
 			th->sem_event_cond.wait(th->event_queue_mutex);
 		if(th->shuttingdown)
 		{
 			//If the queue is empty stop immediately
-			if(th->events_queue.empty())
+			if(th->events_queue.empty() && th->ioEvents->empty())
 			{
 				th->event_queue_mutex.unlock();
 				break;
 			}
 			else if(firstMissingEvents)
 			{
-				LOG(LOG_INFO,th->events_queue.size() << " events missing before exit");
+				LOG(LOG_INFO,th->getEventQueueSize() << " events missing before exit");
 				firstMissingEvents = false;
 			}
 		}
 		Chronometer chronometer;
 
-		th->handleFrontEvent();
+		th->handleFrontEvent(profile);
 		profile->accountTime(chronometer.checkpoint());
 #ifdef MEMORY_USAGE_PROFILING
 		if((snapshotCount%100)==0)
@@ -1944,12 +2142,12 @@ void ABCVm::signalEventWaiters()
 {
 	assert(shuttingdown);
 	//we do not need a lock because th->shuttingdown keeps other events from being enqueued
-	while(!events_queue.empty())
+	std::vector<eventType> events;
+	clearEventQueues(events);
+	for(auto it=events.begin();it!=events.end();it++)
 	{
-		pair<_NR<EventDispatcher>,_R<Event>> e=events_queue.front();
-		events_queue.pop_front();
-		if(e.second->is<WaitableEvent>())
-			e.second->as<WaitableEvent>()->signal();
+		if(it->second->is<WaitableEvent>())
+			it->second->as<WaitableEvent>()->signal();
 	}
 }
 
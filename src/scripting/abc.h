@@ -75,6 +75,7 @@ inline stack_entry make_stack_entry(llvm::Value* v, STACK_TYPE t)
 bool isVmThread();
 
 class Responder;
+class EventQueueLanes;
 
 class method_info
 {
@@ -149,31 +150,16 @@ public:
 	}
 	~method_info()
 	{
+		// all arrays of cc are allocated as one block starting at cc.locals (see call_context::setupFrame)
 		if (cc.locals)
 		{
-			delete[] cc.locals;
+			delete[] (uint8_t*)cc.locals;
 			cc.locals=nullptr;
 		}
-		if (cc.stack)
-		{
-			delete[] cc.stack;
-			cc.stack=nullptr;
-		}
-		if (cc.scope_stack)
-		{
-			delete[] cc.scope_stack;
-			cc.scope_stack=nullptr;
-		}
-		if (cc.scope_stack_dynamic)
-		{
-			delete[] cc.scope_stack_dynamic;
-			cc.scope_stack_dynamic=nullptr;
-		}
-		if (cc.localslots)
-		{
-			delete[] cc.localslots;
-			cc.localslots=nullptr;
-		}
+	}
+	uint32_t getFrameSize() const
+	{
+		return call_context::getFrameSize(body->getMaxLocals(),body->getMaxLocalsWithoutSlots(),body->max_stack,body->max_scope_depth);
 	}
 };
 
@@ -214,6 +200,10 @@ friend class method_info;
 private:
 	bool scriptsdeclared;
 	Global* lastGlobalScope;
+	// signaled once by every method body verification job
+	Semaphore verificationdone;
+	uint32_t verificationjobs;
+	void waitVerification();
 public:
 	ApplicationDomain* applicationDomain;
 	SecurityDomain* securityDomain;
@@ -242,6 +232,15 @@ public:
 	std::vector<method_body_info, reporter_allocator<method_body_info>> method_body;
 	//Base for namespaces in this context
 	uint32_t namespaceBaseId;
+	// wall clock time in microseconds spent in the parsing phases of the constructor
+	struct
+	{
+		uint64_t constantpool;
+		uint64_t infos;
+		uint64_t methodbodies;
+		uint64_t strings;
+		uint64_t linking;
+	} parsetimes;
 
 	
 	std::vector<bool> hasRunScriptInit;
@@ -558,10 +557,15 @@ private:
 	std::deque<eventType, reporter_allocator<eventType>> events_queue;
 	std::list<eventType, reporter_allocator<eventType>> idleevents_queue;
 	std::list<eventType, reporter_allocator<eventType>> event_buffer;
+	// I/O events (loaders, sockets), handled after events_queue or within the I/O event budget
+	EventQueueLanes* ioEvents;
 	template<typename F, typename F2>
 	void tryHandleEvent(F&& beforeCB, F2&& afterCB, eventType&& e);
 	void handleEvent(std::pair<_NR<EventDispatcher>,_R<Event> > e);
-	void handleFrontEvent();
+	// handles the next event of events_queue or ioEvents, if mainQueueOnly is set the front of events_queue is handled
+	void handleFrontEvent(ThreadProfile* profile=nullptr, bool mainQueueOnly=false);
+	// drains events_queue and ioEvents
+	void clearEventQueues(std::vector<eventType>& events);
 	void signalEventWaiters();
 
 	//Profiling support
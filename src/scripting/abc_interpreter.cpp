@@ -1205,6 +1205,13 @@ abc_function ABCVm::abcfunctions[]={
 void ABCVm::preloadFunction(SyntheticFunction* function, ASWorker* wrk)
 {
 	method_info* mi=function->mi;
+	if (mi->body->verifyerror)
+	{
+		char strcodelen[20];
+		sprintf(strcodelen,"%d",(int)mi->body->code.size());
+		createError<VerifyError>(wrk,mi->body->verifyerror,strcodelen);
+		return;
+	}
 
 	const int code_len=mi->body->code.size();
 	preloadstate state(function,wrk);
@@ -373,8 +373,16 @@ istream& lightspark::operator>>(istream& in, cpool_info& v)
 
 	in >> v.string_count;
 	v.strings.resize(v.string_count);
+	v.rawstringoffsets.resize(v.string_count+1);
 	for(unsigned int i=1;i<v.string_count;i++)
-		in >> v.strings[i];
+	{
+		u30 size;
+		in >> size;
+		uint32_t pos=v.rawstrings.size();
+		v.rawstrings.resize(pos+size);
+		in.read(&v.rawstrings[pos],size);
+		v.rawstringoffsets[i+1]=v.rawstrings.size();
+	}
 
 	in >> v.namespace_count;
 	v.namespaces.resize(v.namespace_count);
@@ -405,6 +413,17 @@ cpool_info::cpool_info(MemoryAccount* m):
 {
 }
 
+tiny_string cpool_info::decodeString(uint32_t i) const
+{
+	return tiny_string(std::string(rawstrings.data()+rawstringoffsets[i],rawstringoffsets[i+1]-rawstringoffsets[i]));
+}
+
+void cpool_info::clearRawStrings()
+{
+	std::string().swap(rawstrings);
+	std::vector<uint32_t>().swap(rawstringoffsets);
+}
+
 method_body_info::~method_body_info()
 {
 	if (localsinitialvalues)
@@ -97,6 +97,7 @@ public:
 class string_info
 {
 friend std::istream& operator>>(std::istream& in, string_info& v);
+friend struct cpool_info;
 private:
 	uint32_t val;
 public:
@@ -161,6 +162,12 @@ struct cpool_info
 	std::vector<ns_set_info, reporter_allocator<ns_set_info>> ns_sets;
 	u30 multiname_count;
 	std::vector<multiname_info, reporter_allocator<multiname_info>> multinames;
+	// operator>> only stores the raw bytes of the strings, the ABCContext decodes them and sets the unique ids
+	std::string rawstrings;
+	std::vector<uint32_t> rawstringoffsets;
+	tiny_string decodeString(uint32_t i) const;
+	void setStringId(uint32_t i, uint32_t id) { strings[i].val = id; }
+	void clearRawStrings();
 };
 
 struct option_detail
@@ -320,7 +327,7 @@ struct localconstantslot
 
 struct method_body_info
 {
-	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL),localsinitialvalues(nullptr){}
+	method_body_info():localresultcount(0),hit_count(0),codeStatus(ORIGINAL),verifyerror(0),localsinitialvalues(nullptr){}
 	~method_body_info();
 	u30 method;
 	u30 max_stack;
@@ -338,8 +345,12 @@ struct method_body_info
 	//The code status
 	enum CODE_STATUS { ORIGINAL = 0, USED, OPTIMIZED, JITTED, PRELOADING, PRELOADED };
 	CODE_STATUS codeStatus;
+	// error code of the VerifyError thrown on the first call, set by the verification jobs of the ABCContext
+	uint32_t verifyerror;
 	// list of local/slot pairs that were optimized away
 	std::vector<localconstantslot> localconstantslots;
+	// the preloaded code references runtime objects (abc functions, cached objects, variables and constants)
+	// and depends on the classes defined when the method is first called, so it can't be reused across runs
 	std::vector<preloadedcodedata> preloadedcode;
 	asAtom* localsinitialvalues;
 	inline uint16_t getReturnValuePos() const { return returnvaluepos; }
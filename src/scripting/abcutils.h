@@ -87,6 +87,27 @@ struct call_context
 	{
 	}
 	static void handleError(int errorcode);
+	// size of the memory block containing locals, operand stack, scope stack and localslots of a method
+	static inline uint32_t getFrameSize(uint32_t maxlocals, uint32_t maxlocalswithoutslots, uint32_t maxstack, uint32_t maxscopedepth)
+	{
+		return (maxlocalswithoutslots+maxstack+1+maxscopedepth)*sizeof(asAtom)
+				+ maxlocals*sizeof(asAtom*)
+				+ maxscopedepth*sizeof(bool);
+	}
+	// carves all arrays of the call_context out of a single block of at least getFrameSize() bytes
+	inline void setupFrame(uint8_t* frame, uint32_t maxlocals, uint32_t maxlocalswithoutslots, uint32_t maxstack, uint32_t maxscopedepth)
+	{
+		locals = (asAtom*)frame;
+		stack = locals+maxlocalswithoutslots;
+		scope_stack = stack+maxstack+1;
+		localslots = (asAtom**)(scope_stack+maxscopedepth);
+		scope_stack_dynamic = (bool*)(localslots+maxlocals);
+		stackp = stack;
+		max_stackp = stack+maxstack;
+		lastlocal = locals+maxlocalswithoutslots;
+		for (uint32_t i = 0; i < maxlocalswithoutslots; i++)
+			localslots[i] = &locals[i];
+	}
 	inline void runtime_stack_clear()
 	{
 		while(stackp != stack)
@@ -97,6 +118,108 @@ struct call_context
 	}
 };
 typedef ASObject* (*synt_function)(call_context* cc);
+// offset of the arrays behind a call_context allocated in a call_frame_stack
+#define CALL_CONTEXT_FRAME_OFFSET ((sizeof(call_context)+15)&~size_t(15))
+
+/*
+ * Per worker stack of memory segments used for the call_contexts of recursive calls.
+ * Frames are allocated by bumping a pointer and released in LIFO order by resetting
+ * it to a marker. Calls reserve their frames through a guard, so C++ exceptions release them, too.
+ */
+#define CALL_FRAME_SEGMENT_SIZE (256*1024)
+class call_frame_stack
+{
+private:
+	struct segment
+	{
+		uint8_t* data;
+		uint32_t size;
+		uint32_t used;
+	};
+	std::vector<segment> segments;
+	uint32_t current;
+	uint8_t* allocateInNextSegment(uint32_t size)
+	{
+		++current;
+		if (current < segments.size() && segments[current].size < size)
+		{
+			// segments above the current one are unused, so they can be replaced
+			for (uint32_t i = current; i < segments.size(); i++)
+				delete[] segments[i].data;
+			segments.resize(current);
+		}
+		if (current == segments.size())
+		{
+			segment s;
+			s.size = size > CALL_FRAME_SEGMENT_SIZE ? size : CALL_FRAME_SEGMENT_SIZE;
+			s.data = new uint8_t[s.size];
+			segments.push_back(s);
+		}
+		segments[current].used = size;
+		return segments[current].data;
+	}
+public:
+	struct marker
+	{
+		uint32_t segment;
+		uint32_t used;
+	};
+	call_frame_stack():current(0)
+	{
+		segment s;
+		s.size = CALL_FRAME_SEGMENT_SIZE;
+		s.data = new uint8_t[s.size];
+		s.used = 0;
+		segments.push_back(s);
+	}
+	~call_frame_stack()
+	{
+		for (auto it = segments.begin(); it != segments.end(); it++)
+			delete[] (*it).data;
+	}
+	FORCE_INLINE marker getMarker() const
+	{
+		marker m;
+		m.segment = current;
+		m.used = segments[current].used;
+		return m;
+	}
+	FORCE_INLINE uint8_t* allocate(uint32_t size)
+	{
+		size = (size+15)&~15U;
+		segment& s = segments[current];
+		if (USUALLY_FALSE(s.size-s.used < size))
+			return allocateInNextSegment(size);
+		uint8_t* ret = s.data+s.used;
+		s.used += size;
+		return ret;
+	}
+	FORCE_INLINE void release(const marker& m)
+	{
+		current = m.segment;
+		segments[current].used = m.used;
+	}
+	// releases all frames allocated after reserve() when it goes out of scope, also if a C++ exception is thrown
+	class guard
+	{
+	private:
+		call_frame_stack* stack;
+		marker m;
+	public:
+		guard():stack(nullptr) {}
+		~guard()
+		{
+			if (stack)
+				stack->release(m);
+		}
+		FORCE_INLINE uint8_t* reserve(call_frame_stack& s, uint32_t size)
+		{
+			stack = &s;
+			m = s.getMarker();
+			return s.allocate(size);
+		}
+	};
+};
 
 
 class AVM1context
@@ -340,6 +340,32 @@ void BitmapContainer::fromRawData(uint8_t* data, uint32_t width, uint32_t height
 	}
 }
 
+void BitmapContainer::drawYUVAFrame(const uint8_t* yuva, uint32_t inStride, int32_t w, int32_t h, int32_t x, int32_t y, bool hasAlpha, YUV_COLORSPACE colorspace)
+{
+	int32_t sx = max(0,-x);
+	int32_t sy = max(0,-y);
+	int32_t dx = max(0,x);
+	int32_t dy = max(0,y);
+	int32_t cw = min(w-sx,width-dx);
+	int32_t ch = min(h-sy,height-dy);
+	if (cw <= 0 || ch <= 0)
+		return;
+	uint8_t* d = getCurrentData()+dy*stride+dx*4;
+	const uint8_t* s = yuva+sy*inStride+sx*4;
+	if (!hasAlpha)
+		fastYUVAToPremultipliedARGB(s,inStride,d,stride,cw,ch,colorspace);
+	else
+	{
+		std::vector<uint32_t> row(cw);
+		for (int32_t i = 0; i < ch; i++)
+		{
+			fastYUVAToPremultipliedARGB(s+i*inStride,inStride,(uint8_t*)row.data(),cw*4,cw,1,colorspace);
+			fastCompositePremultipliedARGB(row.data(),(uint32_t*)(d+i*stride),cw);
+		}
+	}
+	setModifiedData(true);
+}
+
 // needs to be called in renderThread
 bool BitmapContainer::checkTextureForUpload(SystemState* sys)
 {
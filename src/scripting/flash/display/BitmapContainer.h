@@ -29,6 +29,7 @@
 #include <queue>
 #include "backends/graphics.h"
 #include "backends/colortransformbase.h"
+#include "platforms/fastpaths.h"
 #include "threading.h"
 
 
@@ -125,6 +126,8 @@ public:
 	bool fromGIF(uint8_t* data, int len, SystemState* sys);
 	bool fromPalette(uint8_t* inData, uint32_t width, uint32_t height, uint32_t inStride, uint8_t* palette, unsigned numColors, unsigned paletteBPP);
 	void fromRawData(uint8_t* data, uint32_t width, uint32_t height);
+	// draws a packed YUVA video frame at x/y, frames with alpha are composited over the current content
+	void drawYUVAFrame(const uint8_t* yuva, uint32_t inStride, int32_t w, int32_t h, int32_t x, int32_t y, bool hasAlpha, YUV_COLORSPACE colorspace);
 	// Clip sourceRect coordinates to this BitmapContainer. The
 	// output coordinates can be used to access pixels in data
 	// without out-of-bounds errors.
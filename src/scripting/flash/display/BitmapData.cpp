@@ -36,6 +36,7 @@
 #include "scripting/flash/filters/flashfilters.h"
 #include "scripting/flash/geom/Rectangle.h"
 #include "scripting/flash/geom/Point.h"
+#include "scripting/flash/media/flashmedia.h"
 #include "backends/rendering.h"
 #include "backends/cachedsurface.h"
 #include "3rdparty/perlinnoise/PerlinNoise.hpp"
@@ -388,6 +389,19 @@ ASFUNCTIONBODY_ATOM(BitmapData,drawWithQuality)
 			case BUILTIN_STRINGS::STRING_SCREEN: bl = BLENDMODE_SCREEN; break;
 			case BUILTIN_STRINGS::STRING_SUBTRACT: bl = BLENDMODE_SUBTRACT; break;
 		}
+		if (d->is<Video>() && bl==BLENDMODE_NORMAL && clipRect.isNull()
+			&& (ctransform.isNull() || ctransform->isIdentity())
+			&& initialMatrix.xx==1 && initialMatrix.yy==1 && initialMatrix.xy==0 && initialMatrix.yx==0
+			&& initialMatrix.x0==floorf(initialMatrix.x0) && initialMatrix.y0==floorf(initialMatrix.y0))
+		{
+			// unscaled video frames are converted on the cpu instead of being rendered
+			th->pixels->flushRenderCalls(th->getSystemState()->getRenderThread());
+			if (d->as<Video>()->drawToBitmap(th->pixels.getPtr(),initialMatrix.x0,initialMatrix.y0))
+			{
+				th->notifyUsers();
+				return;
+			}
+		}
 		th->drawDisplayObject(d, initialMatrix,smoothing,bl,ctransform.getPtr(),clipRect.getPtr(),needscopy,nullptr,qualityfactor);
 		if (th->users.empty())
 			th->pixels->flushRenderCalls(th->getSystemState()->getRenderThread(),drawable->is<BitmapData>() ? d->as<Bitmap>() : nullptr);
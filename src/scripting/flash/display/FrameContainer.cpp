@@ -178,7 +178,7 @@ void Frame::fillExecutionList(TagExecutionList* list, DisplayObjectContainer* di
 	auto it=blueprint.begin();
 	for(;it!=blueprint.end();++it)
 	{
-		RemoveObject2Tag* obj = static_cast<RemoveObject2Tag*>(*it);
+		RemoveObject2Tag* obj = dynamic_cast<RemoveObject2Tag*>(*it);
 		if (obj != nullptr && displayList->hasLegacyChildAt(obj->getDepth()))
 		{
 			DisplayObject* child = displayList->getLegacyChildAt(obj->getDepth());
@@ -198,9 +198,10 @@ void Frame::AVM1executeActionsDirect(MovieClip* clip)
 	}
 }
 
-FrameContainer::FrameContainer():framesLoaded(0)
+FrameContainer::FrameContainer():framesLoaded(0),initActionsDoneFrame(0)
 {
 	frames.emplace_back(Frame());
+	frameIndex.push_back(frames.begin());
 	scenes.resize(1);
 }
 
@@ -237,6 +238,7 @@ void FrameContainer::addFrameLabel(uint32_t frame, const tiny_string& label)
 
 void FrameContainer::destroyTags()
 {
+	snapshots.clear();
 	for(auto it=frames.begin();it!=frames.end();++it)
 		it->destroyTags();
 }
@@ -244,6 +246,110 @@ void FrameContainer::destroyTags()
 void FrameContainer::addFrame()
 {
 	frames.emplace_back(Frame());
+	Locker l(frameIndexMutex);
+	frameIndex.push_back(std::prev(frames.end()));
+}
+
+std::list<Frame>::iterator FrameContainer::getFrame(uint32_t frame)
+{
+	Locker l(frameIndexMutex);
+	assert(frame < frameIndex.size());
+	return frameIndex[frame];
+}
+
+/* Returns the nearest snapshot before the given frame, building missing snapshots on demand.
+ * Snapshots can only be used if the init actions of all frames they cover have been executed */
+const FrameSnapshot* FrameContainer::getSnapshot(uint32_t frame)
+{
+	uint32_t count = frame/FRAME_SNAPSHOT_INTERVAL;
+	if (count == 0)
+		return nullptr;
+	uint32_t lastframe = count*FRAME_SNAPSHOT_INTERVAL-1;
+	if (lastframe >= getFramesLoaded())
+		return nullptr;
+	if (initActionsDoneFrame <= lastframe)
+	{
+		auto it = getFrame(initActionsDoneFrame);
+		while (initActionsDoneFrame <= lastframe && it->avm1initactiontags.empty())
+		{
+			++initActionsDoneFrame;
+			++it;
+		}
+		if (initActionsDoneFrame <= lastframe)
+			return nullptr;
+	}
+	while (snapshots.size() < count)
+		buildNextSnapshot();
+	return &snapshots[count-1];
+}
+
+void FrameContainer::buildNextSnapshot()
+{
+	// the display list is not known here, so removals that depend on it are recorded as conditional
+	TagExecutionList list;
+	list.inSkipping = true;
+	FrameSnapshot snapshot;
+	snapshot.frame = (snapshots.size()+1)*FRAME_SNAPSHOT_INTERVAL-1;
+	uint32_t startframe = 0;
+	if (!snapshots.empty())
+	{
+		restoreSnapshot(snapshots.back(),&list);
+		startframe = snapshots.back().frame+1;
+	}
+	auto it = getFrame(startframe);
+	for (uint32_t i = startframe; i <= snapshot.frame; i++,++it)
+	{
+		for (auto itbp = it->blueprint.begin(); itbp != it->blueprint.end(); ++itbp)
+		{
+			RemoveObject2Tag* obj = dynamic_cast<RemoveObject2Tag*>(*itbp);
+			if (obj != nullptr)
+				snapshot.removedDepths.push_back(obj->getDepth());
+			(*itbp)->fillExecutionList(list);
+		}
+	}
+	std::vector<uint32_t> entrydepths(list.executionList.size());
+	for (auto itdepth = list.executionDepthMap.begin(); itdepth != list.executionDepthMap.end(); ++itdepth)
+	{
+		snapshot.depths.push_back(itdepth->first);
+		auto q = itdepth->second;
+		while (!q.empty())
+		{
+			entrydepths[q.front().second] = itdepth->first;
+			q.pop();
+		}
+	}
+	std::vector<bool> conditional(list.executionList.size(),false);
+	for (auto itcond = list.conditionalEntries.begin(); itcond != list.conditionalEntries.end(); ++itcond)
+		conditional[*itcond] = true;
+	for (uint32_t i = 0; i < list.executionList.size(); i++)
+	{
+		if (!list.executionList[i].first)
+			continue;
+		FrameSnapshot::entry e;
+		e.tag = list.executionList[i].first;
+		e.depth = entrydepths[i];
+		e.conditional = conditional[i];
+		snapshot.entries.push_back(e);
+	}
+	snapshots.push_back(snapshot);
+}
+
+/* Fills the execution list with the state of the snapshot, as if all frames up to snapshot.frame had been filled in skipping mode.
+ * If list->originalDepthMap is set, conditional removals are resolved against it */
+void FrameContainer::restoreSnapshot(const FrameSnapshot& snapshot, TagExecutionList* list)
+{
+	for (auto it = snapshot.depths.begin(); it != snapshot.depths.end(); ++it)
+		list->executionDepthMap.insert(make_pair(*it,std::queue<std::pair<DisplayListTag*,uint32_t>>()));
+	for (auto it = snapshot.entries.begin(); it != snapshot.entries.end(); ++it)
+	{
+		if (it->conditional && list->originalDepthMap
+				&& list->originalDepthMap->find(LEGACY_DEPTH_START+it->depth) == list->originalDepthMap->end())
+			continue;
+		list->executionList.push_back(make_pair(it->tag,true));
+		list->executionDepthMap[it->depth].push(make_pair(it->tag,list->executionList.size()-1));
+		if (it->conditional && !list->originalDepthMap)
+			list->conditionalEntries.push_back(list->executionList.size()-1);
+	}
 }
 
 /* Returns a Scene_data pointer for a scene called sceneName, or for
@@ -450,40 +556,56 @@ void FrameContainer::addScene(uint32_t sceneNo, uint32_t startframe, const tiny_
 }
 void FrameContainer::AVM1ExecuteFrameActionsDirect(uint32_t frame, MovieClip* clip)
 {
-	auto it=frames.begin();
-	uint32_t i=0;
-	while(it != frames.end() && i < frame)
-	{
-		++i;
-		++it;
-	}
-	if (it != frames.end())
-	{
-		it->AVM1executeActionsDirect(clip);
-	}
+	if (frame < getFramesSize())
+		getFrame(frame)->AVM1executeActionsDirect(clip);
 }
 
 void FrameContainer::declareFrame(MovieClip* clip)
 {
 	if(getFramesLoaded())
 	{
-		auto iter=frames.begin();
 		uint32_t frame = clip->state.FP;
 		clip->removedFrameScripts.clear();
 		TagExecutionList executionlist;
 		if (clip->state.last_FP == (int)frame-1)
 		{
 			// common case moving forward one frame => no need to create execution list, just execute all tags of the current frame
-			for(uint32_t i =0;i<frame;i++)
-			{
-				++iter;
-			}
-			iter->execute(clip,false,clip->removedFrameScripts);
+			getFrame(frame)->execute(clip,false,clip->removedFrameScripts);
 			return;
 		}
 		executionlist.originalDepthMap = &clip->mapDepthToLegacyChild;
+		uint32_t startframe = 0;
+		if ((int)frame < clip->state.last_FP)
+		{
+			// seeking backwards: start with the nearest snapshot instead of replaying all frames
+			const FrameSnapshot* snapshot = getSnapshot(frame);
+			if (snapshot)
+			{
+				executionlist.inSkipping=true;
+				restoreSnapshot(*snapshot,&executionlist);
+				for (auto it = snapshots.begin(); &(*it) <= snapshot; ++it)
+				{
+					for (auto itdepth = it->removedDepths.begin(); itdepth != it->removedDepths.end(); ++itdepth)
+					{
+						if (clip->hasLegacyChildAt(*itdepth))
+						{
+							DisplayObject* child = clip->getLegacyChildAt(*itdepth);
+							child->incRef();
+							clip->removedFrameScripts.push_back(_MR(child));
+						}
+					}
+				}
+				startframe = snapshot->frame+1;
+			}
+		}
+		else if (clip->state.last_FP >= 0)
+		{
+			// seeking forward: the frames up to last_FP are not filled anyway
+			startframe = clip->state.last_FP+1;
+		}
+		auto iter=getFrame(startframe);
 		// fill all tags to be executed up to current frame
-		for(clip->state.FP=0;clip->state.FP<=frame;clip->state.FP++)
+		for(clip->state.FP=startframe;clip->state.FP<=frame;clip->state.FP++)
 		{
 			if((int)frame < clip->state.last_FP || (int)clip->state.FP > clip->state.last_FP)
 			{
@@ -509,5 +631,7 @@ void FrameContainer::declareFrame(MovieClip* clip)
 void FrameContainer::pop_frame()
 {
 	assert(!frames.empty());
+	Locker l(frameIndexMutex);
+	frameIndex.pop_back();
 	frames.pop_back();
 }
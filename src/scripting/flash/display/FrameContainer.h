@@ -29,6 +29,8 @@ class AVM1InitActionTag;
 struct TagExecutionList;
 
 #define FRAME_NOT_FOUND 0xffffffff //Used by getFrameIdBy*
+// distance in frames between two snapshots of the display list
+#define FRAME_SNAPSHOT_INTERVAL 64
 
 struct FrameLabel_data
 {
@@ -87,6 +89,29 @@ public:
 	void destroyTags();
 };
 
+/*
+ * Compact state of the TagExecutionList after all frames up to (and including) "frame"
+ * were filled in skipping mode. Seeking backwards starts from the nearest snapshot
+ * instead of replaying the DisplayListTags from the first frame.
+ */
+struct FrameSnapshot
+{
+	struct entry
+	{
+		DisplayListTag* tag;
+		uint32_t depth;
+		// removal that is only executed if the depth is occupied in the display list when seeking
+		bool conditional;
+	};
+	uint32_t frame;
+	// live entries of the execution list in execution order
+	std::vector<entry> entries;
+	// all depths known to the execution list, including those without live entries
+	std::vector<uint32_t> depths;
+	// depths of RemoveObject2Tags in the frames since the previous snapshot
+	std::vector<uint32_t> removedDepths;
+};
+
 class FrameContainer
 {
 protected:
@@ -109,6 +134,17 @@ protected:
 private:
 	//No need for any lock, just make sure accesses are atomic
 	ATOMIC_INT32(framesLoaded);
+	/* Random access to the frames. It is appended to by the parsing thread,
+	 * so reallocations are guarded by frameIndexMutex */
+	std::vector<std::list<Frame>::iterator> frameIndex;
+	Mutex frameIndexMutex;
+	std::vector<FrameSnapshot> snapshots;
+	// all init actions of the frames before this frame have been executed
+	uint32_t initActionsDoneFrame;
+	std::list<Frame>::iterator getFrame(uint32_t frame);
+	const FrameSnapshot* getSnapshot(uint32_t frame);
+	void buildNextSnapshot();
+	void restoreSnapshot(const FrameSnapshot& snapshot, TagExecutionList* list);
 public:
 	FrameContainer();
 	void setFramesLoaded(uint32_t fl) { framesLoaded = fl; }
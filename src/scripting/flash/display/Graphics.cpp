@@ -740,44 +740,6 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 	}
 }
 
-/* Solve for c in the matrix equation
- *
- * [ 1 x1 y1 ] [ c[0] ]   [ u1 ]
- * [ 1 x2 y2 ] [ c[1] ] = [ u2 ]
- * [ 1 x3 y3 ] [ c[2] ]   [ u3 ]
- *
- * The result will be put in the output parameter c.
- */
-void Graphics::solveVertexMapping(double x1, double y1,
-				  double x2, double y2,
-				  double x3, double y3,
-				  double u1, double u2, double u3,
-				  double c[3])
-{
-	double eps = 1e-15;
-	double det = fabs(x2*y3 + x1*y2 + y1*x3 - y2*x3 - x1*y3 - y1*x2);
-
-	if (det < eps)
-	{
-		// Degenerate matrix
-		c[0] = c[1] = c[2] = 0;
-		return;
-	}
-
-	// Symbolic solution of the equation by Gaussian elimination
-	if (fabs(x1-x2) < eps)
-	{
-		c[2] = (u2-u1)/(y2-y1);
-		c[1] = (u3 - u1 - (y3-y1)*c[2])/(x3-x1);
-		c[0] = u1 - x1*c[1] - y1*c[2];
-	}
-	else
-	{
-		c[2] = ((x2-x1)*(u3-u1) - (x3-x1)*(u2-u1))/((y3-y1)*(x2-x1) - (x3-x1)*(y2-y1));
-		c[1] = (u2 - u1 - (y2-y1)*c[2])/(x2-x1);
-		c[0] = u1 - x1*c[1] - y1*c[2];
-	}
-}
 void Graphics::setFillStart()
 {
 	if (!fillstartset)
@@ -1017,20 +979,28 @@ ASFUNCTIONBODY_ATOM(Graphics,drawTriangles)
 
 void Graphics::drawTrianglesToTokens(_NR<Vector> vertices, _NR<Vector> indices, _NR<Vector> uvtData, tiny_string culling, tokensVector* tokens)
 {
-	if (culling != "none")
-		LOG(LOG_NOT_IMPLEMENTED, "Graphics.drawTriangles doesn't support culling");
-
 	// Validate the parameters
 	if (vertices.isNull())
 		return;
 
 	if ((indices.isNull() && (vertices->size() % 6 != 0)) || 
-	    (!indices.isNull() && (indices->size() % 3 != 0)))
+	    (!indices.isNull() && (indices->size() % 3 != 0 || vertices->size() % 2 != 0)))
 	{
 		createError<ArgumentError>(getWorker(),kInvalidParamError);
 		return;
 	}
 
+	int cullsign=0;
+	if (culling == "positive")
+		cullsign=1;
+	else if (culling == "negative")
+		cullsign=-1;
+	else if (culling != "none")
+	{
+		createError<ArgumentError>(getWorker(),kInvalidEnumError,"culling");
+		return;
+	}
+
 	unsigned int numvertices=vertices->size()/2;
 	unsigned int numtriangles;
 	bool has_uvt=false;
@@ -1064,6 +1034,8 @@ void Graphics::drawTrianglesToTokens(_NR<Vector> vertices, _NR<Vector> indices,
 		assert(tokens->filltokens);
 		TokenContainer::getTextureSize(tokens->filltokens->tokens, &texturewidth, &textureheight);
 	}
+	if (!tokens->filltokens)
+		tokens->filltokens = _MR(new tokenListRef());
 
 	// According to testing, drawTriangles first fills the current
 	// path and creates a new path, but keeps the source.
@@ -1072,79 +1044,72 @@ void Graphics::drawTrianglesToTokens(_NR<Vector> vertices, _NR<Vector> indices,
 	if (has_uvt && (texturewidth==0 || textureheight==0))
 		return;
 
-	// Construct the triangles
+	TriangleMesh& mesh = tokens->filltokens->addTriangleMesh();
+	mesh.vertices.resize(numvertices*2);
+	for (unsigned int i=0; i<numvertices*2; i++)
+	{
+		asAtom a = vertices->at(i);
+		mesh.vertices[i]=asAtomHandler::toNumber(a)*TWIPS_FACTOR;
+	}
+	if (has_uvt)
+	{
+		mesh.uvs.resize(numvertices*2);
+		for (unsigned int i=0; i<numvertices; i++)
+		{
+			asAtom au = uvtData->at(i*uvtElemSize);
+			mesh.uvs[i*2]=asAtomHandler::toNumber(au);
+			asAtom av = uvtData->at(i*uvtElemSize+1);
+			mesh.uvs[i*2+1]=asAtomHandler::toNumber(av);
+		}
+	}
+
+	// Construct the triangles, culled triangles are left out of the index buffer
+	mesh.indices.reserve(numtriangles*3);
+	mesh.xmin = mesh.ymin = numeric_limits<float>::max();
+	mesh.xmax = mesh.ymax = -numeric_limits<float>::max();
 	for (unsigned int i=0; i<numtriangles; i++)
 	{
-		double x[3], y[3], u[3]={0}, v[3]={0};
+		uint32_t vertex[3];
 		for (unsigned int j=0; j<3; j++)
 		{
-			unsigned int vertex;
 			if (indices.isNull())
-				vertex=3*i+j;
+				vertex[j]=3*i+j;
 			else
 			{
-				asAtom a =indices->at(3*i+j);
-				vertex=asAtomHandler::toInt(a);
-			}
-
-			asAtom ax = vertices->at(2*vertex);
-			x[j]=asAtomHandler::toNumber(ax)*TWIPS_FACTOR;
-			asAtom ay = vertices->at(2*vertex+1);
-			y[j]=asAtomHandler::toNumber(ay)*TWIPS_FACTOR;
-
-			if (has_uvt)
-			{
-				asAtom au = uvtData->at(vertex*uvtElemSize);
-				u[j]=asAtomHandler::toNumber(au)*texturewidth*TWIPS_FACTOR;
-				asAtom av = uvtData->at(vertex*uvtElemSize+1);
-				v[j]=asAtomHandler::toNumber(av)*textureheight*TWIPS_FACTOR;
+				asAtom a = indices->at(3*i+j);
+				vertex[j]=asAtomHandler::toUInt(a);
 			}
 		}
-		
-		Vector2 a(x[0], y[0]);
-		Vector2 b(x[1], y[1]);
-		Vector2 c(x[2], y[2]);
-		updateTokenBounds(x[0],y[0]);
-		updateTokenBounds(x[1],y[1]);
-		updateTokenBounds(x[2],y[2]);
-
-		tokens->filltokens->tokens.emplace_back(GeomToken(MOVE).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(a).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(STRAIGHT).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(b).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(STRAIGHT).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(c).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(STRAIGHT).uval);
-		tokens->filltokens->tokens.emplace_back(GeomToken(a).uval);
-
-		if (has_uvt)
+		// triangles with indices out of range are ignored
+		if (vertex[0] >= numvertices || vertex[1] >= numvertices || vertex[2] >= numvertices)
+			continue;
+		if (cullsign)
 		{
-			double t[6];
-
-			// Use the known (x, y) and (u, v)
-			// correspondences to compute a transformation
-			// t from (x, y) space into (u, v) space
-			// (cairo needs the mapping in this
-			// direction).
-			//
-			// u = t[0] + t[1]*x + t[2]*y
-			// v = t[3] + t[4]*x + t[5]*y
-			//
-			// u and v parts can be solved separately.
-			solveVertexMapping(x[0], y[0], x[1], y[1], x[2], y[2],
-					   u[0], u[1], u[2], t);
-			solveVertexMapping(x[0], y[0], x[1], y[1], x[2], y[2],
-					   v[0], v[1], v[2], &t[3]);
-
-			tokens->filltokens->tokens.emplace_back(GeomToken(FILL_TRANSFORM_TEXTURE).uval);
-			tokens->filltokens->tokens.emplace_back(GeomToken(t[1]).uval);
-			tokens->filltokens->tokens.emplace_back(GeomToken(t[5]).uval);
-			tokens->filltokens->tokens.emplace_back(GeomToken(t[4]).uval);
-			tokens->filltokens->tokens.emplace_back(GeomToken(t[2]).uval);
-			tokens->filltokens->tokens.emplace_back(GeomToken(t[0]).uval);
-			tokens->filltokens->tokens.emplace_back(GeomToken(t[3]).uval);
+			// the sign of the z component of the triangle normal, the y axis points downwards
+			float* a = &mesh.vertices[vertex[0]*2];
+			float* b = &mesh.vertices[vertex[1]*2];
+			float* c = &mesh.vertices[vertex[2]*2];
+			float normal = (b[0]-a[0])*(c[1]-a[1])-(c[0]-a[0])*(b[1]-a[1]);
+			if (normal*cullsign > 0)
+				continue;
+		}
+		for (unsigned int j=0; j<3; j++)
+		{
+			float x = mesh.vertices[vertex[j]*2];
+			float y = mesh.vertices[vertex[j]*2+1];
+			mesh.xmin = min(mesh.xmin,x);
+			mesh.xmax = max(mesh.xmax,x);
+			mesh.ymin = min(mesh.ymin,y);
+			mesh.ymax = max(mesh.ymax,y);
+			mesh.indices.push_back(vertex[j]);
 		}
 	}
+	if (mesh.indices.empty())
+		return;
+	updateTokenBounds(mesh.xmin,mesh.ymin);
+	updateTokenBounds(mesh.xmax,mesh.ymax);
+	tokens->filltokens->tokens.emplace_back(GeomToken(TRIANGLE_MESH).uval);
+	tokens->filltokens->tokens.emplace_back(GeomToken(mesh).uval);
 }
 
 void Graphics::clone(Graphics* source)
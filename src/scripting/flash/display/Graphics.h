@@ -40,11 +40,6 @@ class Graphics: public ASObject
 {
 private:
 	TokenContainer *owner;
-	static void solveVertexMapping(double x1, double y1,
-				       double x2, double y2,
-				       double x3, double y3,
-				       double u1, double u2, double u3,
-				       double c[3]);
 	int movex;
 	int movey;
 	int fillstartx;
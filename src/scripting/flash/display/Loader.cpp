@@ -326,7 +326,8 @@ ASFUNCTIONBODY_ATOM(Loader,loadBytes)
 	{
 		// better work on a copy of the source bytearray as it may be modified by actionscript before loading is completed
 		ByteArray* b = Class<ByteArray>::getInstanceSNoArgs(wrk);
-		b->writeBytes(bytes->getBufferNoCheck(),bytes->getLength());
+		if (!b->shareBuffer(bytes.getPtr()))
+			b->writeBytes(bytes->getBufferNoCheck(),bytes->getLength());
 		bytes = _MR(b);
 
 		LoaderThread *thread=new LoaderThread(_MR(bytes), th);
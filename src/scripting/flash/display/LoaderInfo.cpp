@@ -261,6 +261,7 @@ void LoaderInfo::setOpened(bool fromBytes)
 	if (!fromByteArray)
 	{
 		auto ev = Class<Event>::getInstanceS(getInstanceWorker(),"open");
+		ev->ioEvent=true;
 		this->incRef();
 		getVm(getSystemState())->addEvent(_MR(this),_MR(ev));
 		if (p)
@@ -432,6 +433,7 @@ void LoaderInfo::checkSendComplete()
 		//The clip is also complete now
 		this->incRef();
 		auto ev = Class<Event>::getInstanceS(getInstanceWorker(),"complete");
+		ev->ioEvent=true;
 		getVm(getSystemState())->addEvent(_MR(this),_MR(ev));
 		loadStatus=LOAD_COMPLETE;
 	}
@@ -462,9 +462,19 @@ bool TokenContainer::boundsRectFromTokens(const tokensVector& tokens, float scal
 				case SET_FILL:
 					it++;
 					break;
-				case FILL_TRANSFORM_TEXTURE:
-					it+=6;
+				case TRIANGLE_MESH:
+				{
+					GeomToken p1(*(++it),false);
+					if (p1.mesh->triangleCount())
+					{
+						Vector2f vmin(p1.mesh->xmin,p1.mesh->ymin);
+						Vector2f vmax(p1.mesh->xmax,p1.mesh->ymax);
+						VECTOR_BOUNDS(vmin);
+						VECTOR_BOUNDS(vmax);
+						hasContent = true;
+					}
 					break;
+				}
 			}
 			it++;
 		}
@@ -513,9 +523,19 @@ bool TokenContainer::boundsRectFromTokens(const tokensVector& tokens, float scal
 				case SET_FILL:
 					it2++;
 					break;
-				case FILL_TRANSFORM_TEXTURE:
-					it2+=6;
+				case TRIANGLE_MESH:
+				{
+					GeomToken p1(*(++it2),false);
+					if (p1.mesh->triangleCount())
+					{
+						Vector2f vmin(p1.mesh->xmin,p1.mesh->ymin);
+						Vector2f vmax(p1.mesh->xmax,p1.mesh->ymax);
+						VECTOR_BOUNDS(vmin);
+						VECTOR_BOUNDS(vmax);
+						hasContent = true;
+					}
 					break;
+				}
 			}
 			it2++;
 		}
@@ -558,8 +578,8 @@ void TokenContainer::getTextureSize(TokenList& tokens, int *width, int *height)
 			case CURVE_CUBIC:
 				i+=3;
 				break;
-			case FILL_TRANSFORM_TEXTURE:
-				i+=6;
+			case TRIANGLE_MESH:
+				i++;
 				break;
 			case SET_FILL:
 			{
@@ -681,9 +701,9 @@ void TokenContainer::fillGraphicsData(Vector* v, _NR<tokenListRef> filltokens, _
 				case CURVE_CUBIC:
 					it = addDrawCommand(GRAPHICSPATH_COMMANDTYPE::CUBIC_CURVE_TO,3,it,&currentpath,wrk,m,this->scaling);
 					break;
-				case FILL_TRANSFORM_TEXTURE:
+				case TRIANGLE_MESH:
 					LOG(LOG_NOT_IMPLEMENTED,"fillGraphicsData for Token type:"<<t.type<<" "<<this->owner->toDebugString());
-					it+=6;
+					it++;
 					break;
 				case SET_FILL:
 					endGraphicsFill(&currentpath,infill,v,wrk);
@@ -723,9 +743,9 @@ void TokenContainer::fillGraphicsData(Vector* v, _NR<tokenListRef> filltokens, _
 				case CURVE_CUBIC:
 					it = addDrawCommand(GRAPHICSPATH_COMMANDTYPE::CUBIC_CURVE_TO,3,it,&currentpath,wrk,m,this->scaling);
 					break;
-				case FILL_TRANSFORM_TEXTURE:
+				case TRIANGLE_MESH:
 					LOG(LOG_NOT_IMPLEMENTED,"fillGraphicsData for Token type:"<<t.type<<" "<<this->owner->toDebugString());
-					it+=6;
+					it++;
 					break;
 				case SET_FILL:
 				{
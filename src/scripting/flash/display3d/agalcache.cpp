@@ -0,0 +1,378 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2017 Ludger Krämer <dbluelle@onlinehome.de>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "scripting/flash/display3d/agalcache.h"
+#include "scripting/flash/display3d/agalconverter.h"
+#include "scripting/flash/utils/ByteArray.h"
+#include "backends/config.h"
+#include "utils/filesystem.h"
+#include "interfaces/threading.h"
+#include "swf.h"
+#include "logger.h"
+#include <fstream>
+#include <cinttypes>
+
+using namespace std;
+using namespace lightspark;
+
+// maximum number of translations kept in memory
+#define AGAL_CACHE_MAX_ENTRIES 1024
+// increase if the generated GLSL or the file format changes
+#define AGAL_CACHE_FILE_VERSION 1
+
+namespace
+{
+// the generated GLSL header depends on the build configuration
+#ifdef ENABLE_GLES2
+const uint32_t glslVariant = 1;
+#elif defined(ENABLE_GLES3)
+const uint32_t glslVariant = 2;
+#elif defined(__APPLE__)
+const uint32_t glslVariant = 3;
+#else
+const uint32_t glslVariant = 0;
+#endif
+
+// FNV-1a
+uint64_t hashBytes(uint64_t h, const uint8_t* data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= data[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+class AGALTranslationJob: public IThreadJob
+{
+private:
+	_R<AGALTranslation> translation;
+public:
+	AGALTranslationJob(_R<AGALTranslation> t):translation(t) {}
+	void execute() override { translation->run(); }
+	void jobFence() override { delete this; }
+};
+
+void writeUInt32(ofstream& f, uint32_t v)
+{
+	f.write((const char*)&v,4);
+}
+void writeString(ofstream& f, const tiny_string& s)
+{
+	writeUInt32(f,s.numBytes());
+	f.write(s.raw_buf(),s.numBytes());
+}
+void writeBytes(ofstream& f, const vector<uint8_t>& v)
+{
+	writeUInt32(f,v.size());
+	f.write((const char*)v.data(),v.size());
+}
+void writeRegisters(ofstream& f, const vector<RegisterMapEntry>& registers)
+{
+	writeUInt32(f,registers.size());
+	for (auto it = registers.begin(); it != registers.end(); it++)
+	{
+		writeString(f,it->name);
+		writeUInt32(f,it->number);
+		writeUInt32(f,it->type);
+		writeUInt32(f,it->usage);
+	}
+}
+bool readUInt32(ifstream& f, uint32_t& v)
+{
+	return bool(f.read((char*)&v,4));
+}
+bool readString(ifstream& f, tiny_string& s)
+{
+	uint32_t len;
+	if (!readUInt32(f,len) || len > 0x1000000)
+		return false;
+	string buf(len,'\0');
+	if (!f.read(&buf[0],len))
+		return false;
+	s = buf;
+	return true;
+}
+bool readBytes(ifstream& f, vector<uint8_t>& v)
+{
+	uint32_t len;
+	if (!readUInt32(f,len) || len > 0x1000000)
+		return false;
+	v.resize(len);
+	return bool(f.read((char*)v.data(),len));
+}
+bool readRegisters(ifstream& f, vector<RegisterMapEntry>& registers)
+{
+	uint32_t count;
+	if (!readUInt32(f,count) || count > 0x10000)
+		return false;
+	registers.resize(count);
+	for (auto it = registers.begin(); it != registers.end(); it++)
+	{
+		uint32_t type;
+		uint32_t usage;
+		if (!readString(f,it->name) || !readUInt32(f,it->number) || !readUInt32(f,type) || !readUInt32(f,usage))
+			return false;
+		it->type = (RegisterType)type;
+		it->usage = (RegisterUsage)usage;
+	}
+	return true;
+}
+}
+
+AGALTranslation::AGALTranslation(ByteArray* vertexProgram, ByteArray* fragmentProgram)
+	:AGALTranslation(vertexProgram ? vertexProgram->getBufferNoCheck() : nullptr,vertexProgram ? vertexProgram->getLength() : 0,vertexProgram && vertexProgram->getLittleEndian(),
+					 fragmentProgram ? fragmentProgram->getBufferNoCheck() : nullptr,fragmentProgram ? fragmentProgram->getLength() : 0,fragmentProgram && fragmentProgram->getLittleEndian())
+{
+}
+
+AGALTranslation::AGALTranslation(const uint8_t* vertexbytes, uint32_t vertexlen, bool vertexLittleEndian, const uint8_t* fragmentbytes, uint32_t fragmentlen, bool fragmentLittleEndian)
+	:state(PENDING),flags(0)
+{
+	if (vertexbytes)
+	{
+		flags |= HAS_VERTEXPROGRAM | (vertexLittleEndian ? VERTEX_LITTLEENDIAN : 0);
+		vertexcode.assign(vertexbytes,vertexbytes+vertexlen);
+	}
+	if (fragmentbytes)
+	{
+		flags |= HAS_FRAGMENTPROGRAM | (fragmentLittleEndian ? FRAGMENT_LITTLEENDIAN : 0);
+		fragmentcode.assign(fragmentbytes,fragmentbytes+fragmentlen);
+	}
+	hash = hashBytes(0xcbf29ce484222325ULL,&flags,1);
+	hash = hashBytes(hash,vertexcode.data(),vertexcode.size());
+	hash = hashBytes(hash,fragmentcode.data(),fragmentcode.size());
+}
+
+bool AGALTranslation::matches(const AGALTranslation& other) const
+{
+	return hash == other.hash
+		&& flags == other.flags
+		&& vertexcode == other.vertexcode
+		&& fragmentcode == other.fragmentcode;
+}
+
+bool AGALTranslation::translate(tiny_string& vertexglsl, tiny_string& fragmentglsl, vector<SamplerRegister>& samplers,
+								vector<RegisterMapEntry>& vertexregisters, vector<RegisterMapEntry>& vertexattribs,
+								vector<RegisterMapEntry>& fragmentregisters, vector<RegisterMapEntry>& fragmentattribs) const
+{
+	samplers.clear();
+	try
+	{
+		RegisterMap vertexmap; // this is needed to keep track of the registers when creating the fragment program
+		if (flags & HAS_VERTEXPROGRAM)
+		{
+			AGALReader reader(vertexcode.data(),vertexcode.size(),flags & VERTEX_LITTLEENDIAN);
+			vertexglsl = AGALtoGLSL(reader,true,samplers,vertexregisters,vertexattribs,vertexmap);
+		}
+		if (flags & HAS_FRAGMENTPROGRAM)
+		{
+			AGALReader reader(fragmentcode.data(),fragmentcode.size(),flags & FRAGMENT_LITTLEENDIAN);
+			fragmentglsl = AGALtoGLSL(reader,false,samplers,fragmentregisters,fragmentattribs,vertexmap);
+		}
+	}
+	catch(std::exception& e)
+	{
+		// the program is uploaded without shaders
+		LOG(LOG_ERROR,"AGAL translation failed:"<<e.what());
+		vertexglsl.clear();
+		fragmentglsl.clear();
+		samplers.clear();
+		return false;
+	}
+	return true;
+}
+
+bool AGALTranslation::loadFromFile()
+{
+	ifstream f(cacheFilename,ios::in|ios::binary);
+	if (!f.is_open())
+		return false;
+	uint32_t version;
+	uint32_t variant;
+	uint32_t storedflags;
+	vector<uint8_t> storedvertexcode;
+	vector<uint8_t> storedfragmentcode;
+	if (!readUInt32(f,version) || version != AGAL_CACHE_FILE_VERSION
+		|| !readUInt32(f,variant) || variant != glslVariant
+		|| !readUInt32(f,storedflags) || storedflags != flags
+		|| !readBytes(f,storedvertexcode) || storedvertexcode != vertexcode
+		|| !readBytes(f,storedfragmentcode) || storedfragmentcode != fragmentcode)
+		return false;
+	uint32_t samplercount;
+	if (!readString(f,vertexprogram) || !readString(f,fragmentprogram) || !readUInt32(f,samplercount) || samplercount > 0x10000)
+		return false;
+	samplerState.resize(samplercount);
+	for (auto it = samplerState.begin(); it != samplerState.end(); it++)
+	{
+		uint32_t values[11];
+		for (uint32_t i = 0; i < 11; i++)
+		{
+			if (!readUInt32(f,values[i]))
+				return false;
+		}
+		it->b = values[0];
+		it->d = values[1];
+		it->f = values[2];
+		it->m = values[3];
+		it->n = values[4];
+		it->isVertexProgram = values[5];
+		it->s = values[6];
+		it->t = values[7];
+		it->type = (RegisterType)values[8];
+		it->w = values[9];
+		it->program_sampler_id = values[10];
+	}
+	return readRegisters(f,vertexregistermap)
+		&& readRegisters(f,vertexattributes)
+		&& readRegisters(f,fragmentregistermap)
+		&& readRegisters(f,fragmentattributes);
+}
+
+void AGALTranslation::saveToFile() const
+{
+	// write to a temporary file first, so other processes never see partially written files
+	string tmpname = cacheFilename + ".tmp" + to_string(uintptr_t(this));
+	{
+		ofstream f(tmpname,ios::out|ios::binary|ios::trunc);
+		if (!f.is_open())
+			return;
+		writeUInt32(f,AGAL_CACHE_FILE_VERSION);
+		writeUInt32(f,glslVariant);
+		writeUInt32(f,flags);
+		writeBytes(f,vertexcode);
+		writeBytes(f,fragmentcode);
+		writeString(f,vertexprogram);
+		writeString(f,fragmentprogram);
+		writeUInt32(f,samplerState.size());
+		for (auto it = samplerState.begin(); it != samplerState.end(); it++)
+		{
+			uint32_t values[11] = { uint32_t(it->b), uint32_t(it->d), uint32_t(it->f), uint32_t(it->m), uint32_t(it->n), it->isVertexProgram,
+									uint32_t(it->s), uint32_t(it->t), uint32_t(it->type), uint32_t(it->w), it->program_sampler_id };
+			for (uint32_t i = 0; i < 11; i++)
+				writeUInt32(f,values[i]);
+		}
+		writeRegisters(f,vertexregistermap);
+		writeRegisters(f,vertexattributes);
+		writeRegisters(f,fragmentregistermap);
+		writeRegisters(f,fragmentattributes);
+		if (!f.good())
+		{
+			f.close();
+			remove(tmpname.c_str());
+			return;
+		}
+	}
+	if (rename(tmpname.c_str(),cacheFilename.c_str()) != 0)
+		remove(tmpname.c_str());
+}
+
+void AGALTranslation::run()
+{
+	{
+		Locker l(mutex);
+		if (state != PENDING)
+			return;
+		state = TRANSLATING;
+	}
+	// waiting threads are signaled even if the translation failed
+	if ((cacheFilename.empty() || !loadFromFile())
+			&& translate(vertexprogram,fragmentprogram,samplerState,vertexregistermap,vertexattributes,fragmentregistermap,fragmentattributes)
+			&& !cacheFilename.empty())
+		saveToFile();
+	Locker l(mutex);
+	state = DONE;
+	translated.broadcast();
+}
+
+void AGALTranslation::waitTranslated()
+{
+	run();
+	Locker l(mutex);
+	while (state != DONE)
+		translated.wait(mutex);
+}
+
+bool AGALTranslation::tryTranslated()
+{
+	run();
+	Locker l(mutex);
+	return state == DONE;
+}
+
+AGALTranslationCache::AGALTranslationCache()
+{
+	if (getenv("LIGHTSPARK_AGAL_CACHE") == nullptr)
+		return;
+	Path p = Path(Config::getConfig()->getCacheDirectory()) / "agal";
+	try
+	{
+		FileSystem::createDirs(p,FileSystem::Perms::OwnerAll);
+		diskCacheDirectory = p.getStr().raw_buf();
+	}
+	catch (std::exception& e)
+	{
+		LOG(LOG_ERROR,"could not create AGAL cache directory:"<<e.what());
+	}
+}
+
+AGALTranslationCache* AGALTranslationCache::getCache()
+{
+	static AGALTranslationCache cache;
+	return &cache;
+}
+
+_R<AGALTranslation> AGALTranslationCache::getTranslation(SystemState* sys, ByteArray* vertexProgram, ByteArray* fragmentProgram)
+{
+	return addTranslation(sys,_MR(new AGALTranslation(vertexProgram,fragmentProgram)));
+}
+
+_R<AGALTranslation> AGALTranslationCache::addTranslation(SystemState* sys, _R<AGALTranslation> translation)
+{
+	Locker l(mutex);
+	auto range = translations.equal_range(translation->hash);
+	for (auto it = range.first; it != range.second; it++)
+	{
+		if (it->second->matches(*translation.getPtr()))
+			return it->second;
+	}
+	if (translations.size() >= AGAL_CACHE_MAX_ENTRIES)
+	{
+		// drop all translations that are not used by any program
+		auto it = translations.begin();
+		while (it != translations.end())
+		{
+			if (it->second->isLastRef())
+				it = translations.erase(it);
+			else
+				it++;
+		}
+	}
+	if (!diskCacheDirectory.empty())
+	{
+		char buf[20];
+		snprintf(buf,sizeof(buf),"%016" PRIx64,translation->hash);
+		translation->cacheFilename = (Path(diskCacheDirectory) / buf).getStr().raw_buf();
+	}
+	translations.insert(make_pair(translation->hash,translation));
+	if (sys)
+		sys->addJob(new AGALTranslationJob(translation));
+	return translation;
+}
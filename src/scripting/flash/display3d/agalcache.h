@@ -0,0 +1,99 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2017 Ludger Krämer <dbluelle@onlinehome.de>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+#ifndef SCRIPTING_FLASH_DISPLAY3D_AGALCACHE_H
+#define SCRIPTING_FLASH_DISPLAY3D_AGALCACHE_H 1
+
+#include "scripting/flash/display3d/flashdisplay3d.h"
+#include "smartrefs.h"
+#include "threading.h"
+#include <unordered_map>
+
+namespace lightspark
+{
+class SystemState;
+
+/*
+ * GLSL translation of a vertex and fragment program pair as uploaded by Program3D.upload.
+ * The fragment program depends on the registers of the vertex program, so both are translated together.
+ * The results are immutable once translated and shared by all programs using the same bytecode.
+ */
+class AGALTranslation: public RefCountable
+{
+friend class AGALTranslationCache;
+private:
+	enum TRANSLATION_STATE { PENDING, TRANSLATING, DONE };
+	enum TRANSLATION_FLAGS { HAS_VERTEXPROGRAM=1, HAS_FRAGMENTPROGRAM=2, VERTEX_LITTLEENDIAN=4, FRAGMENT_LITTLEENDIAN=8 };
+	Mutex mutex;
+	Cond translated;
+	TRANSLATION_STATE state;
+	uint64_t hash;
+	std::vector<uint8_t> vertexcode;
+	std::vector<uint8_t> fragmentcode;
+	uint8_t flags;
+	std::string cacheFilename;
+	bool matches(const AGALTranslation& other) const;
+	bool loadFromFile();
+	void saveToFile() const;
+public:
+	tiny_string vertexprogram;
+	tiny_string fragmentprogram;
+	std::vector<SamplerRegister> samplerState;
+	std::vector<RegisterMapEntry> vertexregistermap;
+	std::vector<RegisterMapEntry> vertexattributes;
+	std::vector<RegisterMapEntry> fragmentregistermap;
+	std::vector<RegisterMapEntry> fragmentattributes;
+	AGALTranslation(ByteArray* vertexProgram, ByteArray* fragmentProgram);
+	// a null vertexbytes or fragmentbytes means the program is not set
+	AGALTranslation(const uint8_t* vertexbytes, uint32_t vertexlen, bool vertexLittleEndian, const uint8_t* fragmentbytes, uint32_t fragmentlen, bool fragmentLittleEndian);
+	// translates the programs if no other thread has started doing it yet
+	void run();
+	// blocks until the translation is available, translating in the calling thread if it wasn't started yet
+	void waitTranslated();
+	// returns true if the translation is available, translating in the calling thread if it wasn't started yet
+	// returns false without waiting if another thread is still translating
+	bool tryTranslated();
+	// translates the programs into the given results without changing the shared ones, returns false if the translation failed
+	bool translate(tiny_string& vertexglsl, tiny_string& fragmentglsl, std::vector<SamplerRegister>& samplers,
+				   std::vector<RegisterMapEntry>& vertexregisters, std::vector<RegisterMapEntry>& vertexattribs,
+				   std::vector<RegisterMapEntry>& fragmentregisters, std::vector<RegisterMapEntry>& fragmentattribs) const;
+};
+
+/*
+ * Process wide cache of AGAL translations keyed by a hash of the bytecode.
+ * New programs are translated in the ThreadPool, so the worker doesn't have to wait for the translation.
+ * If LIGHTSPARK_AGAL_CACHE is set, the translations are also stored in the cache directory.
+ */
+class AGALTranslationCache
+{
+private:
+	Mutex mutex;
+	std::unordered_multimap<uint64_t,_R<AGALTranslation>> translations;
+	std::string diskCacheDirectory;
+	AGALTranslationCache();
+public:
+	static AGALTranslationCache* getCache();
+	// returns the translation of the programs, the caller has to call waitTranslated() before using the results
+	_R<AGALTranslation> getTranslation(SystemState* sys, ByteArray* vertexProgram, ByteArray* fragmentProgram);
+	// returns the cached translation of the same programs, or adds translation to the cache and starts translating it
+	// in the ThreadPool of sys; if sys is null it is translated by the first thread waiting for it
+	_R<AGALTranslation> addTranslation(SystemState* sys, _R<AGALTranslation> translation);
+};
+
+}
+#endif /* SCRIPTING_FLASH_DISPLAY3D_AGALCACHE_H */
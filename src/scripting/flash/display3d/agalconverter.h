@@ -14,7 +14,7 @@ using namespace lightspark;
 // AGAL bytecode format is documented in http://help.adobe.com/en_US/as3/dev/WSd6a006f2eb1dc31e-310b95831324724ec56-8000.html
 // conversion algorithm is taken from https://github.com/openfl/openfl/blob/develop/src/openfl/display3D/_internal/AGALConverter.hx (converted to c++)
 
-tiny_string prefixFromType (RegisterType regType, bool isVertexProgram)
+inline tiny_string prefixFromType (RegisterType regType, bool isVertexProgram)
 {
 	switch (regType)
 	{
@@ -362,24 +362,75 @@ public:
 		}
 	}
 };
-uint64_t readUInt64 (ByteArray* byteArray)
+// reads the AGAL bytecode from a copy of the ByteArray data, so the translation can be done outside of the worker thread
+class AGALReader
 {
-	uint32_t low;
-	byteArray->readUnsignedInt(low);
-	uint32_t high;
-	byteArray->readUnsignedInt(high);
-	return ((uint64_t)high)<<32 | low;
-}
+private:
+	const uint8_t* bytes;
+	uint32_t len;
+	uint32_t position;
+	bool littleEndian;
+public:
+	AGALReader(const uint8_t* _bytes, uint32_t _len, bool _littleEndian):bytes(_bytes),len(_len),position(0),littleEndian(_littleEndian) {}
+	uint32_t getPosition() const { return position; }
+	uint32_t getLength() const { return len; }
+	void setPosition(uint32_t p) { position = p; }
+	void readByte(uint8_t& ret)
+	{
+		ret = 0;
+		if (position >= len)
+			return;
+		ret = bytes[position++];
+	}
+	void readUnsignedInt(uint32_t& ret)
+	{
+		ret = 0;
+		if (len < position+4)
+		{
+			// stop parsing truncated bytecode
+			position = len;
+			return;
+		}
+		for (uint32_t i = 0; i < 4; i++)
+			ret |= uint32_t(bytes[position+(littleEndian ? i : 3-i)])<<(i*8);
+		position+=4;
+	}
+	void readUTF(tiny_string& ret)
+	{
+		if (len < position+2)
+			return;
+		uint16_t stringLen = littleEndian ? bytes[position] | (bytes[position+1]<<8) : (bytes[position]<<8) | bytes[position+1];
+		position+=2;
+		if (len < position+stringLen)
+			return;
+		// check for BOM
+		if (len > position+3 && bytes[position] == 0xef && bytes[position+1] == 0xbb && bytes[position+2] == 0xbf)
+		{
+			position += 3;
+			stringLen -= stringLen > 3 ? 3 : 0;
+		}
+		ret = std::string((const char*)bytes+position,strnlen((const char*)bytes+position,stringLen));
+		position+=stringLen;
+	}
+	uint64_t readUInt64()
+	{
+		uint32_t low;
+		readUnsignedInt(low);
+		uint32_t high;
+		readUnsignedInt(high);
+		return ((uint64_t)high)<<32 | low;
+	}
+};
 
-tiny_string AGALtoGLSL(ByteArray* agal,bool isVertexProgram,std::vector<SamplerRegister>& samplerState,std::vector<RegisterMapEntry>& constants,std::vector<RegisterMapEntry>& attributes,RegisterMap& vertexregistermap)
+inline tiny_string AGALtoGLSL(AGALReader& agal,bool isVertexProgram,std::vector<SamplerRegister>& samplerState,std::vector<RegisterMapEntry>& constants,std::vector<RegisterMapEntry>& attributes,RegisterMap& vertexregistermap)
 {
-	agal->setPosition(0);
+	agal.setPosition(0);
 	uint8_t by;
-	agal->readByte(by);
+	agal.readByte(by);
 	if (by == 0xB0) {
 		// use embedded GLSL shader instead
 		tiny_string res;
-		agal->readUTF(res);
+		agal.readUTF(res);
 		return res;
 	}
 	if (by != 0xA0) {
@@ -387,13 +438,13 @@ tiny_string AGALtoGLSL(ByteArray* agal,bool isVertexProgram,std::vector<SamplerR
 		return "";
 	}
 	uint32_t version;
-	agal->readUnsignedInt(version);
-	agal->readByte(by);
+	agal.readUnsignedInt(version);
+	agal.readByte(by);
 	if (by != 0xA1) {
 		LOG(LOG_ERROR,"invalid shaderTypeID for AGAL:"<<hex<<(uint32_t)by);
 		return "";
 	}
-	agal->readByte(by);
+	agal.readByte(by);
 	if (isVertexProgram && by != 0)
 		LOG(LOG_ERROR,"AGAL:expected vertex shader, got fragment shader");
 	if (!isVertexProgram && by == 0)
@@ -402,14 +453,14 @@ tiny_string AGALtoGLSL(ByteArray* agal,bool isVertexProgram,std::vector<SamplerR
 	tiny_string sb;
 	RegisterMap map;
 
-	while (agal->getPosition() < agal->getLength()) {
+	while (agal.getPosition() < agal.getLength()) {
 		// fetch instruction info
 		uint32_t opcode;
-		agal->readUnsignedInt(opcode);
+		agal.readUnsignedInt(opcode);
 		uint32_t dest;
-		agal->readUnsignedInt(dest);
-		uint64_t source1 = readUInt64 (agal);
-		uint64_t source2 = readUInt64 (agal);
+		agal.readUnsignedInt(dest);
+		uint64_t source1 = agal.readUInt64();
+		uint64_t source2 = agal.readUInt64();
 		// parse registers
 		DestRegister dr = DestRegister::parse (dest, isVertexProgram);
 		SourceRegister sr1 = SourceRegister::parse (source1, isVertexProgram, dr.mask);
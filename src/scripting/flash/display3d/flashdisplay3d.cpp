@@ -30,7 +30,11 @@
 #include "backends/rendering_context.h"
 #include "platforms/engineutils.h"
 #include "scripting/flash/display3d/agalconverter.h"
+#include "scripting/flash/display3d/agalcache.h"
 #include "scripting/abc.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 SamplerRegister SamplerRegister::parse (uint64_t v, bool isVertexProgram)
 {
@@ -106,6 +110,26 @@ void Context3D::handleRenderAction(EngineData* engineData, renderaction& action)
 			int stat;
 			Program3D* p = action.dataobject->as<Program3D>();
 			//LOG(LOG_INFO,"uploadProgram:"<<p<<" "<<p->gpu_program);
+			if (p->translation)
+			{
+				if (p->translation->tryTranslated())
+				{
+					p->vertexprogram = p->translation->vertexprogram;
+					p->fragmentprogram = p->translation->fragmentprogram;
+					p->samplerState = p->translation->samplerState;
+					p->vertexregistermap = p->translation->vertexregistermap;
+					p->vertexattributes = p->translation->vertexattributes;
+					p->fragmentregistermap = p->translation->fragmentregistermap;
+					p->fragmentattributes = p->translation->fragmentattributes;
+				}
+				else
+				{
+					// the thread pool is still translating, translating again is faster than stalling the render thread
+					p->translation->translate(p->vertexprogram,p->fragmentprogram,p->samplerState,
+											  p->vertexregistermap,p->vertexattributes,p->fragmentregistermap,p->fragmentattributes);
+				}
+				p->resetTranslation();
+			}
 			uint32_t f= UINT32_MAX;
 			uint32_t g= UINT32_MAX;
 			if (p->gpu_program == UINT32_MAX)
@@ -374,6 +398,7 @@ void Context3D::handleRenderAction(EngineData* engineData, renderaction& action)
 			}
 			else
 				LOG(LOG_ERROR,"Context3D: missing index bufferID for uploading, should not happen");
+			recycleStagingBuffer(action.bufferdata);
 			break;
 		}
 		case RENDER_DELETEBUFFER:
@@ -563,6 +588,7 @@ void Context3D::handleRenderAction(EngineData* engineData, renderaction& action)
 			}
 			else
 				LOG(LOG_ERROR,"Context3D missing vertex bufferID, should not happen");
+			recycleStagingBuffer(action.bufferdata);
 			break;
 		}
 		case RENDER_SETSTENCILREFERENCEVALUE:
@@ -758,6 +784,7 @@ void Context3D::disposeintern()
 	currentstencilmask=0xff;
 	bufferIDfreelist.clear();
 	bufferIDs.clear();
+	stagingbuffers.clear();
 }
 
 bool Context3D::renderImpl(RenderContext &ctxt)
@@ -1060,7 +1087,35 @@ void Context3D::addAction(renderaction action)
 {
 	if (!getSystemState()->getRenderThread() || !getSystemState()->getRenderThread()->isStarted())
 		return;
-	actions[currentactionvector].push_back(action);
+	actions[currentactionvector].push_back(std::move(action));
+}
+
+void Context3D::getStagingBuffer(std::vector<uint8_t>& buffer, uint32_t size)
+{
+	// use the smallest recycled buffer that is large enough
+	auto best = stagingbuffers.end();
+	for (auto it = stagingbuffers.begin(); it != stagingbuffers.end(); it++)
+	{
+		if (it->capacity() >= size && (best == stagingbuffers.end() || it->capacity() < best->capacity()))
+			best = it;
+	}
+	if (best == stagingbuffers.end() && !stagingbuffers.empty())
+		best = stagingbuffers.end()-1;
+	if (best != stagingbuffers.end())
+	{
+		buffer.swap(*best);
+		stagingbuffers.erase(best);
+	}
+	buffer.resize(size);
+}
+
+void Context3D::recycleStagingBuffer(std::vector<uint8_t>& buffer)
+{
+	// enough for the uploads of two frames with a few dynamic buffers each
+	if (stagingbuffers.size() >= 16)
+		return;
+	stagingbuffers.push_back(std::vector<uint8_t>());
+	stagingbuffers.back().swap(buffer);
 }
 
 void Context3D::sinit(lightspark::Class_base *c)
@@ -2153,6 +2208,36 @@ ASFUNCTIONBODY_ATOM(IndexBuffer3D,dispose)
 		th->bufferIDindex=UINT32_MAX;
 	}
 }
+// Vector.<Number> stores most values as doubles directly in the atoms (see asobject.h),
+// so blocks containing only those are converted without looking at the atom types
+static void convertAtomsToFloat(const asAtom* src, float* dst, uint32_t count)
+{
+	uint32_t i = 0;
+#ifdef __SSE2__
+	for (; i+4 <= count; i+=4)
+	{
+		if (src[i].uintval < ATOM_INVALID_UNDEFINED_NULL_BOOL_STRINGID && src[i+1].uintval < ATOM_INVALID_UNDEFINED_NULL_BOOL_STRINGID
+			&& src[i+2].uintval < ATOM_INVALID_UNDEFINED_NULL_BOOL_STRINGID && src[i+3].uintval < ATOM_INVALID_UNDEFINED_NULL_BOOL_STRINGID)
+		{
+			__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(&src[i].dval));
+			__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(&src[i+2].dval));
+			_mm_storeu_ps(dst+i,_mm_movelh_ps(lo,hi));
+		}
+		else
+		{
+			for (uint32_t j = i; j < i+4; j++)
+				dst[j] = asAtomHandler::toNumber(src[j]);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = asAtomHandler::toNumber(src[i]);
+}
+static void convertAtomsToUInt16(const asAtom* src, uint16_t* dst, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		dst[i] = asAtomHandler::toUInt(src[i]);
+}
 ASFUNCTIONBODY_ATOM(IndexBuffer3D,uploadFromByteArray)
 {
 	IndexBuffer3D* th = asAtomHandler::as<IndexBuffer3D>(obj);
@@ -2176,14 +2261,16 @@ ASFUNCTIONBODY_ATOM(IndexBuffer3D,uploadFromByteArray)
 		createError<RangeError>(wrk,kParamRangeError);
 		return;
 	}
+	th->context->rendermutex.lock();
 	renderaction action;
 	action.action =RENDER_ACTION::RENDER_UPLOADINDEXBUFFER;
 	action.udata1 = th->bufferIDindex;
 	action.udata2 = count;
 	action.udata3 = startOffset;
-	action.bufferdata.resize(count*sizeof(uint16_t));
+	th->context->getStagingBuffer(action.bufferdata,count*sizeof(uint16_t));
 	memcpy(action.bufferdata.data(),data->getBufferNoCheck()+byteArrayOffset,count*sizeof(uint16_t));
-	th->context->addAction(action);
+	th->context->addAction(std::move(action));
+	th->context->rendermutex.unlock();
 }
 ASFUNCTIONBODY_ATOM(IndexBuffer3D,uploadFromVector)
 {
@@ -2197,20 +2284,26 @@ ASFUNCTIONBODY_ATOM(IndexBuffer3D,uploadFromVector)
 	uint32_t startOffset;
 	uint32_t count;
 	ARG_CHECK(ARG_UNPACK(data)(startOffset)(count));
+	if (data.isNull())
+	{
+		createError<TypeError>(wrk,kNullPointerError);
+		return;
+	}
+	if (data->size() < count)
+	{
+		createError<RangeError>(wrk,kParamRangeError);
+		return;
+	}
+	th->context->rendermutex.lock();
 	renderaction action;
 	action.action =RENDER_ACTION::RENDER_UPLOADINDEXBUFFER;
 	action.udata1 = th->bufferIDindex;
 	action.udata2 = count;
 	action.udata3 = startOffset;
-	action.bufferdata.resize(count*sizeof(uint16_t));
-	for (uint32_t i = 0; i< count; i++)
-	{
-		asAtom a = data->at(i);
-		uint16_t d = asAtomHandler::toUInt(a);
-		action.bufferdata[i*2+1]=(d>>8)&0xff;
-		action.bufferdata[i*2  ]=(d   )&0xff;
-	}
-	th->context->addAction(action);
+	th->context->getStagingBuffer(action.bufferdata,count*sizeof(uint16_t));
+	convertAtomsToUInt16(data->getBufferNoCheck(),(uint16_t*)action.bufferdata.data(),count);
+	th->context->addAction(std::move(action));
+	th->context->rendermutex.unlock();
 }
 
 void Program3D::sinit(Class_base *c)
@@ -2223,13 +2316,18 @@ void Program3D::sinit(Class_base *c)
 
 bool Program3D::destruct()
 {
-	if (context && gpu_program != UINT32_MAX)
+	if (context)
 	{
+		// the render thread reads the translation while handling RENDER_UPLOADPROGRAM
 		context->rendermutex.lock();
-		renderaction action;
-		action.action =RENDER_ACTION::RENDER_DELETEPROGRAM;
-		action.udata1 = gpu_program;
-		context->addAction(action);
+		if (gpu_program != UINT32_MAX)
+		{
+			renderaction action;
+			action.action =RENDER_ACTION::RENDER_DELETEPROGRAM;
+			action.udata1 = gpu_program;
+			context->addAction(action);
+		}
+		resetTranslation();
 		context->rendermutex.unlock();
 	}
 	context=nullptr;
@@ -2243,22 +2341,34 @@ bool Program3D::destruct()
 	vertexattributes.clear();
 	fragmentregistermap.clear();
 	fragmentattributes.clear();
+	resetTranslation();
 	return ASObject::destruct();
 }
 void Program3D::finalize()
 {
-	if (context && gpu_program != UINT32_MAX)
+	if (context)
 	{
 		context->rendermutex.lock();
-		renderaction action;
-		action.action =RENDER_ACTION::RENDER_DELETEPROGRAM;
-		action.udata1 = gpu_program;
-		context->addAction(action);
+		if (gpu_program != UINT32_MAX)
+		{
+			renderaction action;
+			action.action =RENDER_ACTION::RENDER_DELETEPROGRAM;
+			action.udata1 = gpu_program;
+			context->addAction(action);
+		}
+		resetTranslation();
 		context->rendermutex.unlock();
 	}
 	context=nullptr;
+	resetTranslation();
 	ASObject::finalize();
 }
+void Program3D::resetTranslation()
+{
+	if (translation)
+		translation->decRef();
+	translation=nullptr;
+}
 
 ASFUNCTIONBODY_ATOM(Program3D,dispose)
 {
@@ -2283,19 +2393,12 @@ ASFUNCTIONBODY_ATOM(Program3D,upload)
 	_NR<ByteArray> vertexProgram;
 	_NR<ByteArray> fragmentProgram;
 	ARG_CHECK(ARG_UNPACK(vertexProgram)(fragmentProgram));
+	// identical bytecode is only translated once, new programs are translated in the thread pool until the render thread needs them
+	_R<AGALTranslation> translation = AGALTranslationCache::getCache()->getTranslation(wrk->getSystemState(),vertexProgram.getPtr(),fragmentProgram.getPtr());
 	th->context->rendermutex.lock();
-	th->samplerState.clear();
-	RegisterMap vertexregistermap; // this is needed to keep track of the registers when creating the fragment program
-	if (!vertexProgram.isNull())
-	{
-		th->vertexprogram = AGALtoGLSL(vertexProgram.getPtr(),true,th->samplerState,th->vertexregistermap,th->vertexattributes,vertexregistermap);
-		// LOG(LOG_INFO,"vertex shader:"<<th<<"\n"<<th->vertexprogram);
-	}
-	if (!fragmentProgram.isNull())
-	{
-		th->fragmentprogram = AGALtoGLSL(fragmentProgram.getPtr(),false,th->samplerState,th->fragmentregistermap,th->fragmentattributes,vertexregistermap);
-		// LOG(LOG_INFO,"fragment shader:"<<th<<"\n"<<th->fragmentprogram);
-	}
+	th->resetTranslation();
+	translation->incRef();
+	th->translation = translation.getPtr();
 	th->context->addAction(RENDER_ACTION::RENDER_UPLOADPROGRAM,th);
 	th->context->rendermutex.unlock();
 }
@@ -2371,14 +2474,16 @@ ASFUNCTIONBODY_ATOM(VertexBuffer3D,uploadFromByteArray)
 		createError<RangeError>(wrk,kParamRangeError);
 		return;
 	}
+	th->context->rendermutex.lock();
 	renderaction action;
 	action.action =RENDER_ACTION::RENDER_UPLOADVERTEXBUFFER;
 	action.udata1 = th->bufferIDindex;
 	action.udata2 = numVertices*th->data32PerVertex;
 	action.udata3 = startVertex*th->data32PerVertex;
-	action.bufferdata.resize(numVertices*th->data32PerVertex*sizeof(float));
+	th->context->getStagingBuffer(action.bufferdata,numVertices*th->data32PerVertex*sizeof(float));
 	memcpy(action.bufferdata.data(),data->getBufferNoCheck()+byteArrayOffset,numVertices*th->data32PerVertex*sizeof(float));
-	th->context->addAction(action);
+	th->context->addAction(std::move(action));
+	th->context->rendermutex.unlock();
 }
 ASFUNCTIONBODY_ATOM(VertexBuffer3D,uploadFromVector)
 {
@@ -2414,20 +2519,8 @@ ASFUNCTIONBODY_ATOM(VertexBuffer3D,uploadFromVector)
 	action.udata1 = th->bufferIDindex;
 	action.udata2 = numVertices*th->data32PerVertex;
 	action.udata3 = startVertex*th->data32PerVertex;
-	action.bufferdata.resize(numVertices*th->data32PerVertex*sizeof(float));
-	for (uint32_t i = 0; i< numVertices*th->data32PerVertex; i++)
-	{
-		asAtom a = data->at(i);
-		union {
-			float f;
-			uint32_t u;
-		} d;
-		d.f = asAtomHandler::toNumber(a);
-		action.bufferdata[i*4  ] = (d.u     )&0xff;
-		action.bufferdata[i*4+1] = (d.u >> 8)&0xff;
-		action.bufferdata[i*4+2] = (d.u >>16)&0xff;
-		action.bufferdata[i*4+3] = (d.u >>24)&0xff;
-	}
-	th->context->addAction(action);
+	th->context->getStagingBuffer(action.bufferdata,numVertices*th->data32PerVertex*sizeof(float));
+	convertAtomsToFloat(data->getBufferNoCheck(),(float*)action.bufferdata.data(),numVertices*th->data32PerVertex);
+	th->context->addAction(std::move(action));
 	th->context->rendermutex.unlock();
 }
@@ -99,6 +99,7 @@ namespace lightspark
 class RenderContext;
 class VertexBuffer3D;
 class Program3D;
+class AGALTranslation;
 class Stage3D;
 class EngineData;
 
@@ -188,6 +189,9 @@ private:
 	uint32_t currentstencilmask;
 	std::vector<uint32_t> bufferIDs;
 	std::list<uint32_t> bufferIDfreelist;
+	// staging buffers of vertex and index uploads, recycled by the render thread so uploads don't allocate every frame
+	std::vector<std::vector<uint8_t>> stagingbuffers;
+	void recycleStagingBuffer(std::vector<uint8_t>& buffer);
 
 	void handleRenderAction(EngineData *engineData, renderaction &action);
 	void setRegisters(EngineData *engineData, std::vector<RegisterMapEntry> &registermap, constantregister *constants, bool isVertex);
@@ -221,6 +225,8 @@ public:
 	void deleteBuffer(uint32_t bufferIDindex);
 	void addAction(RENDER_ACTION type, ASObject* dataobject);
 	void addAction(renderaction action);
+	// rendermutex has to be locked
+	void getStagingBuffer(std::vector<uint8_t>& buffer, uint32_t size);
 	void addTextureToUpload(TextureBase* tex)
 	{
 		tex->incRef();
@@ -398,10 +404,13 @@ protected:
 	std::vector<RegisterMapEntry> vertexattributes;
 	std::vector<RegisterMapEntry> fragmentregistermap;
 	std::vector<RegisterMapEntry> fragmentattributes;
+	// set by upload, the results are moved into the fields above when the render thread uploads the program
+	AGALTranslation* translation;
 	bool disposed;
+	void resetTranslation();
 public:
-	Program3D(ASWorker* wrk,Class_base* c):ASObject(wrk,c,T_OBJECT,SUBTYPE_PROGRAM3D),gpu_program(UINT32_MAX),vcPositionScale(UINT32_MAX),disposed(false){}
-	Program3D(ASWorker* wrk,Class_base* c,Context3D* _ct):ASObject(wrk,c,T_OBJECT,SUBTYPE_PROGRAM3D),context(_ct),gpu_program(UINT32_MAX),vcPositionScale(UINT32_MAX),disposed(false){}
+	Program3D(ASWorker* wrk,Class_base* c):ASObject(wrk,c,T_OBJECT,SUBTYPE_PROGRAM3D),gpu_program(UINT32_MAX),vcPositionScale(UINT32_MAX),translation(nullptr),disposed(false){}
+	Program3D(ASWorker* wrk,Class_base* c,Context3D* _ct):ASObject(wrk,c,T_OBJECT,SUBTYPE_PROGRAM3D),context(_ct),gpu_program(UINT32_MAX),vcPositionScale(UINT32_MAX),translation(nullptr),disposed(false){}
 	static void sinit(Class_base* c);
 	bool destruct() override;
 	void finalize() override;
@@ -35,6 +35,7 @@
 #include "scripting/flash/net/flashnet.h"
 #include "scripting/flash/display/Loader.h"
 #include "scripting/flash/display/RootMovieClip.h"
+#include "backends/config.h"
 
 using namespace std;
 using namespace lightspark;
@@ -71,7 +72,7 @@ void IEventDispatcher::linkTraits(Class_base* c)
 }
 
 Event::Event(ASWorker* wrk, Class_base* cb, const tiny_string& t, bool b, bool c, CLASS_SUBTYPE st):
-	ASObject(wrk,cb,T_OBJECT,st),bubbles(b),cancelable(c),defaultPrevented(false),propagationStopped(false),immediatePropagationStopped(false),queued(false),
+	ASObject(wrk,cb,T_OBJECT,st),bubbles(b),cancelable(c),defaultPrevented(false),propagationStopped(false),immediatePropagationStopped(false),queued(false),queueTime(0),ioEvent(false),
 	eventPhase(0),type(t),target(asAtomHandler::invalidAtom),currentTarget()
 {
 }
@@ -82,6 +83,16 @@ void Event::finalize()
 	target = asAtomHandler::invalidAtom;
 }
 
+void Event::resetForReuse()
+{
+	defaultPrevented = false;
+	propagationStopped = false;
+	immediatePropagationStopped = false;
+	eventPhase = 0;
+	currentTarget.reset();
+	setTarget(asAtomHandler::invalidAtom);
+}
+
 void Event::sinit(Class_base* c)
 {
 	CLASS_SETUP_CONSTRUCTOR_3_PARAMETER(c, ASObject, _constructor, 2,CLASS_GETREF(c,ASString),CLASS_GETREF(c,Boolean),CLASS_GETREF(c,Boolean), CLASS_SEALED);
@@ -296,6 +307,118 @@ MouseEvent::MouseEvent(ASWorker* wrk, Class_base* c, const tiny_string& t, numbe
 {
 }
 
+void MouseEvent::resetForReuse(number_t lx, number_t ly, const LSModifier& _modifiers, bool _buttonDown)
+{
+	Event::resetForReuse();
+	modifiers = _modifiers;
+	buttonDown = _buttonDown;
+	delta = 1;
+	localX = lx;
+	localY = ly;
+}
+
+EventPool::EventPool(ASWorker* wrk):worker(wrk),hits(0),misses(0)
+{
+}
+
+void EventPool::clear()
+{
+	Locker l(poolMutex);
+	for (auto it = events.begin(); it != events.end(); it++)
+	{
+		for (auto ev : it->second)
+			ev->decRef();
+	}
+	events.clear();
+	for (auto it = mouseEvents.begin(); it != mouseEvents.end(); it++)
+	{
+		for (auto ev : it->second)
+			ev->decRef();
+	}
+	mouseEvents.clear();
+	if (hits || misses)
+		LOG(LOG_INFO,"event pool hits:"<<hits<<" misses:"<<misses);
+}
+
+Event* EventPool::getRecycled(std::unordered_map<uint32_t,std::vector<Event*>>& pool, uint32_t typeID)
+{
+	auto it = pool.find(typeID);
+	if (it == pool.end())
+		return nullptr;
+	for (auto ev : it->second)
+	{
+		if (ev->isLastRef())
+		{
+			ev->incRef();
+			return ev;
+		}
+	}
+	return nullptr;
+}
+
+void EventPool::add(std::unordered_map<uint32_t,std::vector<Event*>>& pool, uint32_t typeID, Event* ev)
+{
+	std::vector<Event*>& entries = pool[typeID];
+	if (entries.size() >= EVENTPOOL_MAX_PER_TYPE)
+		return;
+	ev->incRef();
+	entries.push_back(ev);
+}
+
+_R<Event> EventPool::getEvent(const tiny_string& type)
+{
+	uint32_t typeID = worker->getSystemState()->getUniqueStringId(type);
+	Locker l(poolMutex);
+	Event* ev = getRecycled(events,typeID);
+	if (ev)
+	{
+		hits++;
+		ev->resetForReuse();
+	}
+	else
+	{
+		misses++;
+		ev = Class<Event>::getInstanceS(worker,type);
+		add(events,typeID,ev);
+	}
+	return _MR(ev);
+}
+
+_R<MouseEvent> EventPool::getMouseEvent(const tiny_string& type, number_t lx, number_t ly, bool bubbles, const LSModifier& modifiers, bool buttonDown)
+{
+	uint32_t typeID = worker->getSystemState()->getUniqueStringId(type);
+	Locker l(poolMutex);
+	MouseEvent* ev = nullptr;
+	Event* recycled = getRecycled(mouseEvents,typeID);
+	if (recycled && recycled->bubbles == bubbles)
+	{
+		hits++;
+		ev = recycled->as<MouseEvent>();
+		ev->resetForReuse(lx,ly,modifiers,buttonDown);
+	}
+	else
+	{
+		if (recycled)
+			recycled->decRef();
+		misses++;
+		ev = Class<MouseEvent>::getInstanceS(worker,type,lx,ly,bubbles,modifiers,buttonDown);
+		add(mouseEvents,typeID,ev);
+	}
+	return _MR(ev);
+}
+
+uint64_t EventPool::getHits()
+{
+	Locker l(poolMutex);
+	return hits;
+}
+
+uint64_t EventPool::getMisses()
+{
+	Locker l(poolMutex);
+	return misses;
+}
+
 Event* MouseEvent::cloneImpl() const
 {
 	return Class<MouseEvent>::getInstanceS(getInstanceWorker(),type,localX,localY,bubbles,modifiers,buttonDown,relatedObject,delta);
@@ -657,6 +780,7 @@ ASFUNCTIONBODY_ATOM(NativeWindowBoundsEvent,_toString)
 		
 IOErrorEvent::IOErrorEvent(ASWorker* wrk, Class_base* c, const tiny_string& t, const std::string& e, int id) : ErrorEvent(wrk,c, t,e,id)
 {
+	ioEvent=true;
 }
 
 Event *IOErrorEvent::cloneImpl() const
@@ -1291,6 +1415,7 @@ ASFUNCTIONBODY_ATOM(ErrorEvent,_constructor)
 
 SecurityErrorEvent::SecurityErrorEvent(ASWorker* wrk, Class_base* c, const std::string& e):ErrorEvent(wrk,c, "securityError",e)
 {
+	ioEvent=true;
 }
 
 void SecurityErrorEvent::sinit(Class_base* c)
@@ -1923,3 +2048,168 @@ TextInputEvent::TextInputEvent(_NR<InteractiveObject> m, const tiny_string& s) :
 FirstFrameAvailableEvent::FirstFrameAvailableEvent(RootMovieClip* _root):Event(_root->getInstanceWorker(),nullptr, "FirstFrameAvailableEvent"),root(_root)
 {
 }
+
+EVENTQUEUE_LANE EventQueueLanes::getLane(Event* ev)
+{
+	switch (ev->getSubtype())
+	{
+		case SUBTYPE_MOUSE_EVENT:
+		case SUBTYPE_KEYBOARD_EVENT:
+		case SUBTYPE_FOCUSEVENT:
+		case SUBTYPE_GAMEINPUTEVENT:
+			return EVENTLANE_INPUT;
+		case SUBTYPE_TIMEREVENT:
+			return EVENTLANE_TIMER;
+		case SUBTYPE_PROGRESSEVENT:
+		case SUBTYPE_HTTPSTATUSEVENT:
+			return EVENTLANE_IO;
+		default:
+			break;
+	}
+	if (ev->getEventType() == TEXTINPUT_EVENT)
+		return EVENTLANE_INPUT;
+	// completion and error events of loaders and sockets
+	if (ev->ioEvent)
+		return EVENTLANE_IO;
+	// everything else (frame events, worker state changes, internal events) keeps its order in the frame lane
+	return EVENTLANE_FRAME;
+}
+
+EventQueueLanes::EventQueueLanes(bool _allLanes):allLanes(_allLanes),eventsSinceIO(0),ioEventBudget(Config::getConfig()->getIOEventBudget())
+{
+}
+
+bool EventQueueLanes::addIOEvent(_NR<EventDispatcher> obj, _R<Event> ev)
+{
+	assert(!allLanes);
+	if (obj.isNull())
+		return false;
+	if (pendingDispatchers.find(obj.getPtr()) == pendingDispatchers.end())
+	{
+		if (getLane(ev.getPtr()) != EVENTLANE_IO)
+			return false;
+		if (ownerDispatchers.find(obj.getPtr()) != ownerDispatchers.end())
+			return false;
+	}
+	push(EVENTLANE_IO,obj,ev);
+	return true;
+}
+
+void EventQueueLanes::ownerEventAdded(EventDispatcher* obj)
+{
+	if (obj)
+		ownerDispatchers[obj]++;
+}
+
+void EventQueueLanes::ownerEventRemoved(EventDispatcher* obj)
+{
+	if (!obj)
+		return;
+	auto it = ownerDispatchers.find(obj);
+	assert(it != ownerDispatchers.end());
+	if (--it->second == 0)
+		ownerDispatchers.erase(it);
+}
+
+void EventQueueLanes::push(EVENTQUEUE_LANE lane, _NR<EventDispatcher> obj, _R<Event> ev)
+{
+	if (!obj.isNull())
+	{
+		auto it = pendingDispatchers.find(obj.getPtr());
+		if (it == pendingDispatchers.end())
+			pendingDispatchers.insert(make_pair(obj.getPtr(),make_pair(lane,1U)));
+		else
+		{
+			// keep the order of the events of this dispatcher
+			lane = it->second.first;
+			it->second.second++;
+		}
+	}
+	lanes[lane].push_back(eventType(obj,ev));
+}
+
+void EventQueueLanes::add(_NR<EventDispatcher> obj, _R<Event> ev)
+{
+	assert(allLanes);
+	// internal events have no dispatcher and stay in order in the frame lane
+	push(obj.isNull() ? EVENTLANE_FRAME : getLane(ev.getPtr()),obj,ev);
+}
+
+bool EventQueueLanes::empty() const
+{
+	for (uint32_t i = 0; i < EVENTLANE_COUNT; i++)
+	{
+		if (!lanes[i].empty())
+			return false;
+	}
+	return true;
+}
+
+size_t EventQueueLanes::size() const
+{
+	size_t ret = 0;
+	for (uint32_t i = 0; i < EVENTLANE_COUNT; i++)
+		ret += lanes[i].size();
+	return ret;
+}
+
+EVENTQUEUE_LANE EventQueueLanes::nextLane(bool ownerQueueEmpty)
+{
+	if (!lanes[EVENTLANE_INPUT].empty())
+		return EVENTLANE_INPUT;
+	if (!lanes[EVENTLANE_TIMER].empty())
+		return EVENTLANE_TIMER;
+	bool frameEmpty = ownerQueueEmpty && lanes[EVENTLANE_FRAME].empty();
+	if (lanes[EVENTLANE_IO].empty())
+		return EVENTLANE_FRAME;
+	// I/O events wait for the frame lane, but at most ioEventBudget events
+	if (frameEmpty || eventsSinceIO >= ioEventBudget)
+	{
+		eventsSinceIO = 0;
+		return EVENTLANE_IO;
+	}
+	eventsSinceIO++;
+	return EVENTLANE_FRAME;
+}
+
+EventQueueLanes::eventType EventQueueLanes::pop(EVENTQUEUE_LANE lane)
+{
+	eventType e = lanes[lane].front();
+	lanes[lane].pop_front();
+	if (!e.first.isNull())
+	{
+		auto it = pendingDispatchers.find(e.first.getPtr());
+		assert(it != pendingDispatchers.end());
+		if (--it->second.second == 0)
+			pendingDispatchers.erase(it);
+	}
+	return e;
+}
+
+void EventQueueLanes::popBatch(std::vector<eventType>& batch)
+{
+	bool othersPending = false;
+	for (uint32_t lane = 0; lane < EVENTLANE_IO; lane++)
+	{
+		othersPending |= !lanes[lane].empty();
+		while (!lanes[lane].empty())
+			batch.push_back(pop((EVENTQUEUE_LANE)lane));
+	}
+	// leave the remaining I/O events for the next iteration, but never starve them completely
+	size_t count = lanes[EVENTLANE_IO].size();
+	if (othersPending)
+		count = std::min(count,size_t(ioEventBudget ? ioEventBudget : 1));
+	for (size_t i = 0; i < count; i++)
+		batch.push_back(pop(EVENTLANE_IO));
+}
+
+void EventQueueLanes::popAll(std::vector<eventType>& events)
+{
+	for (uint32_t lane = 0; lane < EVENTLANE_COUNT; lane++)
+	{
+		events.insert(events.end(),lanes[lane].begin(),lanes[lane].end());
+		lanes[lane].clear();
+	}
+	pendingDispatchers.clear();
+	eventsSinceIO = 0;
+}
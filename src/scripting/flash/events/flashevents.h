@@ -26,7 +26,10 @@
 #include "threading.h"
 #include "tiny_string.h"
 #include "scripting/flash/ui/keycodes.h"
+#include <deque>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #undef MOUSE_EVENT
 
 namespace lightspark
@@ -93,6 +96,8 @@ public:
 	bool propagationStopped;
 	bool immediatePropagationStopped;
 	ACQUIRE_RELEASE_FLAG(queued); // indicates that this event was added to the event queue
+	uint64_t queueTime; // time in microseconds when the event was added to the event queue, used for profiling
+	bool ioEvent; // set by loaders and sockets, the event is queued in the I/O lane (see EventQueueLanes)
 	ASPROPERTY_GETTER(uint32_t,eventPhase);
 	ASPROPERTY_GETTER(tiny_string,type);
 	//Altough events may be recycled and sent to more than a handler, the target property is set before sending
@@ -101,6 +106,8 @@ public:
 	ASPROPERTY_GETTER(_NR<ASObject>,currentTarget);
 	ASFUNCTION_ATOM(stopPropagation);
 	ASFUNCTION_ATOM(stopImmediatePropagation);
+	// resets the dispatch state of an event recycled by the EventPool
+	void resetForReuse();
 private:
 	/*
 	 * To be implemented by each derived class to allow redispatching
@@ -276,6 +283,34 @@ public:
 	ASPROPERTY_GETTER_SETTER(_NR<InteractiveObject>,relatedObject);
 	ASFUNCTION_ATOM(updateAfterEvent);
 	MouseEvent* getclone() const;
+	void resetForReuse(number_t lx, number_t ly, const LSModifier& _modifiers, bool _buttonDown);
+};
+
+/*
+ * Recycles the instances of builtin events that are dispatched very often
+ * (frame broadcasts and mouse moves). An instance is reused as soon as the pool
+ * holds the only reference to it, i.e. no listener retained it after dispatch.
+ */
+#define EVENTPOOL_MAX_PER_TYPE 4
+class EventPool
+{
+private:
+	Mutex poolMutex;
+	ASWorker* worker;
+	std::unordered_map<uint32_t,std::vector<Event*>> events; // key is the string id of the event type
+	std::unordered_map<uint32_t,std::vector<Event*>> mouseEvents;
+	uint64_t hits;
+	uint64_t misses;
+	Event* getRecycled(std::unordered_map<uint32_t,std::vector<Event*>>& pool, uint32_t typeID);
+	void add(std::unordered_map<uint32_t,std::vector<Event*>>& pool, uint32_t typeID, Event* ev);
+public:
+	EventPool(ASWorker* wrk);
+	// releases all pooled instances, must be called before the worker is finalized
+	void clear();
+	_R<Event> getEvent(const tiny_string& type);
+	_R<MouseEvent> getMouseEvent(const tiny_string& type, number_t lx, number_t ly, bool bubbles, const LSModifier& modifiers, bool buttonDown);
+	uint64_t getHits();
+	uint64_t getMisses();
 };
 
 class NativeDragEvent: public MouseEvent
@@ -375,12 +410,61 @@ public:
 	ASFUNCTION_ATOM(_hasEventListener);
 };
 
+// lanes of an event queue, see EventQueueLanes
+enum EVENTQUEUE_LANE { EVENTLANE_FRAME=0, EVENTLANE_INPUT, EVENTLANE_TIMER, EVENTLANE_IO, EVENTLANE_COUNT };
+
+/*
+ * Sorts the events of an event loop into lanes. Input and timer events are handled first,
+ * I/O events (loaders, sockets) only after the frame lane or within ioEventBudget,
+ * so a flood of network events can't delay the frame.
+ * All pending events of a dispatcher are kept in the same lane, so they are handled in the order they were added.
+ * Not thread safe, the owner protects it with the mutex of its event queue.
+ */
+class EventQueueLanes
+{
+public:
+	typedef std::pair<_NR<EventDispatcher>,_R<Event>> eventType;
+private:
+	std::deque<eventType> lanes[EVENTLANE_COUNT];
+	// lane and number of pending events of every dispatcher
+	std::unordered_map<EventDispatcher*,std::pair<EVENTQUEUE_LANE,uint32_t>> pendingDispatchers;
+	// number of events of every dispatcher in the owner's queue, only used if allLanes is false
+	std::unordered_map<EventDispatcher*,uint32_t> ownerDispatchers;
+	bool allLanes;
+	uint32_t eventsSinceIO;
+	void push(EVENTQUEUE_LANE lane, _NR<EventDispatcher> obj, _R<Event> ev);
+public:
+	// if allLanes is false only the I/O lane is used, the owner keeps the other events in its own queue
+	EventQueueLanes(bool _allLanes);
+	// number of I/O events handled before waiting events of the other lanes, see Config::getIOEventBudget
+	uint32_t ioEventBudget;
+	static EVENTQUEUE_LANE getLane(Event* ev);
+	void add(_NR<EventDispatcher> obj, _R<Event> ev);
+	// adds the event to the I/O lane and returns true unless the owner's queue has to take it, because it is no I/O event
+	// or because older events of the dispatcher are in the owner's queue
+	bool addIOEvent(_NR<EventDispatcher> obj, _R<Event> ev);
+	// the owner reports every event it adds to or removes from its own queue
+	void ownerEventAdded(EventDispatcher* obj);
+	void ownerEventRemoved(EventDispatcher* obj);
+	void ownerQueueCleared() { ownerDispatchers.clear(); }
+	bool empty() const;
+	bool empty(EVENTQUEUE_LANE lane) const { return lanes[lane].empty(); }
+	size_t size() const;
+	// returns the lane of the next event for loops that handle single events, ownerQueueEmpty tells if the owner's own queue is empty
+	EVENTQUEUE_LANE nextLane(bool ownerQueueEmpty);
+	eventType pop(EVENTQUEUE_LANE lane);
+	// moves all events of the frame, input and timer lanes and at most ioEventBudget I/O events to batch
+	void popBatch(std::vector<eventType>& batch);
+	// moves all pending events to events
+	void popAll(std::vector<eventType>& events);
+};
+
 class DataEvent: public TextEvent
 {
 private:
 	Event* cloneImpl() const override;
 public:
-	DataEvent(ASWorker* wrk, Class_base* c, const tiny_string& _data="") : TextEvent(wrk,c, "data"), data(_data) {}
+	DataEvent(ASWorker* wrk, Class_base* c, const tiny_string& _data="") : TextEvent(wrk,c, "data"), data(_data) { ioEvent=true; }
 	static void sinit(Class_base*);
 	ASFUNCTION_ATOM(_constructor);
 	ASPROPERTY_GETTER_SETTER(tiny_string, data);
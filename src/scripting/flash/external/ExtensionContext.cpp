@@ -273,6 +273,8 @@ public:
 			return FRE_TYPE_MISMATCH;
 		obj->as<ByteArray>()->lock();
 		obj->incRef();
+		// the extension may modify the bytes
+		obj->as<ByteArray>()->unshareBuffer();
 		byteArrayToSet->bytes = obj->as<ByteArray>()->getBufferNoCheck();
 		byteArrayToSet->length = obj->as<ByteArray>()->getLength();
 		LOG(LOG_CALLS,"nativeExtension:AcquireByteArray:"<<obj->toDebugString()<<" "<<byteArrayToSet->length);
@@ -415,6 +415,25 @@ bool Video::boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t&
 	return true;
 }
 
+bool Video::drawToBitmap(BitmapContainer* bc, int32_t x, int32_t y)
+{
+	Locker l(mutex);
+	bool ret=false;
+	if (embeddedVideoDecoder)
+	{
+		if (embeddedVideoDecoder->getWidth()==width && embeddedVideoDecoder->getHeight()==height)
+			ret=embeddedVideoDecoder->drawFrameToBitmap(bc,x,y);
+	}
+	else if (netStream && netStream->lockIfReady())
+	{
+		// only unscaled frames are converted directly
+		if (netStream->getVideoWidth()==width && netStream->getVideoHeight()==height)
+			ret=netStream->drawFrameToBitmap(bc,x,y);
+		netStream->unlock();
+	}
+	return ret;
+}
+
 ASFUNCTIONBODY_ATOM(Video,_constructor)
 {
 	Video* th=asAtomHandler::as<Video>(obj);
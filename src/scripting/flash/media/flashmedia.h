@@ -179,6 +179,7 @@ public:
 	//IThreadJob interface
 	void execute() override;
 	void jobFence() override;
+	bool isBlocking() const override { return true; }
 	void threadAbort() override;
 	Semaphore semSampleData;
 };
@@ -223,6 +224,8 @@ public:
 	ASFUNCTION_ATOM(clear);
 	bool boundsRect(number_t& xmin, number_t& xmax, number_t& ymin, number_t& ymax, bool visibleOnly) override;
 	_NR<DisplayObject> hitTestImpl(const Vector2f& globalPoint, const Vector2f& localPoint, HIT_TYPE type,bool interactiveObjectsOnly) override;
+	// draws the current frame into the bitmap on the cpu, returns false if the frame has to be rendered
+	bool drawToBitmap(BitmapContainer* bc, int32_t x, int32_t y);
 };
 
 class SoundMixer : public ASObject
@@ -48,9 +48,6 @@
 #include <unistd.h>
 #include <errno.h>
 
-const char SOCKET_COMMAND_SEND = '*';
-const char SOCKET_COMMAND_CLOSE = '-';
-
 using namespace std;
 using namespace lightspark;
 
@@ -412,10 +409,7 @@ ASFUNCTIONBODY_ATOM(ASSocket,_setEndian)
 	}
 	Locker l(th->joblock);
 	if (th->job)
-	{
 		th->job->datasend->setLittleEndian(v);
-		th->job->datareceive->setLittleEndian(v);
-	}
 }
 ASFUNCTIONBODY_ATOM(ASSocket,readBoolean)
 {
@@ -424,11 +418,7 @@ ASFUNCTIONBODY_ATOM(ASSocket,readBoolean)
 	uint8_t res=0;
 	Locker l(th->joblock);
 	if (th->job)
-	{
-		th->job->datareceive->lock();
-		th->job->datareceive->readByte(res);
-		th->job->datareceive->unlock();
-	}
+		th->job->datareceive.read(&res,1);
 	else
 	{
 		createError<IOError>(wrk,kInvalidSocket);
@@ -444,11 +434,7 @@ ASFUNCTIONBODY_ATOM(ASSocket,readByte)
 	uint8_t res=0;
 	Locker l(th->joblock);
 	if (th->job)
-	{
-		th->job->datareceive->lock();
-		th->job->datareceive->readByte(res);
-		th->job->datareceive->unlock();
-	}
+		th->job->datareceive.read(&res,1);
 	else
 	{
 		createError<IOError>(wrk,kInvalidSocket);
@@ -469,14 +455,10 @@ ASFUNCTIONBODY_ATOM(ASSocket,readBytes)
 	Locker l(th->joblock);
 	if (th->job)
 	{
-		th->job->datareceive->lock();
 		if (length == 0)
 			length = th->_bytesAvailable;
 		uint8_t buf[length];
-		th->job->datareceive->readBytes(0,length,buf);
-		th->job->datareceive->setPosition(length);
-		th->job->datareceive->removeFrontBytes(length);
-		th->job->datareceive->unlock();
+		length = th->job->datareceive.read(buf,length);
 		uint32_t pos = data->getPosition();
 		data->setPosition(offset);
 		data->writeBytes(buf,length);
@@ -815,10 +797,14 @@ ASFUNCTIONBODY_ATOM(ASSocket,readUTFBytes)
 	Locker l(th->joblock);
 	if (th->job)
 	{
-		th->job->datareceive->lock();
-		th->job->datareceive->readUTFBytes(length,data);
-		th->job->datareceive->removeFrontBytes(length);
-		th->job->datareceive->unlock();
+		vector<uint8_t> buf(length);
+		length = th->job->datareceive.read(buf.data(),length);
+		// skip BOM
+		uint32_t start = 0;
+		if (length >= 3 && buf[0] == 0xef && buf[1] == 0xbb && buf[2] == 0xbf)
+			start = 3;
+		data = string((const char*)buf.data()+start,strnlen((const char*)buf.data()+start,length-start));
+		data.checkValidUTF();
 		asAtomHandler::set(ret,asAtomHandler::fromString(wrk->getSystemState(),data));
 	}
 	else
@@ -864,48 +850,9 @@ void ASSocket::threadFinished()
 }
 
 ASSocketThread::ASSocketThread(_R<ASSocket> _owner, const tiny_string& _hostname, int _port, int _timeout)
-: owner(_owner), hostname(_hostname), port(_port), timeout(_timeout)
+: SocketConnection(_owner->getInstanceWorker()), owner(_owner), hostname(_hostname), port(_port), timeout(_timeout)
 {
 	datasend = _MR(Class<ByteArray>::getInstanceS(owner->getInstanceWorker()));
-	datareceive = _MR(Class<ByteArray>::getInstanceS(owner->getInstanceWorker()));
-#ifdef _WIN32
-	HANDLE readPipe, writePipe;
-	if (!CreatePipe(&readPipe,&writePipe,nullptr,0))
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = _open_osfhandle((intptr_t)readPipe, _O_RDONLY);
-	signalEmitter = _open_osfhandle((intptr_t)writePipe, _O_WRONLY);
-#else
-	int pipefd[2];
-	if (pipe(pipefd) == -1)
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = pipefd[0];
-	signalEmitter = pipefd[1];
-#endif
-}
-
-ASSocketThread::~ASSocketThread()
-{
-	if (signalListener != -1)
-		::close(signalListener);
-	if (signalEmitter != -1)
-		::close(signalEmitter);
-
-	sendQueueMutex.lock();
-	while (!sendQueue.empty())
-	{
-		socketbuf *s = sendQueue.front();
-		delete s;
-		sendQueue.pop();
-	}
-	sendQueueMutex.unlock();
 }
 
 void ASSocketThread::execute()
@@ -919,134 +866,40 @@ void ASSocketThread::execute()
 	{
 		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getInstanceWorker(),"connect")));
 	}
-
-//	bool first=true;
-	struct timeval timeout;
-	int maxfd;
-	fd_set readfds;
-	while (!threadAborting)
-	{
-		FD_ZERO(&readfds);
-		FD_SET(signalListener, &readfds);
-		FD_SET(sock.fileDescriptor(), &readfds);
-		maxfd = max(signalListener, sock.fileDescriptor());
-
-		// Check threadAborting periodically
-		timeout.tv_sec = 10;
-		timeout.tv_usec = 0;
-
-		int status = select(maxfd+1, &readfds, nullptr, nullptr, &timeout);
-		if (status  < 0)
-		{
-			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
-			return;
-		}
-
-		if (FD_ISSET(signalListener, &readfds))
-		{
-			char cmd;
-
-			ssize_t nbytes = read(signalListener, &cmd, 1);
-			if (nbytes < 0)
-			{
-				getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
-				return;
-			}
-			else if (nbytes == 0)
-			{
-				//The pipe has been closed. This
-				//shouldn't happen, the pipe will be
-				//closed only in the desctructor.
-				return;
-			}
-			else
-			{
-				executeCommand(cmd, sock);
-			}
-//			if (first && !threadAborting)
-//			{
-//				// send connect event only after first succesful communication
-//				first = false;
-//				owner->incRef();
-//				getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getInstanceWorker(),"connect")));
-//			}
-		}
-		else if (FD_ISSET(sock.fileDescriptor(), &readfds))
-		{
-			readSocket(sock);
-		}
-	}
-}
-
-ssize_t ASSocketThread::receive()
-{
-	uint8_t buf[4096];
-	ssize_t size;
-	ssize_t total = 0;
-	if (datareceive->getPosition())
-		datareceive->removeFrontBytes(datareceive->getPosition());
-	do
-	{
-		size = sock.receive(buf, sizeof buf);
-		if (size > 0)
-			datareceive->append(buf,size);
-		total += size;
-	}
-	while (size == sizeof(buf));
-	return total;
 }
 
-void ASSocketThread::readSocket(const SocketIO& sock)
+ssize_t ASSocketThread::receive(bool& eof)
 {
-	ssize_t nbytes = receive();
+	ssize_t nbytes = datareceive.receive(sock.fileDescriptor(),eof);
 	if (nbytes > 0)
 	{
 		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<ProgressEvent>::getInstanceS(owner->getInstanceWorker(),nbytes,0,"socketData")));
 	}
-	else if (nbytes == 0)
-	{
-		// The server has closed the socket
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getInstanceWorker(),"close")));
-		threadAborting = true;
-	}
-	else
-	{
-		// Error
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
-		threadAborting = true;
-	}
+	return nbytes;
 }
 
-void ASSocketThread::executeCommand(char cmd, SocketIO& sock)
+void ASSocketThread::connectionClosed(CLOSE_REASON reason)
 {
-	switch (cmd)
+	sock.close();
+	switch (reason)
 	{
-		case SOCKET_COMMAND_SEND:
-		{
-			sendQueueMutex.lock();
-			while (!sendQueue.empty())
+		case CLOSE_REQUESTED:
+		case CLOSE_REMOTE:
+			if (!threadAborting)
 			{
-				socketbuf *s = sendQueue.front();
-				sock.sendAll(s->buf, s->len);
-				delete s;
-				sendQueue.pop();
+				Event* ev=Class<Event>::getInstanceS(owner->getInstanceWorker(),"close");
+				ev->ioEvent=true;
+				getVm(owner->getSystemState())->addEvent(owner, _MR(ev));
 			}
-			sendQueueMutex.unlock();
 			break;
-		}
-		case SOCKET_COMMAND_CLOSE:
-		{
-			sock.close();
-			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getInstanceWorker(),"close")));
-			threadAborting = true;
+		case CLOSE_ERROR:
+			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
 			break;
-		}
-		default:
-		{
-			assert_and_throw(false && "Unexpected command");
+		case CLOSE_SHUTDOWN:
 			break;
-		}
 	}
+	owner->threadFinished();
+	delete this;
 }
 
 bool ASSocketThread::isConnected()
@@ -1056,8 +909,14 @@ bool ASSocketThread::isConnected()
 
 void ASSocketThread::jobFence()
 {
-	owner->threadFinished();
-	delete this;
+	// from now on the connection is served by the reactor
+	if (sock.connected() && !threadAborting)
+		startReactor(owner->getSystemState());
+	else
+	{
+		owner->threadFinished();
+		delete this;
+	}
 }
 
 void ASSocketThread::flushData()
@@ -1066,22 +925,10 @@ void ASSocketThread::flushData()
 		return;
 
 	datasend->lock();
-	socketbuf* packet = new socketbuf(datasend->getBuffer(datasend->getLength(),false),datasend->getLength());
+	uint32_t len = datasend->getLength();
+	const uint8_t* buf = datasend->getReadBuffer();
+	vector<uint8_t> packet(buf,buf+len);
 	datasend->setLength(0);
 	datasend->unlock();
-	sendQueueMutex.lock();
-	sendQueue.push(packet);
-	sendQueueMutex.unlock();
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_SEND, 1);
-#pragma GCC diagnostic pop
-}
-
-void ASSocketThread::requestClose()
-{
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_CLOSE, 1);
-#pragma GCC diagnostic pop
+	send(packet);
 }
@@ -20,13 +20,13 @@
 #ifndef FLASH_NET_SOCKET_H_
 #define FLASH_NET_SOCKET_H_
 
-#include <queue>
 #include "forwards/threading.h"
 #include "interfaces/threading.h"
 #include "scripting/flash/events/flashevents.h"
 #include "scripting/flash/utils/flashutils.h"
 #include "tiny_string.h"
 #include "asobject.h"
+#include "backends/socketreactor.h"
 
 namespace lightspark
 {
@@ -107,49 +107,30 @@ public:
 	size_t getBytesAvailable() const { return _bytesAvailable; }
 };
 
-class ASSocketThread : public IThreadJob
+/*
+ * Connects the socket in the ThreadPool, afterwards the connection is served by the SocketReactor
+ */
+class ASSocketThread : public IThreadJob, public SocketConnection
 {
 friend class ASSocket;
 private:
-	struct socketbuf
-	{
-		uint8_t* buf;
-		size_t len;
-		socketbuf(uint8_t* data, size_t l)
-		{
-			buf = new uint8_t[l];
-			len = l;
-			memcpy(buf,data,len);
-		}
-		~socketbuf()
-		{
-			delete[] buf;
-		}
-	};
 	SocketIO sock;
 	_R<ASSocket> owner;
 	tiny_string hostname;
 	int port;
 	int timeout;
-	std::queue<socketbuf*> sendQueue;
-	lightspark::Mutex sendQueueMutex;
-	int signalEmitter;
-	int signalListener;
-
-	int connectSocket();
-	ssize_t receive();
-	void readSocket(const SocketIO& sock);
-	void executeCommand(char cmd, SocketIO& sock);
 protected:
 	_NR<ByteArray> datasend;
-	_NR<ByteArray> datareceive;
+	SocketReceiveBuffer datareceive;
+	int fileDescriptor() const override { return sock.fileDescriptor(); }
+	ssize_t receive(bool& eof) override;
+	void connectionClosed(CLOSE_REASON reason) override;
 public:
 	ASSocketThread(_R<ASSocket> owner, const tiny_string& hostname, int port, int timeout);
-	~ASSocketThread();
 	void execute() override;
 	void jobFence() override;
+	bool isBlocking() const override { return true; }
 	void flushData();
-	void requestClose();
 	bool isConnected();
 };
 
@@ -74,7 +74,9 @@ void URLStreamThread::execute()
 	bool success=false;
 	if(!downloader->hasFailed())
 	{
-		getVm(loader->getSystemState())->addEvent(loader,_MR(Class<Event>::getInstanceS(loader->getInstanceWorker(),"open")));
+		Event* ev=Class<Event>::getInstanceS(loader->getInstanceWorker(),"open");
+		ev->ioEvent=true;
+		getVm(loader->getSystemState())->addEvent(loader,_MR(ev));
 		cache->waitForTermination();
 		if(!downloader->hasFailed() && !threadAborting)
 		{
@@ -98,7 +100,9 @@ void URLStreamThread::execute()
 	{
 		getVm(loader->getSystemState())->addEvent(loader,_MR(Class<ProgressEvent>::getInstanceS(loader->getInstanceWorker(),downloader->getLength(),downloader->getLength())));
 		//Send a complete event for this object
-		getVm(loader->getSystemState())->addEvent(loader,_MR(Class<Event>::getInstanceS(loader->getInstanceWorker(),"complete")));
+		Event* ev=Class<Event>::getInstanceS(loader->getInstanceWorker(),"complete");
+		ev->ioEvent=true;
+		getVm(loader->getSystemState())->addEvent(loader,_MR(ev));
 	}
 	else if(!success && !threadAborting)
 	{
@@ -39,9 +39,6 @@
 #include <unistd.h>
 #endif
 
-const char SOCKET_COMMAND_SEND = '*';
-const char SOCKET_COMMAND_CLOSE = '-';
-
 using namespace std;
 using namespace lightspark;
 
@@ -268,46 +265,8 @@ void XMLSocket::AVM1HandleEvent(EventDispatcher *dispatcher, Event* e)
 }
 
 XMLSocketThread::XMLSocketThread(_R<XMLSocket> _owner, const tiny_string& _hostname, int _port, int _timeout)
-: owner(_owner), hostname(_hostname), port(_port), timeout(_timeout)
-{
-#ifdef _WIN32
-	HANDLE readPipe, writePipe;
-	if (!CreatePipe(&readPipe,&writePipe,NULL,0))
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = _open_osfhandle((intptr_t)readPipe, _O_RDONLY);
-	signalEmitter = _open_osfhandle((intptr_t)writePipe, _O_WRONLY);
-#else
-	int pipefd[2];
-	if (pipe(pipefd) == -1)
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = pipefd[0];
-	signalEmitter = pipefd[1];
-#endif
-}
-
-XMLSocketThread::~XMLSocketThread()
+: SocketConnection(_owner->getInstanceWorker()), owner(_owner), hostname(_hostname), port(_port), timeout(_timeout)
 {
-	if (signalListener != -1)
-		::close(signalListener);
-	if (signalEmitter != -1)
-		::close(signalEmitter);
-
-	sendQueueMutex.lock();
-	while (!sendQueue.empty())
-	{
-		tiny_string *s = sendQueue.front();
-		delete s;
-		sendQueue.pop();
-	}
-	sendQueueMutex.unlock();
 }
 
 void XMLSocketThread::execute()
@@ -322,120 +281,53 @@ void XMLSocketThread::execute()
 	}
 
 	getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getInstanceWorker(),"connect")));
+}
 
-	struct timeval timeout;
-	int maxfd;
-	fd_set readfds;
-	
-	while (!threadAborting)
+ssize_t XMLSocketThread::receive(bool& eof)
+{
+	ssize_t nbytes = datareceive.receive(sock.fileDescriptor(),eof);
+	// according to specs every message is terminated by a null byte, so all received messages are dispatched separately
+	// a message without terminator stays in the buffer until the rest of it is received
+	vector<uint8_t> buf;
+	int32_t end;
+	while ((end = datareceive.find(0)) >= 0)
 	{
-		FD_ZERO(&readfds);
-		FD_SET(signalListener, &readfds);
-		FD_SET(sock.fileDescriptor(), &readfds);
-		maxfd = max(signalListener, sock.fileDescriptor());
-
-		// Check threadAborting periodically
-		timeout.tv_sec = 10;
-		timeout.tv_usec = 0;
-
-		int status = select(maxfd+1, &readfds, nullptr, nullptr, &timeout);
-		if (status  < 0)
+		buf.resize(end+1);
+		datareceive.read(buf.data(),end+1);
+		if (end > 0)
 		{
+			tiny_string data(string((const char*)buf.data(), end));
 			owner->incRef();
-			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
-			return;
-		}
-
-		if (FD_ISSET(signalListener, &readfds))
-		{
-			char cmd;
-
-			ssize_t nbytes = read(signalListener, &cmd, 1);
-			if (nbytes < 0)
-			{
-				owner->incRef();
-				getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
-				return;
-			}
-			else if (nbytes == 0)
-			{
-				//The pipe has been closed. This
-				//shouldn't happen, the pipe will be
-				//closed only in the desctructor.
-				return;
-			}
-			else
-			{
-				executeCommand(cmd, sock);
-			}
+			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<DataEvent>::getInstanceS(owner->getInstanceWorker(),data)));
 		}
-		else if (FD_ISSET(sock.fileDescriptor(), &readfds))
-		{
-			readSocket(sock);
-		}
-	}
-}
-
-void XMLSocketThread::readSocket(const SocketIO& sock)
-{
-	char buf[1024];
-	size_t nbytes = sock.receive(buf, sizeof buf - 1);
-
-	if (nbytes > 0)
-	{
-		buf[nbytes] = '\0';
-		tiny_string data(buf, true);
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<DataEvent>::getInstanceS(owner->getInstanceWorker(),data)));
-	}
-	else if (nbytes == 0)
-	{
-		// The server has closed the socket
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getInstanceWorker(),"close")));
-		threadAborting = true;
-	}
-	else
-	{
-		// Error
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
-		threadAborting = true;
 	}
+	return nbytes;
 }
 
-void XMLSocketThread::executeCommand(char cmd, SocketIO& sock)
+void XMLSocketThread::connectionClosed(CLOSE_REASON reason)
 {
-	switch (cmd)
+	sock.close();
+	switch (reason)
 	{
-		case SOCKET_COMMAND_SEND:
+		case CLOSE_REMOTE:
 		{
-			sendQueueMutex.lock();
-			while (!sendQueue.empty())
-			{
-				tiny_string *s = sendQueue.front();
-				sock.sendAll(s->raw_buf(), s->numBytes());
-				delete s;
-				// according to specs every message is terminated by a null byte
-				char buf=0;
-				sock.sendAll(&buf, 1);
-				sendQueue.pop();
-			}
-			sendQueueMutex.unlock();
+			// The server has closed the socket
+			owner->incRef();
+			Event* ev=Class<Event>::getInstanceS(owner->getInstanceWorker(),"close");
+			ev->ioEvent=true;
+			getVm(owner->getSystemState())->addEvent(owner, _MR(ev));
 			break;
 		}
-		case SOCKET_COMMAND_CLOSE:
-		{
-			sock.close();
-			threadAborting = true;
+		case CLOSE_ERROR:
+			owner->incRef();
+			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getInstanceWorker())));
 			break;
-		}
-		default:
-		{
-			assert_and_throw(false && "Unexpected command");
+		case CLOSE_REQUESTED:
+		case CLOSE_SHUTDOWN:
 			break;
-		}
 	}
+	owner->threadFinished();
+	delete this;
 }
 
 bool XMLSocketThread::isConnected()
@@ -445,8 +337,14 @@ bool XMLSocketThread::isConnected()
 
 void XMLSocketThread::jobFence()
 {
-	owner->threadFinished();
-	delete this;
+	// from now on the connection is served by the reactor
+	if (sock.connected() && !threadAborting)
+		startReactor(owner->getSystemState());
+	else
+	{
+		owner->threadFinished();
+		delete this;
+	}
 }
 
 void XMLSocketThread::sendData(const tiny_string& data)
@@ -454,20 +352,8 @@ void XMLSocketThread::sendData(const tiny_string& data)
 	if (threadAborting)
 		return;
 
-	tiny_string *packet = new tiny_string(data);
-	sendQueueMutex.lock();
-	sendQueue.push(packet);
-	sendQueueMutex.unlock();
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_SEND, 1);
-#pragma GCC diagnostic pop
-}
-
-void XMLSocketThread::requestClose()
-{
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_CLOSE, 1);
-#pragma GCC diagnostic pop
+	// according to specs every message is terminated by a null byte
+	vector<uint8_t> packet(data.numBytes()+1,0);
+	memcpy(packet.data(),data.raw_buf(),data.numBytes());
+	send(packet);
 }
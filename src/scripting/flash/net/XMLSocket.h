@@ -54,7 +54,8 @@ public:
 	void AVM1HandleEvent(EventDispatcher* dispatcher, Event* e) override;
 };
 
-class XMLSocketThread : public IThreadJob
+// connects in the ThreadPool, afterwards the connection is served by the SocketReactor
+class XMLSocketThread : public IThreadJob, public SocketConnection
 {
 private:
 	SocketIO sock;
@@ -62,21 +63,17 @@ private:
 	tiny_string hostname;
 	int port;
 	int timeout;
-	std::queue<tiny_string*> sendQueue;
-	lightspark::Mutex sendQueueMutex;
-	int signalEmitter;
-	int signalListener;
-
-	int connectSocket();
-	void readSocket(const SocketIO& sock);
-	void executeCommand(char cmd, SocketIO& sock);
+	SocketReceiveBuffer datareceive;
+protected:
+	int fileDescriptor() const override { return sock.fileDescriptor(); }
+	ssize_t receive(bool& eof) override;
+	void connectionClosed(CLOSE_REASON reason) override;
 public:
 	XMLSocketThread(_R<XMLSocket> owner, const tiny_string& hostname, int port, int timeout);
-	~XMLSocketThread();
-	virtual void execute();
-	virtual void jobFence();
+	void execute() override;
+	void jobFence() override;
+	bool isBlocking() const override { return true; }
 	void sendData(const tiny_string& data);
-	void requestClose();
 	bool isConnected();
 };
 
@@ -435,44 +435,52 @@ void URLLoaderThread::execute()
 	bool success=false;
 	if(!downloader->hasFailed())
 	{
-		getVm(loader->getSystemState())->addEvent(loader,_MR(Class<Event>::getInstanceS(loader->getInstanceWorker(),"open")));
+		Event* ev=Class<Event>::getInstanceS(loader->getInstanceWorker(),"open");
+		ev->ioEvent=true;
+		getVm(loader->getSystemState())->addEvent(loader,_MR(ev));
 
 		cache->waitForTermination();
 		if(!downloader->hasFailed() && !threadAborting)
 		{
-			std::streambuf *sbuf = cache->createReader();
-			istream s(sbuf);
-			uint8_t* buf=new uint8_t[downloader->getLength()+1];
-			//TODO: avoid this useless copy
-			s.read((char*)buf,downloader->getLength());
-			buf[downloader->getLength()] = '\0';
+			// read the data directly from the chunks of the cache
+			MemoryStreamCache::SpanReader reader=cache->createSpanReader();
+			size_t len=downloader->getLength();
 			//TODO: test binary data format
 			tiny_string dataFormat=loader->getDataFormat();
 			if(dataFormat=="binary")
 			{
+				uint8_t* buf=new uint8_t[len+1];
+				size_t pos=0;
+				for(StreamSpan span=reader.next(len); !span.empty(); span=reader.next(len-pos))
+				{
+					memcpy(buf+pos,span.data,span.size);
+					pos+=span.size;
+				}
+				buf[pos] = '\0';
 				ByteArray* byteArray=Class<ByteArray>::getInstanceS(loader->getInstanceWorker());
-				byteArray->acquireBuffer(buf,downloader->getLength());
+				byteArray->acquireBuffer(buf,pos);
 				data=asAtomHandler::fromObjectNoPrimitive(byteArray);
 				//The buffers must not be deleted, it's now handled by the ByteArray instance
 			}
-			else if(dataFormat=="text")
-			{
-				// don't use abstract_s here, because we are not in the main thread
-				std::string tmp((char*)buf,downloader->getLength());
-				data=asAtomHandler::fromString(loader->getSystemState(),tmp);
-				delete[] buf;
-			}
-			else if(dataFormat=="variables")
+			else if(dataFormat=="text" || dataFormat=="variables")
 			{
-				data=asAtomHandler::fromObjectNoPrimitive(Class<URLVariables>::getInstanceS(loader->getInstanceWorker(),(char*)buf));
-				delete[] buf;
+				std::string tmp;
+				tmp.reserve(len);
+				for(StreamSpan span=reader.next(len); !span.empty(); span=reader.next(len-tmp.size()))
+					tmp.append((const char*)span.data,span.size);
+				if(dataFormat=="text")
+				{
+					// don't use abstract_s here, because we are not in the main thread
+					data=asAtomHandler::fromString(loader->getSystemState(),tmp);
+				}
+				else
+					data=asAtomHandler::fromObjectNoPrimitive(Class<URLVariables>::getInstanceS(loader->getInstanceWorker(),tmp.c_str()));
 			}
 			else
 			{
 				assert(false && "invalid dataFormat");
 			}
 
-			delete sbuf;
 			success=true;
 		}
 	}
@@ -485,7 +493,9 @@ void URLLoaderThread::execute()
 
 		getVm(loader->getSystemState())->addEvent(loader,_MR(Class<ProgressEvent>::getInstanceS(loader->getInstanceWorker(),downloader->getLength(),downloader->getLength())));
 		//Send a complete event for this object
-		getVm(loader->getSystemState())->addEvent(loader,_MR(Class<Event>::getInstanceS(loader->getInstanceWorker(),"complete")));
+		Event* ev=Class<Event>::getInstanceS(loader->getInstanceWorker(),"complete");
+		ev->ioEvent=true;
+		getVm(loader->getSystemState())->addEvent(loader,_MR(ev));
 	}
 	else if(!success && !threadAborting)
 	{
@@ -1100,7 +1110,7 @@ ASFUNCTIONBODY_ATOM(NetConnection,call)
 	message->writeUnsignedInt(messageLen+1);
 
 	uint32_t len=message->getLength();
-	uint8_t* buf=message->getBuffer(len, false);
+	const uint8_t* buf=message->getReadBuffer();
 	th->messageData.clear();
 	th->messageData.insert(th->messageData.end(), buf, buf+len);
 
@@ -1924,7 +1934,7 @@ ASFUNCTIONBODY_ATOM(NetStream,appendBytes)
 			}
 			if (processedlength > 0)
 			{
-				th->datagenerationfile->append(th->datagenerationbuffer->getBuffer(processedlength,false),processedlength);
+				th->datagenerationfile->append(th->datagenerationbuffer->getReadBuffer(),processedlength);
 				if (processedlength!=th->datagenerationbuffer->getLength())
 					th->datagenerationbuffer->removeFrontBytes(processedlength);
 				else
@@ -2255,7 +2265,9 @@ void NetStream::execute()
 	}
 	if(waitForFlush)
 	{
-		//Put the decoders in the flushing state and wait for the complete consumption of contents
+		//Get the frames the video decoder still holds back, put the decoders in the flushing state and wait for the complete consumption of contents
+		if(videoDecoder)
+			videoDecoder->drainFrames();
 		if(audioDecoder)
 			audioDecoder->setFlushing();
 		if(videoDecoder)
@@ -2417,6 +2429,12 @@ TextureChunk& NetStream::getTexture() const
 	return videoDecoder->getTexture();
 }
 
+bool NetStream::drawFrameToBitmap(BitmapContainer* bc, int32_t x, int32_t y) const
+{
+	assert(isReady());
+	return videoDecoder->drawFrameToBitmap(bc,x,y);
+}
+
 uint32_t NetStream::getStreamTime()
 {
 	assert(isReady());
@@ -22,6 +22,7 @@
 
 #include "forwards/threading.h"
 #include "forwards/timer.h"
+#include "forwards/scripting/flash/display/BitmapContainer.h"
 #include "interfaces/threading.h"
 #include "interfaces/timer.h"
 #include "interfaces/backends/netutils.h"
@@ -250,6 +251,7 @@ private:
 	void execute() override;
 	void threadAbort() override;
 	void jobFence() override;
+	bool isBlocking() const override { return true; }
 public:
 	NetConnection(ASWorker* wrk,Class_base* c);
 	void finalize() override;
@@ -311,6 +313,7 @@ private:
 	void execute() override;
 	void threadAbort() override;
 	void jobFence() override;
+	bool isBlocking() const override { return true; }
 	//ITickJob interface to frame advance
 	void tick() override;
 	void tickFence() override;
@@ -404,6 +407,12 @@ public:
 		@return a TextureChunk ready to be blitted
 	*/
 	TextureChunk& getTexture() const;
+	/**
+	  	Draw the current video frame into a bitmap
+		@pre lock on the object should be acquired and object should be ready
+		@return false if the frame could not be converted
+	*/
+	bool drawFrameToBitmap(BitmapContainer* bc, int32_t x, int32_t y) const;
 	/**
 	  	Get the stream time
 
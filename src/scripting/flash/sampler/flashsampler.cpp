@@ -1,4 +1,7 @@
 #include "scripting/flash/sampler/flashsampler.h"
+#include "scripting/flash/sampler/objectsampler.h"
+#include "scripting/flash/system/ASWorker.h"
+#include "scripting/toplevel/UInteger.h"
 #include "scripting/toplevel/ASQName.h"
 #include "scripting/toplevel/Array.h"
 #include "scripting/class.h"
@@ -7,61 +10,142 @@
 using namespace lightspark;
 
 Sample::Sample(ASWorker* wrk, Class_base* c):
-	ASObject(wrk,c)
+	ASObject(wrk,c),time(0),stack(asAtomHandler::invalidAtom)
 {
 }
 
 void Sample::sinit(Class_base* c)
 {
-	CLASS_SETUP_NO_CONSTRUCTOR(c, ASObject, CLASS_SEALED|CLASS_FINAL);
+	CLASS_SETUP_NO_CONSTRUCTOR(c, ASObject, CLASS_SEALED);
+	REGISTER_GETTER_RESULTTYPE(c,time,Number);
+	REGISTER_GETTER_RESULTTYPE(c,stack,Array);
+}
+void Sample::finalize()
+{
+	ASATOM_REMOVESTOREDMEMBER(stack);
+	stack = asAtomHandler::invalidAtom;
+	ASObject::finalize();
+}
+bool Sample::destruct()
+{
+	time = 0;
+	ASATOM_REMOVESTOREDMEMBER(stack);
+	stack = asAtomHandler::invalidAtom;
+	return destructIntern();
 }
+ASFUNCTIONBODY_GETTER(Sample,time)
+ASFUNCTIONBODY_GETTER(Sample,stack)
 
 
 DeleteObjectSample::DeleteObjectSample(ASWorker* wrk,Class_base* c):
-	Sample(wrk,c)
+	Sample(wrk,c),id(0),size(0)
 {
 }
 
 void DeleteObjectSample::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, Sample, CLASS_SEALED|CLASS_FINAL);
+	REGISTER_GETTER_RESULTTYPE(c,id,Number);
+	REGISTER_GETTER_RESULTTYPE(c,size,Number);
 }
+bool DeleteObjectSample::destruct()
+{
+	id = 0;
+	size = 0;
+	return Sample::destruct();
+}
+ASFUNCTIONBODY_GETTER(DeleteObjectSample,id)
+ASFUNCTIONBODY_GETTER(DeleteObjectSample,size)
 
 
 NewObjectSample::NewObjectSample(ASWorker* wrk, Class_base* c):
-	Sample(wrk,c)
+	Sample(wrk,c),id(0),type(asAtomHandler::invalidAtom),size(0)
 {
 }
 
 void NewObjectSample::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, Sample, CLASS_SEALED|CLASS_FINAL);
-	REGISTER_GETTER(c,object);
-	REGISTER_GETTER(c,size);
+	REGISTER_GETTER_RESULTTYPE(c,id,Number);
+	REGISTER_GETTER(c,type);
+	c->setDeclaredMethodByQName("object","",c->getSystemState()->getBuiltinFunction(_getObject),GETTER_METHOD,true);
+	REGISTER_GETTER_RESULTTYPE(c,size,Number);
+}
+void NewObjectSample::finalize()
+{
+	ASATOM_DECREF(type);
+	type = asAtomHandler::invalidAtom;
+	Sample::finalize();
+}
+bool NewObjectSample::destruct()
+{
+	id = 0;
+	size = 0;
+	ASATOM_DECREF(type);
+	type = asAtomHandler::invalidAtom;
+	return Sample::destruct();
+}
+ASFUNCTIONBODY_GETTER(NewObjectSample,id)
+ASFUNCTIONBODY_GETTER(NewObjectSample,type)
+ASFUNCTIONBODY_GETTER(NewObjectSample,size)
+ASFUNCTIONBODY_ATOM(NewObjectSample,_getObject)
+{
+	NewObjectSample* th = asAtomHandler::as<NewObjectSample>(obj);
+	// the object is only available as long as it wasn't deleted
+	ASObject* o = wrk->sampler ? wrk->sampler->getLiveObject(th->id) : nullptr;
+	if (o)
+		ret = asAtomHandler::fromObject(o);
+	else
+		asAtomHandler::setUndefined(ret);
 }
-ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NewObjectSample,object);
-ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NewObjectSample,size);
 
 StackFrame::StackFrame(ASWorker* wrk, Class_base* c):
-	ASObject(wrk,c)
+	ASObject(wrk,c),line(0),scriptID(0)
 {
 }
 
 void StackFrame::sinit(Class_base* c)
 {
 	CLASS_SETUP_NO_CONSTRUCTOR(c, ASObject, CLASS_SEALED|CLASS_FINAL);
+	REGISTER_GETTER_RESULTTYPE(c,name,ASString);
+	REGISTER_GETTER_RESULTTYPE(c,file,ASString);
+	REGISTER_GETTER_RESULTTYPE(c,line,UInteger);
+	REGISTER_GETTER_RESULTTYPE(c,scriptID,Number);
 	c->setDeclaredMethodByQName("toString","",c->getSystemState()->getBuiltinFunction(_toString),NORMAL_METHOD,true);
 }
+bool StackFrame::destruct()
+{
+	name.clear();
+	file.clear();
+	line = 0;
+	scriptID = 0;
+	return destructIntern();
+}
+ASFUNCTIONBODY_GETTER(StackFrame,name)
+ASFUNCTIONBODY_GETTER(StackFrame,file)
+ASFUNCTIONBODY_GETTER(StackFrame,line)
+ASFUNCTIONBODY_GETTER(StackFrame,scriptID)
 ASFUNCTIONBODY_ATOM(StackFrame,_toString)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.stackFrame.toString not implemented");
-	ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
+	StackFrame* th = asAtomHandler::as<StackFrame>(obj);
+	tiny_string res = th->name;
+	res += "()";
+	if (!th->file.empty())
+	{
+		res += "[";
+		res += th->file;
+		res += ":";
+		res += UInteger::toString(th->line);
+		res += "]";
+	}
+	ret = asAtomHandler::fromObject(abstract_s(wrk,res));
 }
 
 
 ASFUNCTIONBODY_ATOM(lightspark,clearSamples)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.clearSamples not implemented");
+	if (wrk->sampler)
+		wrk->sampler->clear();
 }
 ASFUNCTIONBODY_ATOM(lightspark,getGetterInvocationCount)
 {
@@ -112,21 +196,38 @@ ASFUNCTIONBODY_ATOM(lightspark,getMemberNames)
 }
 ASFUNCTIONBODY_ATOM(lightspark,getSampleCount)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.getSampleCount not implemented");
-	asAtomHandler::setInt(ret,-1);
+	if (!wrk->sampler || !wrk->sampler->isStarted())
+	{
+		asAtomHandler::setInt(ret,-1);
+		return;
+	}
+	asAtomHandler::setNumber(ret,wrk->sampler->getSampleCount());
 }
 ASFUNCTIONBODY_ATOM(lightspark,getSamples)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.getSamples not implemented");
-	asAtomHandler::setUndefined(ret);
+	if (!wrk->sampler || !wrk->sampler->isStarted())
+	{
+		asAtomHandler::setNull(ret);
+		return;
+	}
+	std::vector<asAtom> samples;
+	wrk->sampler->getSamples(samples);
+	Array* res=Class<Array>::getInstanceSNoArgs(wrk);
+	for (auto it = samples.begin(); it != samples.end(); it++)
+		res->push(*it);
+	ret = asAtomHandler::fromObject(res);
 }
 
 ASFUNCTIONBODY_ATOM(lightspark,getSize)
 {
 	_NR<ASObject> o;
 	ARG_CHECK(ARG_UNPACK (o));
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.getSize not implemented");
-	asAtomHandler::setInt(ret,0);
+	if (o.isNull())
+	{
+		asAtomHandler::setInt(ret,0);
+		return;
+	}
+	asAtomHandler::setNumber(ret,ObjectSampler::getObjectSize(o.getPtr()));
 }
 ASFUNCTIONBODY_ATOM(lightspark,getSavedThis)
 {
@@ -145,25 +246,34 @@ ASFUNCTIONBODY_ATOM(lightspark,isGetterSetter)
 }
 ASFUNCTIONBODY_ATOM(lightspark,pauseSampling)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.pauseSampling not implemented");
+	if (wrk->sampler)
+		wrk->sampler->pause();
 	ret = asAtomHandler::undefinedAtom;
 }
 ASFUNCTIONBODY_ATOM(lightspark,sampleInternalAllocs)
 {
 	bool b;
 	ARG_CHECK(ARG_UNPACK (b));
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.sampleInternalAllocs not implemented");
+	if (!wrk->sampler)
+		wrk->sampler = new ObjectSampler(wrk);
+	wrk->sampler->setInternalAllocs(b);
 }
 ASFUNCTIONBODY_ATOM(lightspark,setSamplerCallback)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.setSamplerCallback not implemented");
+	asAtom f = argslen ? args[0] : asAtomHandler::invalidAtom;
+	if (!wrk->sampler)
+		wrk->sampler = new ObjectSampler(wrk);
+	wrk->sampler->setCallback(asAtomHandler::isFunction(f) ? f : asAtomHandler::invalidAtom);
 }
 ASFUNCTIONBODY_ATOM(lightspark,startSampling)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.startSampling not implemented");
+	if (!wrk->sampler)
+		wrk->sampler = new ObjectSampler(wrk);
+	wrk->sampler->start();
 }
 ASFUNCTIONBODY_ATOM(lightspark,stopSampling)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"flash.sampler.stopSampling not implemented");
+	if (wrk->sampler)
+		wrk->sampler->stop();
 }
 
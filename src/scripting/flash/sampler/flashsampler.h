@@ -29,6 +29,10 @@ class Sample : public ASObject
 public:
 	Sample(ASWorker* wrk,Class_base* c);
 	static void sinit(Class_base*);
+	void finalize() override;
+	bool destruct() override;
+	ASPROPERTY_GETTER(number_t,time);
+	ASPROPERTY_GETTER(asAtom,stack);
 };
 
 class DeleteObjectSample : public Sample
@@ -36,13 +40,20 @@ class DeleteObjectSample : public Sample
 public:
 	DeleteObjectSample(ASWorker* wrk, Class_base* c);
 	static void sinit(Class_base*);
+	bool destruct() override;
+	ASPROPERTY_GETTER(number_t,id);
+	ASPROPERTY_GETTER(number_t,size);
 };
 class NewObjectSample : public Sample
 {
 public:
 	NewObjectSample(ASWorker* wrk,Class_base* c);
 	static void sinit(Class_base*);
-	ASPROPERTY_GETTER(_NR<ASObject>,object);
+	void finalize() override;
+	bool destruct() override;
+	ASPROPERTY_GETTER(number_t,id);
+	ASPROPERTY_GETTER(asAtom,type);
+	ASFUNCTION_ATOM(_getObject);
 	ASPROPERTY_GETTER(number_t,size);
 };
 class StackFrame : public ASObject
@@ -50,6 +61,11 @@ class StackFrame : public ASObject
 public:
 	StackFrame(ASWorker* wrk,Class_base* c);
 	static void sinit(Class_base*);
+	bool destruct() override;
+	ASPROPERTY_GETTER(tiny_string,name);
+	ASPROPERTY_GETTER(tiny_string,file);
+	ASPROPERTY_GETTER(uint32_t,line);
+	ASPROPERTY_GETTER(number_t,scriptID);
 	ASFUNCTION_ATOM(_toString);
 };
 
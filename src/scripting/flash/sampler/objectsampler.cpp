@@ -0,0 +1,428 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include "scripting/flash/sampler/objectsampler.h"
+#include "scripting/flash/sampler/flashsampler.h"
+#include "scripting/flash/system/ASWorker.h"
+#include "scripting/flash/utils/ByteArray.h"
+#include "scripting/toplevel/Array.h"
+#include "scripting/class.h"
+#include "swf.h"
+
+using namespace lightspark;
+
+namespace lightspark
+{
+ATOMIC_INT32(activeSamplerCount)(0);
+
+void samplerObjectCreated(ASObject* o, bool computesize)
+{
+	ASWorker* w = o->getInstanceWorker();
+	// the primordial worker is the worker of itself and not completely constructed here
+	if (w && w != o && w->sampler)
+		w->sampler->objectCreated(o,computesize);
+}
+void samplerObjectDeleted(ASObject* o, uint32_t id, bool computesize)
+{
+	ASWorker* w = o->getInstanceWorker();
+	if (w && w != o && w->sampler)
+		w->sampler->objectDeleted(o,id,computesize);
+}
+void samplerFunctionEntered(ASWorker* w)
+{
+	if (w->sampler)
+		w->sampler->functionEntered();
+}
+}
+
+std::atomic<uint32_t> ObjectSampler::nextId(1);
+
+ObjectSampler::ObjectSampler(ASWorker* w)
+	:owner(w)
+	,ring(SAMPLER_RING_SIZE)
+	,enqueuePos(0)
+	,dequeuePos(0)
+	,dropped(0)
+	,active(false)
+	,started(false)
+	,internalAllocs(false)
+	,inCallback(false)
+	,seenDropped(0)
+	,lastStackSample(0)
+	,callback(asAtomHandler::invalidAtom)
+{
+	for (uint32_t i = 0; i < SAMPLER_RING_SIZE; i++)
+		ring[i].sequence.store(i,std::memory_order_relaxed);
+}
+
+ObjectSampler::~ObjectSampler()
+{
+	setActive(false);
+	ASATOM_DECREF(callback);
+}
+
+void ObjectSampler::setActive(bool a)
+{
+	if (active.exchange(a) != a)
+		activeSamplerCount += a ? 1 : -1;
+}
+
+bool ObjectSampler::enqueue(const SampleRecord& r)
+{
+	// bounded multi producer queue, every slot carries a sequence number telling producers and consumer whose turn it is
+	uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+	RingSlot* slot;
+	while (true)
+	{
+		slot = &ring[pos & (SAMPLER_RING_SIZE-1)];
+		int32_t diff = int32_t(slot->sequence.load(std::memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			if (enqueuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// ring is full
+			dropped.fetch_add(1,std::memory_order_relaxed);
+			return false;
+		}
+		else
+			pos = enqueuePos.load(std::memory_order_relaxed);
+	}
+	slot->record = r;
+	slot->sequence.store(pos+1,std::memory_order_release);
+	return true;
+}
+
+bool ObjectSampler::dequeue(SampleRecord& r)
+{
+	uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+	RingSlot* slot;
+	while (true)
+	{
+		slot = &ring[pos & (SAMPLER_RING_SIZE-1)];
+		int32_t diff = int32_t(slot->sequence.load(std::memory_order_acquire) - (pos+1));
+		if (diff == 0)
+		{
+			if (dequeuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false;
+		else
+			pos = dequeuePos.load(std::memory_order_relaxed);
+	}
+	r = slot->record;
+	slot->sequence.store(pos+SAMPLER_RING_SIZE,std::memory_order_release);
+	return true;
+}
+
+void ObjectSampler::drain()
+{
+	SampleRecord r;
+	while (dequeue(r))
+	{
+		switch (r.kind)
+		{
+			case SAMPLE_NEWOBJECT:
+				if (!started)
+					continue;
+				liveObjects[r.id] = LiveObject { r.object, uint32_t(collected.size()) };
+				break;
+			case SAMPLE_DELETEOBJECT:
+			{
+				auto it = liveObjects.find(r.id);
+				if (it == liveObjects.end())
+					continue; // allocated before the last call to stopSampling
+				if (it->second.index != UINT32_MAX)
+				{
+					collected[it->second.index].object = nullptr;
+					collected[it->second.index].size = r.size;
+				}
+				liveObjects.erase(it);
+				break;
+			}
+			default:
+				break;
+		}
+		if (started)
+			collected.push_back(r);
+	}
+	uint32_t d = dropped.load();
+	if (d != seenDropped)
+	{
+		// deletions may have been lost, so we can't tell anymore which objects are still alive
+		LOG(LOG_ERROR,"flash.sampler: "<<d-seenDropped<<" samples were dropped");
+		seenDropped = d;
+		for (auto it = collected.begin(); it != collected.end(); it++)
+			it->object = nullptr;
+		liveObjects.clear();
+	}
+}
+
+uint32_t ObjectSampler::captureStack()
+{
+	if (owner->cur_recursion == 0)
+		return UINT32_MAX;
+	stackScratch.clear();
+	owner->fillStackTrace(stackScratch);
+	stackKey.clear();
+	for (auto it = stackScratch.begin(); it != stackScratch.end(); it++)
+	{
+		uint32_t v[5] = { it->clsname, it->init, it->function, it->ns, it->methodnumber };
+		stackKey.append((const char*)v,sizeof(v));
+		stackKey.push_back(char(it->isGetter | (it->isSetter<<1)));
+	}
+	auto it = stackIndex.find(stackKey);
+	if (it != stackIndex.end())
+		return it->second;
+	uint32_t res = stacks.size();
+	stacks.push_back(stackScratch);
+	stackIndex.insert(make_pair(stackKey,res));
+	return res;
+}
+
+uint32_t ObjectSampler::getObjectSize(ASObject* o)
+{
+	// approximation, we don't know the real allocation size of the derived classes
+	uint32_t res = sizeof(ASObject) + o->numVariables()*sizeof(variable);
+	if (o->is<ByteArray>())
+		res += o->as<ByteArray>()->getLength();
+	return res;
+}
+
+void ObjectSampler::start()
+{
+	if (!started)
+	{
+		// drop the records of the last session
+		drain();
+		collected.clear();
+		started = true;
+	}
+	setActive(true);
+}
+
+void ObjectSampler::pause()
+{
+	setActive(false);
+}
+
+void ObjectSampler::stop()
+{
+	setActive(false);
+	{
+		Locker l(aliveMutex);
+		aliveObjects.clear();
+	}
+	drain();
+	started = false;
+	collected.clear();
+	liveObjects.clear();
+	stacks.clear();
+	stackIndex.clear();
+}
+
+void ObjectSampler::clear()
+{
+	drain();
+	collected.clear();
+	for (auto it = liveObjects.begin(); it != liveObjects.end(); it++)
+		it->second.index = UINT32_MAX;
+	// stacks are only captured in this thread, so no pending record refers to them
+	stacks.clear();
+	stackIndex.clear();
+}
+
+void ObjectSampler::setCallback(asAtom f)
+{
+	ASATOM_DECREF(callback);
+	callback = f;
+	ASATOM_INCREF(callback);
+}
+
+number_t ObjectSampler::getSampleCount()
+{
+	drain();
+	return collected.size();
+}
+
+void ObjectSampler::getSamples(std::vector<asAtom>& samples)
+{
+	// don't sample the Sample objects
+	bool wasactive = active.load();
+	setActive(false);
+	drain();
+	std::vector<asAtom> stackarrays(stacks.size(),asAtomHandler::invalidAtom);
+	samples.reserve(collected.size());
+	for (auto it = collected.begin(); it != collected.end(); it++)
+	{
+		Sample* s;
+		switch (it->kind)
+		{
+			case SAMPLE_NEWOBJECT:
+			{
+				NewObjectSample* ns = Class<NewObjectSample>::getInstanceSNoArgs(owner);
+				ns->id = it->id;
+				if (it->type)
+				{
+					it->type->incRef();
+					ns->type = asAtomHandler::fromObject(it->type);
+				}
+				// the object may already have been deleted by another thread, so only the recorded size is used
+				ns->size = it->size;
+				s = ns;
+				break;
+			}
+			case SAMPLE_DELETEOBJECT:
+			{
+				DeleteObjectSample* ds = Class<DeleteObjectSample>::getInstanceSNoArgs(owner);
+				ds->id = it->id;
+				ds->size = it->size;
+				s = ds;
+				break;
+			}
+			default:
+				s = Class<Sample>::getInstanceSNoArgs(owner);
+				break;
+		}
+		s->time = it->time;
+		if (it->stack != UINT32_MAX)
+		{
+			// samples with the same stack share the array
+			asAtom& a = stackarrays[it->stack];
+			if (asAtomHandler::isInvalid(a))
+			{
+				Array* frames = Class<Array>::getInstanceSNoArgs(owner);
+				const StackTraceList& st = stacks[it->stack];
+				for (auto itf = st.begin(); itf != st.end(); itf++)
+				{
+					StackFrame* f = Class<StackFrame>::getInstanceSNoArgs(owner);
+					f->name = ASWorker::getStackTraceEntryName(owner->getSystemState(),*itf);
+					frames->push(asAtomHandler::fromObject(f));
+				}
+				a = asAtomHandler::fromObject(frames);
+			}
+			ASATOM_ADDSTOREDMEMBER(a);
+			s->stack = a;
+		}
+		samples.push_back(asAtomHandler::fromObject(s));
+	}
+	for (auto it = stackarrays.begin(); it != stackarrays.end(); it++)
+		ASATOM_DECREF(*it);
+	setActive(wasactive);
+}
+
+ASObject* ObjectSampler::getLiveObject(uint32_t id)
+{
+	// the deleting thread removes the object under aliveMutex before it is freed, so it can't go away while we add the reference
+	Locker l(aliveMutex);
+	auto it = aliveObjects.find(id);
+	if (it == aliveObjects.end() || it->second->getInDestruction() || it->second->getRefCount() <= 0)
+		return nullptr;
+	it->second->incRef();
+	return it->second;
+}
+
+void ObjectSampler::objectCreated(ASObject* o, bool computesize)
+{
+	if (!active.load(std::memory_order_relaxed))
+		return;
+	bool onworkerthread = getWorker() == owner;
+	// allocations outside of actionscript code are internal to the player
+	if (!internalAllocs && (!onworkerthread || owner->cur_recursion == 0))
+		return;
+	SampleRecord r;
+	r.kind = SAMPLE_NEWOBJECT;
+	r.time = compat_usectiming();
+	r.object = o;
+	r.type = o->getClass();
+	r.id = nextId.fetch_add(1,std::memory_order_relaxed);
+	if (r.id == 0)
+		r.id = nextId.fetch_add(1,std::memory_order_relaxed);
+	// the derived class is not constructed yet when called from the constructor of ASObject
+	r.size = computesize ? getObjectSize(o) : sizeof(ASObject);
+	r.stack = onworkerthread ? captureStack() : UINT32_MAX;
+	Locker l(aliveMutex);
+	if (enqueue(r))
+	{
+		o->samplerId = r.id;
+		aliveObjects[r.id] = o;
+	}
+}
+
+void ObjectSampler::objectDeleted(ASObject* o, uint32_t id, bool computesize)
+{
+	// deletions are also recorded while sampling is paused, so we know which objects are still alive
+	// after stopSampling the objects are forgotten and nothing drains the ring anymore, so their deletions are not recorded
+	Locker l(aliveMutex);
+	if (aliveObjects.erase(id) == 0)
+		return;
+	SampleRecord r;
+	r.kind = SAMPLE_DELETEOBJECT;
+	r.time = compat_usectiming();
+	r.object = nullptr;
+	r.type = nullptr;
+	r.id = id;
+	r.size = computesize ? getObjectSize(o) : sizeof(ASObject);
+	r.stack = UINT32_MAX;
+	enqueue(r);
+}
+
+void ObjectSampler::functionEntered()
+{
+	if (!active.load(std::memory_order_relaxed) || getWorker() != owner)
+		return;
+	uint64_t now = compat_usectiming();
+	if (now - lastStackSample < SAMPLER_STACK_INTERVAL)
+		return;
+	lastStackSample = now;
+	SampleRecord r;
+	r.kind = SAMPLE_STACK;
+	r.time = now;
+	r.object = nullptr;
+	r.type = nullptr;
+	r.id = 0;
+	r.size = 0;
+	r.stack = captureStack();
+	enqueue(r);
+}
+
+void ObjectSampler::eventHandled()
+{
+	if (!started || inCallback)
+		return;
+	uint32_t lastdropped = seenDropped;
+	drain();
+	if (asAtomHandler::isInvalid(callback))
+		return;
+	if (collected.size() >= SAMPLER_CALLBACK_THRESHOLD || seenDropped != lastdropped)
+	{
+		inCallback = true;
+		asAtom ret = asAtomHandler::invalidAtom;
+		asAtom obj = asAtomHandler::nullAtom;
+		asAtom f = callback;
+		ASATOM_INCREF(f);
+		asAtomHandler::callFunction(f,owner,ret,obj,nullptr,0,false);
+		ASATOM_DECREF(f);
+		ASATOM_DECREF(ret);
+		inCallback = false;
+	}
+}
@@ -0,0 +1,128 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SCRIPTING_FLASH_SAMPLER_OBJECTSAMPLER_H
+#define SCRIPTING_FLASH_SAMPLER_OBJECTSAMPLER_H 1
+
+#include "asobject.h"
+#include "threading.h"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// number of records in the ring buffer of a sampler, must be a power of 2
+#define SAMPLER_RING_SIZE 65536
+// minimum time in microseconds between two stack samples
+#define SAMPLER_STACK_INTERVAL 1000
+// number of collected samples after which the sampler callback is called
+#define SAMPLER_CALLBACK_THRESHOLD 32768
+
+namespace lightspark
+{
+
+enum SAMPLE_KIND { SAMPLE_STACK=0, SAMPLE_NEWOBJECT, SAMPLE_DELETEOBJECT };
+
+struct SampleRecord
+{
+	uint64_t time; // in microseconds
+	ASObject* object; // only valid for SAMPLE_NEWOBJECT records until the matching SAMPLE_DELETEOBJECT record
+	Class_base* type;
+	uint32_t id;
+	uint32_t size; // recorded when the sample is taken, updated by the matching SAMPLE_DELETEOBJECT record
+	uint32_t stack; // index into the stack table of the sampler, UINT32_MAX if no stack was captured
+	SAMPLE_KIND kind;
+};
+
+/*
+ * Memory and stack sampler backing flash.sampler, one per worker.
+ * Allocations and deletions of objects of the worker are recorded from any thread into a lock-free ring buffer,
+ * all other methods must only be called from the thread of the worker.
+ * While no sampler is active the hooks only cost a single relaxed atomic load.
+ */
+class ObjectSampler
+{
+private:
+	struct RingSlot
+	{
+		std::atomic<uint32_t> sequence;
+		SampleRecord record;
+	};
+	// the object and the index of its record in collected (UINT32_MAX if the record was cleared)
+	struct LiveObject
+	{
+		ASObject* object;
+		uint32_t index;
+	};
+	ASWorker* owner;
+	// objects with a NewObjectSample that were not deleted yet, updated synchronously by the threads creating and deleting them
+	Mutex aliveMutex;
+	std::unordered_map<uint32_t,ASObject*> aliveObjects;
+	std::vector<RingSlot> ring;
+	std::atomic<uint32_t> enqueuePos;
+	std::atomic<uint32_t> dequeuePos;
+	std::atomic<uint32_t> dropped;
+	std::atomic<bool> active;
+	// the following members are only accessed in the thread of the worker
+	bool started;
+	bool internalAllocs;
+	bool inCallback;
+	uint32_t seenDropped;
+	uint64_t lastStackSample;
+	asAtom callback;
+	std::vector<SampleRecord> collected;
+	std::unordered_map<uint32_t,LiveObject> liveObjects;
+	std::vector<StackTraceList> stacks;
+	std::unordered_map<std::string,uint32_t> stackIndex;
+	std::string stackKey;
+	StackTraceList stackScratch;
+	static std::atomic<uint32_t> nextId;
+	void setActive(bool a);
+	bool enqueue(const SampleRecord& r);
+	bool dequeue(SampleRecord& r);
+	// moves all records from the ring buffer to collected
+	void drain();
+	uint32_t captureStack();
+public:
+	ObjectSampler(ASWorker* w);
+	~ObjectSampler();
+	static uint32_t getObjectSize(ASObject* o);
+
+	void start();
+	void pause();
+	void stop();
+	void clear();
+	bool isStarted() const { return started; }
+	void setInternalAllocs(bool b) { internalAllocs = b; }
+	void setCallback(asAtom f);
+	number_t getSampleCount();
+	// creates the Sample objects for all collected samples
+	void getSamples(std::vector<asAtom>& samples);
+	// returns the object of a NewObjectSample with an added reference if it is still alive, nullptr otherwise
+	ASObject* getLiveObject(uint32_t id);
+
+	void objectCreated(ASObject* o, bool computesize);
+	void objectDeleted(ASObject* o, uint32_t id, bool computesize);
+	void functionEntered();
+	// called in the thread of the worker after an event was handled
+	void eventHandled();
+};
+
+}
+#endif /* SCRIPTING_FLASH_SAMPLER_OBJECTSAMPLER_H */
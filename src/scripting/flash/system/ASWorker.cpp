@@ -27,6 +27,7 @@
 #include "scripting/flash/errors/flasherrors.h"
 #include "scripting/flash/utils/ByteArray.h"
 #include "scripting/flash/system/ApplicationDomain.h"
+#include "scripting/flash/sampler/objectsampler.h"
 #include "scripting/toplevel/IFunction.h"
 #include "scripting/toplevel/toplevel.h"
 #include "scripting/avm1/scope.h"
@@ -48,6 +49,8 @@ ASWorker::ASWorker(SystemState* s)
 	,started(false)
 	,inShutdown(false)
 	,inFinalize(false)
+	,events_queue(true)
+	,profile(nullptr)
 	,gcStart(nullptr)
 	,gcEnd(nullptr)
 	,stage(nullptr)
@@ -57,6 +60,7 @@ ASWorker::ASWorker(SystemState* s)
 	,cur_recursion(0)
 	,AVM1_cur_recursion_function(0)
 	,AVM1_cur_recursion_internal(0)
+	,sampler(nullptr)
 	,isPrimordial(true)
 	,state("running")
 	,nativeExtensionCallCount(0)
@@ -79,6 +83,8 @@ ASWorker::ASWorker(Class_base* c)
 	,started(false)
 	,inShutdown(false)
 	,inFinalize(false)
+	,events_queue(true)
+	,profile(nullptr)
 	,gcStart(nullptr)
 	,gcEnd(nullptr)
 	,stage(nullptr)
@@ -88,6 +94,7 @@ ASWorker::ASWorker(Class_base* c)
 	,cur_recursion(0)
 	,AVM1_cur_recursion_function(0)
 	,AVM1_cur_recursion_internal(0)
+	,sampler(nullptr)
 	,isPrimordial(false)
 	,state("new")
 	,nativeExtensionCallCount(0)
@@ -111,6 +118,8 @@ ASWorker::ASWorker(ASWorker* wrk, Class_base* c)
 	,started(false)
 	,inShutdown(false)
 	,inFinalize(false)
+	,events_queue(true)
+	,profile(nullptr)
 	,gcStart(nullptr)
 	,gcEnd(nullptr)
 	,stage(nullptr)
@@ -120,6 +129,7 @@ ASWorker::ASWorker(ASWorker* wrk, Class_base* c)
 	,cur_recursion(0)
 	,AVM1_cur_recursion_function(0)
 	,AVM1_cur_recursion_internal(0)
+	,sampler(nullptr)
 	,isPrimordial(false)
 	,state("new")
 	,nativeExtensionCallCount(0)
@@ -245,6 +255,11 @@ void ASWorker::finalize()
 		delete o;
 	}
 	constantrefs.clear();
+	if (sampler)
+	{
+		delete sampler;
+		sampler=nullptr;
+	}
 	delete[] stacktrace;
 	delete[] freelist;
 	freelist=nullptr;
@@ -337,6 +352,39 @@ void ASWorker::fillStackTrace(StackTraceList& strace)
 	}
 }
 
+tiny_string ASWorker::getStackTraceEntryName(SystemState* sys, const stacktrace_string_entry& e)
+{
+	tiny_string ret = sys->getStringFromUniqueId(e.clsname);
+	if (e.init != BUILTIN_STRINGS::EMPTY)
+	{
+		ret += "$";
+		if (e.init != UINT32_MAX)
+			ret += sys->getStringFromUniqueId(e.init);
+	}
+	if (e.function != BUILTIN_STRINGS::EMPTY)
+	{
+		if (e.clsname != BUILTIN_STRINGS::EMPTY)
+			ret += "/";
+		if (e.isGetter)
+			ret +="get ";
+		if (e.isSetter)
+			ret += "set ";
+		if (e.ns != BUILTIN_STRINGS::EMPTY)
+		{
+			ret += sys->getStringFromUniqueId(e.ns);
+			ret +="::";
+		}
+		ret += sys->getStringFromUniqueId(e.function);
+	}
+	else if(e.methodnumber != UINT32_MAX)
+	{
+		char buf[100];
+		sprintf(buf,"MethodInfo-%i",e.methodnumber);
+		ret += buf;
+	}
+	return ret;
+}
+
 tiny_string ASWorker::getStackTraceString(SystemState* sys,const StackTraceList& strace, ASObject* error, bool uncaughtException)
 {
 	tiny_string ret;
@@ -347,35 +395,7 @@ tiny_string ASWorker::getStackTraceString(SystemState* sys,const StackTraceList&
 	for (auto it = strace.begin(); it != strace.end(); it++)
 	{
 		ret += "\n\tat ";
-		ret += sys->getStringFromUniqueId((*it).clsname);
-		if ((*it).init != BUILTIN_STRINGS::EMPTY)
-		{
-			ret += "$";
-			if ((*it).init != UINT32_MAX)
-				ret += sys->getStringFromUniqueId((*it).init);
-		}
-		if ((*it).function != BUILTIN_STRINGS::EMPTY)
-		{
-			if ((*it).clsname != BUILTIN_STRINGS::EMPTY)
-				ret += "/";
-			if ((it)->isGetter)
-				ret +="get ";
-			if ((it)->isSetter)
-				ret += "set ";
-			if ((it)->ns != BUILTIN_STRINGS::EMPTY)
-			{
-				ret += sys->getStringFromUniqueId((*it).ns);
-				ret +="::";
-			}
-			ret += sys->getStringFromUniqueId((*it).function);
-		}
-		else if((*it).methodnumber != UINT32_MAX)
-		{
-			char buf[100];
-			sprintf(buf,"MethodInfo-%i",(*it).methodnumber);
-			ret += buf;
-		}
-
+		ret += getStackTraceEntryName(sys,*it);
 		ret += "()";
 		if (sys->use_testrunner_date && !uncaughtException
 			&& (*it).clsname==BUILTIN_STRINGS::STRING_GLOBAL
@@ -448,81 +468,91 @@ void ASWorker::execute()
 		swf->objfreelist=nullptr;
 		swf.reset();
 	}
+	profile=getSystemState()->allocateProfiler(RGB(200,0,200));
+	profile->setTag("Worker");
+	std::vector<EventQueueLanes::eventType> batch;
 	while (true)
 	{
 		event_queue_mutex.lock();
 		while(events_queue.empty() && !this->threadAborting)
 			sem_event_cond.wait(event_queue_mutex);
-		processGarbageCollection(false);
-		if (this->threadAborting)
+		if (this->threadAborting && events_queue.empty())
 		{
-			if(events_queue.empty())
-			{
-				event_queue_mutex.unlock();
-				break;
-			}
+			event_queue_mutex.unlock();
+			processGarbageCollection(false);
+			break;
 		}
-
-		EventDispatcher* dispatcher=events_queue.front().first.getPtr();
-		_R<Event> e=events_queue.front().second;
-		events_queue.pop_front();
-
+		profile->accountQueueDepth(events_queue.size());
+		events_queue.popBatch(batch);
 		event_queue_mutex.unlock();
-		try
-		{
-			//LOG(LOG_INFO,"worker handle event:"<<e->type);
-			if (dispatcher)
-			{
-				dispatcher->incRef();
-				dispatcher->addStoredMember();
-				dispatcher->handleEvent(e);
-				dispatcher->afterHandleEvent(e.getPtr());
-				dispatcher->removeStoredMember();
-			}
-			else
-				handleInternalEvent(e.getPtr());
+		processGarbageCollection(false);
 
-			processGarbageCollection(false);
-		}
-		catch(LightsparkException& e)
-		{
-			LOG(LOG_ERROR,"Error in worker " << e.cause);
-			getSystemState()->setError(e.cause);
-			threadAborting = true;
-		}
-		catch(ASObject*& e)
+		uint64_t now = compat_usectiming();
+		auto it = batch.begin();
+		for (; it != batch.end() && !threadAborting; it++)
 		{
-			StackTraceList stacktrace;
-			fillStackTrace(stacktrace);
+			EventDispatcher* dispatcher=it->first.getPtr();
+			_R<Event> e=it->second;
+			profile->accountQueueLatency(now > e->queueTime ? now-e->queueTime : 0);
+			try
+			{
+				//LOG(LOG_INFO,"worker handle event:"<<e->type);
+				if (dispatcher)
+				{
+					dispatcher->incRef();
+					dispatcher->addStoredMember();
+					dispatcher->handleEvent(e);
+					dispatcher->afterHandleEvent(e.getPtr());
+					dispatcher->removeStoredMember();
+				}
+				else
+					handleInternalEvent(e.getPtr());
+				if (sampler)
+					sampler->eventHandled();
 
-			if(e->getClass())
-				LOG(LOG_ERROR,"Unhandled ActionScript exception in worker " << e->toString());
-			else
-				LOG(LOG_ERROR,"Unhandled ActionScript exception in worker (no type)");
-			if (e->is<ASError>())
+				processGarbageCollection(false);
+			}
+			catch(LightsparkException& e)
 			{
-				LOG(LOG_ERROR,"Unhandled ActionScript exception in worker " << e->as<ASError>()->getStackTraceString());
-				if (getSystemState()->ignoreUnhandledExceptions)
-					return;
-				getSystemState()->setError(e->as<ASError>()->getStackTraceString());
+				LOG(LOG_ERROR,"Error in worker " << e.cause);
+				getSystemState()->setError(e.cause);
+				threadAborting = true;
+			}
+			catch(ASObject*& e)
+			{
+				StackTraceList stacktrace;
+				fillStackTrace(stacktrace);
+
+				if(e->getClass())
+					LOG(LOG_ERROR,"Unhandled ActionScript exception in worker " << e->toString());
+				else
+					LOG(LOG_ERROR,"Unhandled ActionScript exception in worker (no type)");
+				if (e->is<ASError>())
+				{
+					LOG(LOG_ERROR,"Unhandled ActionScript exception in worker " << e->as<ASError>()->getStackTraceString());
+					if (getSystemState()->ignoreUnhandledExceptions)
+						continue;
+					getSystemState()->setError(e->as<ASError>()->getStackTraceString());
+				}
+				else
+					getSystemState()->setError(getStackTraceString(getSystemState(),stacktrace,e));
+				threadAborting = true;
 			}
-			else
-				getSystemState()->setError(getStackTraceString(getSystemState(),stacktrace,e));
-			threadAborting = true;
 		}
 		if (threadAborting)
 		{
-			while(!events_queue.empty())
+			// notify dispatchers of the events that were not handled
+			for (; it != batch.end(); it++)
 			{
-				_R<Event> e=events_queue.front().second;
-				EventDispatcher* dispatcher=events_queue.front().first.getPtr();
-				if (dispatcher)
-					dispatcher->afterHandleEvent(e.getPtr());
-				events_queue.pop_front();
+				if (it->first)
+					it->first->afterHandleEvent(it->second.getPtr());
 			}
+			batch.clear();
+			clearEventQueue();
 			threadAbort();
 			started = false;
 		}
+		batch.clear();
 	}
 	delete sbuf;
 }
@@ -613,13 +643,27 @@ bool ASWorker::addEvent(_NR<EventDispatcher> obj, _R<Event> ev)
 			obj->afterHandleEvent(ev.getPtr());
 		return false;
 	}
+	ev->queueTime = compat_usectiming();
 	Locker l(event_queue_mutex);
-	events_queue.push_back(pair<_NR<EventDispatcher>,_R<Event>>(obj, ev));
+	events_queue.add(obj, ev);
 	RELEASE_WRITE(ev->queued,true);
 	sem_event_cond.signal();
 	return true;
 }
 
+void ASWorker::clearEventQueue()
+{
+	std::vector<EventQueueLanes::eventType> pending;
+	event_queue_mutex.lock();
+	events_queue.popAll(pending);
+	event_queue_mutex.unlock();
+	for (auto it = pending.begin(); it != pending.end(); it++)
+	{
+		if (it->first)
+			it->first->afterHandleEvent(it->second.getPtr());
+	}
+}
+
 tiny_string ASWorker::getDefaultXMLNamespace() const
 {
 	return getSystemState()->getStringFromUniqueId(currentCallContext ? currentCallContext->defaultNamespaceUri : (uint32_t)BUILTIN_STRINGS::EMPTY);
@@ -692,6 +736,7 @@ void ASWorker::processGarbageCollection(bool force)
 	if (!force && !getSystemState()->use_testrunner_date && diff < 10000) // ony execute garbagecollection every 10 seconds
 		return;
 	last_garbagecollection = currtime;
+	TraceScope tracescope(TRACE_GC,"garbageCollection");
 	if (this->stage)
 		this->stage->cleanupDeadHiddenObjects();
 	bool hasEntries=this->gcStart;
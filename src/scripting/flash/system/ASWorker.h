@@ -30,6 +30,8 @@ namespace lightspark
 class WorkerDomain;
 class ParseThread;
 class Prototype;
+class ThreadProfile;
+class ObjectSampler;
 
 class ASWorker: public EventDispatcher, public IThreadJob
 {
@@ -47,8 +49,10 @@ private:
 	Mutex event_queue_mutex;
 	Mutex constantrefmutex;
 	Cond sem_event_cond;
-	typedef std::pair<_NR<EventDispatcher>,_R<Event>> eventType;
-	std::deque<eventType> events_queue;
+	// protected by event_queue_mutex
+	EventQueueLanes events_queue;
+	ThreadProfile* profile;
+	void clearEventQueue();
 	map<const Class_base*,_R<Prototype>> protoypeMap;
 	std::set<ASObject*> constantrefs;
 	uint64_t last_garbagecollection;
@@ -80,6 +84,7 @@ public:
 	abc_limits limits;
 	std::vector<call_context*> callStack;
 	call_context* currentCallContext;
+	call_frame_stack callFrames; // memory for the call_contexts of recursive calls
 	/* The current recursion level. Each call increases this by one,
 	 * each return from a call decreases this. */
 	uint32_t cur_recursion;
@@ -87,7 +92,10 @@ public:
 	uint32_t AVM1_cur_recursion_internal; // recursion count for internal avm1 function calls (getters,setters...)
 	stacktrace_entry* stacktrace;
 	void fillStackTrace(StackTraceList& strace);
+	static tiny_string getStackTraceEntryName(SystemState* sys, const stacktrace_string_entry& e);
 	static tiny_string getStackTraceString(SystemState* sys, const StackTraceList& strace, ASObject* error, bool uncaughtException=false);
+	// flash.sampler state of this worker, created on the first call to startSampling
+	ObjectSampler* sampler;
 	FORCE_INLINE call_context* incStack(asAtom o, SyntheticFunction* f)
 	{
 		if(USUALLY_FALSE(cur_recursion == limits.max_recursion))
@@ -97,6 +105,8 @@ public:
 		}
 		stacktrace[cur_recursion].set(o,f);
 		++cur_recursion; //increment current recursion depth
+		if (USUALLY_FALSE(activeSamplerCount.load(std::memory_order_relaxed)))
+			samplerFunctionEntered(this);
 		return currentCallContext;
 	}
 	FORCE_INLINE void decStack(call_context* saved_cc)
@@ -143,6 +153,7 @@ public:
 	ASFUNCTION_ATOM(terminate);
 	void execute() override;
 	void jobFence() override;
+	bool isBlocking() const override { return true; }
 	void threadAbort() override;
 	void afterHandleEvent(Event* ev) override;
 	bool addEvent(_NR<EventDispatcher> obj ,_R<Event> ev);
@@ -790,6 +790,7 @@ void ApplicationDomain::checkDomainMemory()
 		domainMemory = defaultDomainMemory;
 		domainMemory->setLength(MIN_DOMAIN_MEMORY_LIMIT);
 	}
+	domainMemory->disableBufferSharing();
 	currentDomainMemory=domainMemory.getPtr();
 }
 
@@ -30,9 +30,16 @@
 #include "scripting/toplevel/UInteger.h"
 #include "scripting/toplevel/Undefined.h"
 #include "scripting/flash/errors/flasherrors.h"
+#include "interfaces/threading.h"
+#include "swf.h"
 #include <sstream>
 #include <zlib.h>
 #include <lzma.h>
+#ifdef __linux__
+#include <sys/mman.h>
+// large buffers are allocated with mmap, so they can be grown with mremap without copying the data
+#define BA_USE_MMAP 1
+#endif
 
 using namespace std;
 using namespace lightspark;
@@ -42,43 +49,115 @@ using namespace lightspark;
 // so we simply don't allow bytearrays larger than 1GiB
 // maybe we should set this smaller
 #define BA_MAX_SIZE 0x40000000
+// buffers of at least this size are allocated with mmap if available
+#define BA_MMAP_THRESHOLD (1024*1024)
+
+ByteArrayStorage::~ByteArrayStorage()
+{
+	switch (allocation)
+	{
+		case ALLOC_NEW:
+			delete[] data;
+			break;
+		case ALLOC_MALLOC:
+			free(data);
+			break;
+		case ALLOC_MMAP:
+#ifdef BA_USE_MMAP
+			munmap(data,capacity);
+#endif
+			break;
+	}
+}
 
-ByteArray::ByteArray(ASWorker* wrk, Class_base* c, uint8_t* b, uint32_t l):ASObject(wrk,c,T_OBJECT,SUBTYPE_BYTEARRAY),littleEndian(false),
-	objectEncoding(OBJECT_ENCODING::AMF3),currentObjectEncoding(OBJECT_ENCODING::AMF3),
-	position(0),bytes(b),real_len(l),len(l),shareable(false)
+ByteArrayStorage* ByteArrayStorage::create(uint32_t capacity)
 {
-#ifdef MEMORY_USAGE_PROFILING
-	c->memoryAccount->addBytes(l);
+#ifdef BA_USE_MMAP
+	if (capacity >= BA_MMAP_THRESHOLD)
+	{
+		void* p = mmap(nullptr,capacity,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+		if (p != MAP_FAILED)
+			return new ByteArrayStorage((uint8_t*)p,capacity,ALLOC_MMAP);
+	}
 #endif
+	uint8_t* p = (uint8_t*)calloc(max(capacity,1U),1);
+	if (p == nullptr)
+		return nullptr;
+	return new ByteArrayStorage(p,capacity,ALLOC_MALLOC);
 }
 
-ByteArray::~ByteArray()
+bool ByteArrayStorage::resize(uint32_t newcapacity)
 {
-	if(bytes)
+	switch (allocation)
 	{
-#ifdef MEMORY_USAGE_PROFILING
-		getClass()->memoryAccount->removeBytes(real_len);
+		case ALLOC_MMAP:
+#ifdef BA_USE_MMAP
+			if (newcapacity >= BA_MMAP_THRESHOLD)
+			{
+				// the kernel moves the pages instead of copying them, added pages are zeroed
+				void* p = mremap(data,capacity,newcapacity,MREMAP_MAYMOVE);
+				if (p == MAP_FAILED)
+					return false;
+				data = (uint8_t*)p;
+				capacity = newcapacity;
+				return true;
+			}
 #endif
-		delete[] bytes;
-		bytes = nullptr;
+			break;
+		case ALLOC_MALLOC:
+#ifdef BA_USE_MMAP
+			if (newcapacity >= BA_MMAP_THRESHOLD)
+				break;
+#endif
+			{
+				uint8_t* p = (uint8_t*)realloc(data,max(newcapacity,1U));
+				if (p == nullptr)
+					return false;
+				data = p;
+				if (newcapacity > capacity)
+					memset(data+capacity,0,newcapacity-capacity);
+				capacity = newcapacity;
+				return true;
+			}
+		case ALLOC_NEW:
+			break;
 	}
+	// the allocation method changes, so the data has to be copied
+	ByteArrayStorage* s = create(newcapacity);
+	if (s == nullptr)
+		return false;
+	memcpy(s->data,data,min(capacity,newcapacity));
+	std::swap(data,s->data);
+	std::swap(capacity,s->capacity);
+	std::swap(allocation,s->allocation);
+	s->decRef();
+	return true;
 }
 
-bool ByteArray::destruct()
+ByteArray::ByteArray(ASWorker* wrk, Class_base* c, uint8_t* b, uint32_t l):ASObject(wrk,c,T_OBJECT,SUBTYPE_BYTEARRAY),littleEndian(false),
+	objectEncoding(OBJECT_ENCODING::AMF3),currentObjectEncoding(OBJECT_ENCODING::AMF3),
+	position(0),bytes(b),real_len(b ? l : 0),len(b ? l : 0),storage(nullptr),bufferSharingDisabled(false),shareable(false)
 {
-	if(bytes)
-	{
+	if (b)
+		storage = new ByteArrayStorage(b,l,ByteArrayStorage::ALLOC_NEW);
 #ifdef MEMORY_USAGE_PROFILING
-		getClass()->memoryAccount->removeBytes(real_len);
+	c->memoryAccount->addBytes(real_len);
 #endif
-		delete[] bytes;
-		bytes = nullptr;
-	}
+}
+
+ByteArray::~ByteArray()
+{
+	releaseBuffer();
+}
+
+bool ByteArray::destruct()
+{
+	releaseBuffer();
 	currentObjectEncoding = OBJECT_ENCODING::AMF3;
 	objectEncoding = OBJECT_ENCODING::AMF3;
 	position = 0;
-	real_len = 0;
 	len = 0;
+	bufferSharingDisabled = false;
 	shareable = false;
 	littleEndian = false;
 	return ASObject::destruct();
@@ -86,14 +165,68 @@ bool ByteArray::destruct()
 
 void ByteArray::finalize()
 {
-	if(bytes)
+	releaseBuffer();
+}
+
+void ByteArray::releaseBuffer()
+{
+	if(storage)
 	{
 #ifdef MEMORY_USAGE_PROFILING
 		getClass()->memoryAccount->removeBytes(real_len);
 #endif
-		delete[] bytes;
-		bytes = nullptr;
+		storage->decRef();
+		storage = nullptr;
+	}
+	bytes = nullptr;
+	real_len = 0;
+}
+
+void ByteArray::reallocateBuffer(uint32_t newcapacity)
+{
+	if (storage->isLastRef())
+	{
+		assert_and_throw(storage->resize(newcapacity));
+	}
+	else
+	{
+		// the buffer is shared with other ByteArrays, so we have to use our own copy
+		ByteArrayStorage* s = ByteArrayStorage::create(newcapacity);
+		assert_and_throw(s);
+		memcpy(s->data,bytes,min(len,newcapacity));
+		storage->decRef();
+		storage = s;
 	}
+#ifdef MEMORY_USAGE_PROFILING
+	getClass()->memoryAccount->addBytes(newcapacity-real_len);
+#endif
+	bytes = storage->data;
+	real_len = newcapacity;
+}
+
+bool ByteArray::shareBuffer(ByteArray* source)
+{
+	// shareable ByteArrays are accessed from multiple workers, so they always keep their own buffer
+	if (source == this || source->storage == nullptr
+		|| shareable || source->shareable
+		|| bufferSharingDisabled || source->bufferSharingDisabled)
+		return false;
+	releaseBuffer();
+	source->storage->incRef();
+	storage = source->storage;
+	bytes = source->bytes;
+	real_len = source->real_len;
+	len = source->len;
+#ifdef MEMORY_USAGE_PROFILING
+	getClass()->memoryAccount->addBytes(real_len);
+#endif
+	return true;
+}
+
+void ByteArray::disableBufferSharing()
+{
+	bufferSharingDisabled = true;
+	unshareBuffer();
 }
 
 void ByteArray::sinit(Class_base* c)
@@ -164,14 +297,15 @@ uint8_t* ByteArray::getBufferIntern(unsigned int size, bool enableResize)
 		return nullptr;
 	}
 	// The first allocation is exactly the size we need,
-	// the subsequent reallocations happen in increments of BA_CHUNK_SIZE bytes
+	// the subsequent reallocations grow the buffer geometrically, so appending data takes amortized constant time
 	uint32_t prevLen = len;
-	if(bytes==nullptr)
+	if(storage==nullptr)
 	{
 		len=size;
+		storage = ByteArrayStorage::create(len);
+		assert_and_throw(storage);
+		bytes = storage->data;
 		real_len=len;
-		bytes = new uint8_t[len];
-		memset(bytes,0,len);
 #ifdef MEMORY_USAGE_PROFILING
 		getClass()->memoryAccount->addBytes(len);
 #endif
@@ -179,31 +313,24 @@ uint8_t* ByteArray::getBufferIntern(unsigned int size, bool enableResize)
 	else if(enableResize==false)
 	{
 		assert_and_throw(size<=len);
+		unshareBuffer();
 	}
 	else if(real_len<size) // && enableResize==true
 	{
-#ifdef MEMORY_USAGE_PROFILING
 		uint32_t prev_real_len = real_len;
-#endif
-		while(real_len < size)
-			real_len += BA_CHUNK_SIZE;
-		// Reallocate the buffer, in chunks of BA_CHUNK_SIZE bytes
-		uint8_t* bytes2 = new uint8_t[real_len];
-		assert_and_throw(bytes2);
-		memcpy(bytes2,bytes,prevLen);
-		delete[] bytes;
-#ifdef MEMORY_USAGE_PROFILING
-		getClass()->memoryAccount->addBytes(real_len-prev_real_len);
-#endif
-		bytes = bytes2;
-		if(prevLen<size)
-			memset(bytes+prevLen,0,real_len-prevLen);
+		uint64_t newcapacity = max(uint64_t(size),uint64_t(real_len)+real_len/2);
+		newcapacity = min(uint64_t(BA_MAX_SIZE),(newcapacity+BA_CHUNK_SIZE-1)&~uint64_t(BA_CHUNK_SIZE-1));
+		reallocateBuffer(newcapacity);
+		// the bytes added by the reallocation are already zeroed
+		if(prevLen<prev_real_len)
+			memset(bytes+prevLen,0,prev_real_len-prevLen);
 		len=size;
-		bytes=bytes2;
 	}
-	else if(len<size)
+	else
 	{
-		len=size;
+		unshareBuffer();
+		if(len<size)
+			len=size;
 	}
 	return bytes;
 }
@@ -305,17 +432,7 @@ void ByteArray::setLength(uint32_t newLen)
 		getBuffer(newLen,true);
 	}
 	else
-	{
-		if (bytes)
-		{
-#ifdef MEMORY_USAGE_PROFILING
-			getClass()->memoryAccount->removeBytes(real_len);
-#endif
-			delete[] bytes;
-		}
-		bytes = nullptr;
-		real_len = newLen;
-	}
+		releaseBuffer();
 	len = newLen;
 	if (position > len)
 		position = (len > 0 ? len : 0);
@@ -378,8 +495,12 @@ ASFUNCTIONBODY_ATOM(ByteArray,readBytes)
 		return;
 	}
 	
-	uint8_t* buf=out->getBuffer(length+offset,true);
-	memcpy(buf+offset,th->bytes+th->position,length);
+	// reading the whole array shares the buffer until one of the arrays is modified
+	if (offset != 0 || th->position != 0 || length != th->len || out->len > length || !out->shareBuffer(th))
+	{
+		uint8_t* buf=out->getBuffer(length+offset,true);
+		memcpy(buf+offset,th->bytes+th->position,length);
+	}
 	th->position+=length;
 	th->unlock();
 }
@@ -687,10 +808,14 @@ ASFUNCTIONBODY_ATOM(ByteArray,writeBytes)
 	//If the length is 0 the whole buffer must be copied
 	if(length == 0)
 		length=(out->getLength()-offset);
-	uint8_t* buf=out->getBuffer(offset+length,false);
 	th->lock();
-	th->getBuffer(th->position+length,true);
-	memcpy(th->bytes+th->position,buf+offset,length);
+	// writing a whole array into an empty one shares the buffer until one of the arrays is modified
+	if (offset != 0 || th->position != 0 || length != out->len || th->len > length || !th->shareBuffer(out))
+	{
+		th->getBuffer(th->position+length,true);
+		// out may be th, so the source pointer is fetched after resizing
+		memcpy(th->bytes+th->position,out->getBufferNoCheck()+offset,length);
+	}
 	th->position+=length;
 	th->unlock();
 }
@@ -1291,6 +1416,8 @@ multiname *ByteArray::setVariableByMultiname(multiname& name, asAtom& o, CONST_A
 		// Fill the gap between the end of the current data and the index with zeros
 		memset(bytes+prevLen, 0, index-prevLen);
 	}
+	else
+		unshareBuffer();
 	// Fill the byte pointed to by index with the truncated uint value of the object.
 	uint8_t value = static_cast<uint8_t>(asAtomHandler::toUInt(o) & 0xff);
 	bytes[index] = value;
@@ -1315,6 +1442,8 @@ void ByteArray::setVariableByInteger(int index, asAtom &o, CONST_ALLOWED_FLAG al
 		memset(bytes+prevLen, 0, index-prevLen);
 	}
 
+	else
+		unshareBuffer();
 	// Fill the byte pointed to by index with the truncated uint value of the object.
 	uint8_t value = static_cast<uint8_t>(asAtomHandler::toUInt(o) & 0xff);
 	bytes[index] = value;
@@ -1330,13 +1459,8 @@ void ByteArray::setVariableByMultiname_i(multiname& name, int32_t value, ASWorke
 
 void ByteArray::acquireBuffer(uint8_t* buf, int bufLen)
 {
-	if(bytes)
-	{
-#ifdef MEMORY_USAGE_PROFILING
-		getClass()->memoryAccount->removeBytes(real_len);
-#endif
-		delete[] bytes;
-	}
+	releaseBuffer();
+	storage = new ByteArrayStorage(buf,bufLen,ByteArrayStorage::ALLOC_NEW);
 	bytes=buf;
 	real_len=bufLen;
 	len=bufLen;
@@ -1479,6 +1603,7 @@ void ByteArray::append(uint8_t* data, int length)
 }
 void ByteArray::removeFrontBytes(int count)
 {
+	unshareBuffer();
 	if (count < (int)len)
 		memmove(bytes,bytes+count,len-count);
 	position -= count;
@@ -1487,6 +1612,207 @@ void ByteArray::removeFrontBytes(int count)
 
 
 
+namespace
+{
+// buffers of at least this size are deflated in parallel by the ThreadPool
+#define BA_PARALLEL_DEFLATE_THRESHOLD (4*1024*1024)
+// number of bytes deflated by a single job
+#define BA_DEFLATE_BLOCK_SIZE (1024*1024)
+// the last bytes of the previous block are used as dictionary, so the compression ratio is nearly the same as for a single stream
+#define BA_DEFLATE_DICTIONARY_SIZE 32768
+// maximum number of jobs added to the ThreadPool, the calling thread deflates blocks too
+#define BA_DEFLATE_MAX_JOBS 7
+
+struct DeflateBlock
+{
+	const uint8_t* data;
+	uint32_t len;
+	uint32_t dictionarylen; // number of bytes before data used as dictionary
+	bool last;
+	std::vector<uint8_t> out;
+	uLong adler;
+	bool ok;
+	void deflateBlock()
+	{
+		z_stream strm;
+		strm.zalloc=Z_NULL;
+		strm.zfree=Z_NULL;
+		strm.opaque=Z_NULL;
+		ok=false;
+		if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return;
+		if (dictionarylen)
+			deflateSetDictionary(&strm, data-dictionarylen, dictionarylen);
+		// a sync flush adds an empty stored block, so the next block starts at a byte boundary
+		out.resize(deflateBound(&strm,len)+16);
+		strm.next_in=(Bytef*)data;
+		strm.avail_in=len;
+		strm.next_out=out.data();
+		strm.avail_out=out.size();
+		int status = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if (last)
+			ok = status == Z_STREAM_END;
+		else
+			ok = status == Z_OK && strm.avail_in == 0 && strm.avail_out != 0;
+		out.resize(strm.total_out);
+		deflateEnd(&strm);
+		adler = adler32(adler32(0,Z_NULL,0),data,len);
+	}
+};
+
+// the blocks are claimed by the jobs and the calling thread, so the calling thread never waits for jobs that didn't start yet
+class DeflateBlocks: public RefCountable
+{
+private:
+	ATOMIC_INT32(nextblock);
+	ATOMIC_INT32(finishedblocks);
+public:
+	std::vector<DeflateBlock> blocks;
+	Semaphore done;
+	DeflateBlocks(uint32_t count):nextblock(0),finishedblocks(0),blocks(count),done(0) {}
+	void deflateBlocks()
+	{
+		int32_t i;
+		while ((i = ATOMIC_INCREMENT(nextblock)-1) < int32_t(blocks.size()))
+		{
+			blocks[i].deflateBlock();
+			if (ATOMIC_INCREMENT(finishedblocks) == int32_t(blocks.size()))
+				done.signal();
+		}
+	}
+};
+
+class DeflateJob: public IThreadJob
+{
+private:
+	_R<DeflateBlocks> blocks;
+public:
+	DeflateJob(_R<DeflateBlocks> b):blocks(b) {}
+	void execute() override
+	{
+		blocks->deflateBlocks();
+	}
+	void jobFence() override
+	{
+		delete this;
+	}
+};
+
+// grows a buffer used for output of unknown size, returns false if it can't grow anymore
+bool growOutput(ByteArrayStorage* out)
+{
+	if (out->capacity >= BA_MAX_SIZE)
+		return false;
+	return out->resize(min(uint64_t(BA_MAX_SIZE),uint64_t(out->capacity)*2));
+}
+
+// runs the lzma coder over the input and returns the output in a new storage, or nullptr on errors
+ByteArrayStorage* runLZMA(lzma_stream& strm, const uint8_t* data, uint32_t len, uint32_t initialsize, bool encode)
+{
+	ByteArrayStorage* out = ByteArrayStorage::create(max(initialsize,uint32_t(BA_CHUNK_SIZE)));
+	if (out == nullptr)
+	{
+		lzma_end(&strm);
+		return nullptr;
+	}
+	strm.next_in = data;
+	strm.avail_in = len;
+	while (strm.total_out < out->capacity || growOutput(out))
+	{
+		strm.next_out = out->data+strm.total_out;
+		strm.avail_out = out->capacity-strm.total_out;
+		lzma_ret ret = lzma_code(&strm, encode ? LZMA_FINISH : LZMA_RUN);
+		// the decoder accepts streams without end marker that end with the input
+		if (ret == LZMA_STREAM_END || (ret == LZMA_OK && !encode && strm.avail_in == 0 && strm.avail_out != 0))
+		{
+			lzma_end(&strm);
+			// don't keep too much unused memory
+			if (out->capacity-strm.total_out > strm.total_out/2)
+				out->resize(strm.total_out);
+			return out;
+		}
+		if (ret != LZMA_OK)
+		{
+			LOG(LOG_ERROR,"lzma coder error:"<<ret);
+			break;
+		}
+	}
+	lzma_end(&strm);
+	out->decRef();
+	return nullptr;
+}
+}
+
+void ByteArray::setStorage(ByteArrayStorage* s, uint32_t length)
+{
+	releaseBuffer();
+	storage = s;
+	bytes = s->data;
+	real_len = s->capacity;
+	len = length;
+#ifdef MEMORY_USAGE_PROFILING
+	getClass()->memoryAccount->addBytes(real_len);
+#endif
+}
+
+bool ByteArray::compress_zlib_parallel(bool raw)
+{
+	uint32_t blockcount = (len+BA_DEFLATE_BLOCK_SIZE-1)/BA_DEFLATE_BLOCK_SIZE;
+	_R<DeflateBlocks> d = _MR(new DeflateBlocks(blockcount));
+	for (uint32_t i = 0; i < blockcount; i++)
+	{
+		DeflateBlock& b = d->blocks[i];
+		b.data = bytes+i*BA_DEFLATE_BLOCK_SIZE;
+		b.len = min(uint32_t(BA_DEFLATE_BLOCK_SIZE),len-i*BA_DEFLATE_BLOCK_SIZE);
+		b.dictionarylen = min(uint32_t(BA_DEFLATE_DICTIONARY_SIZE),uint32_t(b.data-bytes));
+		b.last = i == blockcount-1;
+	}
+	uint32_t jobcount = min(blockcount-1,uint32_t(BA_DEFLATE_MAX_JOBS));
+	for (uint32_t i = 0; i < jobcount; i++)
+		getSystemState()->addJob(new DeflateJob(d));
+	d->deflateBlocks();
+	d->done.wait();
+
+	uint64_t outlen = raw ? 0 : 6; // zlib header and adler32 checksum
+	uLong adler = adler32(0,Z_NULL,0);
+	for (auto it = d->blocks.begin(); it != d->blocks.end(); it++)
+	{
+		if (!it->ok)
+			return false;
+		outlen += it->out.size();
+		adler = adler32_combine(adler,it->adler,it->len);
+	}
+	if (outlen > BA_MAX_SIZE)
+		return false;
+	ByteArrayStorage* s = ByteArrayStorage::create(outlen);
+	if (s == nullptr)
+		return false;
+	uint8_t* p = s->data;
+	if (!raw)
+	{
+		// header for the default compression level and a 32k window
+		*p++ = 0x78;
+		*p++ = 0x9c;
+	}
+	for (auto it = d->blocks.begin(); it != d->blocks.end(); it++)
+	{
+		memcpy(p,it->out.data(),it->out.size());
+		p += it->out.size();
+		// jobs that didn't start yet keep the blocks alive
+		std::vector<uint8_t>().swap(it->out);
+	}
+	if (!raw)
+	{
+		*p++ = adler>>24;
+		*p++ = adler>>16;
+		*p++ = adler>>8;
+		*p++ = adler;
+	}
+	setStorage(s,outlen);
+	position=outlen;
+	return true;
+}
+
 void ByteArray::compress_zlib(bool raw)
 {
 	z_stream strm;
@@ -1495,6 +1821,10 @@ void ByteArray::compress_zlib(bool raw)
 	if(len==0)
 		return;
 
+	// the output of the parallel compression is a valid stream, but it differs from the output of a single deflate call
+	if (len >= BA_PARALLEL_DEFLATE_THRESHOLD && compress_zlib_parallel(raw))
+		return;
+
 	strm.zalloc=Z_NULL;
 	strm.zfree=Z_NULL;
 	strm.opaque=Z_NULL;
@@ -1508,20 +1838,20 @@ void ByteArray::compress_zlib(bool raw)
 	if (status != Z_OK)
 		throw RunTimeException("zlib compress failed");
 	unsigned long buflen=compressBound(len);
-	position=0;
-	unsigned char* compressed = new unsigned char[buflen];
+	ByteArrayStorage* compressed = ByteArrayStorage::create(buflen);
+	assert_and_throw(compressed);
 	strm.avail_out = buflen;
-	strm.next_out = compressed;
+	strm.next_out = compressed->data;
 	status = deflate (&strm, Z_FINISH);
 	if (status == Z_STREAM_ERROR || strm.avail_in != 0)
 	{
-		delete[] compressed;
+		compressed->decRef();
 		throw RunTimeException("zlib compress failed");
 	}
 	deflateEnd(&strm);
 
-	acquireBuffer(compressed, buflen);
-	position=buflen;
+	setStorage(compressed, strm.total_out);
+	position=strm.total_out;
 }
 
 void ByteArray::uncompress_zlib(bool raw)
@@ -1550,36 +1880,37 @@ void ByteArray::uncompress_zlib(bool raw)
 		return;
 	}
 
-	vector<uint8_t> buf(3*len);
+	// the data is inflated directly into the new buffer, which is grown as needed
+	ByteArrayStorage* out = ByteArrayStorage::create(min(uint64_t(BA_MAX_SIZE),uint64_t(len)*3));
 	do
 	{
-		strm.next_out=&buf[strm.total_out];
-		strm.avail_out=buf.size()-strm.total_out;
+		if (out == nullptr || (strm.total_out == out->capacity && !growOutput(out)))
+		{
+			inflateEnd(&strm);
+			if (out)
+				out->decRef();
+			createError<ASError>(getInstanceWorker(),kOutOfMemoryError);
+			return;
+		}
+		strm.next_out=out->data+strm.total_out;
+		strm.avail_out=out->capacity-strm.total_out;
 		status=inflate(&strm, Z_NO_FLUSH);
 
 		if(status!=Z_OK && status!=Z_STREAM_END)
 		{
 			inflateEnd(&strm);
+			out->decRef();
 			createError<IOError>(getInstanceWorker(),kCompressedDataError);
 			return;
 		}
-
-		if(strm.avail_out==0)
-			buf.resize(buf.size()+len);
 	} while(status!=Z_STREAM_END);
 
 	inflateEnd(&strm);
 
-	len=strm.total_out;
-#ifdef MEMORY_USAGE_PROFILING
-	getClass()->memoryAccount->addBytes(len-real_len);
-#endif
-	real_len = len;
-	uint8_t* bytes2 = new uint8_t[len];
-	assert_and_throw(bytes2);
-	delete[] bytes;
-	bytes = bytes2;
-	memcpy(bytes, &buf[0], len);
+	// don't keep too much unused memory
+	if (out->capacity-strm.total_out > strm.total_out/2)
+		out->resize(strm.total_out);
+	setStorage(out, strm.total_out);
 	position=0;
 }
 void ByteArray::compress_lzma()
@@ -1596,46 +1927,15 @@ void ByteArray::compress_lzma()
 		createError<IOError>(getInstanceWorker(),kCompressedDataError);
 		return;
 	}
-	uint32_t inputlen = getLength();
-	uint32_t outputlen = BA_CHUNK_SIZE;
-	uint8_t* inbuffer = new uint8_t[inputlen];
-	memcpy(inbuffer,getBufferNoCheck(),inputlen);
-	strm.next_in = inbuffer;
-	strm.avail_in = inputlen;
-	strm.avail_out = outputlen;
-	this->setLength(outputlen);
-	strm.next_out = this->getBufferNoCheck();
-	
-	bool abort=false;
-	while (strm.avail_in!=0 && !abort)
+	// the input is read directly from the current buffer
+	ByteArrayStorage* out = runLZMA(strm,bytes,len,len/2,true);
+	if (out == nullptr)
 	{
-		do
-		{
-			lzma_ret ret=lzma_code(&strm, LZMA_FINISH);
-			
-			if(ret==LZMA_STREAM_END || strm.avail_in==0)
-				break;
-			else if(ret!=LZMA_OK)
-			{
-				LOG(LOG_ERROR,"lzma decoder error:"<<ret);
-				createError<IOError>(getInstanceWorker(),kCompressedDataError);
-				abort=true;
-				break;
-			}
-			if (strm.avail_out==0)
-			{
-				uint32_t oldlen = getLength();
-				strm.avail_out=outputlen;
-				setLength(getLength()+outputlen);
-				strm.next_out=getBufferNoCheck()+oldlen;
-			}
-		}
-		while(strm.avail_out!=0);
+		createError<IOError>(getInstanceWorker(),kCompressedDataError);
+		return;
 	}
-	this->setLength(strm.total_out);
-	lzma_end(&strm);
-	setPosition(0);
-	delete[] inbuffer;
+	setStorage(out, strm.total_out);
+	position=0;
 }
 void ByteArray::uncompress_lzma()
 {
@@ -1649,51 +1949,26 @@ void ByteArray::uncompress_lzma()
 		createError<IOError>(getInstanceWorker(),kCompressedDataError);
 		return;
 	}
-	uint32_t inputlen = getLength();
-	uint32_t outputlen = getLength();// TODO: I don't know what's the best value for chunk size, we just use the length of the input for now
-	uint8_t* inbuffer = new uint8_t[inputlen];
-	memcpy(inbuffer,getBufferNoCheck(),inputlen);
-	strm.next_in = inbuffer;
-	strm.avail_in = inputlen;
-	strm.avail_out = outputlen;
-	strm.next_out = this->getBufferNoCheck();
-	bool abort=false;
-	while (strm.avail_in!=0 && !abort)
-	{
-		do
-		{
-			lzma_ret ret=lzma_code(&strm, LZMA_RUN);
-			
-			if(ret==LZMA_STREAM_END)
-				break;
-			else if(ret!=LZMA_OK)
-			{
-				LOG(LOG_ERROR,"lzma decoder error:"<<ret);
-				createError<IOError>(getInstanceWorker(),kCompressedDataError);
-				this->setLength(inputlen);
-				memcpy(getBufferNoCheck(),inbuffer,inputlen);
-				abort=true;
-				break;
-			}
-			if (strm.avail_out==0)
-			{
-				uint32_t oldlen = getLength();
-				strm.avail_out=outputlen;
-				setLength(getLength()+outputlen);
-				strm.next_out=getBufferNoCheck()+oldlen;
-			}
-			if(strm.avail_in==0)
-				break;
-		}
-		while(strm.avail_out!=0);
+	// use the uncompressed size from the header if it is known, the header is not trusted,
+	// so the buffer is only presized up to a multiple of the input and grown as needed
+	uint32_t outputlen = len;
+	if (len >= 13)
+	{
+		uint64_t size;
+		memcpy(&size,bytes+5,8);
+		size = LS_UINT64_TO_LE(size);
+		if (size != UINT64_MAX)
+			outputlen = min(size,min(uint64_t(BA_MAX_SIZE),uint64_t(len)*16));
 	}
-	if (!abort && strm.avail_out!=0)
+	// the input is read directly from the current buffer, so it is unchanged if decoding fails
+	ByteArrayStorage* out = runLZMA(strm,bytes,len,outputlen,false);
+	if (out == nullptr)
 	{
-		this->setLength(this->getLength()-strm.avail_out);
+		createError<IOError>(getInstanceWorker(),kCompressedDataError);
+		return;
 	}
-	lzma_end(&strm);
-	setPosition(0);
-	delete[] inbuffer;
+	setStorage(out, strm.total_out);
+	position=0;
 }
 
 ASFUNCTIONBODY_ATOM(ByteArray,_compress)
@@ -1746,16 +2021,8 @@ ASFUNCTIONBODY_ATOM(ByteArray,clear)
 {
 	ByteArray* th=asAtomHandler::as<ByteArray>(obj);
 	th->lock();
-	if(th->bytes)
-	{
-#ifdef MEMORY_USAGE_PROFILING
-		th->getClass()->memoryAccount->removeBytes(th->real_len);
-#endif
-		delete[] th->bytes;
-	}
-	th->bytes = nullptr;
+	th->releaseBuffer();
 	th->len=0;
-	th->real_len=0;
 	th->position=0;
 	th->unlock();
 }
@@ -1768,6 +2035,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,pop)
 	th->lock();
 	if (th->readByte(res))
 	{
+		th->unshareBuffer();
 		memmove(th->bytes,(th->bytes+1),th->getLength()-1);
 		th->len--;
 	}
@@ -1799,6 +2067,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,shift)
 	th->lock();
 	if (th->readByte(res))
 	{
+		th->unshareBuffer();
 		memmove(th->bytes,(th->bytes+1),th->getLength()-1);
 		th->len--;
 	}
@@ -1854,6 +2123,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,atomicCompareAndSwapIntAt)
 
 	if (res == expectedValue)
 	{
+		th->unshareBuffer();
 		memcpy(th->bytes+byteindex,&newvalue,4);
 	}
 	th->unlock();
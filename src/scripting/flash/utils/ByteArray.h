@@ -27,6 +27,25 @@
 
 namespace lightspark
 {
+/*
+ * The memory holding the bytes of a ByteArray.
+ * It is shared between ByteArrays after copies of the whole buffer and copied before it is modified (see ByteArray::unshareBuffer)
+ */
+class ByteArrayStorage: public RefCountable
+{
+public:
+	enum ALLOCATION { ALLOC_NEW, ALLOC_MALLOC, ALLOC_MMAP };
+	uint8_t* data;
+	uint32_t capacity;
+	ALLOCATION allocation;
+	ByteArrayStorage(uint8_t* d, uint32_t c, ALLOCATION a):data(d),capacity(c),allocation(a) {}
+	~ByteArrayStorage();
+	// returns a zeroed storage or nullptr if the memory couldn't be allocated
+	static ByteArrayStorage* create(uint32_t capacity);
+	// changes the capacity of an unshared storage, added bytes are zeroed
+	bool resize(uint32_t newcapacity);
+};
+
 
 class DLL_PUBLIC ByteArray: public ASObject, public IDataInput, public IDataOutput
 {
@@ -43,12 +62,18 @@ protected:
 	uint8_t* bytes;
 	uint32_t real_len;
 	uint32_t len;
+	ByteArrayStorage* storage;
+	bool bufferSharingDisabled;
 	void compress_zlib(bool raw);
+	bool compress_zlib_parallel(bool raw);
 	void uncompress_zlib(bool raw);
 	void compress_lzma();
 	void uncompress_lzma();
 	Mutex mutex;
 	uint8_t* getBufferIntern(unsigned int size, bool enableResize);
+	void reallocateBuffer(uint32_t newcapacity);
+	void releaseBuffer();
+	void setStorage(ByteArrayStorage* s, uint32_t length);
 public:
 	FORCE_INLINE void lock()
 	{
@@ -224,10 +249,25 @@ public:
 		@pre buf must be allocated using new[]
 	*/
 	void acquireBuffer(uint8_t* buf, int bufLen);
+	/**
+		Use the bytes of source until one of the ByteArrays is modified
+		@return false if the buffers of the ByteArrays can't be shared
+	*/
+	bool shareBuffer(ByteArray* source);
+	// has to be called before the buffer is modified without using getBuffer()
+	FORCE_INLINE void unshareBuffer()
+	{
+		if (storage && !storage->isLastRef())
+			reallocateBuffer(real_len);
+	}
+	// used for domain memory, as it is modified without calling unshareBuffer()
+	void disableBufferSharing();
 	inline uint8_t* getBufferNoCheck() const { return bytes; }
+	// for reading only, a shared buffer is not copied
+	inline const uint8_t* getReadBuffer() const { return bytes; }
 	inline uint8_t* getBuffer(unsigned int size, bool enableResize)
 	{
-		if (size <= real_len && size > 0)
+		if (size <= real_len && size > 0 && storage->isLastRef())
 		{
 			if(len<size)
 			{
@@ -33,30 +33,119 @@
 using namespace std;
 using namespace lightspark;
 
-ASString::ASString(ASWorker* wrk,Class_base* c):ASObject(wrk,c,T_STRING),hasId(true),datafilled(true)
+ASString::ASString(ASWorker* wrk,Class_base* c):ASObject(wrk,c,T_STRING),hasId(true),datafilled(true),ropeleft(nullptr),ropenumbytes(0),ropenumchars(0)
 {
 	stringId = BUILTIN_STRINGS::EMPTY;
 }
 
-ASString::ASString(ASWorker* wrk,Class_base* c,const string& s) : ASObject(wrk,c,T_STRING),data(s),hasId(false),datafilled(true)
+ASString::ASString(ASWorker* wrk,Class_base* c,const string& s) : ASObject(wrk,c,T_STRING),data(s),hasId(false),datafilled(true),ropeleft(nullptr),ropenumbytes(0),ropenumchars(0)
 {
 }
 
-ASString::ASString(ASWorker* wrk,Class_base* c,const tiny_string& s) : ASObject(wrk,c,T_STRING),data(s),hasId(false),datafilled(true)
+ASString::ASString(ASWorker* wrk,Class_base* c,const tiny_string& s) : ASObject(wrk,c,T_STRING),data(s),hasId(false),datafilled(true),ropeleft(nullptr),ropenumbytes(0),ropenumchars(0)
 {
 }
 
-ASString::ASString(ASWorker* wrk,Class_base* c,const char* s) : ASObject(wrk,c,T_STRING),data(s, /*copy:*/true),hasId(false),datafilled(true)
+ASString::ASString(ASWorker* wrk,Class_base* c,const char* s) : ASObject(wrk,c,T_STRING),data(s, /*copy:*/true),hasId(false),datafilled(true),ropeleft(nullptr),ropenumbytes(0),ropenumchars(0)
 {
 }
 
-ASString::ASString(ASWorker* wrk,Class_base* c,const char* s, uint32_t len) : ASObject(wrk,c,T_STRING)
+ASString::ASString(ASWorker* wrk,Class_base* c,const char* s, uint32_t len) : ASObject(wrk,c,T_STRING),ropeleft(nullptr),ropenumbytes(0),ropenumchars(0)
 {
 	data = std::string(s,len);
 	hasId = false;
 	datafilled=true;
 }
 
+void ASString::flattenRope()
+{
+	// collect the right parts, the last node of the chain contains the beginning of the string
+	std::vector<tiny_string> parts;
+	parts.push_back(data);
+	ASString* first = ropeleft;
+	while (first->ropeleft)
+	{
+		parts.push_back(first->data);
+		first = first->ropeleft;
+	}
+	tiny_string res = first->getData();
+	// release the chain before appending, so the buffer of the first part can be reused if no one else references it
+	releaseRope();
+	res.reserve(ropenumbytes);
+	for (auto it = parts.rbegin(); it != parts.rend(); it++)
+		res += *it;
+	data = res;
+	charpositions.clear();
+}
+
+void ASString::releaseRope()
+{
+	// release the chain iteratively to avoid deep recursion in destruct()
+	ASString* l = ropeleft;
+	ropeleft = nullptr;
+	while (l)
+	{
+		ASString* next = nullptr;
+		if (l->isLastRef())
+		{
+			next = l->ropeleft;
+			l->ropeleft = nullptr;
+		}
+		l->decRef();
+		l = next;
+	}
+}
+
+void ASString::buildCharIndex()
+{
+	const tiny_string& d = getData();
+	charpositions.reserve(d.numChars()/ASSTRING_CHARINDEX_STEP+1);
+	uint32_t i = 0;
+	for (auto it = d.begin(); it != d.end(); it++,i++)
+	{
+		if (i%ASSTRING_CHARINDEX_STEP == 0)
+			charpositions.push_back(it.ptr()-d.raw_buf());
+	}
+}
+
+ASObject* ASString::concatenate(ASWorker* wrk, asAtom& left, asAtom& right)
+{
+	if (!asAtomHandler::isString(left) || asAtomHandler::isStringID(left))
+		return nullptr;
+	ASString* l = asAtomHandler::getObjectNoCheck(left)->as<ASString>();
+	if (l->getNumBytes() < ASSTRING_ROPE_MIN_BYTES)
+		return nullptr;
+	tiny_string r = asAtomHandler::toString(right,wrk);
+	if (r.empty())
+		return nullptr;
+	ASString* ret = Class<ASString>::getInstanceSNoArgs(wrk);
+	l->incRef();
+	ret->ropeleft = l;
+	ret->ropenumbytes = l->getNumBytes()+r.numBytes();
+	ret->ropenumchars = l->getNumChars()+r.numChars();
+	ret->data = r;
+	ret->stringId = UINT32_MAX;
+	ret->hasId = false;
+	ret->datafilled = true;
+	return ret;
+}
+
+ASObject* ASString::getSubstring(ASWorker* wrk, uint32_t start, uint32_t end)
+{
+	uint32_t startpos = getBytePosition(start);
+	// substrings reaching the end of the string may share the buffer
+	return abstract_s(wrk,getData().substr_bytes(startpos,getBytePosition(end)-startpos));
+}
+
+void ASString::prepareShutdown()
+{
+	if (preparedforshutdown)
+		return;
+	ASObject::prepareShutdown();
+	if (ropeleft)
+		flattenRope();
+}
+
 ASFUNCTIONBODY_ATOM(ASString,_constructor)
 {
 	ASString* th=asAtomHandler::as<ASString>(obj);
@@ -79,7 +168,7 @@ ASFUNCTIONBODY_ATOM(ASString,_getLength)
 	else if (asAtomHandler::isString(obj))
 	{
 		ASString* th = asAtomHandler::getObjectNoCheck(obj)->as<ASString>();
-		asAtomHandler::setInt(ret,int32_t(th->getData().numChars()));
+		asAtomHandler::setInt(ret,int32_t(th->getNumChars()));
 	}
 	else
 	{
@@ -456,7 +545,7 @@ ASFUNCTIONBODY_ATOM(ASString,substr)
 	if (asAtomHandler::isStringID(obj))
 		numchars = wrk->getSystemState()->getStringFromUniqueId(asAtomHandler::getStringId(obj)).numChars();
 	else if (asAtomHandler::is<ASString>(obj))
-		numchars = asAtomHandler::as<ASString>(obj)->getData().numChars();
+		numchars = asAtomHandler::as<ASString>(obj)->getNumChars();
 	else
 		numchars = asAtomHandler::toString(obj,wrk).numChars();
 	if(start<0) {
@@ -489,7 +578,7 @@ ASFUNCTIONBODY_ATOM(ASString,substr)
 	else if (asAtomHandler::is<ASString>(obj))
 	{
 		ASString* th = asAtomHandler::as<ASString>(obj);
-		ret = asAtomHandler::fromObject(abstract_s(wrk,th->data.substr_bytes(th->getBytePosition(start),start+len >= numchars ? UINT32_MAX  : (th->getBytePosition(start+len)-th->getBytePosition(start)))));
+		ret = asAtomHandler::fromObject(th->getSubstring(wrk,start,len >= numchars-start ? numchars : start+len));
 	}
 	else
 		ret = asAtomHandler::fromObject(abstract_s(wrk,asAtomHandler::toString(obj,wrk).substr(start,len)));
@@ -517,7 +606,10 @@ ASFUNCTIONBODY_ATOM(ASString,substring)
 		end=tmp;
 	}
 
-	ret = asAtomHandler::fromObject(abstract_s(wrk,data.substr(start,end-start)));
+	if (asAtomHandler::isString(obj) && !asAtomHandler::isStringID(obj))
+		ret = asAtomHandler::fromObject(asAtomHandler::as<ASString>(obj)->getSubstring(wrk,start,end));
+	else
+		ret = asAtomHandler::fromObject(abstract_s(wrk,data.substr(start,end-start)));
 }
 
 number_t ASString::toNumber()
@@ -752,7 +844,9 @@ void ASString::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 string ASString::toDebugString() const
 {
 	tiny_string ret;
-	if (!datafilled && hasId)
+	if (ropeleft)
+		ret = std::string("\"...") + std::string(data) + "\"_rope";
+	else if (!datafilled && hasId)
 		ret = std::string("\"") + std::string(getSystemState()->getStringFromUniqueId(stringId)) + "\"_id";
 	else
 		ret = std::string("\"") + std::string(data) + "\"";
@@ -793,7 +887,9 @@ ASFUNCTIONBODY_ATOM(ASString,slice)
 		ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
 	else
 	{
-		if (data.isSinglebyte()) // fast path for ascii strings to avoid unneccessary buffer copying
+		if (asAtomHandler::isString(obj) && !asAtomHandler::isStringID(obj))
+			ret = asAtomHandler::fromObject(asAtomHandler::as<ASString>(obj)->getSubstring(wrk,startIndex,endIndex));
+		else if (data.isSinglebyte()) // fast path for ascii strings to avoid unneccessary buffer copying
 			ret = asAtomHandler::fromObject(abstract_s(wrk,data.raw_buf()+startIndex,endIndex-startIndex,endIndex-startIndex,data.isSinglebyte(),data.hasNullEntries(),data.isIntegerValue()));
 		else
 			ret = asAtomHandler::fromObject(abstract_s(wrk,data.substr(startIndex,endIndex-startIndex)));
@@ -22,6 +22,10 @@
 
 #include "scripting/class.h"
 
+// strings with at least this number of bytes are concatenated lazily
+#define ASSTRING_ROPE_MIN_BYTES 256
+// number of characters between two entries of the character index
+#define ASSTRING_CHARINDEX_STEP 64
 
 namespace lightspark
 {
@@ -41,9 +45,16 @@ private:
 	static number_t parseStringInfinite(const char *s, char **end);
 	tiny_string data;
 	
-	// stores the position of utf8-characters in the string
+	// stores the byte position of every ASSTRING_CHARINDEX_STEP'th utf8-character in the string
 	// speeds up direct access to characters by position
 	std::vector<uint32_t> charpositions;
+	// left part of a string created by concatenation, 'data' only contains the right part until the string is flattened
+	ASString* ropeleft;
+	uint32_t ropenumbytes;
+	uint32_t ropenumchars;
+	void flattenRope();
+	void releaseRope();
+	void buildCharIndex();
 public:
 	ASString(ASWorker* wrk,Class_base* c);
 	ASString(ASWorker* wrk,Class_base* c, const std::string& s);
@@ -54,7 +65,9 @@ public:
 	bool datafilled:1;
 	FORCE_INLINE tiny_string& getData()
 	{
-		if (!datafilled)
+		if (ropeleft)
+			flattenRope();
+		else if (!datafilled)
 		{
 			data = getSystemState()->getStringFromUniqueId(stringId);
 			datafilled = true;
@@ -63,10 +76,26 @@ public:
 	}
 	FORCE_INLINE bool isEmpty() const
 	{
+		if (ropeleft)
+			return false;
 		if (hasId)
 			return stringId == BUILTIN_STRINGS::EMPTY || stringId == UINT32_MAX;
 		return data.empty();
 	}
+	// these don't flatten concatenated strings
+	FORCE_INLINE uint32_t getNumBytes()
+	{
+		return ropeleft ? ropenumbytes : getData().numBytes();
+	}
+	FORCE_INLINE uint32_t getNumChars()
+	{
+		return ropeleft ? ropenumchars : getData().numChars();
+	}
+	// returns a concatenated string that references the left string instead of copying it,
+	// or nullptr if the strings are better concatenated directly
+	static ASObject* concatenate(ASWorker* wrk, asAtom& left, asAtom& right);
+	// returns the substring between the character positions start and end
+	ASObject* getSubstring(ASWorker* wrk, uint32_t start, uint32_t end);
 
 	static void sinit(Class_base* c);
 	ASFUNCTION_ATOM(_constructor);
@@ -107,8 +136,11 @@ public:
 	std::string toDebugString() const override;
 	static bool isEcmaSpace(uint32_t c);
 	static bool isEcmaLineTerminator(uint32_t c);
+	void prepareShutdown() override;
 	inline bool destruct() override
 	{
+		if (ropeleft)
+			releaseRope();
 		data.clear(); 
 		hasId = false;
 		datafilled=false; 
@@ -124,20 +156,19 @@ public:
 	}
 	inline uint32_t getBytePosition(uint32_t charpos)
 	{
-		if (charpos > data.numChars())
+		const tiny_string& d = getData();
+		if (charpos > d.numChars())
 			return UINT32_MAX;
-		if (data.isSinglebyte())
+		if (d.isSinglebyte())
 			return charpos;
+		if (charpos == d.numChars())
+			return d.numBytes();
 		if (charpositions.empty())
-		{
-			charpositions.reserve(this->data.numChars());
-			for (auto it = data.begin(); it != data.end(); it++)
-			{
-				charpositions.push_back(it.ptr()-data.raw_buf());
-			}
-		}
-		return charpositions[charpos];
-		
+			buildCharIndex();
+		CharIterator it((char*)d.raw_buf()+charpositions[charpos/ASSTRING_CHARINDEX_STEP]);
+		for (uint32_t i = charpos%ASSTRING_CHARINDEX_STEP; i > 0; i--)
+			++it;
+		return it.ptr()-d.raw_buf();
 	}
 };
 
@@ -1059,26 +1059,52 @@ ASFUNCTIONBODY_ATOM(Array,_pop)
 }
 
 
-number_t Array::sortComparatorDefault::compare(const sort_value& d1, const sort_value& d2)
-{
-	asAtom o1 = d1.dataAtom;
-	asAtom o2 = d2.dataAtom;
-	if(isNumeric
-		&& (wrk->needsActionScript3() ||
-			(asAtomHandler::isNumeric(o1) && asAtomHandler::isNumeric(o2) )))
+void Array::sortComparatorDefault::extractKeys(std::vector<sort_value>& values)
+{
+	compareNumeric = isNumeric && wrk->needsActionScript3();
+	keys.resize(values.size());
+	bool allnumeric=true;
+	for (uint32_t i = 0; i < values.size(); i++)
+	{
+		asAtom o = values[i].dataAtom;
+		sort_key& k = keys[i];
+		values[i].keyindex=i;
+		k.isnumeric = asAtomHandler::isNumeric(o);
+		k.isundefined = asAtomHandler::isUndefined(o);
+		allnumeric &= k.isnumeric;
+		if (isNumeric && (compareNumeric || k.isnumeric))
+		{
+			if (useoldversion)
+				k.num=asAtomHandler::toInt(o) & 0x1fffffff;
+			else
+				k.num=asAtomHandler::toNumber(o);
+		}
+	}
+	if (compareNumeric || (isNumeric && allnumeric))
+		return;
+	//Comparison is always in lexicographic order
+	for (uint32_t i = 0; i < values.size(); i++)
 	{
-		number_t a=numeric_limits<double>::quiet_NaN();
-		number_t b=numeric_limits<double>::quiet_NaN();
-		if (useoldversion)
+		asAtom o = values[i].dataAtom;
+		sort_key& k = keys[i];
+		if (wrk->needsActionScript3())
 		{
-			a=asAtomHandler::toInt(o1) & 0x1fffffff;
-			b=asAtomHandler::toInt(o2) & 0x1fffffff;
+			if (!k.isundefined)
+				k.str=asAtomHandler::toString(o,wrk);
 		}
 		else
-		{
-			a=asAtomHandler::toNumber(o1);
-			b=asAtomHandler::toNumber(o2);
-		}
+			k.str=asAtomHandler::AVM1toString(o,wrk);
+	}
+}
+
+number_t Array::sortComparatorDefault::compare(const sort_value& d1, const sort_value& d2)
+{
+	sort_key& k1 = keys[d1.keyindex];
+	sort_key& k2 = keys[d2.keyindex];
+	if(isNumeric && (compareNumeric || (k1.isnumeric && k2.isnumeric)))
+	{
+		number_t a=k1.num;
+		number_t b=k2.num;
 		// nan entries are always put at the end
 		if (std::isnan(a))
 			return isDescending?-1:1;
@@ -1091,37 +1117,27 @@ number_t Array::sortComparatorDefault::compare(const sort_value& d1, const sort_
 	}
 	else
 	{
-		//Comparison is always in lexicographic order
-		tiny_string s1;
-		tiny_string s2;
+		// undefined entries are always put at the end
 		if (wrk->needsActionScript3())
 		{
-			// undefined entries are always put at the end
-			if (asAtomHandler::isUndefined(o1))
+			if (k1.isundefined)
 				return 1;
-			if (asAtomHandler::isUndefined(o2))
+			if (k2.isundefined)
 				return -1;
-			s1=asAtomHandler::toString(o1,wrk);
-			s2=asAtomHandler::toString(o2,wrk);
-		}
-		else
-		{
-			s1=asAtomHandler::AVM1toString(o1,wrk);
-			s2=asAtomHandler::AVM1toString(o2,wrk);
 		}
 		if(isDescending)
 		{
 			if(isCaseInsensitive)
-				return -s1.strcasecmp(s2);
+				return -k1.str.strcasecmp(k2.str);
 			else
-				return -s1.strcmp(s2);
+				return -k1.str.strcmp(k2.str);
 		}
 		else
 		{
 			if(isCaseInsensitive)
-				return s1.strcasecmp(s2);
+				return k1.str.strcasecmp(k2.str);
 			else
-				return s1.strcmp(s2);
+				return k1.str.strcmp(k2.str);
 		}
 	}
 }
@@ -1130,7 +1146,9 @@ number_t Array::sortComparatorDefault::compare(const sort_value& d1, const sort_
 
 // this is the quicksort algorithm used by avmplus
 // see https://github.com/adobe-flash/avmplus/blob/master/core/ArrayClass.cpp
-void qsort(std::vector<sort_value>& v, Array::ISortComparator& comp, uint32_t lo, uint32_t hi)
+// it is kept (instead of a stable sort) to get the same order of equal elements as flash
+template<class T>
+void qsort(std::vector<sort_value>& v, T& comp, uint32_t lo, uint32_t hi)
 {
 	// This is an iterative implementation of the recursive quick sort.
 	// Recursive implementations are basically storing nested (lo,hi) pairs
@@ -1605,48 +1623,66 @@ ASFUNCTIONBODY_ATOM(Array,_sort)
 	else
 	{
 		sortComparatorDefault c(wrk,wrk->getSystemState()->getSwfVersion() < 11, isNumeric,isCaseInsensitive,isDescending);
+		c.extractKeys(tmp);
 		qsort(tmp,c,0,tmp.size()-1);
 	}
 	th->fillSortedArray(ret,tmp,isUniqueSort,returnIndexedArray,isCaseInsensitive,hasDuplicates);
 }
 
+void Array::sortOnComparator::extractKeys(std::vector<sort_value>& values)
+{
+	const uint32_t fieldcount = fields.size();
+	keys.resize(values.size()*fieldcount);
+	for (uint32_t f = 0; f < fieldcount; f++)
+	{
+		bool allnumeric=true;
+		for (uint32_t i = 0; i < values.size(); i++)
+		{
+			asAtom o = values[i].sortvalues.at(f);
+			sort_key& k = keys[i*fieldcount+f];
+			values[i].keyindex=i;
+			k.isnumeric = asAtomHandler::isNumeric(o);
+			allnumeric &= k.isnumeric;
+			if (k.isnumeric)
+				k.num=asAtomHandler::toNumber(o);
+		}
+		if (fields[f].isNumeric && allnumeric)
+			continue;
+		//Comparison is always in lexicographic order
+		for (uint32_t i = 0; i < values.size(); i++)
+			keys[i*fieldcount+f].str=asAtomHandler::toString(values[i].sortvalues.at(f),wrk);
+	}
+}
+
 number_t Array::sortOnComparator::compare(const sort_value& d1, const sort_value& d2)
 {
-	std::vector<sorton_field>::iterator it=fields.begin();
-	uint32_t i = 0;
-	for(;it != fields.end();++it)
+	const uint32_t fieldcount = fields.size();
+	sort_key* k1 = &keys[d1.keyindex*fieldcount];
+	sort_key* k2 = &keys[d2.keyindex*fieldcount];
+	for(uint32_t i = 0; i < fieldcount; i++,k1++,k2++)
 	{
-		asAtom obj1 = d1.sortvalues.at(i);
-		asAtom obj2 = d2.sortvalues.at(i);
-		i++;
-		if (it->isNumeric && asAtomHandler::isNumeric(obj1) && asAtomHandler::isNumeric(obj2))
+		const sorton_field& field = fields[i];
+		if (field.isNumeric && k1->isnumeric && k2->isnumeric)
 		{
-			number_t a=numeric_limits<double>::quiet_NaN();
-			number_t b=numeric_limits<double>::quiet_NaN();
-			a=asAtomHandler::toNumber(obj1);
-			b=asAtomHandler::toNumber(obj2);
+			number_t a=k1->num;
+			number_t b=k2->num;
 			if (a != b)
-				return it->isDescending ? b-a : a-b;
+				return field.isDescending ? b-a : a-b;
 		}
 		else
 		{
-			//Comparison is always in lexicographic order
-			tiny_string s1;
-			tiny_string s2;
-			s1=asAtomHandler::toString(obj1,wrk);
-			s2=asAtomHandler::toString(obj2,wrk);
-			if(it->isCaseInsensitive)
+			if(field.isCaseInsensitive)
 			{
-				int n = s1.strcasecmp(s2);
+				int n = k1->str.strcasecmp(k2->str);
 				if (n != 0)
-					return it->isDescending ? -n : n;
+					return field.isDescending ? -n : n;
 			}
 			else
 			{
-				if (s1 != s2)
+				if (k1->str != k2->str)
 				{
-					int n = s1<s2 ? -1 : 1;
-					return it->isDescending ? -n : n;
+					int n = k1->str<k2->str ? -1 : 1;
+					return field.isDescending ? -n : n;
 				}
 			}
 		}
@@ -1758,6 +1794,7 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 	std::vector<sort_value> tmp;
 	th->fillUnsortedArray(tmp,sortfields);
 	sortOnComparator c(sortfields,wrk);
+	c.extractKeys(tmp);
 	qsort(tmp,c,0,tmp.size()-1);
 	th->fillSortedArray(ret,tmp,isUniqueSort,returnIndexedArray,false,c.hasduplicates);
 }
@@ -46,8 +46,18 @@ struct sort_value
 	std::vector<asAtom> sortvalues;
 	asAtom dataAtom;
 	int originalindex;
+	uint32_t keyindex;
 	bool fromprototype;
-	sort_value(asAtom _dataAtom,int _originalindex,bool _fromprototype):dataAtom(_dataAtom),originalindex(_originalindex),fromprototype(_fromprototype) {}
+	sort_value(asAtom _dataAtom,int _originalindex,bool _fromprototype):dataAtom(_dataAtom),originalindex(_originalindex),keyindex(0),fromprototype(_fromprototype) {}
+};
+// sort key extracted once per value before sorting, so comparisons don't have to convert the atoms again
+struct sort_key
+{
+	tiny_string str;
+	number_t num;
+	bool isnumeric;
+	bool isundefined;
+	sort_key():num(0),isnumeric(false),isundefined(false) {}
 };
 
 class Array: public ASObject
@@ -78,12 +88,14 @@ public:
 		virtual number_t compare(const sort_value& d1, const sort_value& d2)=0;
 		bool hasduplicates;
 	};
-	class sortOnComparator : public ISortComparator
+	class sortOnComparator final : public ISortComparator
 	{
 	private:
 		std::vector<sorton_field> fields;
+		std::vector<sort_key> keys;
 	public:
 		sortOnComparator(const std::vector<sorton_field>& sf,ASWorker* _wrk):ISortComparator(),fields(sf),wrk(_wrk){}
+		void extractKeys(std::vector<sort_value>& values);
 		number_t compare(const sort_value& d1, const sort_value& d2) override;
 		ASWorker* wrk;
 
@@ -96,16 +108,19 @@ public:
 		sortComparatorWrapper(asAtom c):ISortComparator(),comparator(c){}
 		number_t compare(const sort_value& d1, const sort_value& d2) override;
 	};
-	class sortComparatorDefault : public ISortComparator
+	class sortComparatorDefault final : public ISortComparator
 	{
 		private:
 		ASWorker* wrk;
+		std::vector<sort_key> keys;
 		bool isNumeric;
 		bool isCaseInsensitive;
 		bool isDescending;
 		bool useoldversion;
+		bool compareNumeric;
 		public:
-		sortComparatorDefault(ASWorker* _wrk, bool oldversion, bool n, bool ci, bool d):wrk(_wrk),isNumeric(n),isCaseInsensitive(ci),isDescending(d),useoldversion(oldversion){}
+		sortComparatorDefault(ASWorker* _wrk, bool oldversion, bool n, bool ci, bool d):wrk(_wrk),isNumeric(n),isCaseInsensitive(ci),isDescending(d),useoldversion(oldversion),compareNumeric(false){}
+		void extractKeys(std::vector<sort_value>& values);
 		number_t compare(const sort_value& d1, const sort_value& d2) override;
 	};
 	static bool isIntegerWithoutLeadingZeros(const tiny_string& value);
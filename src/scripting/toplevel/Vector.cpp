@@ -1007,21 +1007,37 @@ ASFUNCTIONBODY_ATOM(Vector,indexOf)
 	}
 	asAtomHandler::setInt(ret,res);
 }
-bool Vector::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d2)
+void Vector::sortComparatorDefault::extractKeys(const std::vector<asAtom>& values, ASWorker* wrk)
 {
-	asAtom o1 = d1;
-	asAtom o2 = d2;
 	if(isNumeric)
 	{
-		number_t a=asAtomHandler::toNumber(o1);
-
-		number_t b=asAtomHandler::toNumber(o2);
-		if (a==b || (std::isnan(a) && std::isnan(b)))
-			src->hasDuplicates=true;
+		numbers.resize(values.size());
+		for (uint32_t i = 0; i < values.size(); i++)
+		{
+			asAtom o = values[i];
+			numbers[i]=asAtomHandler::toNumber(o);
+		}
+	}
+	else
+	{
+		strings.resize(values.size());
+		for (uint32_t i = 0; i < values.size(); i++)
+		{
+			asAtom o = values[i];
+			strings[i]=asAtomHandler::toString(o,wrk);
+		}
+	}
+}
+bool Vector::sortComparatorDefault::isLess(uint32_t i1, uint32_t i2)
+{
+	if(isNumeric)
+	{
+		number_t a=numbers[i1];
+		number_t b=numbers[i2];
 
 		// nan entries are always put at the end
 		if (std::isnan(a))
-			return isDescending;
+			return isDescending && !std::isnan(b);
 		if (std::isnan(b))
 			return !isDescending;
 
@@ -1033,16 +1049,11 @@ bool Vector::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d
 	else
 	{
 		//Comparison is always in lexicographic order
-		tiny_string s1 = asAtomHandler::toString(o1,getWorker());
-		tiny_string s2 = asAtomHandler::toString(o2,getWorker());
-		if(isCaseInsensitive && s1.strcasecmp(s2)==0)
-			src->hasDuplicates=true;
-		else if (s1==s2)
-			src->hasDuplicates=true;
-
+		//TODO: unicode support
+		tiny_string& s1 = strings[i1];
+		tiny_string& s2 = strings[i2];
 		if(isDescending)
 		{
-			//TODO: unicode support
 			if(isCaseInsensitive)
 				return s1.strcasecmp(s2)>0;
 			else
@@ -1050,7 +1061,6 @@ bool Vector::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d
 		}
 		else
 		{
-			//TODO: unicode support
 			if(isCaseInsensitive)
 				return s1.strcasecmp(s2)<0;
 			else
@@ -1058,6 +1068,18 @@ bool Vector::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d
 		}
 	}
 }
+bool Vector::sortComparatorDefault::isEqual(uint32_t i1, uint32_t i2)
+{
+	if(isNumeric)
+	{
+		number_t a=numbers[i1];
+		number_t b=numbers[i2];
+		return a==b || (std::isnan(a) && std::isnan(b));
+	}
+	if(isCaseInsensitive)
+		return strings[i1].strcasecmp(strings[i2])==0;
+	return strings[i1]==strings[i2];
+}
 number_t Vector::sortComparatorWrapper::compare(const asAtom& d1, const asAtom& d2)
 {
 	asAtom objs[2];
@@ -1291,9 +1313,25 @@ ASFUNCTIONBODY_ATOM(Vector,_sort)
 		}
 		else
 		{
-			sort(tmp.begin(),tmp.end(),sortComparatorDefault(isNumeric,isCaseInsensitive,isDescending,th));
-			if (uniquesort && th->hasDuplicates)
-				dosort = false; // don't really sort the vector if it has duplicates
+			sortComparatorDefault c(isNumeric,isCaseInsensitive,isDescending);
+			c.extractKeys(tmp,wrk);
+			std::vector<uint32_t> order(tmp.size());
+			for (uint32_t i = 0; i < order.size(); i++)
+				order[i]=i;
+			std::stable_sort(order.begin(),order.end(),[&c](uint32_t i1, uint32_t i2) { return c.isLess(i1,i2); });
+			// equal values are adjacent after sorting
+			for (uint32_t i = 1; uniquesort && i < order.size(); i++)
+			{
+				if (c.isEqual(order[i-1],order[i]))
+				{
+					dosort = false; // don't really sort the vector if it has duplicates
+					break;
+				}
+			}
+			std::vector<asAtom> sorted(tmp.size());
+			for (uint32_t i = 0; i < order.size(); i++)
+				sorted[i]=tmp[order[i]];
+			tmp.swap(sorted);
 		}
 		th->hasDuplicates=false;
 	}
@@ -274,16 +274,20 @@ class Vector: public ASObject
 	bool hasDuplicates;
 	std::vector<asAtom, reporter_allocator<asAtom>> vec;
 	int capIndex(int i) const;
+	// compares indexes into the sort keys, which are extracted once from the values before sorting
 	class sortComparatorDefault
 	{
 	private:
+		std::vector<number_t> numbers;
+		std::vector<tiny_string> strings;
 		bool isNumeric;
 		bool isCaseInsensitive;
 		bool isDescending;
-		Vector* src;
 	public:
-		sortComparatorDefault(bool n, bool ci, bool d,Vector* s):isNumeric(n),isCaseInsensitive(ci),isDescending(d),src(s){}
-		bool operator()(const asAtom& d1, const asAtom& d2);
+		sortComparatorDefault(bool n, bool ci, bool d):isNumeric(n),isCaseInsensitive(ci),isDescending(d){}
+		void extractKeys(const std::vector<asAtom>& values, ASWorker* wrk);
+		bool isLess(uint32_t i1, uint32_t i2);
+		bool isEqual(uint32_t i1, uint32_t i2);
 	};
 	asAtom getDefaultValue();
 public:
@@ -380,6 +384,10 @@ public:
 	{
 		return vec.at(index);
 	}
+	const asAtom* getBufferNoCheck() const
+	{
+		return vec.data();
+	}
 	bool ensureLength(uint32_t len);
 	void set(uint32_t index, asAtom v)
 	{
@@ -47,16 +47,16 @@ void setDefaultXMLSettings(SystemState* sys)
 	sys->static_XML_prettyPrinting = true;
 }
 
-XML::XML(ASWorker* wrk,Class_base* c):ASObject(wrk,c,T_OBJECT,SUBTYPE_XML),parentNode(nullptr),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenameID(BUILTIN_STRINGS::EMPTY),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false)
+XML::XML(ASWorker* wrk,Class_base* c):ASObject(wrk,c,T_OBJECT,SUBTYPE_XML),parentNode(nullptr),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenameID(BUILTIN_STRINGS::EMPTY),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false),childrenpending(false),attributespending(false)
 {
 }
 
-XML::XML(ASWorker* wrk,Class_base* c, const std::string &str):ASObject(wrk,c,T_OBJECT,SUBTYPE_XML),parentNode(nullptr),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenameID(BUILTIN_STRINGS::EMPTY),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false)
+XML::XML(ASWorker* wrk,Class_base* c, const std::string &str):ASObject(wrk,c,T_OBJECT,SUBTYPE_XML),parentNode(nullptr),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenameID(BUILTIN_STRINGS::EMPTY),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false),childrenpending(false),attributespending(false)
 {
-	createTree(buildFromString(str, getParseMode()),false);
+	createTreeFromString(str);
 }
 
-XML::XML(ASWorker* wrk,Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList):ASObject(wrk,c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenameID(BUILTIN_STRINGS::EMPTY),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false)
+XML::XML(ASWorker* wrk,Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList):ASObject(wrk,c,T_OBJECT,SUBTYPE_XML),parentNode(0),nodetype((pugi::xml_node_type)0),isAttribute(false),nodenameID(BUILTIN_STRINGS::EMPTY),nodenamespace_uri(BUILTIN_STRINGS::EMPTY),nodenamespace_prefix(BUILTIN_STRINGS::EMPTY),constructed(false),childrenpending(false),attributespending(false)
 {
 	if (parent)
 		parentNode = parent;
@@ -65,6 +65,8 @@ XML::XML(ASWorker* wrk,Class_base* c, const pugi::xml_node& _n, XML* parent, boo
 
 void XML::finalize()
 {
+	detachChildren();
+	releaseLazyNode();
 	childrenlist.reset();
 	attributelist.reset();
 	procinstlist.reset();
@@ -77,6 +79,8 @@ bool XML::destruct()
 	nodetype =(pugi::xml_node_type)0;
 	isAttribute = false;
 	constructed = false;
+	detachChildren();
+	releaseLazyNode();
 	childrenlist.reset();
 	nodenameID = BUILTIN_STRINGS::EMPTY;
 	nodevalue.clear();
@@ -241,7 +245,7 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 	   asAtomHandler::is<Null>(args[0]) || 
 	   asAtomHandler::is<Undefined>(args[0]))
 	{
-		th->createTree(th->buildFromString("", getParseMode()),false);
+		th->createTreeFromString("");
 	}
 	else if(asAtomHandler::is<ByteArray>(args[0]))
 	{
@@ -249,8 +253,8 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 		//ByteArray seems to be though (see XML test) so let's support it
 		ByteArray* ba=asAtomHandler::as<ByteArray>(args[0]);
 		uint32_t len=ba->getLength();
-		const uint8_t* str=ba->getBuffer(len, false);
-		th->createTree(th->buildFromString(std::string((const char*)str,len), getParseMode()),false);
+		const uint8_t* str=ba->getReadBuffer();
+		th->createTreeFromString(std::string((const char*)str,len));
 	}
 	else if(asAtomHandler::isString(args[0]) ||
 		asAtomHandler::is<Number>(args[0]) ||
@@ -260,7 +264,7 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 	{
 		//By specs, XML constructor will only convert to string Numbers or Booleans
 		//ints are not explicitly mentioned, but they seem to work
-		th->createTree(th->buildFromString(asAtomHandler::toString(args[0],wrk), getParseMode()),false);
+		th->createTreeFromString(asAtomHandler::toString(args[0],wrk));
 	}
 	else if(asAtomHandler::is<XML>(args[0]))
 	{
@@ -275,7 +279,7 @@ ASFUNCTIONBODY_ATOM(XML,_constructor)
 	}
 	else
 	{
-		th->createTree(th->buildFromString(asAtomHandler::toString(args[0],wrk), getParseMode()),false);
+		th->createTreeFromString(asAtomHandler::toString(args[0],wrk));
 	}
 }
 
@@ -450,8 +454,8 @@ void XML::appendChild(_NR<XML> newChild)
 			}
 			node = node->parentNode;
 		}
-		newChild->parentNode = this;
-		childrenlist->append(newChild);
+		newChild->setParentNode(this);
+		getChildrenlistRef()->append(newChild);
 		handleNotification("nodeAdded",asAtomHandler::fromObject(newChild.getPtr()),asAtomHandler::nullAtom);
 	}
 }
@@ -475,9 +479,9 @@ ASFUNCTIONBODY_ATOM(XML,attribute)
 
 	XMLVector tmp;
 	XMLList* res = XMLList::create(wrk,tmp,th->getChildrenlist(),multiname(nullptr));
-	if (!th->attributelist.isNull())
+	if (!th->getAttributelistRef().isNull())
 	{
-		for (XMLList::XMLListVector::const_iterator it = th->attributelist->nodes.begin(); it != th->attributelist->nodes.end(); it++)
+		for (XMLList::XMLListVector::const_iterator it = th->getAttributelistRef()->nodes.begin(); it != th->getAttributelistRef()->nodes.end(); it++)
 		{
 			_NR<XML> attr = *it;
 			if (attr && attr->nodenamespace_uri == tmpns && (attrnameID== BUILTIN_STRINGS::STRING_WILDCARD || attr->nodenameID == attrnameID))
@@ -493,10 +497,10 @@ ASFUNCTIONBODY_ATOM(XML,attributes)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
 	assert_and_throw(argslen==0);
-	if (th->attributelist)
+	if (th->getAttributelistRef())
 	{
-		th->attributelist->incRef();
-		ret = asAtomHandler::fromObject(th->attributelist.getPtr());
+		th->getAttributelistRef()->incRef();
+		ret = asAtomHandler::fromObject(th->getAttributelistRef().getPtr());
 	}
 	else
 		ret = asAtomHandler::nullAtom;
@@ -504,7 +508,7 @@ ASFUNCTIONBODY_ATOM(XML,attributes)
 
 XMLList* XML::getAllAttributes()
 {
-	return attributelist.getPtr();
+	return getAttributelistRef().getPtr();
 }
 
 const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefix, const char *indent,bool bfirst)
@@ -622,9 +626,9 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 					res += ":";
 				}
 				res += getSystemState()->getStringFromUniqueId(this->nodenameID);
-				if (!attributelist.isNull())
+				if (!getAttributelistRef().isNull())
 				{
-					for (XMLList::XMLListVector::const_iterator it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+					for (XMLList::XMLListVector::const_iterator it = getAttributelistRef()->nodes.begin(); it != getAttributelistRef()->nodes.end(); it++)
 					{
 						res += " ";
 						_NR<XML> attr = *it;
@@ -742,9 +746,9 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 					res += getInstanceWorker()->getDefaultXMLNamespace();
 					res += "\"";
 				}
-				if (!attributelist.isNull())
+				if (!getAttributelistRef().isNull())
 				{
-					for (XMLList::XMLListVector::const_iterator it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+					for (XMLList::XMLListVector::const_iterator it = getAttributelistRef()->nodes.begin(); it != getAttributelistRef()->nodes.end(); it++)
 					{
 						_NR<XML> attr = *it;
 						if (attr->nodenamespace_prefix != BUILTIN_STRINGS::EMPTY)
@@ -767,7 +771,7 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 						}
 					}
 				}
-				if (childrenlist.isNull() || childrenlist->nodes.size() == 0)
+				if (getChildrenlistRef().isNull() || getChildrenlistRef()->nodes.size() == 0)
 				{
 					res += "/>";
 					break;
@@ -779,13 +783,13 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 					pretty &&
 					getSystemState()->static_XML_prettyPrinting &&
 					getSystemState()->static_XML_prettyIndent >= 0 &&
-					!childrenlist.isNull() &&
+					!getChildrenlistRef().isNull() &&
 					(
-						childrenlist->nodes.size() > 1 ||
-						!childrenlist->nodes[0]->procinstlist.isNull() ||
+						getChildrenlistRef()->nodes.size() > 1 ||
+						!getChildrenlistRef()->nodes[0]->procinstlist.isNull() ||
 						(
-							childrenlist->nodes[0]->nodetype != pugi::node_pcdata &&
-							childrenlist->nodes[0]->nodetype != pugi::node_cdata
+							getChildrenlistRef()->nodes[0]->nodetype != pugi::node_pcdata &&
+							getChildrenlistRef()->nodes[0]->nodetype != pugi::node_cdata
 						)
 					)
 				);
@@ -797,9 +801,9 @@ const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefi
 						newindent += " ";
 					}
 				}
-				if (!childrenlist.isNull())
+				if (!getChildrenlistRef().isNull())
 				{
-					for (auto it =childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+					for (auto it =getChildrenlistRef()->nodes.begin(); it != getChildrenlistRef()->nodes.end(); it++)
 					{
 						tiny_string tmpres = (*it)->toXMLString_internal(pretty,defaultnsprefix,newindent.raw_buf(),false);
 						if (bindent && !tmpres.empty())
@@ -845,11 +849,11 @@ ASFUNCTIONBODY_ATOM(XML,toXMLString)
 
 void XML::childrenImpl(XMLVector& ret, uint32_t nameID)
 {
-	if (!childrenlist.isNull())
+	if (!getChildrenlistRef().isNull())
 	{
-		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getChildrenlistRef()->nodes.size(); i++)
 		{
-			_NR<XML> child= childrenlist->nodes[i];
+			_NR<XML> child= getChildrenlistRef()->nodes[i];
 			if(nameID!=BUILTIN_STRINGS::STRING_WILDCARD && child->nodenameID != nameID)
 				continue;
 			ret.push_back(child);
@@ -859,9 +863,9 @@ void XML::childrenImpl(XMLVector& ret, uint32_t nameID)
 
 void XML::childrenImplIndex(XMLVector& ret, uint32_t index)
 {
-	if (constructed && !childrenlist.isNull() && index < childrenlist->nodes.size())
+	if (constructed && !getChildrenlistRef().isNull() && index < getChildrenlistRef()->nodes.size())
 	{
-		_NR<XML> child= childrenlist->nodes[index];
+		_NR<XML> child= getChildrenlistRef()->nodes[index];
 		ret.push_back(child);
 	}
 }
@@ -903,12 +907,12 @@ ASFUNCTIONBODY_ATOM(XML,children)
 ASFUNCTIONBODY_ATOM(XML,childIndex)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
-	if (th->parentNode && !th->parentNode->childrenlist.isNull())
+	if (th->parentNode && !th->parentNode->getChildrenlistRef().isNull())
 	{
 		XML* parent = th->parentNode;
-		for (uint32_t i = 0; i < parent->childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < parent->getChildrenlistRef()->nodes.size(); i++)
 		{
-			ASObject* o= parent->childrenlist->nodes[i].getPtr();
+			ASObject* o= parent->getChildrenlistRef()->nodes[i].getPtr();
 			if (o == th)
 			{
 				asAtomHandler::setUInt(ret,i);
@@ -939,11 +943,11 @@ ASFUNCTIONBODY_ATOM(XML,valueOf)
 
 void XML::getText(XMLVector& ret)
 {
-	if (childrenlist.isNull())
+	if (getChildrenlistRef().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildrenlistRef()->nodes.size(); i++)
 	{
-		_NR<XML> child= childrenlist->nodes[i];
+		_NR<XML> child= getChildrenlistRef()->nodes[i];
 		if (child->getNodeKind() == pugi::node_pcdata  ||
 			child->getNodeKind() == pugi::node_cdata)
 		{
@@ -977,11 +981,11 @@ ASFUNCTIONBODY_ATOM(XML,elements)
 
 void XML::getElementNodes(uint32_t nameID, XMLVector& foundElements)
 {
-	if (childrenlist.isNull())
+	if (getChildrenlistRef().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildrenlistRef()->nodes.size(); i++)
 	{
-		_NR<XML> child= childrenlist->nodes[i];
+		_NR<XML> child= getChildrenlistRef()->nodes[i];
 		if(child->nodetype==pugi::node_element && (nameID == BUILTIN_STRINGS::EMPTY || nameID == child->nodenameID))
 		{
 			foundElements.push_back( child );
@@ -1045,6 +1049,7 @@ ASFUNCTIONBODY_ATOM(XML,addNamespace)
 	{
 		ns_uri = asAtomHandler::toStringId(newNamespace,wrk);
 	}
+	th->materializeTree();
 	if (th->nodenamespace_prefix == ns_prefix)
 		th->nodenamespace_prefix=BUILTIN_STRINGS::EMPTY;
 	for (uint32_t i = 0; i < th->namespacedefs.size(); i++)
@@ -1233,6 +1238,7 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 	if (th->isAttribute && th->parentNode)
 	{
 		XML* tmp = th->parentNode;
+		tmp->materializeTree();
 		for (uint32_t i = 0; i < tmp->namespacedefs.size(); i++)
 		{
 			bool b;
@@ -1249,6 +1255,7 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 
 void XML::setNamespace(uint32_t ns_uri, uint32_t ns_prefix)
 {
+	materializeTree();
 	this->nodenamespace_prefix = ns_prefix;
 	this->nodenamespace_uri = ns_uri;
 	handleNotification("namespaceSet",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
@@ -1265,11 +1272,11 @@ ASFUNCTIONBODY_ATOM(XML,_copy)
 void XML::copy(XML* res, XML* parent)
 {
 	res->parentNode=parent;
-	if (!childrenlist.isNull())
+	if (!getChildrenlistRef().isNull())
 	{
-		res->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
-		res->childrenlist->nodes.reserve(childrenlist->nodes.size());
-		childrenlist->copy(res->childrenlist.getPtr(),res);
+		res->getChildrenlistRef() = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+		res->getChildrenlistRef()->nodes.reserve(getChildrenlistRef()->nodes.size());
+		getChildrenlistRef()->copy(res->getChildrenlistRef().getPtr(),res);
 	}
 	res->nodetype = this->nodetype;
 	res->isAttribute = this->isAttribute;
@@ -1277,11 +1284,11 @@ void XML::copy(XML* res, XML* parent)
 	res->nodevalue = this->nodevalue;
 	res->nodenamespace_uri = this->nodenamespace_uri;
 	res->nodenamespace_prefix = this->nodenamespace_prefix;
-	if (!attributelist.isNull())
+	if (!getAttributelistRef().isNull())
 	{
-		res->attributelist = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
-		res->attributelist->nodes.reserve(attributelist->nodes.size());
-		attributelist->copy(res->attributelist.getPtr());
+		res->getAttributelistRef() = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+		res->getAttributelistRef()->nodes.reserve(getAttributelistRef()->nodes.size());
+		getAttributelistRef()->copy(res->getAttributelistRef().getPtr());
 	}
 	if (!procinstlist.isNull())
 	{
@@ -1306,7 +1313,7 @@ ASFUNCTIONBODY_ATOM(XML,_setChildren)
 	asAtom newChildren = asAtomHandler::invalidAtom;
 	ARG_CHECK(ARG_UNPACK(newChildren));
 
-	th->childrenlist->clear();
+	th->getChildrenlistRef()->clear();
 
 	if (asAtomHandler::is<XML>(newChildren))
 	{
@@ -1345,7 +1352,7 @@ ASFUNCTIONBODY_ATOM(XML,_normalize)
 
 void XML::normalize()
 {
-	childrenlist->normalize();
+	getChildrenlistRef()->normalize();
 }
 
 void XML::addTextContent(const tiny_string& str)
@@ -1373,11 +1380,11 @@ bool XML::hasSimpleContent() const
 	if (getNodeKind() == pugi::node_comment ||
 		getNodeKind() == pugi::node_pi)
 		return false;
-	if (childrenlist.isNull())
+	if (getChildrenlistRef().isNull())
 		return true;
-	for(size_t i=0; i<childrenlist->nodes.size(); i++)
+	for(size_t i=0; i<getChildrenlistRef()->nodes.size(); i++)
 	{
-		if (childrenlist->nodes[i]->getNodeKind() == pugi::node_element)
+		if (getChildrenlistRef()->nodes[i]->getNodeKind() == pugi::node_element)
 			return false;
 	}
 	return true;
@@ -1394,17 +1401,53 @@ pugi::xml_node_type XML::getNodeKind() const
 }
 
 
+// compares the local part of a (possibly prefixed) pugixml node name
+static bool lazyLocalNameEquals(const pugi::char_t* qname, const tiny_string& localname)
+{
+	const pugi::char_t* colon = strchr(qname,':');
+	return strcmp(colon ? colon+1 : qname,localname.raw_buf())==0;
+}
+// checks on the pugixml DOM if any element below node (or any attribute of node and its descendants) has the given local name
+// the result is stored for node and all its descendants, so every subtree is only scanned once per query
+static bool lazySubtreeHasName(const pugi::xml_node& node, const tiny_string& localname, bool isAttribute, std::unordered_map<pugi::xml_node_struct*,bool>& lazymatches)
+{
+	bool found = false;
+	if (isAttribute)
+	{
+		for (pugi::xml_attribute attr = node.first_attribute(); attr && !found; attr = attr.next_attribute())
+			found = lazyLocalNameEquals(attr.name(),localname);
+	}
+	for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling())
+	{
+		if (child.type() != pugi::node_element)
+			continue;
+		if (lazySubtreeHasName(child,localname,isAttribute,lazymatches))
+			found = true;
+		else if (!isAttribute && lazyLocalNameEquals(child.name(),localname))
+			found = true;
+	}
+	lazymatches[node.internal_object()] = found;
+	return found;
+}
+
 void XML::getDescendantsByQName(const multiname& name, XMLVector& ret) const
 {
 	if (!constructed)
 		return;
-	uint32_t nodenameID = name.normalizedNameId(getInstanceWorker());
-	if (name.isAttribute && !attributelist.isNull())
+	LazyMatchMap lazymatches;
+	getDescendantsByQNameIntern(name,name.normalizedNameId(getInstanceWorker()),ret,lazymatches);
+}
+
+void XML::getDescendantsByQNameIntern(const multiname& name, uint32_t nodenameID, XMLVector& ret, LazyMatchMap& lazymatches) const
+{
+	if (!constructed)
+		return;
+	if (name.isAttribute && !getAttributelistRef().isNull())
 	{
-		for (uint32_t i = 0; i < attributelist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getAttributelistRef()->nodes.size(); i++)
 		{
 			
-			_NR<XML> child= attributelist->nodes[i];
+			_NR<XML> child= getAttributelistRef()->nodes[i];
 			if(nodenameID==BUILTIN_STRINGS::EMPTY || nodenameID==BUILTIN_STRINGS::STRING_WILDCARD || (nodenameID == child->nodenameID))
 			{
 				if (name.ns.empty())
@@ -1423,11 +1466,11 @@ void XML::getDescendantsByQName(const multiname& name, XMLVector& ret) const
 			}
 		}
 	}
-	if (childrenlist.isNull())
+	if (getChildrenlistRef().isNull())
 		return;
-	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+	for (uint32_t i = 0; i < getChildrenlistRef()->nodes.size(); i++)
 	{
-		_NR<XML> child= childrenlist->nodes[i];
+		_NR<XML> child= getChildrenlistRef()->nodes[i];
 		if(!name.isAttribute)
 		{
 			if(nodenameID==BUILTIN_STRINGS::EMPTY || nodenameID==BUILTIN_STRINGS::STRING_WILDCARD || (nodenameID == child->nodenameID))
@@ -1447,7 +1490,17 @@ void XML::getDescendantsByQName(const multiname& name, XMLVector& ret) const
 				}
 			}
 		}
-		child->getDescendantsByQName(name, ret);
+		// subtrees that are still only present in the pugixml DOM are skipped if they can't contain a match
+		if (child->childrenpending && (!name.isAttribute || child->attributespending) &&
+			nodenameID!=BUILTIN_STRINGS::EMPTY && nodenameID!=BUILTIN_STRINGS::STRING_WILDCARD)
+		{
+			auto it = lazymatches.find(child->lazynode.internal_object());
+			bool found = it != lazymatches.end() ? it->second
+				: lazySubtreeHasName(child->lazynode,getSystemState()->getStringFromUniqueId(nodenameID),name.isAttribute,lazymatches);
+			if (!found)
+				continue;
+		}
+		child->getDescendantsByQNameIntern(name, nodenameID, ret, lazymatches);
 	}
 }
 
@@ -1463,7 +1516,7 @@ XML::XMLVector XML::getAttributes()
 XML::XMLVector XML::getAttributesByMultiname(const multiname& name, uint32_t normalizedNameID) const
 {
 	XMLVector ret;
-	if (attributelist.isNull())
+	if (getAttributelistRef().isNull())
 		return ret;
 	uint32_t defns = getInstanceWorker()->getDefaultXMLNamespaceID();
 	std::unordered_set<uint32_t> namespace_uri;
@@ -1502,7 +1555,7 @@ XML::XMLVector XML::getAttributesByMultiname(const multiname& name, uint32_t nor
 		}
 		++it;
 	}
-	const XMLList::XMLListVector& nodes = attributelist->nodes;
+	const XMLList::XMLListVector& nodes = getAttributelistRef()->nodes;
 	if (normalizedNameID==BUILTIN_STRINGS::EMPTY)
 	{
 		for (auto child = nodes.cbegin(); child != nodes.cend(); child++)
@@ -1681,7 +1734,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 	{
 		//Lookup attribute
 		const XMLVector& attributes=getAttributesByMultiname(name,normalizedNameID);
-		ret = asAtomHandler::fromObject(XMLList::create(getInstanceWorker(),attributes,attributelist.getPtr(),name));
+		ret = asAtomHandler::fromObject(XMLList::create(getInstanceWorker(),attributes,getAttributelistRef().getPtr(),name));
 		return GET_VARIABLE_RESULT::GETVAR_ISINCREFFED;
 	}
 	else if(XML::isValidMultiname(getInstanceWorker(),name,index))
@@ -1696,7 +1749,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 		else
 			ret = asAtomHandler::fromObject(getSystemState()->getUndefinedRef());
 	}
-	else if (!childrenlist.isNull())
+	else if (!getChildrenlistRef().isNull())
 	{
 		if (normalizedNameID == BUILTIN_STRINGS::STRING_WILDCARD)
 		{
@@ -1711,7 +1764,7 @@ GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& na
 		}
 		else
 		{
-			const XMLVector& res=getValuesByMultiname(childrenlist,name);
+			const XMLVector& res=getValuesByMultiname(getChildrenlistRef(),name);
 			
 			if(res.empty() && (opt & FROM_GETLEX)!=0)
 				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
@@ -1751,7 +1804,7 @@ void XML::setVariableByInteger(int index, asAtom &o, CONST_ALLOWED_FLAG allowCon
 		createError<TypeError>(getWorker(),kXMLAssignmentToIndexedXMLNotAllowed);
 		return;
 	}
-	childrenlist->setVariableByInteger(index,o,allowConst,alreadyset,wrk);
+	getChildrenlistRef()->setVariableByInteger(index,o,allowConst,alreadyset,wrk);
 }
 multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_ALLOWED_FLAG allowConst, bool replacetext, bool* alreadyset,ASWorker* wrk)
 {
@@ -1783,8 +1836,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 		isAttr=true;
 		normalizedNameID=getSystemState()->getUniqueStringId(normalizedName.raw_buf()+1);
 	}
-	if (childrenlist.isNull())
-		childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+	if (getChildrenlistRef().isNull())
+		getChildrenlistRef() = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
 	if(isAttr)
 	{
 		tiny_string nodeval;
@@ -1803,8 +1856,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			nodeval = asAtomHandler::toString(o,getInstanceWorker());
 		}
 		_NR<XML> a;
-		auto it = attributelist->nodes.begin();
-		while (it != attributelist->nodes.end())
+		auto it = getAttributelistRef()->nodes.begin();
+		while (it != getAttributelistRef()->nodes.end())
 		{
 			_NR<XML> attr = *it;
 			auto ittmp = it;
@@ -1812,7 +1865,11 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			if (attr->nodenamespace_uri == ns_uri && (attr->nodenameID == normalizedNameID || (normalizedNameID==BUILTIN_STRINGS::STRING_WILDCARD)|| (normalizedNameID==BUILTIN_STRINGS::EMPTY)))
 			{
 				if (!a.isNull())
-					it=attributelist->nodes.erase(ittmp);
+				{
+					if (attr->parentNode == this)
+						attr->parentNode = nullptr;
+					it=getAttributelistRef()->nodes.erase(ittmp);
+				}
 				a = *ittmp;
 				asAtom oldval = asAtomHandler::fromStringID(getSystemState()->getUniqueStringId(a->nodevalue));
 				a->nodevalue = nodeval;
@@ -1830,7 +1887,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			tmp->nodenamespace_prefix = ns_prefix;
 			tmp->nodevalue = nodeval;
 			tmp->constructed = true;
-			attributelist->nodes.push_back(tmp);
+			getAttributelistRef()->nodes.push_back(tmp);
 			handleNotification("attributeAdded",asAtomHandler::fromStringID(tmp->nodenameID),o);
 		}
 		ASATOM_DECREF(o);
@@ -1843,14 +1900,14 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			ASATOM_DECREF(o);
 			return nullptr;
 		}
-		return childrenlist->setVariableByMultinameIntern(name,o,allowConst,replacetext,alreadyset,wrk);
+		return getChildrenlistRef()->setVariableByMultinameIntern(name,o,allowConst,replacetext,alreadyset,wrk);
 	}
 	else
 	{
 		bool notificationhandled = false;
 		bool found = false;
 		XMLVector tmpnodes;
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end();it++)
+		for (auto it = getChildrenlistRef()->nodes.begin(); it != getChildrenlistRef()->nodes.end();it++)
 		{
 			_NR<XML> tmpnode = *it;
 			
@@ -1886,8 +1943,8 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 							tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 							tmp->nodevalue = asAtomHandler::toString(o,getInstanceWorker());
 							tmp->constructed = true;
-							tmpnode->childrenlist->clear();
-							tmpnode->childrenlist->append(_MNR(tmp));
+							tmpnode->getChildrenlistRef()->clear();
+							tmpnode->getChildrenlistRef()->append(_MNR(tmp));
 						}
 						if (!found)
 							tmpnodes.push_back(tmpnode);
@@ -1897,7 +1954,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 					else
 					{
 						XML* tmp = asAtomHandler::as<XML>(o);
-						tmp->parentNode = this;
+						tmp->setParentNode(this);
 						if (!found)
 						{
 							tmp->incRef();
@@ -1908,15 +1965,15 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 				}
 				else
 				{
-					if (tmpnode->childrenlist.isNull())
-						tmpnode->childrenlist = _MNR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+					if (tmpnode->getChildrenlistRef().isNull())
+						tmpnode->getChildrenlistRef() = _MNR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
 					
-					if (tmpnode->childrenlist->nodes.size() == 1 && tmpnode->childrenlist->nodes[0]->nodetype == pugi::node_pcdata)
-						tmpnode->childrenlist->nodes[0]->nodevalue = asAtomHandler::toString(o,getInstanceWorker());
+					if (tmpnode->getChildrenlistRef()->nodes.size() == 1 && tmpnode->getChildrenlistRef()->nodes[0]->nodetype == pugi::node_pcdata)
+						tmpnode->getChildrenlistRef()->nodes[0]->nodevalue = asAtomHandler::toString(o,getInstanceWorker());
 					else
 					{
 						XML* newnode = createFromString(getInstanceWorker(),asAtomHandler::toString(o,getInstanceWorker()));
-						tmpnode->childrenlist->clear();
+						tmpnode->getChildrenlistRef()->clear();
 						asAtom v = asAtomHandler::fromObject(newnode);
 						tmpnode->setVariableByMultiname(name,v,allowConst,nullptr,wrk);
 						if (newnode->getNodeKind() == pugi::node_pcdata)
@@ -1942,7 +1999,7 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 			if(asAtomHandler::is<XML>(o))
 			{
 				_NR<XML> tmp = _MNR(asAtomHandler::as<XML>(o));
-				tmp->parentNode = this;
+				tmp->setParentNode(this);
 				tmpnodes.push_back(tmp);
 			}
 			else
@@ -1984,8 +2041,17 @@ multiname* XML::setVariableByMultinameIntern(multiname& name, asAtom& o, CONST_A
 					*alreadyset=true;
 			}
 		}
-		childrenlist->nodes.clear();
-		childrenlist->nodes.assign(tmpnodes.begin(),tmpnodes.end());
+		// the children that were replaced don't belong to this node anymore
+		std::unordered_set<XML*> keptnodes;
+		for (auto it = tmpnodes.begin(); it != tmpnodes.end(); it++)
+			keptnodes.insert((*it).getPtr());
+		for (auto it = getChildrenlistRef()->nodes.begin(); it != getChildrenlistRef()->nodes.end(); it++)
+		{
+			if ((*it)->parentNode == this && keptnodes.find((*it).getPtr()) == keptnodes.end())
+				(*it)->parentNode = nullptr;
+		}
+		getChildrenlistRef()->nodes.clear();
+		getChildrenlistRef()->nodes.assign(tmpnodes.begin(),tmpnodes.end());
 		if (!notificationhandled)
 			handleNotification("nodeChanged",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
 	}
@@ -2027,9 +2093,9 @@ bool XML::hasProperty(const multiname& name, bool checkXMLPropsOnly, bool consid
 	if(isAttr)
 	{
 		//Lookup attribute
-		if (!attributelist.isNull())
+		if (!getAttributelistRef().isNull())
 		{
-			for (auto it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+			for (auto it = getAttributelistRef()->nodes.begin(); it != getAttributelistRef()->nodes.end(); it++)
 			{
 				_NR<XML> attr = *it;
 				if (attr->nodenamespace_uri == ns_uri && attr->nodenameID == normalizedNameID)
@@ -2043,12 +2109,12 @@ bool XML::hasProperty(const multiname& name, bool checkXMLPropsOnly, bool consid
 		// object is treated as a single-item XMLList.
 		return(index==0);
 	}
-	else if (!childrenlist.isNull())
+	else if (!getChildrenlistRef().isNull())
 	{
 		//Lookup children
-		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		for (uint32_t i = 0; i < getChildrenlistRef()->nodes.size(); i++)
 		{
-			_NR<XML> child= childrenlist->nodes[i];
+			_NR<XML> child= getChildrenlistRef()->nodes[i];
 			bool name_match=(child->nodenameID == normalizedNameID);
 			bool ns_match=ns_uri==BUILTIN_STRINGS::EMPTY || 
 				(child->nodenamespace_uri == ns_uri);
@@ -2084,10 +2150,10 @@ bool XML::deleteVariableByMultiname(const multiname& name, ASWorker* wrk)
 		{
 			ns_uri = getInstanceWorker()->getDefaultXMLNamespaceID();
 		}
-		if (!attributelist.isNull() && attributelist->nodes.size() > 0)
+		if (!getAttributelistRef().isNull() && getAttributelistRef()->nodes.size() > 0)
 		{
-			auto it = attributelist->nodes.end();
-			while (it != attributelist->nodes.begin())
+			auto it = getAttributelistRef()->nodes.end();
+			while (it != getAttributelistRef()->nodes.begin())
 			{
 				it--;
 				_NR<XML> attr = *it;
@@ -2096,7 +2162,9 @@ bool XML::deleteVariableByMultiname(const multiname& name, ASWorker* wrk)
 						(attr->nodenamespace_uri == ns_uri && normalizedNameID == BUILTIN_STRINGS::EMPTY) ||
 						(attr->nodenamespace_uri == ns_uri && attr->nodenameID == normalizedNameID))
 				{
-					attributelist->nodes.erase(it);
+					if (attr->parentNode == this)
+						attr->parentNode = nullptr;
+					getAttributelistRef()->nodes.erase(it);
 					asAtom oldval = asAtomHandler::fromStringID(getSystemState()->getUniqueStringId(attr->nodevalue));
 					handleNotification("attributeRemoved",asAtomHandler::fromStringID(attr->nodenameID),oldval);
 				}
@@ -2105,8 +2173,13 @@ bool XML::deleteVariableByMultiname(const multiname& name, ASWorker* wrk)
 	}
 	else if(XML::isValidMultiname(getInstanceWorker(),name,index))
 	{
-		if (!childrenlist.isNull())
-			childrenlist->nodes.erase(childrenlist->nodes.begin() + index);
+		if (!getChildrenlistRef().isNull() && index < getChildrenlistRef()->nodes.size())
+		{
+			XML* node = getChildrenlistRef()->nodes[index].getPtr();
+			if (node->parentNode == this)
+				node->parentNode = nullptr;
+			getChildrenlistRef()->nodes.erase(getChildrenlistRef()->nodes.begin() + index);
+		}
 	}
 	else
 	{
@@ -2117,10 +2190,10 @@ bool XML::deleteVariableByMultiname(const multiname& name, ASWorker* wrk)
 			assert_and_throw(name.ns[0].kind==NAMESPACE);
 			ns_uri=name.ns[0].nsNameId;
 		}
-		if (!childrenlist.isNull() && childrenlist->nodes.size() > 0)
+		if (!getChildrenlistRef().isNull() && getChildrenlistRef()->nodes.size() > 0)
 		{
-			auto it = childrenlist->nodes.end();
-			while (it != childrenlist->nodes.begin())
+			auto it = getChildrenlistRef()->nodes.end();
+			while (it != getChildrenlistRef()->nodes.begin())
 			{
 				it--;
 				_NR<XML> node = *it;
@@ -2129,7 +2202,9 @@ bool XML::deleteVariableByMultiname(const multiname& name, ASWorker* wrk)
 						(node->nodenamespace_uri == ns_uri && normalizedNameID == BUILTIN_STRINGS::EMPTY) ||
 						(node->nodenamespace_uri == ns_uri && node->nodenameID == normalizedNameID))
 				{
-					childrenlist->nodes.erase(it);
+					if (node->parentNode == this)
+						node->parentNode = nullptr;
+					getChildrenlistRef()->nodes.erase(it);
 					handleNotification("nodeRemoved",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
 				}
 			}
@@ -2177,6 +2252,7 @@ uint32_t XML::getNamespacePrefixByURI(uint32_t uri, bool create)
 
 	if(!found && create)
 	{
+		materializeTree();
 		nodenamespace_uri = uri;
 	}
 
@@ -2192,7 +2268,7 @@ ASFUNCTIONBODY_ATOM(XML,_toString)
 	}
 	
 	XML* th=asAtomHandler::as<XML>(obj);
-	if (th->nodetype == pugi::node_element && th->hasSimpleContent() && (th->childrenlist.isNull() || th->childrenlist->nodes.empty()))
+	if (th->nodetype == pugi::node_element && th->hasSimpleContent() && (th->getChildrenlistRef().isNull() || th->getChildrenlistRef()->nodes.empty()))
 		ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
 	else
 		ret = asAtomHandler::fromObject(abstract_s(wrk,th->toString_priv()));
@@ -2330,9 +2406,9 @@ bool XML::CheckCyclicReference(XML* node)
 		createError<TypeError>(getInstanceWorker(),kXMLIllegalCyclicalLoop);
 		return true;
 	}
-	if (!childrenlist.isNull())
+	if (!getChildrenlistRef().isNull())
 	{
-		for (auto it = tmp->childrenlist->nodes.begin(); it != tmp->childrenlist->nodes.end(); it++)
+		for (auto it = tmp->getChildrenlistRef()->nodes.begin(); it != tmp->getChildrenlistRef()->nodes.end(); it++)
 		{
 			if ((*it).getPtr() == this)
 			{
@@ -2349,8 +2425,7 @@ bool XML::CheckCyclicReference(XML* node)
 XML *XML::createFromString(ASWorker* wrk, const tiny_string &s, bool usefirstchild)
 {
 	XML* res = Class<XML>::getInstanceSNoArgs(wrk);
-	pugi::xml_node root = res->buildFromString(s, getParseMode());
-	res->createTree(usefirstchild ? root.first_child() : root,false);
+	res->createTreeFromString(s,usefirstchild);
 	return res;
 }
 
@@ -2363,6 +2438,138 @@ XML *XML::createFromNode(ASWorker* wrk, const pugi::xml_node &_n, XML *parent, b
 	return res;
 }
 
+void XML::createTreeFromString(const tiny_string& str, bool usefirstchild)
+{
+	releaseLazyNode();
+	_NR<XMLSharedDocument> doc = _MNR(new XMLSharedDocument(getSystemState()->static_XML_ignoreWhitespace,getInstanceWorker()->getDefaultXMLNamespaceID()));
+	pugi::xml_node root = buildFromString(doc->doc, str, getParseMode());
+	if (usefirstchild)
+		root = root.first_child();
+	// trees that would raise an error during construction are built eagerly, so the error is thrown here
+	if (validateTree(root))
+		lazydoc = doc;
+	createTree(root,false);
+	if (!childrenpending && !attributespending)
+		releaseLazyNode();
+}
+
+static bool validateLazyNode(const pugi::xml_node& node, std::vector<const pugi::char_t*>& prefixes)
+{
+	size_t prefixcount = prefixes.size();
+	if (node.type() == pugi::node_element)
+	{
+		for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute())
+		{
+			if (strncmp(attr.name(),"xmlns:",6)==0)
+				prefixes.push_back(attr.name()+6);
+			for (pugi::xml_attribute attr2 = attr.next_attribute(); attr2; attr2 = attr2.next_attribute())
+			{
+				if (strcmp(attr.name(),attr2.name())==0)
+					return false;
+			}
+		}
+		const pugi::char_t* nodename = node.name();
+		const pugi::char_t* colon = strchr(nodename,':');
+		if (colon)
+		{
+			size_t len = colon-nodename;
+			if (len==0)
+				return false;
+			bool found = len==3 && strncmp(nodename,"xml",3)==0;
+			for (auto it = prefixes.begin(); it != prefixes.end() && !found; it++)
+				found = strlen(*it)==len && strncmp(*it,nodename,len)==0;
+			if (!found)
+				return false;
+		}
+	}
+	for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling())
+	{
+		if (!validateLazyNode(child,prefixes))
+			return false;
+	}
+	prefixes.resize(prefixcount);
+	return true;
+}
+
+bool XML::validateTree(const pugi::xml_node& rootnode)
+{
+	std::vector<const pugi::char_t*> prefixes;
+	return validateLazyNode(rootnode,prefixes);
+}
+
+void XML::materializeChildren() const
+{
+	childrenpending = false;
+	XML* th = const_cast<XML*>(this);
+	if (childrenlist.isNull())
+		childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+	for (pugi::xml_node_iterator it=lazynode.begin(); it!=lazynode.end(); ++it)
+	{
+		XML* tmp = Class<XML>::getInstanceSNoArgs(getInstanceWorker());
+		tmp->parentNode = th;
+		tmp->lazydoc = lazydoc;
+		tmp->createTree(*it,false);
+		if (!tmp->childrenpending && !tmp->attributespending)
+			tmp->releaseLazyNode();
+		childrenlist->append(_MNR(tmp));
+	}
+	if (!attributespending)
+		releaseLazyNode();
+}
+
+void XML::materializeAttributes() const
+{
+	attributespending = false;
+	fillAttributes(const_cast<XML*>(this),lazynode);
+	if (!childrenpending)
+		releaseLazyNode();
+}
+
+void XML::releaseLazyNode() const
+{
+	childrenpending = false;
+	attributespending = false;
+	lazynode = pugi::xml_node();
+	lazydoc.reset();
+}
+
+void XML::materializeTree()
+{
+	getAttributelistRef();
+	if (getChildrenlistRef().isNull())
+		return;
+	for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		(*it)->materializeTree();
+}
+
+void XML::setParentNode(XML* parent)
+{
+	if (parentNode != parent)
+		materializeTree();
+	parentNode = parent;
+}
+
+void XML::detachChildren()
+{
+	// the lists are used directly, pending children don't exist yet
+	if (childrenlist)
+	{
+		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		{
+			if ((*it) && (*it)->parentNode == this)
+				(*it)->parentNode = nullptr;
+		}
+	}
+	if (attributelist)
+	{
+		for (auto it = attributelist->nodes.begin(); it != attributelist->nodes.end(); it++)
+		{
+			if ((*it) && (*it)->parentNode == this)
+				(*it)->parentNode = nullptr;
+		}
+	}
+}
+
 ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
@@ -2394,24 +2601,24 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 		child2 = asAtomHandler::fromObjectNoPrimitive(createFromString(wrk,asAtomHandler::toString(child2,wrk)));
 		incref=false;
 	}
-	if (th->childrenlist.isNull())
-		th->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(wrk));
+	if (th->getChildrenlistRef().isNull())
+		th->getChildrenlistRef() = _MR(Class<XMLList>::getInstanceSNoArgs(wrk));
 	if (asAtomHandler::isNull(child1))
 	{
 		if (asAtomHandler::is<XML>(child2))
 		{
 			if (incref)
 				asAtomHandler::as<XML>(child2)->incRef();
-			asAtomHandler::as<XML>(child2)->parentNode = th;
-			th->childrenlist->nodes.insert(th->childrenlist->nodes.begin(),_MNR(asAtomHandler::as<XML>(child2)));
+			asAtomHandler::as<XML>(child2)->setParentNode(th);
+			th->getChildrenlistRef()->nodes.insert(th->getChildrenlistRef()->nodes.begin(),_MNR(asAtomHandler::as<XML>(child2)));
 		}
 		else if (asAtomHandler::is<XMLList>(child2))
 		{
 			for (auto it2 = asAtomHandler::as<XMLList>(child2)->nodes.begin(); it2 < asAtomHandler::as<XMLList>(child2)->nodes.end(); it2++)
 			{
-				(*it2)->parentNode = th;
+				(*it2)->setParentNode(th);
 			}
-			th->childrenlist->nodes.insert(th->childrenlist->nodes.begin(),asAtomHandler::as<XMLList>(child2)->nodes.begin(), asAtomHandler::as<XMLList>(child2)->nodes.end());
+			th->getChildrenlistRef()->nodes.insert(th->getChildrenlistRef()->nodes.begin(),asAtomHandler::as<XMLList>(child2)->nodes.begin(), asAtomHandler::as<XMLList>(child2)->nodes.end());
 		}
 		th->incRef();
 		ret = asAtomHandler::fromObject(th);
@@ -2426,7 +2633,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 		}
 		child1 = asAtomHandler::fromObjectNoPrimitive(asAtomHandler::as<XMLList>(child1)->nodes[0].getPtr());
 	}
-	for (auto it = th->childrenlist->nodes.begin(); it != th->childrenlist->nodes.end(); it++)
+	for (auto it = th->getChildrenlistRef()->nodes.begin(); it != th->getChildrenlistRef()->nodes.end(); it++)
 	{
 		if ((*it).getPtr() == asAtomHandler::getObjectNoCheck(child1))
 		{
@@ -2434,16 +2641,16 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 			{
 				if (incref)
 					asAtomHandler::as<XML>(child2)->incRef();
-				asAtomHandler::as<XML>(child2)->parentNode = th;
-				th->childrenlist->nodes.insert(it+1,_NR<XML>(asAtomHandler::as<XML>(child2)));
+				asAtomHandler::as<XML>(child2)->setParentNode(th);
+				th->getChildrenlistRef()->nodes.insert(it+1,_NR<XML>(asAtomHandler::as<XML>(child2)));
 			}
 			else if (asAtomHandler::is<XMLList>(child2))
 			{
 				for (auto it2 = asAtomHandler::as<XMLList>(child2)->nodes.begin(); it2 < asAtomHandler::as<XMLList>(child2)->nodes.end(); it2++)
 				{
-					(*it2)->parentNode = th;
+					(*it2)->setParentNode(th);
 				}
-				th->childrenlist->nodes.insert(it+1,asAtomHandler::as<XMLList>(child2)->nodes.begin(), asAtomHandler::as<XMLList>(child2)->nodes.end());
+				th->getChildrenlistRef()->nodes.insert(it+1,asAtomHandler::as<XMLList>(child2)->nodes.begin(), asAtomHandler::as<XMLList>(child2)->nodes.end());
 			}
 			th->incRef();
 			ret = asAtomHandler::fromObject(th);
@@ -2483,8 +2690,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 		incref=false;
 	}
 
-	if (th->childrenlist.isNull())
-		th->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(wrk));
+	if (th->getChildrenlistRef().isNull())
+		th->getChildrenlistRef() = _MR(Class<XMLList>::getInstanceSNoArgs(wrk));
 	if (asAtomHandler::isNull(child1))
 	{
 		if (asAtomHandler::is<XML>(child2))
@@ -2497,8 +2704,8 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 		{
 			for (auto it = asAtomHandler::as<XMLList>(child2)->nodes.begin(); it < asAtomHandler::as<XMLList>(child2)->nodes.end(); it++)
 			{
-				(*it)->parentNode = th;
-				th->childrenlist->nodes.push_back(_NR<XML>(*it));
+				(*it)->setParentNode(th);
+				th->getChildrenlistRef()->nodes.push_back(_NR<XML>(*it));
 			}
 		}
 		th->incRef();
@@ -2514,7 +2721,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 		}
 		child1 = asAtomHandler::fromObjectNoPrimitive(asAtomHandler::as<XMLList>(child1)->nodes[0].getPtr());
 	}
-	for (auto it = th->childrenlist->nodes.begin(); it != th->childrenlist->nodes.end(); it++)
+	for (auto it = th->getChildrenlistRef()->nodes.begin(); it != th->getChildrenlistRef()->nodes.end(); it++)
 	{
 		if ((*it).getPtr() == asAtomHandler::getObjectNoCheck(child1))
 		{
@@ -2522,16 +2729,16 @@ ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 			{
 				if (incref)
 					asAtomHandler::as<XML>(child2)->incRef();
-				asAtomHandler::as<XML>(child2)->parentNode = th;
-				th->childrenlist->nodes.insert(it,_NR<XML>(asAtomHandler::as<XML>(child2)));
+				asAtomHandler::as<XML>(child2)->setParentNode(th);
+				th->getChildrenlistRef()->nodes.insert(it,_NR<XML>(asAtomHandler::as<XML>(child2)));
 			}
 			else if (asAtomHandler::is<XMLList>(child2))
 			{
 				for (auto it2 = asAtomHandler::as<XMLList>(child2)->nodes.begin(); it2 < asAtomHandler::as<XMLList>(child2)->nodes.end(); it2++)
 				{
-					(*it2)->parentNode = th;
+					(*it2)->setParentNode(th);
 				}
-				th->childrenlist->nodes.insert(it,asAtomHandler::as<XMLList>(child2)->nodes.begin(), asAtomHandler::as<XMLList>(child2)->nodes.end());
+				th->getChildrenlistRef()->nodes.insert(it,asAtomHandler::as<XMLList>(child2)->nodes.begin(), asAtomHandler::as<XMLList>(child2)->nodes.end());
 			}
 			th->incRef();
 			ret = asAtomHandler::fromObject(th);
@@ -2563,6 +2770,7 @@ ASFUNCTIONBODY_ATOM(XML,removeNamespace)
 	XML* th=asAtomHandler::as<XML>(obj);
 	asAtom arg1=asAtomHandler::invalidAtom;
 	ARG_CHECK(ARG_UNPACK(arg1));
+	th->materializeTree();
 	Namespace* ns;
 	if (asAtomHandler::is<Namespace>(arg1))
 	{
@@ -2595,9 +2803,9 @@ void XML::RemoveNamespace(Namespace *ns)
 			break;
 		}
 	}
-	if (childrenlist)
+	if (getChildrenlistRef())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildrenlistRef()->nodes.begin(); it != getChildrenlistRef()->nodes.end(); it++)
 		{
 			(*it)->RemoveNamespace(ns);
 		}
@@ -2619,9 +2827,9 @@ ASFUNCTIONBODY_ATOM(XML,comments)
 }
 void XML::getComments(XMLVector& ret)
 {
-	if (childrenlist)
+	if (getChildrenlistRef())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildrenlistRef()->nodes.begin(); it != getChildrenlistRef()->nodes.end(); it++)
 		{
 			if ((*it)->getNodeKind() == pugi::node_comment)
 			{
@@ -2643,9 +2851,9 @@ ASFUNCTIONBODY_ATOM(XML,processingInstructions)
 }
 void XML::getprocessingInstructions(XMLVector& ret, uint32_t name)
 {
-	if (childrenlist)
+	if (getChildrenlistRef())
 	{
-		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
+		for (auto it = getChildrenlistRef()->nodes.begin(); it != getChildrenlistRef()->nodes.end(); it++)
 		{
 			if ((*it)->getNodeKind() == pugi::node_pi && (name == BUILTIN_STRINGS::STRING_WILDCARD || name == (*it)->nodenameID))
 			{
@@ -2701,10 +2909,10 @@ tiny_string XML::toString_priv()
 	}
 	else if (hasSimpleContent())
 	{
-		if (!childrenlist.isNull() && !childrenlist->nodes.empty())
+		if (!getChildrenlistRef().isNull() && !getChildrenlistRef()->nodes.empty())
 		{
-			auto it = childrenlist->nodes.begin();
-			while(it != childrenlist->nodes.end())
+			auto it = getChildrenlistRef()->nodes.begin();
+			while(it != getChildrenlistRef()->nodes.end())
 			{
 				if ((*it)->getNodeKind() != pugi::node_comment &&
 						(*it)->getNodeKind() != pugi::node_pi)
@@ -2712,7 +2920,7 @@ tiny_string XML::toString_priv()
 				it++;
 			}
 		}
-		else if (getNodeKind() == pugi::node_element && !attributelist.isNull() && !attributelist->nodes.empty())
+		else if (getNodeKind() == pugi::node_element && !getAttributelistRef().isNull() && !getAttributelistRef()->nodes.empty())
 		{
 			ret=toXMLString_internal();
 		}
@@ -2784,19 +2992,19 @@ bool XML::nodesEqual(XML *a, XML *b) const
 	if (a->nodevalue != b->nodevalue)
 		return false;
 	// attributes
-	if (a->attributelist.isNull())
-		return b->attributelist.isNull() || b->attributelist->nodes.size() == 0;
-	if (b->attributelist.isNull())
-		return a->attributelist.isNull() || a->attributelist->nodes.size() == 0;
-	if (a->attributelist->nodes.size() != b->attributelist->nodes.size())
+	if (a->getAttributelistRef().isNull())
+		return b->getAttributelistRef().isNull() || b->getAttributelistRef()->nodes.size() == 0;
+	if (b->getAttributelistRef().isNull())
+		return a->getAttributelistRef().isNull() || a->getAttributelistRef()->nodes.size() == 0;
+	if (a->getAttributelistRef()->nodes.size() != b->getAttributelistRef()->nodes.size())
 		return false;
-	for (int i = 0; i < (int)a->attributelist->nodes.size(); i++)
+	for (int i = 0; i < (int)a->getAttributelistRef()->nodes.size(); i++)
 	{
-		_NR<XML> oa= a->attributelist->nodes[i];
+		_NR<XML> oa= a->getAttributelistRef()->nodes[i];
 		bool bequal = false;
-		for (int j = 0; j < (int)b->attributelist->nodes.size(); j++)
+		for (int j = 0; j < (int)b->getAttributelistRef()->nodes.size(); j++)
 		{
-			_NR<XML> ob= b->attributelist->nodes[j];
+			_NR<XML> ob= b->getAttributelistRef()->nodes[j];
 			if (oa->isEqual(ob.getPtr()))
 			{
 				bequal = true;
@@ -2831,12 +3039,12 @@ bool XML::nodesEqual(XML *a, XML *b) const
 	}
 	
 	// children
-	if (a->childrenlist.isNull())
-		return b->childrenlist.isNull() || b->childrenlist->nodes.size() == 0;
-	if (b->childrenlist.isNull())
-		return a->childrenlist.isNull() || a->childrenlist->nodes.size() == 0;
+	if (a->getChildrenlistRef().isNull())
+		return b->getChildrenlistRef().isNull() || b->getChildrenlistRef()->nodes.size() == 0;
+	if (b->getChildrenlistRef().isNull())
+		return a->getChildrenlistRef().isNull() || a->getChildrenlistRef()->nodes.size() == 0;
 	
-	return a->childrenlist->isEqual(b->childrenlist.getPtr());
+	return a->getChildrenlistRef()->isEqual(b->getChildrenlistRef().getPtr());
 }
 
 uint32_t XML::nextNameIndex(uint32_t cur_index)
@@ -2966,6 +3174,14 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 				case pugi::node_element: // Element tag, i.e. '<node/>'
 				{
 					fillNode(this,node);
+					if (!this->lazydoc.isNull())
+					{
+						// children are created on first access
+						this->lazynode = node;
+						this->childrenpending = !node.first_child().empty();
+						done = true;
+						break;
+					}
 					pugi::xml_node_iterator it=node.begin();
 					while(it!=node.end())
 					{
@@ -3010,6 +3226,13 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 			case pugi::node_element: // Element tag, i.e. '<node/>'
 			{
 				fillNode(this,node);
+				if (!this->lazydoc.isNull())
+				{
+					// children are created on first access
+					this->lazynode = node;
+					this->childrenpending = !node.first_child().empty();
+					break;
+				}
 				pugi::xml_node_iterator it=node.begin();
 				{
 					while(it!=node.end())
@@ -3028,6 +3251,23 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 	}
 }
 
+// resolves a prefix on the pugixml DOM of a lazily created node, the XML objects of its old parents may already be gone
+static bool lookupLazyPrefix(const pugi::xml_node& srcnode, const tiny_string& prefix, tiny_string& uri)
+{
+	tiny_string attrname("xmlns:");
+	attrname += prefix;
+	for (pugi::xml_node n = srcnode; n; n = n.parent())
+	{
+		pugi::xml_attribute attr = n.attribute(attrname.raw_buf());
+		if (attr)
+		{
+			uri = attr.value();
+			return true;
+		}
+	}
+	return false;
+}
+
 void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 {
 	if (node->childrenlist.isNull())
@@ -3041,8 +3281,9 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 	if (node->parentNode && node->parentNode->nodenamespace_prefix == BUILTIN_STRINGS::EMPTY)
 		node->nodenamespace_uri = node->parentNode->nodenamespace_uri;
 	else
-		node->nodenamespace_uri = node->getInstanceWorker()->getDefaultXMLNamespaceID();
-	if (node->getSystemState()->static_XML_ignoreWhitespace && node->nodetype == pugi::node_pcdata)
+		node->nodenamespace_uri = node->lazydoc.isNull() ? node->getInstanceWorker()->getDefaultXMLNamespaceID() : node->lazydoc->defaultNamespaceID;
+	bool ignoreWhitespace = node->lazydoc.isNull() ? node->getSystemState()->static_XML_ignoreWhitespace : node->lazydoc->ignoreWhitespace;
+	if (ignoreWhitespace && node->nodetype == pugi::node_pcdata)
 		node->nodevalue = node->nodevalue.removeWhitespace();
 	node->attributelist = _MR(Class<XMLList>::getInstanceSNoArgs(node->getInstanceWorker()));
 	pugi::xml_attribute_iterator itattr;
@@ -3079,6 +3320,13 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		node->nodenameID = node->getSystemState()->getUniqueStringId(nodename.substr(pos+1,nodename.end()));
 		if (node->nodenamespace_prefix == BUILTIN_STRINGS::STRING_XML)
 			node->nodenamespace_uri = BUILTIN_STRINGS::STRING_NAMESPACENS;
+		else if (!node->lazydoc.isNull())
+		{
+			tiny_string uri;
+			namespacefound = lookupLazyPrefix(srcnode,nodename.substr(0,pos),uri);
+			if (namespacefound)
+				node->nodenamespace_uri = node->getSystemState()->getUniqueStringId(uri);
+		}
 		else
 		{
 			XML* tmpnode = node;
@@ -3107,6 +3355,20 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		createError<TypeError>(getWorker(),kXMLPrefixNotBound);
 		return;
 	}
+	if (!node->lazydoc.isNull())
+	{
+		// attributes are created on first access
+		node->lazynode = srcnode;
+		node->attributespending = !srcnode.first_attribute().empty();
+	}
+	else
+		fillAttributes(node,srcnode);
+	node->constructed=true;
+}
+
+void XML::fillAttributes(XML* node, const pugi::xml_node &srcnode)
+{
+	pugi::xml_attribute_iterator itattr;
 	for(itattr = srcnode.attributes_begin();itattr!=srcnode.attributes_end();++itattr)
 	{
 		tiny_string aname = tiny_string(itattr->name(),true);
@@ -3117,14 +3379,20 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		tmp->nodetype = pugi::node_null;
 		tmp->isAttribute = true;
 		tmp->nodenameID = node->getSystemState()->getUniqueStringId(aname);
-		tmp->nodenamespace_uri = node->getInstanceWorker()->getDefaultXMLNamespaceID();
-		pos = aname.find(":");
+		tmp->nodenamespace_uri = node->lazydoc.isNull() ? node->getInstanceWorker()->getDefaultXMLNamespaceID() : node->lazydoc->defaultNamespaceID;
+		uint32_t pos = aname.find(":");
 		if (pos != tiny_string::npos)
 		{
 			tmp->nodenamespace_prefix = node->getSystemState()->getUniqueStringId(aname.substr(0,pos));
 			tmp->nodenameID = node->getSystemState()->getUniqueStringId(aname.substr(pos+1,aname.end()));
 			if (tmp->nodenamespace_prefix == BUILTIN_STRINGS::STRING_XML)
 				tmp->nodenamespace_uri = BUILTIN_STRINGS::STRING_NAMESPACENS;
+			else if (!node->lazydoc.isNull())
+			{
+				tiny_string uri;
+				if (lookupLazyPrefix(srcnode,aname.substr(0,pos),uri))
+					tmp->nodenamespace_uri = node->getSystemState()->getUniqueStringId(uri);
+			}
 			else
 			{
 				XML* tmpnode = node;
@@ -3166,7 +3434,6 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		node->attributelist->nodes.push_back(tmp);
 		
 	}
-	node->constructed=true;
 }
 
 ASFUNCTIONBODY_ATOM(XML,_prependChild)
@@ -3238,8 +3505,8 @@ void XML::prependChild(_NR<XML> newChild)
 			}
 			node = node->parentNode;
 		}
-		newChild->parentNode = this;
-		childrenlist->prepend(newChild);
+		newChild->setParentNode(this);
+		getChildrenlistRef()->prepend(newChild);
 	}
 }
 
@@ -3261,21 +3528,24 @@ ASFUNCTIONBODY_ATOM(XML,_replace)
 	{
 		if (asAtomHandler::is<XMLList>(value))
 		{
-			th->childrenlist->decRef();
+			for (auto it = asAtomHandler::as<XMLList>(value)->nodes.begin(); it != asAtomHandler::as<XMLList>(value)->nodes.end(); it++)
+				(*it)->setParentNode(th);
+			th->getChildrenlistRef()->decRef();
 			ASATOM_INCREF(value);
-			th->childrenlist = _NR<XMLList>(asAtomHandler::as<XMLList>(value));
+			th->getChildrenlistRef() = _NR<XMLList>(asAtomHandler::as<XMLList>(value));
 		}
 		else if (asAtomHandler::is<XML>(value))
 		{
-			th->childrenlist->clear();
+			th->getChildrenlistRef()->clear();
 			ASATOM_INCREF(value);
-			th->childrenlist->append(_MNR(asAtomHandler::as<XML>(value)));
+			asAtomHandler::as<XML>(value)->setParentNode(th);
+			th->getChildrenlistRef()->append(_MNR(asAtomHandler::as<XML>(value)));
 		}
 		else
 		{
 			XML* x = createFromString(wrk,asAtomHandler::toString(value,wrk));
-			th->childrenlist->clear();
-			th->childrenlist->append(_MNR(x));
+			th->getChildrenlistRef()->clear();
+			th->getChildrenlistRef()->append(_MNR(x));
 		}
 		th->incRef();
 		ret = asAtomHandler::fromObject(th);
@@ -3291,7 +3561,7 @@ ASFUNCTIONBODY_ATOM(XML,_replace)
 	{
 		bool alreadyset=false;
 		ASATOM_INCREF(value);
-		th->childrenlist->setVariableByMultinameIntern(name,value,CONST_NOT_ALLOWED,true,&alreadyset,wrk);
+		th->getChildrenlistRef()->setVariableByMultinameIntern(name,value,CONST_NOT_ALLOWED,true,&alreadyset,wrk);
 		if (alreadyset)
 			ASATOM_DECREF(value);
 		
@@ -21,6 +21,7 @@
 #define SCRIPTING_TOPLEVEL_XML_H 1
 #include "asobject.h"
 #include "backends/xml_support.h"
+#include <unordered_map>
 
 namespace lightspark
 {
@@ -33,7 +34,9 @@ public:
 	typedef std::vector<_NR<XML>> XMLVector;
 	typedef std::vector<_R<Namespace>> NSVector;
 private:
-	_NR<XMLList> childrenlist;
+	// childrenlist and attributelist of nodes created from a shared document are filled on first access,
+	// so they must only be accessed through getChildrenlistRef()/getAttributelistRef()
+	mutable _NR<XMLList> childrenlist;
 	XML* parentNode;
 	pugi::xml_node_type nodetype;
 	bool isAttribute;
@@ -41,17 +44,49 @@ private:
 	tiny_string nodevalue;
 	uint32_t nodenamespace_uri;
 	uint32_t nodenamespace_prefix;
-	_NR<XMLList> attributelist;
+	mutable _NR<XMLList> attributelist;
 	_NR<XMLList> procinstlist;
 	_NR<IFunction> notifierfunction;
 	NSVector namespacedefs;
 
 	void createTree(const pugi::xml_node &rootnode, bool fromXMLList);
+	void createTreeFromString(const tiny_string& str, bool usefirstchild=false);
+	bool validateTree(const pugi::xml_node& rootnode);
 	static void fillNode(XML* node, const pugi::xml_node &srcnode);
+	static void fillAttributes(XML* node, const pugi::xml_node &srcnode);
+	void materializeChildren() const;
+	void materializeAttributes() const;
+	void releaseLazyNode() const;
+	// materializes the whole subtree, needed before namespace changes that affect the resolution of descendants
+	void materializeTree();
+	// moves this node to parent, the lazy subtree is materialized first to keep the namespaces of its descendants
+	void setParentNode(XML* parent);
+	// the children and attributes don't keep their parent alive, so they are detached when it goes away
+	void detachChildren();
+	inline _NR<XMLList>& getChildrenlistRef() const
+	{
+		if (childrenpending)
+			materializeChildren();
+		return childrenlist;
+	}
+	inline _NR<XMLList>& getAttributelistRef() const
+	{
+		if (attributespending)
+			materializeAttributes();
+		return attributelist;
+	}
 	tiny_string toString_priv();
 	const char* nodekindString();
 	
 	bool constructed;
+	// document and source node for not yet materialized children/attributes
+	mutable _NR<XMLSharedDocument> lazydoc;
+	mutable pugi::xml_node lazynode;
+	mutable bool childrenpending;
+	mutable bool attributespending;
+	// for every pugixml node of a lazy subtree already scanned by a descendants query, whether its subtree contains a match
+	typedef std::unordered_map<pugi::xml_node_struct*,bool> LazyMatchMap;
+	void getDescendantsByQNameIntern(const multiname& name, uint32_t nodenameID, XMLVector& ret, LazyMatchMap& lazymatches) const;
 	bool nodesEqual(XML *a, XML *b) const;
 	XMLVector getAttributes();
 	XMLVector getAttributesByMultiname(const multiname& name, uint32_t normalizedNameID) const;
@@ -148,7 +183,7 @@ public:
 
 	uint32_t getNameID() const { return nodenameID;}
 	uint32_t getNamespaceURI() const { return nodenamespace_uri;}
-	XMLList* getChildrenlist() { return childrenlist ? childrenlist.getPtr() : nullptr; }
+	XMLList* getChildrenlist() { return getChildrenlistRef() ? childrenlist.getPtr() : nullptr; }
 	
 	
 	void getDescendantsByQName(const multiname& name, XMLVector& ret) const;
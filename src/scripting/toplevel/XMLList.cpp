@@ -814,8 +814,8 @@ void XMLList::getTargetVariables(const multiname& name,XML::XMLVector& retnodes)
 			{
 				retnodes.push_back(child);
 			}
-			if (child->childrenlist)
-				child->childrenlist->getTargetVariables(name,retnodes);
+			if (child->getChildrenlistRef())
+				child->getChildrenlistRef()->getTargetVariables(name,retnodes);
 		}
 	}
 }
@@ -1017,7 +1017,7 @@ multiname* XMLList::setVariableByMultinameIntern(multiname& name, asAtom& o, CON
 				XML* tmp = Class<XML>::getInstanceSNoArgs(getInstanceWorker());
 				tmp->nodetype = pugi::node_element;
 				tmp->nodenameID = targetproperty.normalizedNameId(getInstanceWorker());
-				tmp->attributelist = _MNR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+				tmp->getAttributelistRef() = _MNR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
 				tmp->constructed = true;
 				tmp->setVariableByMultiname(name,o,allowConst,nullptr,wrk);
 				uint32_t tmpnameID = tmpprop.normalizedNameId(getInstanceWorker());
@@ -1026,7 +1026,7 @@ multiname* XMLList::setVariableByMultinameIntern(multiname& name, asAtom& o, CON
 					XML* tmp2 = Class<XML>::getInstanceSNoArgs(getInstanceWorker());
 					tmp2->nodetype = pugi::node_element;
 					tmp2->nodenameID = tmpnameID;
-					tmp2->attributelist = _MNR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
+					tmp2->getAttributelistRef() = _MNR(Class<XMLList>::getInstanceSNoArgs(getInstanceWorker()));
 					tmp2->constructed = true;
 					asAtom v = asAtomHandler::fromObject(tmp);
 					tmp2->setVariableByMultiname(targetproperty,v,allowConst,nullptr,wrk);
@@ -1077,22 +1077,23 @@ bool XMLList::deleteVariableByMultiname(const multiname& name, ASWorker* wrk)
 		if (index >= nodes.size())
 			return true;
 		_NR<XML> node = nodes[index];
-		if (node->parentNode && node->parentNode->childrenlist.getPtr() != this)
+		if (node->parentNode && node->parentNode->getChildrenlistRef().getPtr() != this)
 		{
 			// the node to remove is also added to another list, so it has to be deleted there, too
 			if (node->parentNode)
 			{
-				auto it = node->parentNode->childrenlist->nodes.end();
-				while (it != node->parentNode->childrenlist->nodes.begin())
+				auto it = node->parentNode->getChildrenlistRef()->nodes.end();
+				while (it != node->parentNode->getChildrenlistRef()->nodes.begin())
 				{
 					it--;
 					_NR<XML> n = *it;
 					if (n.getPtr() == node.getPtr())
 					{
-						node->parentNode->childrenlist->nodes.erase(it);
+						node->parentNode->getChildrenlistRef()->nodes.erase(it);
 						break;
 					}
 				}
+				node->parentNode = nullptr;
 			}
 		}
 		this->nodes.erase(this->nodes.begin()+index);
@@ -1268,7 +1269,7 @@ void XMLList::replace(unsigned int idx, asAtom o, const XML::XMLVector &retnodes
 		{
 			if (replacetext)
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildrenlistRef()->clear();
 				nodes[idx]->nodetype = pugi::node_pcdata;
 				nodes[idx]->nodenameID = BUILTIN_STRINGS::STRING_TEXT;
 				nodes[idx]->nodevalue = asAtomHandler::toString(o,wrk);
@@ -1277,7 +1278,7 @@ void XMLList::replace(unsigned int idx, asAtom o, const XML::XMLVector &retnodes
 			}
 			else
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildrenlistRef()->clear();
 				XML* tmp = Class<XML>::getInstanceSNoArgs(getInstanceWorker());
 				tmp->parentNode = nodes[idx].getPtr();
 				tmp->nodetype = pugi::node_pcdata;
@@ -1286,7 +1287,7 @@ void XMLList::replace(unsigned int idx, asAtom o, const XML::XMLVector &retnodes
 				tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 				tmp->nodevalue = asAtomHandler::toString(o,wrk);
 				tmp->constructed = true;
-				nodes[idx]->childrenlist->append(_MNR(tmp));
+				nodes[idx]->getChildrenlistRef()->append(_MNR(tmp));
 			}
 			ASATOM_DECREF(o);
 		}
@@ -1310,7 +1311,7 @@ void XMLList::replace(unsigned int idx, asAtom o, const XML::XMLVector &retnodes
 	{
 		if (replacetext)
 		{
-			nodes[idx]->childrenlist->clear();
+			nodes[idx]->getChildrenlistRef()->clear();
 			nodes[idx]->nodetype = pugi::node_pcdata;
 			nodes[idx]->nodenameID = BUILTIN_STRINGS::STRING_TEXT;
 			nodes[idx]->nodevalue = asAtomHandler::toString(o,getInstanceWorker());
@@ -1327,7 +1328,7 @@ void XMLList::replace(unsigned int idx, asAtom o, const XML::XMLVector &retnodes
 			}
 			else 
 			{
-				nodes[idx]->childrenlist->clear();
+				nodes[idx]->getChildrenlistRef()->clear();
 				XML* tmp = Class<XML>::getInstanceSNoArgs(getInstanceWorker());
 				tmp->parentNode = nodes[idx].getPtr();
 				tmp->nodetype = pugi::node_pcdata;
@@ -1336,7 +1337,7 @@ void XMLList::replace(unsigned int idx, asAtom o, const XML::XMLVector &retnodes
 				tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 				tmp->nodevalue = asAtomHandler::toString(o,wrk);
 				tmp->constructed = true;
-				nodes[idx]->childrenlist->append(_MNR(tmp));
+				nodes[idx]->getChildrenlistRef()->append(_MNR(tmp));
 				ASATOM_DECREF(o);
 			}
 		}
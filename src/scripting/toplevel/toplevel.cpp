@@ -52,6 +52,7 @@
 #include "scripting/toplevel/Vector.h"
 #include "scripting/toplevel/XML.h"
 #include "scripting/toplevel/Global.h"
+#include "tracing.h"
 
 using namespace std;
 using namespace lightspark;
@@ -185,6 +186,7 @@ void SyntheticFunction::call(ASWorker* wrk,asAtom& ret, asAtom& obj, asAtom *arg
 		// this is a call to this method during preloading, it can happen when constructing objects for optimization detection
 		return;
 	}
+	TraceScope tracescope(TRACE_ABC,functionname,TRACE_ABC_MIN_DURATION);
 	auto prev_cur_recursion = wrk->cur_recursion;
 	call_context* saved_cc = wrk->incStack(obj,this);
 	if (codeStatus != method_body_info::PRELOADED && codeStatus != method_body_info::USED)
@@ -196,17 +198,7 @@ void SyntheticFunction::call(ASWorker* wrk,asAtom& ret, asAtom& obj, asAtom *arg
 		ABCVm::preloadFunction(this,wrk);
 		mi->body->codeStatus = method_body_info::PRELOADED;
 		mi->cc.exec_pos = mi->body->preloadedcode.data();
-		mi->cc.locals = new asAtom[mi->body->getMaxLocalsWithoutSlots()];
-		mi->cc.stack = new asAtom[mi->body->max_stack+1];
-		mi->cc.scope_stack = new asAtom[mi->body->max_scope_depth];
-		mi->cc.scope_stack_dynamic = new bool[mi->body->max_scope_depth];
-		mi->cc.max_stackp=mi->cc.stack+mi->cc.mi->body->max_stack;
-		mi->cc.lastlocal = mi->cc.locals+mi->cc.mi->body->getMaxLocalsWithoutSlots();
-		mi->cc.localslots = new asAtom*[mi->body->getMaxLocals()];
-		for (uint32_t i = 0; i < uint32_t(mi->body->getMaxLocalsWithoutSlots()); i++)
-		{
-			mi->cc.localslots[i] = &mi->cc.locals[i];
-		}
+		mi->cc.setupFrame(new uint8_t[mi->getFrameSize()],mi->body->getMaxLocals(),mi->body->getMaxLocalsWithoutSlots(),mi->body->max_stack,mi->body->max_scope_depth);
 		uint32_t lastlocalcount=mi->body->getMaxLocalsWithoutSlots();
 		wrk->checkUndefinedAtomPool(lastlocalcount+1);
 		wrk->fillArrayWithUndefinedAtom(mi->cc.locals,lastlocalcount);
@@ -299,23 +291,16 @@ void SyntheticFunction::call(ASWorker* wrk,asAtom& ret, asAtom& obj, asAtom *arg
 	/* setup call_context */
 	bool recursive_call = codeStatus == method_body_info::USED;
 	call_context* cc = nullptr;
+	call_frame_stack::guard frameguard;
 	if (recursive_call)
 	{
-		cc = new call_context(mi);
+		// call_context and all its arrays are carved out of the worker's frame stack in one allocation
+		uint8_t* frame = frameguard.reserve(wrk->callFrames,CALL_CONTEXT_FRAME_OFFSET+mi->getFrameSize());
+		cc = new (frame) call_context(mi);
 		cc->sys = getSystemState();
 		cc->worker=wrk;
 		cc->exceptionthrown = nullptr;
-		cc->locals= LS_STACKALLOC(asAtom, mi->body->getMaxLocalsWithoutSlots());
-		cc->stack = LS_STACKALLOC(asAtom, mi->body->max_stack+1);
-		cc->scope_stack=LS_STACKALLOC(asAtom, mi->body->max_scope_depth);
-		cc->scope_stack_dynamic=LS_STACKALLOC(bool, mi->body->max_scope_depth);
-		cc->max_stackp=cc->stackp+cc->mi->body->max_stack;
-		cc->lastlocal = cc->locals+mi->body->getMaxLocalsWithoutSlots();
-		cc->localslots = LS_STACKALLOC(asAtom*,mi->body->getMaxLocals());
-		for (uint32_t i = 0; i < uint32_t(mi->body->getMaxLocalsWithoutSlots()); i++)
-		{
-			cc->localslots[i] = &cc->locals[i];
-		}
+		cc->setupFrame(frame+CALL_CONTEXT_FRAME_OFFSET,mi->body->getMaxLocals(),mi->body->getMaxLocalsWithoutSlots(),mi->body->max_stack,mi->body->max_scope_depth);
 		uint32_t lastlocalcount=mi->body->getMaxLocalsWithoutSlots();
 		wrk->fillArrayWithUndefinedAtom(cc->locals+args_len+1,lastlocalcount-(args_len+1));
 	}
@@ -593,8 +578,6 @@ void SyntheticFunction::call(ASWorker* wrk,asAtom& ret, asAtom& obj, asAtom *arg
 		if (asAtomHandler::isValid(ret) && mi->returnType->coerce(getInstanceWorker(),ret))
 			ASATOM_DECREF(v);
 	}
-	if (recursive_call)
-		delete cc;
 #ifdef PROFILING_SUPPORT
 	uint64_t t2 = compat_get_thread_cputime_us();
 	if (inClass)
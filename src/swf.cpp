@@ -64,6 +64,7 @@
 #include "backends/input.h"
 #include "backends/locale.h"
 #include "backends/currency.h"
+#include "backends/socketreactor.h"
 #include "memory_support.h"
 #include "parsing/tags.h"
 #include "scripting/flash/external/ExtensionContext.h"
@@ -166,7 +167,7 @@ void SystemState::handleBroadcastEvent(const tiny_string& event)
 	}
 	if (tmplisteners.empty())
 		return;
-	_R<Event> e(Class<Event>::getInstanceS(worker, event));
+	_R<Event> e(eventPool->getEvent(event));
 	for (auto it : tmplisteners)
 		ABCVm::publicHandleEvent(it, e);
 
@@ -274,6 +275,7 @@ SystemState::SystemState
 	,invalidateQueueTail(nullptr)
 	,lastUsedNamespaceId(0x7fffffff)
 	,framePhase(FramePhase::IDLE)
+	,framePhaseStart(0)
 	,instanceCounter(0)
 	,showProfilingData(false)
 	,allowFullscreen(false)
@@ -414,9 +416,10 @@ SystemState::SystemState
 	avm1FocusRectLinestyle.Color=RGBA(0xff,0xff,0,0xff);
 	avm1FocusRectLinestyle.Width=200;
 
-	threads = std::min(size_t(NUM_THREADS), threads);
+	// one worker per CPU, the downloads only need threads for blocking jobs
+	threads = std::min(size_t(std::max(SDL_GetCPUCount(),1)), threads);
 	threadPool=new ThreadPool(this, threads);
-	downloadThreadPool=new ThreadPool(this, threads);
+	downloadThreadPool=new ThreadPool(this, 0);
 
 	if (eventLoop == nullptr || !eventLoop->timersInEventLoop())
 	{
@@ -429,7 +432,9 @@ SystemState::SystemState
 		frameTimerThread = nullptr;
 	}
 	audioManager=nullptr;
+	socketReactor=nullptr;
 	intervalManager=new IntervalManager();
+	eventPool=new EventPool(worker);
 	securityManager=new SecurityManager();
 	localeManager = new LocaleManager();
 	currencyManager = new CurrencyManager();
@@ -620,6 +625,13 @@ void SystemState::waitThreadpool()
 	if(threadPool)
 		threadPool->waitAll();
 }
+SocketReactor* SystemState::getSocketReactor()
+{
+	Locker l(socketReactorMutex);
+	if (socketReactor == nullptr)
+		socketReactor = new SocketReactor(this);
+	return socketReactor;
+}
 void SystemState::stopEngines()
 {
 	if (audioManager)
@@ -628,6 +640,11 @@ void SystemState::stopEngines()
 		downloadThreadPool->forceStop();
 	if(threadPool)
 		threadPool->forceStop();
+	{
+		Locker l(socketReactorMutex);
+		delete socketReactor;
+		socketReactor=nullptr;
+	}
 	if (timerThread != nullptr)
 		timerThread->wait();
 	if (frameTimerThread != nullptr)
@@ -741,6 +758,7 @@ void SystemState::systemFinalize()
 		it = sharedobjectmap.erase(it);
 	}
 	mainClip->destroyTags();
+	eventPool->clear();
 }
 #ifndef NDEBUG
 extern std::set<ASObject*> memcheckset;
@@ -831,10 +849,18 @@ void SystemState::destroy()
 		threadPool->forceStop();
 	stopEngines();
 
+	if (!traceOut.empty())
+	{
+		Tracer::setEnabled(false);
+		Tracer::write(traceOut,this);
+	}
+
 	delete extScriptObject;
 	delete intervalManager;
-	//Finalize ourselves
+	//Finalize ourselves, this releases the pooled events
 	systemFinalize();
+	delete eventPool;
+	eventPool=nullptr;
 
 	/*
 	 * 1) call finalize on all objects, this will free all non constant referenced objects and thereby
@@ -1005,6 +1031,9 @@ void SystemState::removeWorker(ASWorker *w)
 	workerDomain->removeWorker(w);
 	singleworker=workerDomain->workerlist->size() <= 1;
 	threadPool->forceStopWorker(w);
+	Locker lr(socketReactorMutex);
+	if (socketReactor)
+		socketReactor->stopWorker(w);
 
 }
 void SystemState::addEventToBackgroundWorkers(_NR<EventDispatcher> obj, _R<Event> ev)
@@ -1392,6 +1421,22 @@ void SystemState::signalRenderFrame()
 		getRenderThread()->set_canrender(canrender);
 }
 
+void SystemState::setTracingOutput(const tiny_string& t)
+{
+	traceOut=t;
+	Tracer::setEnabled(!t.empty());
+}
+
+void SystemState::traceFramePhase(FramePhase newphase)
+{
+	static const char* phaseNames[] = { "no phase", "advanceFrame", "initFrame", "frameConstructed", "executeFrameScript", "exitFrame", "idle" };
+	uint64_t now = Tracer::now();
+	FramePhase oldphase = ACQUIRE_READ(framePhase);
+	if (framePhaseStart && oldphase != FramePhase::NO_PHASE && oldphase != newphase)
+		Tracer::addSlice(TRACE_FRAME,phaseNames[(int)oldphase],framePhaseStart,now);
+	if (oldphase != newphase)
+		framePhaseStart = now;
+}
 
 #ifdef PROFILING_SUPPORT
 void SystemState::setProfilingOutput(const tiny_string& t)
@@ -1406,9 +1451,68 @@ const tiny_string& SystemState::getProfilingOutput() const
 }
 #endif
 
+ThreadProfile::ThreadProfile(const RGB& c,uint32_t l,EngineData* _engineData):color(c),len(l),tickCount(0),engineData(_engineData)
+{
+	memset(queueDepthHistogram,0,sizeof(queueDepthHistogram));
+	memset(queueLatencyHistogram,0,sizeof(queueLatencyHistogram));
+}
+
+ThreadProfile::~ThreadProfile()
+{
+	uint64_t* histograms[2] = { queueDepthHistogram, queueLatencyHistogram };
+	const char* names[2] = { "event queue depth", "event queue latency (us)" };
+	for (uint32_t h = 0; h < 2; h++)
+	{
+		std::ostringstream s;
+		for (uint32_t i = 0; i < PROFILE_HISTOGRAM_BUCKETS; i++)
+		{
+			if (histograms[h][i])
+				s << " <" << (uint64_t(1)<<i) << ":" << histograms[h][i];
+		}
+		if (!s.str().empty())
+			LOG(LOG_INFO,"Profile " << name << " " << names[h] << s.str());
+	}
+}
+
+uint32_t ThreadProfile::getHistogramBucket(uint64_t value)
+{
+	uint32_t bucket=0;
+	while (value && bucket < PROFILE_HISTOGRAM_BUCKETS-1)
+	{
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void ThreadProfile::accountQueueDepth(uint32_t depth)
+{
+	Locker locker(mutex);
+	queueDepthHistogram[getHistogramBucket(depth)]++;
+}
+
+void ThreadProfile::accountQueueLatency(uint64_t latencyUs)
+{
+	Locker locker(mutex);
+	queueLatencyHistogram[getHistogramBucket(latencyUs)]++;
+}
+
+void ThreadProfile::getQueueDepthHistogram(std::vector<uint64_t>& histogram)
+{
+	Locker locker(mutex);
+	histogram.assign(queueDepthHistogram,queueDepthHistogram+PROFILE_HISTOGRAM_BUCKETS);
+}
+
+void ThreadProfile::getQueueLatencyHistogram(std::vector<uint64_t>& histogram)
+{
+	Locker locker(mutex);
+	histogram.assign(queueLatencyHistogram,queueLatencyHistogram+PROFILE_HISTOGRAM_BUCKETS);
+}
+
 void ThreadProfile::setTag(const std::string& t)
 {
 	Locker locker(mutex);
+	name=t;
 	if(data.empty())
 		data.push_back(ProfilingData(tickCount,0));
 
@@ -1651,6 +1755,7 @@ void ParseThread::parseSWFHeader(RootMovieClip *root, UI8 ver)
 void ParseThread::execute()
 {
 	tls_set(parse_thread_tls,this);
+	Tracer::setThreadName("Parse");
 	try
 	{
 		if (backgroundWorkerFileLength)
@@ -1765,6 +1870,8 @@ void ParseThread::parseSWF(UI8 ver)
 
 	TAGTYPE lasttagtype = TAG;
 	std::queue<const ControlTag*> queuedTags;
+	// bitmaps of the current frame that are still decoded in the ThreadPool
+	std::vector<const BitmapTag*> pendingBitmaps;
 	try
 	{
 		parseSWFHeader(root, ver);
@@ -1816,6 +1923,7 @@ void ParseThread::parseSWF(UI8 ver)
 		bool empty=true;
 		while(!done)
 		{
+			TraceScope tracescope(TRACE_PARSE,"processTag");
 			lasttagtype = tag->getType();
 			switch(tag->getType())
 			{
@@ -1831,10 +1939,12 @@ void ParseThread::parseSWF(UI8 ver)
 						queuedTags.pop();
 					}
 
+					waitForPendingBitmaps(pendingBitmaps);
 					if(!empty)
 						root->commitFrame(false);
 					else
 						root->revertFrame();
+					root->loaderInfo->setBytesLoaded(root->loaderInfo->getBytesTotal());
 
 					RELEASE_WRITE(root->finishedLoading,true);
 					done=true;
@@ -1845,6 +1955,9 @@ void ParseThread::parseSWF(UI8 ver)
 				{
 					DictionaryTag* d=static_cast<DictionaryTag*>(tag);
 					root->applicationDomain->addToDictionary(d);
+					BitmapTag* b=dynamic_cast<BitmapTag*>(d);
+					if (b && b->isDecodePending())
+						pendingBitmaps.push_back(b);
 					break;
 				}
 				case DISPLAY_LIST_TAG:
@@ -1872,7 +1985,11 @@ void ParseThread::parseSWF(UI8 ver)
 						queuedTags.pop();
 					}
 
+					// the frame is playable as soon as all its dictionary entries are available
+					waitForPendingBitmaps(pendingBitmaps);
 					root->commitFrame(true);
+					if (!root->loaderInfo->isFromByteArray())
+						root->loaderInfo->setBytesLoaded(f.tellg());
 					empty=true;
 					delete tag;
 					break;
@@ -1973,6 +2090,13 @@ void ParseThread::parseSWF(UI8 ver)
 	LOG(LOG_TRACE,"End of parsing");
 }
 
+void ParseThread::waitForPendingBitmaps(std::vector<const BitmapTag*>& pendingBitmaps)
+{
+	for (auto it = pendingBitmaps.begin(); it != pendingBitmaps.end(); it++)
+		(*it)->waitForDecoding();
+	pendingBitmaps.clear();
+}
+
 void ParseThread::parseExtensions(RootMovieClip* root)
 {
 	for (auto it = extensions.begin(); it != extensions.end(); it++)
@@ -34,6 +34,7 @@
 #include "timer.h"
 #include "threading.h"
 #include "compat.h"
+#include "tracing.h"
 #include <fstream>
 #include <list>
 #include <queue>
@@ -66,10 +67,13 @@ class ParseThread;
 class PluginManager;
 class RenderThread;
 class SecurityManager;
+class SocketReactor;
 class LocaleManager;
 class CurrencyManager;
 class DownloadManager;
 class Tag;
+class EventPool;
+class BitmapTag;
 class Class_inherit;
 class FontTag;
 class SoundTransform;
@@ -99,6 +103,7 @@ enum class FramePhase
 	IDLE
 };
 
+#define PROFILE_HISTOGRAM_BUCKETS 24
 class ThreadProfile
 {
 private:
@@ -118,11 +123,24 @@ private:
 	int32_t len;
 	uint32_t tickCount;
 	EngineData* engineData;
+	// last tag, used to identify the thread in the log
+	std::string name;
+	// histograms with power of two buckets, bucket i counts values in [2^(i-1),2^i)
+	uint64_t queueDepthHistogram[PROFILE_HISTOGRAM_BUCKETS];
+	uint64_t queueLatencyHistogram[PROFILE_HISTOGRAM_BUCKETS];
+	static uint32_t getHistogramBucket(uint64_t value);
 public:
-	ThreadProfile(const RGB& c,uint32_t l,EngineData* _engineData):color(c),len(l),tickCount(0),engineData(_engineData){}
+	ThreadProfile(const RGB& c,uint32_t l,EngineData* _engineData);
+	// logs the queue histograms
+	~ThreadProfile();
 	void accountTime(uint32_t time);
 	void setTag(const std::string& tag);
 	void tick();
+	// statistics of event queues
+	void accountQueueDepth(uint32_t depth);
+	void accountQueueLatency(uint64_t latencyUs);
+	void getQueueDepthHistogram(std::vector<uint64_t>& histogram);
+	void getQueueLatencyHistogram(std::vector<uint64_t>& histogram);
 #ifdef ENABLE_CAIRO
 	void plot(uint32_t max, cairo_t *cr);
 #endif
@@ -139,6 +157,9 @@ private:
 	std::list<TimeSpec> recentFrameTimings;
 	TimerThread* timerThread;
 	TimerThread* frameTimerThread;
+	// created when the first script socket is connected
+	SocketReactor* socketReactor;
+	Mutex socketReactorMutex;
 	EventLoop* eventLoop;
 	ITime* time;
 	Optional<ILogger&> logger;
@@ -243,11 +264,20 @@ private:
 	Mutex mutexLocalConnection;
 	std::map<uint32_t, LocalConnection*> localconnection_client_map;
 	ACQUIRE_RELEASE_VARIABLE(FramePhase, framePhase);
+	// start of the current frame phase when tracing is enabled
+	uint64_t framePhaseStart;
+	// records a slice for the phase that ends when switching to the new phase
+	void traceFramePhase(FramePhase newphase);
+	/*
+	   Output file for the trace
+	*/
+	tiny_string traceOut;
 	ATOMIC_INT32(instanceCounter); // used to create unique instanceX names for AVM1
 public:
 	void setURL(const tiny_string& url) DLL_PUBLIC;
 	tiny_string getDumpedSWFPath() const { return dumpedSWFPath;}
 	void waitThreadpool();
+	SocketReactor* getSocketReactor();
 
 	//Interative analysis flags
 	bool showProfilingData;
@@ -321,7 +351,12 @@ public:
 	LocalConnection* getLocalConnectionClient(uint32_t nameID);
 	void handleLocalConnectionEvent(LocalConnectionEvent* ev);
 	FramePhase getFramePhase() const { return ACQUIRE_READ(framePhase); }
-	void setFramePhase(FramePhase phase) { RELEASE_WRITE(framePhase, phase); }
+	void setFramePhase(FramePhase phase)
+	{
+		if (USUALLY_FALSE(Tracer::isEnabled()))
+			traceFramePhase(phase);
+		RELEASE_WRITE(framePhase, phase);
+	}
 
 	/**
 	 * Be careful, SystemState constructor does some global initialization that must be done
@@ -473,6 +508,8 @@ public:
 	void unregisterFrameListener(DisplayObject* clip);
 	void addBroadcastEvent(const tiny_string& event);
 	void handleBroadcastEvent(const tiny_string& event);
+	// recycled event objects for broadcasts and mouse moves
+	EventPool* eventPool;
 
 	//Invalidation queue management
 	void addToInvalidateQueue(DisplayObject* d) override;
@@ -485,6 +522,8 @@ public:
 	//Resize support
 	void resizeCompleted();
 
+	// enables tracing, the trace is written to t when the SystemState is destroyed
+	void setTracingOutput(const tiny_string& t) DLL_PUBLIC;
 #ifdef PROFILING_SUPPORT
 	void setProfilingOutput(const tiny_string& t) DLL_PUBLIC;
 	const tiny_string& getProfilingOutput() const;
@@ -618,8 +657,10 @@ private:
 	uint32_t backgroundWorkerFileLength;
 	void threadAbort() override;
 	void jobFence() override {}
+	bool isBlocking() const override { return true; }
 	void parseSWFHeader(RootMovieClip *root, UI8 ver);
 	void parseSWF(UI8 ver);
+	void waitForPendingBitmaps(std::vector<const BitmapTag*>& pendingBitmaps);
 	void parseBitmap();
 	void parseExtensions(RootMovieClip* root);
 };
@@ -17,6 +17,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 #include <cassert>
+#include <typeinfo>
 
 #include "interfaces/threading.h"
 #include "thread_pool.h"
@@ -25,265 +26,524 @@
 #include "exceptions.h"
 #include "compat.h"
 #include "logger.h"
+#include "tracing.h"
 #include "swf.h"
 #include "scripting/flash/system/ASWorker.h"
 
 using namespace lightspark;
 
-ThreadPool::ThreadPool(SystemState* s, size_t threads) :
-threadPool(!s->runSingleThreaded ? threads : 0),
-num_jobs(0),
-stopFlag(false),
-runcount(0)
+// the worker thread running in the current thread, if any
+DEFINE_AND_INITIALIZE_TLS(tls_poolworker);
+
+WorkStealingDeque::WorkStealingDeque():top(0),bottom(0),array(new Array(WORK_STEALING_DEQUE_SIZE))
+{
+}
+
+WorkStealingDeque::~WorkStealingDeque()
+{
+	delete array.load(std::memory_order_relaxed);
+	for (auto it = oldArrays.begin(); it != oldArrays.end(); it++)
+		delete *it;
+}
+
+WorkStealingDeque::Array* WorkStealingDeque::grow(Array* a, int64_t b, int64_t t)
+{
+	Array* newarray = new Array(a->size*2);
+	for (int64_t i = t; i < b; i++)
+		newarray->put(i,a->get(i));
+	oldArrays.push_back(a);
+	array.store(newarray,std::memory_order_release);
+	return newarray;
+}
+
+void WorkStealingDeque::push(IThreadJob* j)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	Array* a = array.load(std::memory_order_relaxed);
+	if (b - t > a->size - 1)
+		a = grow(a,b,t);
+	a->put(b,j);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b+1,std::memory_order_relaxed);
+}
+
+IThreadJob* WorkStealingDeque::take()
 {
-	m_sys=s;
-	size_t i = 0;
-	for (auto& thread : threadPool)
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	Array* a = array.load(std::memory_order_relaxed);
+	bottom.store(b,std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+	if (t > b)
 	{
-		thread.sys = s;
-		thread.pool = this;
-		thread.index = i++;
-		thread.job = nullptr;
-		thread.thread = SDL_CreateThread(job_worker,"ThreadPool",&thread);
+		// empty
+		bottom.store(b+1,std::memory_order_relaxed);
+		return nullptr;
 	}
+	IThreadJob* j = a->get(b);
+	if (t == b)
+	{
+		// last job, race against the thieves
+		if (!top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed))
+			j = nullptr;
+		bottom.store(b+1,std::memory_order_relaxed);
+	}
+	return j;
+}
+
+IThreadJob* WorkStealingDeque::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+	Array* a = array.load(std::memory_order_acquire);
+	IThreadJob* j = a->get(t);
+	if (!top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed))
+		return nullptr;
+	return j;
+}
+
+void ThreadPoolStatistics::add(const ThreadPoolStatistics& s)
+{
+	jobs += s.jobs;
+	steals += s.steals;
+	totalQueueTime += s.totalQueueTime;
+	maxQueueTime = std::max(maxQueueTime,s.maxQueueTime);
+	totalRunTime += s.totalRunTime;
+	maxRunTime = std::max(maxRunTime,s.maxRunTime);
+}
+
+ThreadPool::ThreadPool(SystemState* s, size_t threads) :
+m_sys(s),
+stopFlag(false),
+draining(false),
+queuedJobs(0),
+sleepingWorkers(0),
+jobsAvailable(0),
+idleBlockingThreads(0)
+{
+	if (s->runSingleThreaded)
+		threads = 0;
+	for (size_t i = 0; i < threads; i++)
+		workers.push_back(new Thread(s,this,i));
+	for (auto thread : workers)
+		thread->thread = SDL_CreateThread(job_worker,"ThreadPool",thread);
 }
 
 void ThreadPool::forceStop()
 {
-	if(!stopFlag)
 	{
+		Locker l(sharedMutex);
+		Locker lb(blockingMutex);
+		if (stopFlag)
+			return;
 		stopFlag=true;
-		//Signal an event for all the threads
-		for (size_t i = 0; i < threadPool.size(); ++i)
-			num_jobs.signal();
-
-		{
-			Locker l(mutex);
-			//Now abort any job that is still executing
-			for (auto thread : threadPool)
-			{
-				if (thread.job != nullptr)
-				{
-					thread.job->threadAborting = true;
-					thread.job->threadAbort();
-				}
-			}
-			//Fence all the non executed jobs
-			for (auto job : jobs)
-				job->jobFence();
-			jobs.clear();
-		}
-		for (auto thread : threadPool)
-			SDL_WaitThread(thread.thread, nullptr);
+	}
+	//Signal an event for all the workers
+	for (size_t i = 0; i < workers.size(); ++i)
+		jobsAvailable.signal();
 
-		for (auto pair : additionalThreads)
+	//Now abort any job that is still executing
+	Locker lb(blockingMutex);
+	std::vector<Thread*> threads = workers;
+	threads.insert(threads.end(),blockingThreads.begin(),blockingThreads.end());
+	for (auto thread : threads)
+	{
+		Locker l(thread->jobMutex);
+		if (thread->job != nullptr)
 		{
-			auto thread = pair.first;
-			auto job = pair.second;
-
-			if (job != nullptr)
-			{
-				job->threadAborting = true;
-				job->threadAbort();
-				job->jobFence();
-			}
-
-			SDL_WaitThread(thread, nullptr);
+			thread->job->threadAborting = true;
+			thread->job->threadAbort();
 		}
 	}
+	blockingCond.broadcast();
+	lb.release();
+
+	joinThreads();
 }
 
 void ThreadPool::waitAll()
 {
-	//Signal an event for all the threads
-	for (size_t i = 0; i < threadPool.size(); ++i)
-		num_jobs.signal();
-	// wait for all threads to end
-	for (auto thread : threadPool)
-		SDL_WaitThread(thread.thread, nullptr);
-	threadPool.clear();
-	for (auto pair : additionalThreads)
 	{
-		auto thread = pair.first;
-		SDL_WaitThread(thread, nullptr);
+		// jobs added from now on are run by the blocking threads
+		Locker l(sharedMutex);
+		draining=true;
 	}
-	additionalThreads.clear();
+	//Signal an event for all the workers
+	for (size_t i = 0; i < workers.size(); ++i)
+		jobsAvailable.signal();
+	{
+		Locker l(blockingMutex);
+		blockingCond.broadcast();
+	}
+	// wait for all threads to end
+	joinThreads();
 }
 
-void ThreadPool::forceStopWorker(ASWorker* wrk)
+void ThreadPool::joinThreads()
 {
-	//Signal an event for all the threads
-	for (size_t i = 0; i < threadPool.size(); ++i)
-		num_jobs.signal();
+	for (auto thread : workers)
+		SDL_WaitThread(thread->thread, nullptr);
+	// no thread adds jobs to the deques of the workers anymore
+	std::vector<IThreadJob*> jobs;
+	for (auto thread : workers)
+	{
+		IThreadJob* j;
+		while ((j = thread->deque.take()) != nullptr)
+			jobs.push_back(j);
+	}
+	{
+		Locker l(sharedMutex);
+		jobs.insert(jobs.end(),sharedJobs.begin(),sharedJobs.end());
+		sharedJobs.clear();
+	}
+	queuedJobs = 0;
+	//Fence all the non executed jobs, the blocking threads may be waiting for them
+	for (auto job : jobs)
+		job->jobFence();
+	jobs.clear();
 
+	//While draining the running blocking jobs may still add jobs, which may create new threads
+	size_t joined = 0;
+	while (true)
 	{
-		Locker l(mutex);
-		//Now abort any job that is still executing and was started by wrk
-		for (auto thread : threadPool)
+		std::vector<Thread*> threads;
 		{
-			if (thread.job != nullptr && thread.job->fromWorker == wrk)
+			Locker l(sharedMutex);
+			Locker lb(blockingMutex);
+			if (joined == blockingThreads.size())
 			{
-				thread.job->threadAborting = true;
-				thread.job->threadAbort();
+				//No thread is left to run jobs, jobs added from now on are fenced
+				stopFlag = true;
+				jobs.insert(jobs.end(),blockingJobs.begin(),blockingJobs.end());
+				blockingJobs.clear();
+				break;
 			}
+			threads.assign(blockingThreads.begin()+joined,blockingThreads.end());
 		}
-		//Fence all the non executed jobs started by wrk
-		auto it = jobs.begin();
-		while (it != jobs.end())
+		for (auto thread : threads)
+			SDL_WaitThread(thread->thread, nullptr);
+		joined += threads.size();
+	}
+	for (auto job : jobs)
+		job->jobFence();
+
+	logStatistics();
+	for (auto thread : workers)
+		delete thread;
+	workers.clear();
+	Locker l(blockingMutex);
+	for (auto thread : blockingThreads)
+		delete thread;
+	blockingThreads.clear();
+}
+
+void ThreadPool::forceStopWorker(ASWorker* wrk)
+{
+	std::vector<IThreadJob*> jobs;
+	Locker lb(blockingMutex);
+	//Now abort any job that is still executing and was started by wrk
+	std::vector<Thread*> threads = workers;
+	threads.insert(threads.end(),blockingThreads.begin(),blockingThreads.end());
+	for (auto thread : threads)
+	{
+		Locker l(thread->jobMutex);
+		if (thread->job != nullptr && thread->job->fromWorker == wrk)
 		{
-			auto job = *it;
-			if (job->fromWorker == wrk)
+			thread->job->threadAborting = true;
+			thread->job->threadAbort();
+		}
+	}
+	//Fence all the non executed blocking jobs started by wrk
+	auto it = blockingJobs.begin();
+	while (it != blockingJobs.end())
+	{
+		if ((*it)->fromWorker == wrk)
+		{
+			jobs.push_back(*it);
+			it = blockingJobs.erase(it);
+		}
+		else
+			it++;
+	}
+	lb.release();
+	{
+		// the jobs in the deques of the workers can't be removed, they are short and will just run
+		Locker l(sharedMutex);
+		auto it = sharedJobs.begin();
+		while (it != sharedJobs.end())
+		{
+			if ((*it)->fromWorker == wrk)
 			{
-				job->jobFence();
-				it = jobs.erase(it);
+				jobs.push_back(*it);
+				it = sharedJobs.erase(it);
+				queuedJobs--;
 			}
 			else
 				it++;
 		}
 	}
+	for (auto job : jobs)
+		job->jobFence();
+}
 
-	auto ita = additionalThreads.begin();
-	while (ita != additionalThreads.end())
-	{
-		auto thread = (*ita).first;
-		auto job = (*ita).second;
+ThreadPool::~ThreadPool()
+{
+	forceStop();
+}
 
-		if (job != nullptr && job->fromWorker == wrk)
+void ThreadPool::runJob(Thread* thread, IThreadJob* myJob, bool stolen)
+{
+	uint64_t start = compat_nsectiming();
+	{
+		Locker l(thread->jobMutex);
+		thread->job = myJob;
+	}
+	setTLSWorker(myJob->fromWorker);
+	try
+	{
+		// it's possible that a job was added and will be executed while forcestop() has been called
+		if(!stopFlag)
 		{
-			job->threadAborting = true;
-			job->threadAbort();
-			job->jobFence();
-			SDL_WaitThread(thread, nullptr);
-			ita = additionalThreads.erase(ita);
+			TraceScope tracescope(TRACE_JOB,USUALLY_FALSE(Tracer::isEnabled()) ? Tracer::getTypeName(typeid(*myJob)) : "job");
+			myJob->execute();
 		}
-		else
-			ita++;
+	}
+	catch(JobTerminationException& ex)
+	{
+		LOG(LOG_NOT_IMPLEMENTED,"Job terminated");
+	}
+	catch(LightsparkException& e)
+	{
+		LOG(LOG_ERROR,"Exception in ThreadPool " << e.what());
+		thread->sys->setError(e.cause);
+	}
+	catch(std::exception& e)
+	{
+		LOG(LOG_ERROR,"std Exception in ThreadPool:"<<myJob<<" "<<e.what());
+		thread->sys->setError(e.what());
+	}
+	uint64_t end = compat_nsectiming();
+
+	{
+		Locker l(thread->jobMutex);
+		thread->job = nullptr;
+		ThreadPoolStatistics& stats = thread->stats;
+		uint64_t queuetime = start - myJob->queueTime;
+		stats.jobs++;
+		if (stolen)
+			stats.steals++;
+		stats.totalQueueTime += queuetime;
+		stats.maxQueueTime = std::max(stats.maxQueueTime,queuetime);
+		stats.totalRunTime += end - start;
+		stats.maxRunTime = std::max(stats.maxRunTime,end - start);
 	}
 
+	//jobFencing is allowed to happen outside the mutex
+	myJob->jobFence();
 }
 
-ThreadPool::~ThreadPool()
+IThreadJob* ThreadPool::findJob(Thread* thread, bool& stolen)
 {
-	forceStop();
+	stolen = false;
+	IThreadJob* j = thread->deque.take();
+	if (j == nullptr && queuedJobs > 0)
+	{
+		// take a batch of jobs from the shared queue, so the other workers can steal them from us
+		Locker l(sharedMutex);
+		if (!sharedJobs.empty())
+		{
+			j = sharedJobs.front();
+			sharedJobs.pop_front();
+			size_t count = std::min(sharedJobs.size()/2,size_t(WORK_STEALING_BATCH_SIZE));
+			for (size_t i = 0; i < count; i++)
+			{
+				thread->deque.push(sharedJobs.front());
+				sharedJobs.pop_front();
+			}
+		}
+	}
+	for (size_t i = 1; j == nullptr && i < workers.size(); i++)
+	{
+		j = workers[(thread->index+i)%workers.size()]->deque.steal();
+		stolen = j != nullptr;
+	}
+	if (j)
+		queuedJobs--;
+	return j;
 }
 
 int ThreadPool::job_worker(void *d)
 {
 	Thread* thread = (Thread*)d;
+	ThreadPool* pool = thread->pool;
 	setTLSSys(thread->sys);
+	tls_set(tls_poolworker,thread);
 
 	ThreadProfile* profile=thread->sys->allocateProfiler(RGB(200,200,0));
 	char buf[16];
 	snprintf(buf,16,"Thread %u",(uint32_t)thread->index);
 	profile->setTag(buf);
+	Tracer::setThreadName("ThreadPool");
 
 	Chronometer chronometer;
-	while(1)
+	while(!pool->stopFlag)
 	{
-		thread->pool->num_jobs.wait();
-		if(thread->pool->stopFlag)
-			return 0;
-		Locker l(thread->pool->mutex);
-		if (thread->pool->jobs.empty())
-			return 0;
-		IThreadJob* myJob = thread->pool->jobs.front();
-		thread->pool->jobs.pop_front();
-		thread->job = myJob;
-		thread->pool->runcount++;
-		l.release();
-
-		setTLSWorker(myJob->fromWorker);
-		chronometer.checkpoint();
-		try
+		bool stolen;
+		IThreadJob* myJob = pool->findJob(thread,stolen);
+		if (myJob)
 		{
-			// it's possible that a job was added and will be executed while forcestop() has been called
-			if(thread->pool->stopFlag)
-				return 0;
-			myJob->execute();
-		}
-		catch(JobTerminationException& ex)
-		{
-			LOG(LOG_NOT_IMPLEMENTED,"Job terminated");
+			chronometer.checkpoint();
+			pool->runJob(thread,myJob,stolen);
+			profile->accountTime(chronometer.checkpoint());
+			continue;
 		}
-		catch(LightsparkException& e)
+		// a job added just before draining started may not have been visible to findJob()
+		if (pool->draining && pool->queuedJobs <= 0)
+			break;
+		// announce that we are going to sleep before checking for jobs again,
+		// so either we see the new job or addWorkerJob() sees us sleeping
+		pool->sleepingWorkers++;
+		if (pool->queuedJobs > 0 || pool->stopFlag || pool->draining)
 		{
-			LOG(LOG_ERROR,"Exception in ThreadPool " << e.what());
-			thread->sys->setError(e.cause);
+			pool->sleepingWorkers--;
+			continue;
 		}
-		catch(std::exception& e)
+		pool->jobsAvailable.wait();
+		pool->sleepingWorkers--;
+	}
+	return 0;
+}
+
+int ThreadPool::blocking_job_worker(void* d)
+{
+	Thread* thread = (Thread*)d;
+	ThreadPool* pool = thread->pool;
+	setTLSSys(thread->sys);
+	Tracer::setThreadName("ThreadPool (blocking)");
+
+	Locker l(pool->blockingMutex);
+	while(true)
+	{
+		while (pool->blockingJobs.empty() && !pool->stopFlag && !pool->draining)
 		{
-			LOG(LOG_ERROR,"std Exception in ThreadPool:"<<myJob<<" "<<e.what());
-			thread->sys->setError(e.what());
+			pool->idleBlockingThreads++;
+			pool->blockingCond.wait(pool->blockingMutex);
+			pool->idleBlockingThreads--;
 		}
-		
-		profile->accountTime(chronometer.checkpoint());
-
-		l.acquire();
-		thread->job = nullptr;
-		thread->pool->runcount--;
+		// on forceStop() the remaining jobs are fenced
+		if (pool->stopFlag || pool->blockingJobs.empty())
+			break;
+		IThreadJob* myJob = pool->blockingJobs.front();
+		pool->blockingJobs.pop_front();
 		l.release();
-
-		//jobFencing is allowed to happen outside the mutex
-		myJob->jobFence();
+		pool->runJob(thread,myJob,false);
+		l.acquire();
 	}
 	return 0;
 }
 
 void ThreadPool::addJob(IThreadJob* j)
 {
-	Locker l(mutex);
+	assert(j);
 	j->setWorker(getWorker());
+	j->queueTime = compat_nsectiming();
 	if(stopFlag)
 	{
 		j->jobFence();
 		return;
 	}
-	assert(j);
-	if (runcount == threadPool.size())
+	if (j->isBlocking() || workers.empty())
+		addBlockingJob(j);
+	else
+		addWorkerJob(j);
+}
+
+void ThreadPool::addWorkerJob(IThreadJob* j)
+{
+	Thread* current = (Thread*)tls_get(tls_poolworker);
+	if (current && current->pool == this)
 	{
-		// no slot available, we create an additional thread
-		runAdditionalThread(j);
+		// jobs added by a job stay with the worker, the other workers can steal them
+		current->deque.push(j);
+		queuedJobs++;
 	}
 	else
 	{
-		jobs.push_back(j);
-		num_jobs.signal();
+		Locker l(sharedMutex);
+		if (stopFlag)
+		{
+			l.release();
+			j->jobFence();
+			return;
+		}
+		if (draining)
+		{
+			// the workers may have ended already
+			l.release();
+			addBlockingJob(j);
+			return;
+		}
+		sharedJobs.push_back(j);
+		// counted under the lock, so a draining worker can't miss the job
+		queuedJobs++;
 	}
-}
-void ThreadPool::runAdditionalThread(IThreadJob* j)
-{
-	additionalThreads.emplace_back(nullptr, nullptr);
-	auto& thread = additionalThreads.back();
-	thread.second = j;
-	thread.first = SDL_CreateThread(additional_job_worker,"additionalThread",&thread);
+	if (sleepingWorkers > 0)
+		jobsAvailable.signal();
 }
 
-int ThreadPool::additional_job_worker(void* d)
+void ThreadPool::addBlockingJob(IThreadJob* j)
 {
-	ThreadPair* pair = (ThreadPair*)d;
-	IThreadJob* myJob = pair->second;
-
-	setTLSSys(myJob->fromWorker->getSystemState());
-	setTLSWorker(myJob->fromWorker);
-	try
+	Locker l(blockingMutex);
+	if (stopFlag)
 	{
-		myJob->execute();
+		l.release();
+		j->jobFence();
+		return;
 	}
-	catch(JobTerminationException& ex)
+	blockingJobs.push_back(j);
+	// blocking jobs may wait for each other, so every queued job needs its own thread
+	if (blockingJobs.size() > idleBlockingThreads)
 	{
-		LOG(LOG_NOT_IMPLEMENTED,"Job terminated");
+		Thread* thread = new Thread(m_sys,this,blockingThreads.size());
+		blockingThreads.push_back(thread);
+		thread->thread = SDL_CreateThread(blocking_job_worker,"ThreadPool",thread);
 	}
-	catch(LightsparkException& e)
+	blockingCond.signal();
+}
+
+void ThreadPool::getStatistics(ThreadPoolStatistics& worker, ThreadPoolStatistics& blocking)
+{
+	worker = ThreadPoolStatistics();
+	blocking = ThreadPoolStatistics();
+	for (auto thread : workers)
 	{
-		LOG(LOG_ERROR,"Exception in AdditionalThread " << e.what());
-		myJob->fromWorker->getSystemState()->setError(e.cause);
+		Locker l(thread->jobMutex);
+		worker.add(thread->stats);
 	}
-	catch(std::exception& e)
+	Locker lb(blockingMutex);
+	for (auto thread : blockingThreads)
 	{
-		LOG(LOG_ERROR,"std Exception in AdditionalThread:"<<myJob<<" "<<e.what());
-		myJob->fromWorker->getSystemState()->setError(e.what());
+		Locker l(thread->jobMutex);
+		blocking.add(thread->stats);
 	}
-	myJob->jobFence();
-	pair->second = nullptr;
-	return 0;
+}
+
+void ThreadPool::logStatistics()
+{
+	ThreadPoolStatistics worker;
+	ThreadPoolStatistics blocking;
+	getStatistics(worker,blocking);
+	// times in microseconds
+	if (worker.jobs)
+		LOG(LOG_INFO,"ThreadPool: " << worker.jobs << " jobs on " << workers.size() << " workers, " << worker.steals << " stolen"
+			<< ", queue time avg " << worker.totalQueueTime/worker.jobs/1000 << " max " << worker.maxQueueTime/1000
+			<< ", run time avg " << worker.totalRunTime/worker.jobs/1000 << " max " << worker.maxRunTime/1000);
+	if (blocking.jobs)
+		LOG(LOG_INFO,"ThreadPool: " << blocking.jobs << " blocking jobs on " << blockingThreads.size() << " threads"
+			<< ", queue time avg " << blocking.totalQueueTime/blocking.jobs/1000 << " max " << blocking.maxQueueTime/1000
+			<< ", run time avg " << blocking.totalRunTime/blocking.jobs/1000 << " max " << blocking.maxRunTime/1000);
 }
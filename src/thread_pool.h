@@ -21,17 +21,79 @@
 #define THREAD_POOL_H 1
 
 #include "compat.h"
+#include <atomic>
 #include <deque>
+#include <vector>
 #include <cstdlib>
 #include "threading.h"
 
 namespace lightspark
 {
 
-#define NUM_THREADS 10
+// initial capacity of the deques of the workers, they grow when needed
+#define WORK_STEALING_DEQUE_SIZE 256
+// maximum number of jobs a worker moves from the shared queue to its own deque at once
+#define WORK_STEALING_BATCH_SIZE 16
 
 class SystemState;
 
+/*
+ * Chase-Lev work-stealing deque.
+ * Only the owner thread may push() and take() at the bottom, any thread may steal() from the top.
+ * Replaced arrays are kept until the deque is destroyed, because thieves may still read from them.
+ */
+class WorkStealingDeque
+{
+private:
+	struct Array
+	{
+		int64_t size;
+		std::atomic<IThreadJob*>* buffer;
+		Array(int64_t s):size(s),buffer(new std::atomic<IThreadJob*>[s]) {}
+		~Array() { delete[] buffer; }
+		IThreadJob* get(int64_t i) const { return buffer[i&(size-1)].load(std::memory_order_relaxed); }
+		void put(int64_t i, IThreadJob* j) { buffer[i&(size-1)].store(j,std::memory_order_relaxed); }
+	};
+	std::atomic<int64_t> top;
+	std::atomic<int64_t> bottom;
+	std::atomic<Array*> array;
+	// only accessed by the owner
+	std::vector<Array*> oldArrays;
+	Array* grow(Array* a, int64_t b, int64_t t);
+public:
+	WorkStealingDeque();
+	~WorkStealingDeque();
+	void push(IThreadJob* j);
+	// returns nullptr if the deque is empty
+	IThreadJob* take();
+	// returns nullptr if the deque is empty or another thread took the job first
+	IThreadJob* steal();
+};
+
+struct ThreadPoolStatistics
+{
+	uint64_t jobs;
+	// number of jobs a worker took from the deque of another worker
+	uint64_t steals;
+	// times in nanoseconds
+	uint64_t totalQueueTime;
+	uint64_t maxQueueTime;
+	uint64_t totalRunTime;
+	uint64_t maxRunTime;
+	ThreadPoolStatistics():jobs(0),steals(0),totalQueueTime(0),maxQueueTime(0),totalRunTime(0),maxRunTime(0) {}
+	void add(const ThreadPoolStatistics& s);
+};
+
+/*
+ * Runs IThreadJobs.
+ * Jobs that are not blocking are run by a fixed number of workers, usually one per CPU.
+ * Every worker has its own WorkStealingDeque, jobs added by a worker stay in its deque and
+ * jobs from other threads are added to a shared queue. Idle workers first look into their own deque,
+ * then move a batch of jobs from the shared queue to their deque and finally steal from the other workers.
+ * Blocking jobs may wait for each other, so every blocking job gets its own thread.
+ * These threads are created when needed and reused afterwards.
+ * While waitAll() drains the pool, jobs that are not blocking are run by the blocking threads.
+ */
 class ThreadPool
 {
 private:
@@ -41,27 +103,54 @@ private:
 		SDL_Thread* thread;
 		ThreadPool* pool;
 		size_t index;
+		// protects job, so running jobs can be aborted
+		Mutex jobMutex;
 		IThreadJob* job;
+		// only used by workers
+		WorkStealingDeque deque;
+		// protected by jobMutex
+		ThreadPoolStatistics stats;
+		Thread(SystemState* s, ThreadPool* p, size_t i):sys(s),thread(nullptr),pool(p),index(i),job(nullptr) {}
 	};
-	Mutex mutex;
-	std::vector<Thread> threadPool;
-	using ThreadPair = std::pair<SDL_Thread*, IThreadJob*>;
-	std::deque<ThreadPair> additionalThreads;
-	std::deque<IThreadJob*> jobs;
-	Semaphore num_jobs;
-	static int job_worker(void* d);
 	SystemState* m_sys;
-	volatile bool stopFlag;
-	uint32_t runcount;
-	void runAdditionalThread(IThreadJob* j);
-	static int additional_job_worker(void* d);
+	std::atomic<bool> stopFlag;
+	// set by waitAll() under sharedMutex, threads end when there are no more jobs
+	std::atomic<bool> draining;
+
+	// workers for non-blocking jobs
+	std::vector<Thread*> workers;
+	Mutex sharedMutex;
+	std::deque<IThreadJob*> sharedJobs;
+	// number of non-blocking jobs that were added but not yet taken by a worker
+	std::atomic<int32_t> queuedJobs;
+	std::atomic<int32_t> sleepingWorkers;
+	Semaphore jobsAvailable;
+	static int job_worker(void* d);
+	IThreadJob* findJob(Thread* thread, bool& stolen);
+	void addWorkerJob(IThreadJob* j);
+
+	// threads for blocking jobs, protected by blockingMutex
+	Mutex blockingMutex;
+	Cond blockingCond;
+	std::vector<Thread*> blockingThreads;
+	std::deque<IThreadJob*> blockingJobs;
+	uint32_t idleBlockingThreads;
+	static int blocking_job_worker(void* d);
+	void addBlockingJob(IThreadJob* j);
+
+	void runJob(Thread* thread, IThreadJob* j, bool stolen);
+	// joins all threads, fences the jobs that were not run and deletes the threads
+	void joinThreads();
+	void logStatistics();
 public:
-	ThreadPool(SystemState* s, size_t threads = NUM_THREADS);
+	ThreadPool(SystemState* s, size_t threads);
 	~ThreadPool();
 	void addJob(IThreadJob* j);
 	void forceStop();
 	void waitAll();
 	void forceStopWorker(ASWorker* wrk);
+	// statistics of the jobs that were run by the workers and by the blocking threads
+	void getStatistics(ThreadPoolStatistics& worker, ThreadPoolStatistics& blocking);
 };
 
 }
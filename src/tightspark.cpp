@@ -39,6 +39,7 @@ int main(int argc, char* argv[])
 	bool useInterpreter=true;
 	bool useJit=false;
 	LOG_LEVEL log_level=LOG_INFO;
+	char* traceFileName=nullptr;
 	bool error=false;
 
 	for(int i=1;i<argc;i++)
@@ -65,6 +66,18 @@ int main(int argc, char* argv[])
 
 			log_level=(LOG_LEVEL)atoi(argv[i]);
 		}
+		else if(strcmp(argv[i],"-t")==0 || 
+			strcmp(argv[i],"--trace-output")==0)
+		{
+			i++;
+			if(i==argc)
+			{
+				error=true;
+				break;
+			}
+
+			traceFileName=argv[i];
+		}
 		else
 		{
 			//More than a file is allowed in tightspark
@@ -74,7 +87,7 @@ int main(int argc, char* argv[])
 
 	if(fileNames.empty() || error)
 	{
-		LOG(LOG_ERROR, "Usage: " << argv[0] << " [--disable-interpreter|-ni] [--enable-jit|-j] [--log-level|-l 0-4] <file.abc> [<file2.abc>]");
+		LOG(LOG_ERROR, "Usage: " << argv[0] << " [--disable-interpreter|-ni] [--enable-jit|-j] [--log-level|-l 0-4] [--trace-output|-t trace-file] <file.abc> [<file2.abc>]");
 		exit(-1);
 	}
 #ifdef HAVE_G_THREAD_INIT
@@ -95,6 +108,8 @@ int main(int argc, char* argv[])
 	}
 	sys->useInterpreter=useInterpreter;
 	sys->useJit=useJit;
+	if(traceFileName)
+		sys->setTracingOutput(traceFileName);
 
 	sys->mainClip->setOrigin(string("file://") + fileNames[0]);
 
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cassert>
+#include <unordered_set>
 
 #include "timer.h"
 #include "compat.h"
@@ -33,7 +34,7 @@
 using namespace lightspark;
 using namespace std;
 
-TimerThread::TimerThread(SystemState* s):m_sys(s),stopped(false),joined(false)
+TimerThread::TimerThread(SystemState* s):pendingEvents(1,compat_msectiming()),m_sys(s),stopped(false),joined(false)
 {
 	t = SDL_CreateThread(&TimerThread::worker,"TimerThread",this);
 }
@@ -58,37 +59,22 @@ void TimerThread::wait()
 TimerThread::~TimerThread()
 {
 	stop();
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	for(;it!=pendingEvents.end();++it)
+	pendingEvents.forEach([](TimingEvent* e)
 	{
-		if ((*it)->job)
-			(*it)->job->tickFence();
-		delete *it;
-	}
+		if (e->job)
+			e->job->tickFence();
+		delete e;
+	});
+	pendingEvents.clear();
 }
 
 void TimerThread::insertNewEvent_nolock(TimingEvent* e)
 {
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
 	//If there are no events pending, or this is earlier than the first, signal newEvent
-	if(pendingEvents.empty() || (*it)->wakeUpTime > e->wakeUpTime)
-	{
-		pendingEvents.insert(it, e);
+	bool notify = pendingEvents.empty() || pendingEvents.frontDeadline() > e->wakeUpTime;
+	pendingEvents.insert(e, e->job, e->wakeUpTime);
+	if (notify)
 		newEvent.signal();
-		return;
-	}
-	++it;
-
-	for(;it!=pendingEvents.end();++it)
-	{
-		if((*it)->wakeUpTime > e->wakeUpTime)
-		{
-			pendingEvents.insert(it, e);
-			return;
-		}
-	}
-	//Event has to be inserted after all the others
-	pendingEvents.insert(pendingEvents.end(), e);
 }
 
 void TimerThread::insertNewEvent(TimingEvent* e)
@@ -100,10 +86,10 @@ void TimerThread::insertNewEvent(TimingEvent* e)
 //Unsafe debugging routine
 void TimerThread::dumpJobs()
 {
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	//Find if the job is in the list
-	for(;it!=pendingEvents.end();++it)
-		LOG(LOG_INFO, (*it)->job );
+	pendingEvents.forEach([](TimingEvent* e)
+	{
+		LOG(LOG_INFO, e->job );
+	});
 }
 
 // TODO: Use `LSTimers` here, instead of doing it manually.
@@ -132,12 +118,13 @@ int TimerThread::worker(void *d)
 				return 0;
 		}
 
-		/* Get expiration of first event */
-		CondTime timing=th->pendingEvents.front()->wakeUpTime;
-		/* Wait for the absolute time or a newEvent signal
+		/* Wait for the expiration of the first event or a newEvent signal
 		 * this unlocks the mutex and relocks it before returing
 		 */
-		timing.wait(th->mutex,th->newEvent);
+		uint64_t now = compat_msectiming();
+		uint64_t wakeUpTime = th->pendingEvents.frontDeadline();
+		if (wakeUpTime > now)
+			th->newEvent.wait_until(th->mutex,wakeUpTime-now);
 
 		if(th->stopped)
 			return 0;
@@ -145,14 +132,15 @@ int TimerThread::worker(void *d)
 		if(th->pendingEvents.empty())
 			continue;
 
-		TimingEvent* e=th->pendingEvents.front();
-
 		/* check if the top event is due now. It could be have been removed/inserted
 		 * while we slept */
-		if(e->wakeUpTime.isInTheFuture())
+		now = compat_msectiming();
+		if(th->pendingEvents.frontDeadline() > now)
 			continue;
 
-		th->pendingEvents.pop_front();
+		/* all events due in the same millisecond are expired by the wheel in one batch,
+		 * they are handed out one by one as the mutex is released while executing them */
+		TimingEvent* e=th->pendingEvents.pop();
 
 		if(e->job->stopMe)
 		{
@@ -164,7 +152,7 @@ int TimerThread::worker(void *d)
 		if(e->isTick)
 		{
 			/* re-enqueue*/
-			e->wakeUpTime.addMilliseconds(e->tickTime);
+			e->wakeUpTime += e->tickTime;
 			th->insertNewEvent_nolock(e);
 		}
 
@@ -215,24 +203,12 @@ void TimerThread::removeJob(ITickJob* job)
 }
 void TimerThread::removeJob_noLock(ITickJob* job)
 {
-
-	/* See if that job is currently pending */
-	list<TimingEvent*>::iterator it=pendingEvents.begin();
-	bool first=true;
-	//Find if the job is in the list
-	for(;it!=pendingEvents.end();++it)
-	{
-		if((*it)->job==job)
-			break;
-		first=false;
-	}
-
-	if(it==pendingEvents.end())
+	bool first = !pendingEvents.empty() && pendingEvents.front()->job == job;
+	TimingEvent* e=nullptr;
+	if(!pendingEvents.remove(job,&e))
 		return;
 
 	job->tickFence();
-	TimingEvent* e=*it;
-	pendingEvents.erase(it);
 	delete e;
 
 	/* the worker is waiting on this job, wake him up */
@@ -243,17 +219,18 @@ void TimerThread::removeJob_noLock(ITickJob* job)
 void LSTimers::cleanup()
 {
 	Locker l(timerMutex);
-	std::set<ITickJob*> uniquejobs;
-	for (auto it = timers.begin(); it != timers.end(); it++)
+	std::unordered_set<ITickJob*> uniquejobs;
+	timers.forEach([&](const LSTimer& timer)
 	{
-		if ((*it).job)
-			uniquejobs.insert((*it).job);
-	}
+		if (timer.job)
+			uniquejobs.insert(timer.job);
+	});
 	for (auto it = uniquejobs.begin(); it != uniquejobs.end(); it++)
 	{
 		(*it)->tickFence();
 	}
 	timers.clear();
+	frameTimerCount = 0;
 }
 
 TimeSpec LSTimers::updateTimers(const TimeSpec& delta, bool allowFrameTimers)
@@ -266,7 +243,7 @@ TimeSpec LSTimers::updateTimers(const TimeSpec& delta, bool allowFrameTimers)
 
 	auto push = [&](const LSTimer& timer) { return pushTimerNoLock(timer); };
 	auto pop = [&] { return popTimerNoLock(); };
-	auto peek = [&] { return peekTimerNoLock(); };
+	auto peek = [&]() -> const LSTimer& { return peekTimerNoLock(); };
 
 	auto resetTimer = [&](LSTimer&& timer)
 	{
@@ -275,18 +252,10 @@ TimeSpec LSTimers::updateTimers(const TimeSpec& delta, bool allowFrameTimers)
 		push(timer);
 	};
 
-	auto getFrameJobs = [&]
-	{
-		int ret = 0;
-		for (auto timer : timers)
-			ret += timer.isFrame();
-		return ret;
-	};
-
 	int tickCount = 0;
 	int frameTickCount = 0;
 
-	const auto maxFrameTicks = LSTimers::maxFrames * getFrameJobs();
+	const auto maxFrameTicks = LSTimers::maxFrames * frameTimerCount;
 	while (!timers.empty() && peek().deadline() < currentTime)
 	{
 		if (!allowFrameTimers && peek().isFrame())
@@ -312,7 +281,7 @@ TimeSpec LSTimers::updateTimers(const TimeSpec& delta, bool allowFrameTimers)
 			break;
 		}
 
-		if (peek().isFrame() && ++frameTickCount > maxFrameTicks)
+		if (peek().isFrame() && uint32_t(++frameTickCount) > maxFrameTicks)
 		{
 			// Reset current time to a bit before the most recent frame timer.
 			currentTime -= TimeSpec::fromMs(1);
@@ -352,8 +321,10 @@ void LSTimers::pushTimer(const LSTimer& timer)
 
 void LSTimers::pushTimerNoLock(const LSTimer& timer)
 {
-	bool notify = peekTimerNoLock() > timer;
-	timers.insert(timer);
+	bool notify = timers.empty() || peekTimerNoLock() > timer;
+	timers.insert(timer, timer.job, timer.deadline().toNs());
+	if (timer.isFrame())
+		frameTimerCount++;
 	if (notify)
 		sys->getEngineData()->notifyTimer();
 }
@@ -366,8 +337,9 @@ LSTimer LSTimers::popTimer()
 
 LSTimer LSTimers::popTimerNoLock()
 {
-	LSTimer timer = peekTimerNoLock();
-	timers.erase(timers.begin());
+	LSTimer timer = timers.pop();
+	if (timer.isFrame())
+		frameTimerCount--;
 	return timer;
 }
 
@@ -377,9 +349,9 @@ const LSTimer& LSTimers::peekTimer()
 	return peekTimerNoLock();
 }
 
-const LSTimer& LSTimers::peekTimerNoLock() const
+const LSTimer& LSTimers::peekTimerNoLock()
 {
-	return *timers.begin();
+	return timers.front();
 }
 
 void LSTimers::addJob(const TimeSpec& time, const LSTimer::Type& type, ITickJob* job)
@@ -400,16 +372,12 @@ void LSTimers::removeJob(ITickJob* job)
 
 void LSTimers::removeJobNoLock(ITickJob* job)
 {
-	auto it = std::find_if(timers.begin(), timers.end(), [&](const LSTimer& it)
-	{
-		return it.job == job;
-	});
-
-	if (it == timers.end())
+	bool first = !timers.empty() && timers.front().job == job;
+	LSTimer timer;
+	if (!timers.remove(job, &timer))
 		return;
-
-	bool first = it == timers.begin();
-	timers.erase(it);
+	if (timer.isFrame())
+		frameTimerCount--;
 
 	if (first)
 		sys->getEngineData()->notifyTimer();
@@ -26,7 +26,11 @@
 #include "utils/timespec.h"
 #include "compat.h"
 #include <list>
-#include <set>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
 #include <ctime>
 #include "threading.h"
 
@@ -46,23 +50,265 @@ class Time : public ITime
 	void sleep_ns(uint64_t ns) override { compat_nsleep(ns); }
 };
 
+/*
+ * Hierarchical timing wheel with four levels of 256 slots each.
+ * Deadlines are given in arbitrary units and mapped to ticks of "resolution" units.
+ * Insertion and removal of a timer are O(1). All timers due in the same tick are moved
+ * to the ready queue in one batch and handed out in deadline/insertion order, so the
+ * wheel behaves like a stable priority queue ordered by deadline.
+ */
+template<class T>
+class TimerWheel
+{
+private:
+	static constexpr uint32_t levelBits = 8;
+	static constexpr uint32_t levelCount = 4;
+	static constexpr uint32_t slotCount = 1 << levelBits;
+	static constexpr uint32_t slotMask = slotCount-1;
+	struct Node
+	{
+		Node* prev;
+		Node* next;
+		T value;
+		ITickJob* job;
+		uint64_t deadline;
+		uint64_t tick;
+		uint64_t seq;
+		uint32_t level; // levelCount for the overflow list, UINT32_MAX for the ready queue
+		uint32_t slot;
+	};
+	Node* slots[levelCount+1][slotCount];
+	uint32_t levelSize[levelCount+1];
+	std::deque<Node*> ready;
+	std::unordered_map<ITickJob*,std::vector<Node*>> jobNodes;
+	std::vector<Node*> freeNodes;
+	uint64_t resolution;
+	uint64_t currentTick; // the next tick that is not yet moved to the ready queue
+	uint64_t nextSeq;
+	uint32_t wheelSize;
+	static bool nodeLess(const Node* a, const Node* b)
+	{
+		return a->deadline < b->deadline || (a->deadline == b->deadline && a->seq < b->seq);
+	}
+	void link(Node* n)
+	{
+		if (n->tick < currentTick)
+		{
+			// already due, keep the ready queue sorted
+			n->level = UINT32_MAX;
+			ready.insert(std::upper_bound(ready.begin(),ready.end(),n,nodeLess),n);
+			return;
+		}
+		uint64_t delta = n->tick-currentTick;
+		uint32_t level = 0;
+		while (level < levelCount && delta >= (uint64_t(1) << (levelBits*(level+1))))
+			level++;
+		n->level = level;
+		n->slot = level < levelCount ? (n->tick >> (levelBits*level)) & slotMask : 0;
+		Node*& head = slots[level][n->slot];
+		n->prev = nullptr;
+		n->next = head;
+		if (head)
+			head->prev = n;
+		head = n;
+		levelSize[level]++;
+		wheelSize++;
+	}
+	void unlink(Node* n)
+	{
+		if (n->level == UINT32_MAX)
+		{
+			auto it = std::lower_bound(ready.begin(),ready.end(),n,nodeLess);
+			assert(it != ready.end() && *it == n);
+			ready.erase(it);
+			return;
+		}
+		if (n->prev)
+			n->prev->next = n->next;
+		else
+			slots[n->level][n->slot] = n->next;
+		if (n->next)
+			n->next->prev = n->prev;
+		levelSize[n->level]--;
+		wheelSize--;
+	}
+	Node* takeSlot(uint32_t level, uint32_t slot)
+	{
+		Node* n = slots[level][slot];
+		slots[level][slot] = nullptr;
+		for (Node* it = n; it; it = it->next)
+		{
+			levelSize[level]--;
+			wheelSize--;
+		}
+		return n;
+	}
+	void relink(Node* n)
+	{
+		while (n)
+		{
+			Node* next = n->next;
+			link(n);
+			n = next;
+		}
+	}
+	// moves the timers of the next non-empty tick to the ready queue
+	void expireNextTick()
+	{
+		while (wheelSize)
+		{
+			if ((currentTick & slotMask) == 0)
+			{
+				// cascade the timers of the higher levels that are now in range, starting from the highest one
+				uint32_t top = 1;
+				while (top < levelCount && (currentTick & ((uint64_t(1) << (levelBits*(top+1)))-1)) == 0)
+					top++;
+				if (top == levelCount)
+					relink(takeSlot(levelCount,0));
+				for (uint32_t l = std::min(top,levelCount-1); l > 0; l--)
+					relink(takeSlot(l,(currentTick >> (levelBits*l)) & slotMask));
+			}
+			Node* n = takeSlot(0,currentTick & slotMask);
+			currentTick++;
+			if (n)
+			{
+				std::vector<Node*> batch;
+				for (; n; n = n->next)
+					batch.push_back(n);
+				std::sort(batch.begin(),batch.end(),nodeLess);
+				for (auto it = batch.begin(); it != batch.end(); it++)
+				{
+					(*it)->level = UINT32_MAX;
+					ready.push_back(*it);
+				}
+				return;
+			}
+			// skip all ticks until the next cascade of a non-empty level
+			for (uint32_t l = 0; l < levelCount && levelSize[l] == 0; l++)
+			{
+				uint64_t span = uint64_t(1) << (levelBits*(l+1));
+				currentTick = (currentTick + span - 1) & ~(span - 1);
+			}
+		}
+	}
+	void releaseNode(Node* n)
+	{
+		std::vector<Node*>& nodes = jobNodes[n->job];
+		nodes.erase(std::find(nodes.begin(),nodes.end(),n));
+		if (nodes.empty())
+			jobNodes.erase(n->job);
+		freeNodes.push_back(n);
+	}
+public:
+	// start is the current time, in the units of the deadlines. Starting at 0 with absolute
+	// deadlines would cascade through the overflow list for every empty span until the first deadline
+	TimerWheel(uint64_t _resolution, uint64_t start=0):resolution(_resolution),currentTick(start/_resolution),nextSeq(0),wheelSize(0)
+	{
+		memset(slots,0,sizeof(slots));
+		memset(levelSize,0,sizeof(levelSize));
+	}
+	~TimerWheel()
+	{
+		clear();
+		for (auto it = freeNodes.begin(); it != freeNodes.end(); it++)
+			delete *it;
+	}
+	bool empty() const { return wheelSize == 0 && ready.empty(); }
+	size_t size() const { return wheelSize + ready.size(); }
+	void insert(const T& value, ITickJob* job, uint64_t deadline)
+	{
+		Node* n;
+		if (freeNodes.empty())
+			n = new Node();
+		else
+		{
+			n = freeNodes.back();
+			freeNodes.pop_back();
+		}
+		n->value = value;
+		n->job = job;
+		n->deadline = deadline;
+		n->tick = deadline/resolution;
+		n->seq = nextSeq++;
+		link(n);
+		jobNodes[job].push_back(n);
+	}
+	// returns the timer with the earliest deadline, the wheel must not be empty
+	T& front()
+	{
+		if (ready.empty())
+			expireNextTick();
+		assert(!ready.empty());
+		return ready.front()->value;
+	}
+	uint64_t frontDeadline()
+	{
+		front();
+		return ready.front()->deadline;
+	}
+	T pop()
+	{
+		front();
+		Node* n = ready.front();
+		ready.pop_front();
+		T ret = n->value;
+		releaseNode(n);
+		return ret;
+	}
+	// removes the earliest timer of the job, returns false if the job has no timer
+	bool remove(ITickJob* job, T* removed=nullptr)
+	{
+		auto it = jobNodes.find(job);
+		if (it == jobNodes.end())
+			return false;
+		Node* n = *std::min_element(it->second.begin(),it->second.end(),nodeLess);
+		unlink(n);
+		if (removed)
+			*removed = n->value;
+		releaseNode(n);
+		return true;
+	}
+	template<class F>
+	void forEach(F f)
+	{
+		for (auto it = jobNodes.begin(); it != jobNodes.end(); it++)
+		{
+			for (auto itn = it->second.begin(); itn != it->second.end(); itn++)
+				f((*itn)->value);
+		}
+	}
+	void clear()
+	{
+		for (auto it = jobNodes.begin(); it != jobNodes.end(); it++)
+		{
+			for (auto itn = it->second.begin(); itn != it->second.end(); itn++)
+				freeNodes.push_back(*itn);
+		}
+		jobNodes.clear();
+		ready.clear();
+		memset(slots,0,sizeof(slots));
+		memset(levelSize,0,sizeof(levelSize));
+		wheelSize = 0;
+	}
+};
+
 class TimerThread
 {
 private:
 	class TimingEvent
 	{
 	public:
-		TimingEvent(ITickJob* _job, bool _isTick, uint32_t _tickTime, uint32_t _waitTime) 
-			: job(_job),wakeUpTime(_isTick ? _tickTime : _waitTime),tickTime(_tickTime),isTick(_isTick) {}
+		TimingEvent(ITickJob* _job, bool _isTick, uint32_t _tickTime, uint32_t _waitTime)
+			: job(_job),wakeUpTime(compat_msectiming()+(_isTick ? _tickTime : _waitTime)),tickTime(_tickTime),isTick(_isTick) {}
 		ITickJob* job;
-		CondTime wakeUpTime;
+		uint64_t wakeUpTime; // in milliseconds
 		uint32_t tickTime;
 		bool isTick;
 	};
 	Mutex mutex;
 	Cond newEvent;
 	SDL_Thread* t;
-	std::list<TimingEvent*> pendingEvents;
+	TimerWheel<TimingEvent*> pendingEvents;
 	SystemState* m_sys;
 	volatile bool stopped;
 	bool joined;
@@ -124,7 +370,9 @@ class LSTimers
 	using TimerType = LSTimer::Type;
 private:
 	Mutex timerMutex;
-	std::multiset<LSTimer> timers;
+	// ordered by LSTimer::deadline() in nanoseconds, with a resolution of one millisecond
+	TimerWheel<LSTimer> timers;
+	uint32_t frameTimerCount;
 	TimeSpec currentTime;
 	// Fake/Ideal current time, useful for deterministic timing.
 	TimeSpec fakeCurrentTime;
@@ -142,12 +390,12 @@ private:
 	LSTimer popTimer();
 	LSTimer popTimerNoLock();
 	const LSTimer& peekTimer();
-	const LSTimer& peekTimerNoLock() const;
+	const LSTimer& peekTimerNoLock();
 
 	void addJob(const TimeSpec& time, const TimerType& type, ITickJob* job);
 	TimeSpec getFrameRate() const;
 public:
-	LSTimers(SystemState* _sys) : sys(_sys) {}
+	LSTimers(SystemState* _sys) : timers(TimeSpec::nsPerMs), frameTimerCount(0), sys(_sys) {}
 	void cleanup();
 
 	void addTick(const TimeSpec& tickTime, ITickJob* job) { addJob(tickTime, TimerType::Tick, job); }
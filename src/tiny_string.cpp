@@ -22,7 +22,7 @@
 
 using namespace lightspark;
 
-tiny_string::tiny_string(std::istream& in, int len):buf(_buf_static),stringSize(len+1),type(STATIC)
+tiny_string::tiny_string(std::istream& in, int len):buf(_buf_static),stringSize(len+1),bufOffset(0),type(STATIC)
 {
 	if(stringSize > STATIC_SIZE)
 		createBuffer(stringSize);
@@ -31,7 +31,7 @@ tiny_string::tiny_string(std::istream& in, int len):buf(_buf_static),stringSize(
 	init();
 }
 
-tiny_string::tiny_string(const char* s,bool copy):_buf_static(),buf(_buf_static),type(READONLY)
+tiny_string::tiny_string(const char* s,bool copy):_buf_static(),buf(_buf_static),bufOffset(0),type(READONLY)
 {
 	if(copy)
 		makePrivateCopy(s);
@@ -44,7 +44,7 @@ tiny_string::tiny_string(const char* s,bool copy):_buf_static(),buf(_buf_static)
 }
 
 tiny_string::tiny_string(const tiny_string& r):
-	_buf_static(),buf(_buf_static),stringSize(r.stringSize),numchars(r.numchars),type(STATIC),isASCII(r.isASCII),hasNull(r.hasNull),isInteger(r.isInteger)
+	_buf_static(),buf(_buf_static),stringSize(r.stringSize),numchars(r.numchars),bufOffset(0),type(STATIC),isASCII(r.isASCII),hasNull(r.hasNull),isInteger(r.isInteger)
 {
 	//Fast path for static read-only strings
 	if(r.type==READONLY)
@@ -53,12 +53,17 @@ tiny_string::tiny_string(const tiny_string& r):
 		buf=r.buf;
 		return;
 	}
+	if(r.type==DYNAMIC && stringSize > STATIC_SIZE)
+	{
+		shareBuffer(r);
+		return;
+	}
 	if(stringSize > STATIC_SIZE)
 		createBuffer(stringSize);
 	memcpy(buf,r.buf,stringSize);
 }
 
-tiny_string::tiny_string(const std::string& r):_buf_static(),buf(_buf_static),stringSize(r.size()+1),type(STATIC)
+tiny_string::tiny_string(const std::string& r):_buf_static(),buf(_buf_static),stringSize(r.size()+1),bufOffset(0),type(STATIC)
 {
 	if(stringSize > STATIC_SIZE)
 		createBuffer(stringSize);
@@ -70,6 +75,7 @@ tiny_string::tiny_string(CharIterator first, CharIterator last) :
 _buf_static(),
 buf(_buf_static),
 stringSize(last.ptr() - first.ptr() + 1),
+bufOffset(0),
 type(STATIC)
 {
 	if (stringSize > STATIC_SIZE)
@@ -86,6 +92,23 @@ tiny_string::~tiny_string()
 
 tiny_string& tiny_string::operator=(const tiny_string& s)
 {
+	if(this==&s)
+		return *this;
+	if(s.type==DYNAMIC && s.stringSize > STATIC_SIZE)
+	{
+		// s may share the buffer of this string, so take the new reference before releasing the old one
+		BufferHeader* h=s.getBufferHeader();
+		ATOMIC_INCREMENT(h->refcount);
+		resetToStatic();
+		releaseBuffer(h);
+		shareBuffer(s);
+		stringSize=s.stringSize;
+		this->isASCII = s.isASCII;
+		this->hasNull = s.hasNull;
+		this->isInteger = s.isInteger;
+		this->numchars = s.numchars;
+		return *this;
+	}
 	resetToStatic();
 	stringSize=s.stringSize;
 	//Fast path for static read-only strings
@@ -133,6 +156,8 @@ tiny_string& tiny_string::operator+=(const char* s)
 		makePrivateCopy(tmp);
 	}
 	uint32_t addedLen=strlen(s);
+	if(addedLen==0)
+		return *this;
 	uint32_t newStringSize=stringSize + addedLen;
 	if(type==STATIC && newStringSize > STATIC_SIZE)
 	{
@@ -140,7 +165,7 @@ tiny_string& tiny_string::operator+=(const char* s)
 		//don't copy trailing \0
 		memcpy(buf,_buf_static,stringSize-1);
 	}
-	else if(type==DYNAMIC && addedLen!=0)
+	else if(type==DYNAMIC)
 		resizeBuffer(newStringSize);
 	//also copy \0 at the end
 	memcpy(buf+stringSize-1,s,addedLen+1);
@@ -151,6 +176,11 @@ tiny_string& tiny_string::operator+=(const char* s)
 
 tiny_string& tiny_string::operator+=(const tiny_string& r)
 {
+	if(&r==this)
+	{
+		tiny_string tmp(r);
+		return *this += tmp;
+	}
 	if (this->empty() || this->isInteger)
 		this->isInteger = r.isInteger;
 	if(type==READONLY)
@@ -158,6 +188,8 @@ tiny_string& tiny_string::operator+=(const tiny_string& r)
 		char* tmp=buf;
 		makePrivateCopy(tmp);
 	}
+	if(r.stringSize==1)
+		return *this;
 	uint32_t newStringSize=stringSize + r.stringSize-1;
 	if(type==STATIC && newStringSize > STATIC_SIZE)
 	{
@@ -165,7 +197,7 @@ tiny_string& tiny_string::operator+=(const tiny_string& r)
 		//don't copy trailing \0
 		memcpy(buf,_buf_static,stringSize-1);
 	}
-	else if(type==DYNAMIC && r.stringSize>1)
+	else if(type==DYNAMIC)
 		resizeBuffer(newStringSize);
 	//start position is where the \0 was
 	memcpy(buf+stringSize-1,r.buf,r.stringSize);
@@ -550,7 +582,7 @@ bool tiny_string::getLine(uint32_t& byteindex, tiny_string& line)
 		line.resetToStatic();
 	if(line.type==STATIC && newStringSize > STATIC_SIZE)
 		line.createBuffer(newStringSize);
-	else if(line.type==DYNAMIC && newStringSize > line.stringSize)
+	else if(line.type==DYNAMIC)
 		line.resizeBuffer(newStringSize);
 
 	// copy part from startindex to byteindex into line
@@ -657,32 +689,71 @@ void tiny_string::makePrivateCopy(const char* s)
 
 void tiny_string::createBuffer(uint32_t s)
 {
+	char* block=new char[sizeof(BufferHeader)+s];
+	BufferHeader* h=new (block) BufferHeader;
+	h->refcount=1;
+	h->capacity=s;
 	type=DYNAMIC;
 	reportMemoryChange(s);
-	buf=new char[s];
+	buf=block+sizeof(BufferHeader);
+	bufOffset=0;
 }
 
 void tiny_string::resizeBuffer(uint32_t s)
 {
 	assert(type==DYNAMIC);
+	BufferHeader* h=getBufferHeader();
+	bool unique=h->refcount==1 && bufOffset==0;
+	if(unique && h->capacity >= s)
+		return;
+	uint32_t capacity=s;
+	// grow geometrically when appending to a string, shared strings are only copied
+	if(unique && s > stringSize && capacity < stringSize+stringSize/2)
+		capacity=stringSize+stringSize/2;
 	char* oldBuf=buf;
-	reportMemoryChange(s-stringSize);
-	buf=new char[s];
-	assert(s >= stringSize);
-	memcpy(buf,oldBuf,stringSize);
-	delete[] oldBuf;
+	createBuffer(capacity);
+	memcpy(buf,oldBuf,std::min(stringSize,s));
+	releaseBuffer(h);
 }
 
-void tiny_string::resetToStatic()
+void tiny_string::shareBuffer(const tiny_string& r)
 {
-	if(type==DYNAMIC)
+	assert(type!=DYNAMIC && r.type==DYNAMIC);
+	type=DYNAMIC;
+	buf=r.buf;
+	bufOffset=r.bufOffset;
+	ATOMIC_INCREMENT(getBufferHeader()->refcount);
+}
+
+void tiny_string::releaseBuffer(BufferHeader* h) const
+{
+	if(ATOMIC_DECREMENT(h->refcount)==0)
 	{
-		reportMemoryChange(-stringSize);
-		delete[] buf;
+		reportMemoryChange(-int32_t(h->capacity));
+		h->~BufferHeader();
+		delete[] (char*)h;
 	}
+}
+
+void tiny_string::reserve(uint32_t numbytes)
+{
+	if(type==STATIC && numbytes+1 > STATIC_SIZE)
+	{
+		createBuffer(numbytes+1);
+		memcpy(buf,_buf_static,stringSize);
+	}
+	else if(type==DYNAMIC)
+		resizeBuffer(numbytes+1);
+}
+
+void tiny_string::resetToStatic()
+{
+	if(type==DYNAMIC)
+		releaseBuffer(getBufferHeader());
 	stringSize=1;
 	_buf_static[0] = '\0';
 	buf=_buf_static;
+	bufOffset=0;
 	type=STATIC;
 }
 
@@ -759,18 +830,16 @@ tiny_string& tiny_string::replace_bytes(uint32_t bytestart, uint32_t bytenum, co
 {
 	uint32_t newlen = this->stringSize+o.numBytes()-bytenum;
 	assert(bytestart+bytenum<stringSize);
-	char* newbuf = new char[newlen];
-	memcpy(newbuf,this->raw_buf(),bytestart);
-	memcpy(newbuf+bytestart,o.raw_buf(),o.numBytes());
-	memcpy(newbuf+bytestart+o.numBytes(),this->raw_buf()+bytestart+bytenum,this->stringSize-(bytestart+bytenum));
-	newbuf[newlen-1] = '\0';
-	if(type==DYNAMIC)
-	{
-		reportMemoryChange(-stringSize);
-		delete[] buf;
-	}
-	this->type=DYNAMIC;
-	this->buf=newbuf;
+	// keep the old content alive while the new buffer is filled, o may be this string
+	tiny_string oldstring(*this);
+	tiny_string other(o);
+	resetToStatic();
+	if(newlen > STATIC_SIZE)
+		createBuffer(newlen);
+	memcpy(buf,oldstring.raw_buf(),bytestart);
+	memcpy(buf+bytestart,other.raw_buf(),other.numBytes());
+	memcpy(buf+bytestart+other.numBytes(),oldstring.raw_buf()+bytestart+bytenum,oldstring.stringSize-(bytestart+bytenum));
+	buf[newlen-1] = '\0';
 	this->stringSize=newlen;
 	if (this->isASCII && o.isASCII)
 	{
@@ -791,10 +860,21 @@ tiny_string tiny_string::substr_bytes(uint32_t start, uint32_t len, bool resulti
 	if ((len == UINT32_MAX) || (start+len >= stringSize))
 		len =stringSize-(start+1);
 	assert(start+len < stringSize);
-	if(len+1 > STATIC_SIZE)
-		ret.createBuffer(len+1);
-	memcpy(ret.buf,buf+start,len);
-	ret.buf[len]=0;
+	if(type==DYNAMIC && start+len+1 == stringSize && len+1 > STATIC_SIZE && len >= numBytes()/2)
+	{
+		// the substring ends at the trailing \0 of this string, so it can share the buffer
+		// small substrings are copied to avoid keeping large buffers alive
+		ret.shareBuffer(*this);
+		ret.buf+=start;
+		ret.bufOffset+=start;
+	}
+	else
+	{
+		if(len+1 > STATIC_SIZE)
+			ret.createBuffer(len+1);
+		memcpy(ret.buf,buf+start,len);
+		ret.buf[len]=0;
+	}
 	ret.stringSize = len+1;
 	if (this->isASCII && !this->hasNull)
 		ret.numchars = len;
@@ -181,9 +181,18 @@ class DLL_PUBLIC tiny_string
 friend std::ostream& operator<<(std::ostream& s, const tiny_string& r);
 friend struct std::hash<lightspark::tiny_string>;
 private:
-	enum TYPE { READONLY=0, STATIC, DYNAMIC };
+	enum TYPE : uint8_t { READONLY=0, STATIC, DYNAMIC };
 	/*must be at least 6 bytes for tiny_string(uint32_t c) constructor */
 	#define STATIC_SIZE 64
+	/*
+	 * DYNAMIC buffers are preceded by this header and shared by all copies of the string,
+	 * the buffer is copied before a shared string is modified
+	 */
+	struct BufferHeader
+	{
+		ATOMIC_INT32(refcount);
+		uint32_t capacity;
+	};
 	char _buf_static[STATIC_SIZE];
 	char* buf;
 	/*
@@ -191,6 +200,10 @@ private:
 	*/
 	uint32_t stringSize;
 	uint32_t numchars;
+	/*
+	   offset of buf in a DYNAMIC buffer, substrings are only shared if they end at the trailing \0
+	*/
+	uint32_t bufOffset;
 	TYPE type;
 #ifdef MEMORY_USAGE_PROFILING
 	//Implemented in memory_support.cpp
@@ -201,8 +214,15 @@ private:
 #endif
 	//TODO: use static buffer again if reassigning to short string
 	void makePrivateCopy(const char* s);
+	inline BufferHeader* getBufferHeader() const
+	{
+		return ((BufferHeader*)(buf-bufOffset))-1;
+	}
 	void createBuffer(uint32_t s);
+	// ensures that the DYNAMIC buffer is not shared and can hold s bytes, keeping the content
 	void resizeBuffer(uint32_t s);
+	void shareBuffer(const tiny_string& r);
+	void releaseBuffer(BufferHeader* h) const;
 	void resetToStatic();
 	void getTrimPositions(uint32_t& start, uint32_t &end) const;
 	void init();
@@ -212,7 +232,7 @@ private:
 public:
 	static const uint32_t npos = (uint32_t)(-1);
 
-	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),numchars(0),type(STATIC)
+	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),numchars(0),bufOffset(0),type(STATIC)
 		,isASCII(true),hasNull(false),isInteger(false)
 	{
 		buf[0]=0;
@@ -253,6 +273,8 @@ public:
 	{
 		return stringSize == 1;
 	}
+	/* allocates enough memory so that the string can grow to numbytes bytes without reallocation */
+	void reserve(uint32_t numbytes);
 	inline void clear()
 	{
 		resetToStatic();
@@ -339,11 +361,7 @@ public:
 		}
 		else
 		{
-			if(type==DYNAMIC)
-			{
-				reportMemoryChange(-stringSize);
-				delete[] buf;
-			}
+			resetToStatic();
 			type=READONLY;
 			stringSize=_numbytes+1;
 			buf=(char*)s;
@@ -0,0 +1,261 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+#include "tracing.h"
+#include "threading.h"
+#include "logger.h"
+#include "swf.h"
+
+using namespace lightspark;
+
+namespace
+{
+struct TraceSlice
+{
+	uint64_t start;
+	uint64_t end;
+	const char* name;
+	uint32_t nameId;
+	TRACE_CATEGORY category;
+};
+
+// filled by a single thread, count is published with release semantics so the chunk can be read while the thread is still running
+struct TraceChunk
+{
+	TraceSlice slices[TRACE_CHUNK_SIZE];
+	std::atomic<uint32_t> count;
+	std::atomic<TraceChunk*> next;
+	TraceChunk():count(0),next(nullptr) {}
+};
+
+struct TraceThreadBuffer
+{
+	TraceChunk* first;
+	TraceChunk* current;
+	uint32_t chunkCount;
+	uint64_t threadId;
+	std::atomic<const char*> name;
+	std::atomic<uint32_t> dropped;
+	TraceThreadBuffer():first(new TraceChunk()),chunkCount(1),threadId(SDL_ThreadID()),name(nullptr),dropped(0)
+	{
+		current=first;
+	}
+};
+
+const char* categoryNames[TRACE_CATEGORY_COUNT] = { "frame", "abc", "parse", "render", "job", "gc" };
+
+// the buffers are never freed, threads may still add slices while the trace is written
+Mutex bufferMutex;
+std::vector<TraceThreadBuffer*> buffers;
+uint64_t traceStart = 0;
+
+// demangled type names, see Tracer::getTypeName
+Mutex typeNameMutex;
+std::unordered_map<const char*,std::string> typeNames;
+
+DEFINE_AND_INITIALIZE_TLS(tls_tracebuffer);
+// name set by setThreadName() before the thread got a buffer
+DEFINE_AND_INITIALIZE_TLS(tls_tracethreadname);
+
+// the buffer is only created by the first slice, so threads don't allocate anything while tracing is disabled
+TraceThreadBuffer* getThreadBuffer()
+{
+	TraceThreadBuffer* buf = (TraceThreadBuffer*)tls_get(tls_tracebuffer);
+	if (buf==nullptr)
+	{
+		buf = new TraceThreadBuffer();
+		buf->name.store((const char*)tls_get(tls_tracethreadname),std::memory_order_relaxed);
+		tls_set(tls_tracebuffer,buf);
+		Locker l(bufferMutex);
+		buffers.push_back(buf);
+	}
+	return buf;
+}
+
+void writeJSONString(std::ostream& o, const char* s)
+{
+	o << '"';
+	for (; *s; s++)
+	{
+		unsigned char c = *s;
+		if (c=='"' || c=='\\')
+			o << '\\' << c;
+		else if (c < 0x20)
+		{
+			char tmp[8];
+			snprintf(tmp,8,"\\u%04x",c);
+			o << tmp;
+		}
+		else
+			o << c;
+	}
+	o << '"';
+}
+
+// timestamps in microseconds relative to the start of the trace
+void writeTime(std::ostream& o, uint64_t ns)
+{
+	char tmp[32];
+	snprintf(tmp,32,"%llu.%03u",(unsigned long long)(ns/1000),(unsigned int)(ns%1000));
+	o << tmp;
+}
+}
+
+std::atomic<bool> Tracer::enabled(false);
+
+void Tracer::setEnabled(bool e)
+{
+	if (e && traceStart==0)
+		traceStart = now();
+	enabled.store(e,std::memory_order_relaxed);
+}
+
+uint64_t Tracer::now()
+{
+	return compat_nsectiming();
+}
+
+void Tracer::addSlice(TRACE_CATEGORY cat, const char* name, uint32_t nameId, uint64_t start, uint64_t end)
+{
+	TraceThreadBuffer* buf = getThreadBuffer();
+	TraceChunk* chunk = buf->current;
+	uint32_t n = chunk->count.load(std::memory_order_relaxed);
+	if (n==TRACE_CHUNK_SIZE)
+	{
+		if (buf->chunkCount==TRACE_MAX_CHUNKS)
+		{
+			buf->dropped.fetch_add(1,std::memory_order_relaxed);
+			return;
+		}
+		TraceChunk* c = new TraceChunk();
+		chunk->next.store(c,std::memory_order_release);
+		buf->current=chunk=c;
+		buf->chunkCount++;
+		n=0;
+	}
+	TraceSlice& s = chunk->slices[n];
+	s.start=start;
+	s.end=end;
+	s.name=name;
+	s.nameId=nameId;
+	s.category=cat;
+	chunk->count.store(n+1,std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name)
+{
+	tls_set(tls_tracethreadname,(void*)name);
+	TraceThreadBuffer* buf = (TraceThreadBuffer*)tls_get(tls_tracebuffer);
+	if (buf)
+		buf->name.store(name,std::memory_order_relaxed);
+}
+
+const char* Tracer::getTypeName(const std::type_info& t)
+{
+	Locker l(typeNameMutex);
+	auto it = typeNames.find(t.name());
+	if (it == typeNames.end())
+	{
+		std::string name = t.name();
+#ifdef __GNUC__
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(t.name(),nullptr,nullptr,&status);
+		if (demangled)
+		{
+			if (status==0)
+				name = demangled;
+			free(demangled);
+		}
+#endif
+		it = typeNames.insert(std::make_pair(t.name(),name)).first;
+	}
+	// elements of an unordered_map are not moved on rehashing
+	return it->second.c_str();
+}
+
+bool Tracer::write(const std::string& filename, SystemState* sys)
+{
+	std::ofstream f(filename.c_str(), std::ios_base::out | std::ios_base::trunc);
+	if (!f)
+	{
+		LOG(LOG_ERROR,"Tracing: could not open " << filename);
+		return false;
+	}
+	std::vector<TraceThreadBuffer*> bufs;
+	{
+		Locker l(bufferMutex);
+		bufs = buffers;
+	}
+	f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool firstEvent=true;
+	uint32_t slicecount=0;
+	uint32_t droppedcount=0;
+	for (auto it = bufs.begin(); it != bufs.end(); it++)
+	{
+		TraceThreadBuffer* buf = *it;
+		const char* threadname = buf->name.load(std::memory_order_relaxed);
+		if (threadname)
+		{
+			f << (firstEvent ? "\n" : ",\n");
+			firstEvent=false;
+			f << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buf->threadId << ",\"args\":{\"name\":";
+			writeJSONString(f,threadname);
+			f << "}}";
+		}
+		droppedcount += buf->dropped.load(std::memory_order_relaxed);
+		for (TraceChunk* chunk = buf->first; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			uint32_t n = chunk->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < n; i++)
+			{
+				const TraceSlice& s = chunk->slices[i];
+				if (s.start < traceStart)
+					continue;
+				f << (firstEvent ? "\n" : ",\n");
+				firstEvent=false;
+				f << "{\"name\":";
+				if (s.name)
+					writeJSONString(f,s.name);
+				else if (sys)
+					writeJSONString(f,sys->getStringFromUniqueId(s.nameId).raw_buf());
+				else
+					f << "\"" << s.nameId << "\"";
+				f << ",\"cat\":\"" << categoryNames[s.category] << "\",\"ph\":\"X\",\"ts\":";
+				writeTime(f,s.start-traceStart);
+				f << ",\"dur\":";
+				writeTime(f,s.end-s.start);
+				f << ",\"pid\":1,\"tid\":" << buf->threadId << "}";
+				slicecount++;
+			}
+		}
+	}
+	f << "\n]}\n";
+	f.close();
+	LOG(LOG_INFO,"Tracing: wrote " << slicecount << " slices to " << filename);
+	if (droppedcount)
+		LOG(LOG_INFO,"Tracing: " << droppedcount << " slices were dropped because the thread buffers were full");
+	return true;
+}
@@ -0,0 +1,105 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef TRACING_H
+#define TRACING_H 1
+
+#include "compat.h"
+#include <atomic>
+#include <string>
+#include <typeinfo>
+
+// number of slices in a chunk of a thread buffer
+#define TRACE_CHUNK_SIZE 4096
+// maximum number of chunks per thread, further slices are dropped
+#define TRACE_MAX_CHUNKS 256
+// ABC method calls shorter than this (in nanoseconds) are not recorded
+#define TRACE_ABC_MIN_DURATION 20000
+
+namespace lightspark
+{
+class SystemState;
+
+enum TRACE_CATEGORY { TRACE_FRAME=0, TRACE_ABC, TRACE_PARSE, TRACE_RENDER, TRACE_JOB, TRACE_GC, TRACE_CATEGORY_COUNT };
+
+/*
+ * Records time slices of the player threads, they can be written as Chrome trace / Perfetto JSON.
+ * Every thread appends to its own buffer without locking.
+ * While tracing is disabled a slice only costs a single relaxed atomic load
+ */
+class DLL_PUBLIC Tracer
+{
+private:
+	static std::atomic<bool> enabled;
+	static void addSlice(TRACE_CATEGORY cat, const char* name, uint32_t nameId, uint64_t start, uint64_t end);
+public:
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool e);
+	// current time in nanoseconds
+	static uint64_t now();
+	// name must have static storage duration
+	static void addSlice(TRACE_CATEGORY cat, const char* name, uint64_t start, uint64_t end)
+	{
+		addSlice(cat,name,UINT32_MAX,start,end);
+	}
+	// slice named by a string id of the SystemState, it is resolved when the trace is written
+	static void addSlice(TRACE_CATEGORY cat, uint32_t nameId, uint64_t start, uint64_t end)
+	{
+		addSlice(cat,nullptr,nameId,start,end);
+	}
+	// name of the current thread in the trace, must have static storage duration
+	static void setThreadName(const char* name);
+	// demangled name of a type, the returned string is kept until the program ends
+	static const char* getTypeName(const std::type_info& t);
+	// writes all slices recorded so far, string ids are resolved with sys
+	static bool write(const std::string& filename, SystemState* sys);
+};
+
+// records a slice from construction to destruction
+class TraceScope
+{
+private:
+	uint64_t start;
+	const char* name;
+	uint32_t nameId;
+	uint32_t minDuration;
+	TRACE_CATEGORY category;
+public:
+	TraceScope(TRACE_CATEGORY cat, const char* n)
+		:start(USUALLY_FALSE(Tracer::isEnabled()) ? Tracer::now() : 0),name(n),nameId(UINT32_MAX),minDuration(0),category(cat) {}
+	// slices shorter than mindur nanoseconds are not recorded
+	TraceScope(TRACE_CATEGORY cat, uint32_t id, uint32_t mindur)
+		:start(USUALLY_FALSE(Tracer::isEnabled()) ? Tracer::now() : 0),name(nullptr),nameId(id),minDuration(mindur),category(cat) {}
+	~TraceScope()
+	{
+		if (USUALLY_FALSE(start))
+		{
+			uint64_t end = Tracer::now();
+			if (end-start < minDuration)
+				return;
+			if (name)
+				Tracer::addSlice(category,name,start,end);
+			else
+				Tracer::addSlice(category,nameId,start,end);
+		}
+	}
+};
+
+}
+#endif /* TRACING_H */
@@ -0,0 +1,170 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+#include <lightspark/tiny_string.h>
+#include <lightspark/smartrefs.h>
+#include <lightspark/scripting/flash/display3d/agalcache.h>
+
+#include <libtest++/test_runner.h>
+
+#include "macros.h"
+
+#include "agal_tests.h"
+
+using namespace lightspark;
+using namespace libtestpp;
+
+using OutcomeType = Outcome::Type;
+
+// writes AGAL bytecode in either byte order
+struct AGALWriter
+{
+	std::vector<uint8_t> bytes;
+	bool littleEndian;
+	AGALWriter(bool vertex, bool _littleEndian):littleEndian(_littleEndian)
+	{
+		bytes.push_back(0xA0);
+		writeUInt32(1); // version
+		bytes.push_back(0xA1);
+		bytes.push_back(vertex ? 0 : 1);
+	}
+	void writeUInt32(uint32_t v)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+			bytes.push_back(v>>((littleEndian ? i : 3-i)*8));
+	}
+	void writeUInt64(uint64_t v)
+	{
+		writeUInt32(v);
+		writeUInt32(v>>32);
+	}
+	// dest and sources use all components without swizzling
+	void instruction(uint32_t opcode, uint32_t desttype, uint32_t destnumber, uint32_t srctype, uint32_t srcnumber)
+	{
+		writeUInt32(opcode);
+		writeUInt32(desttype<<24 | 0xF<<16 | destnumber);
+		writeUInt64(uint64_t(srctype)<<32 | uint64_t(0xE4)<<24 | srcnumber);
+		writeUInt64(0);
+	}
+};
+
+// mov op, va0
+static AGALWriter vertexProgram(bool littleEndian)
+{
+	AGALWriter w(true,littleEndian);
+	w.instruction(0x00,RegisterType::OUTPUT,0,RegisterType::ATTRIBUTE,0);
+	return w;
+}
+
+// mov oc, fc<constant>
+static AGALWriter fragmentProgram(bool littleEndian, uint32_t constant)
+{
+	AGALWriter w(false,littleEndian);
+	w.instruction(0x00,RegisterType::OUTPUT,0,RegisterType::CONSTANT,constant);
+	return w;
+}
+
+static _R<AGALTranslation> newTranslation(const AGALWriter& vertex, const AGALWriter& fragment)
+{
+	return _MR(new AGALTranslation(vertex.bytes.data(),vertex.bytes.size(),vertex.littleEndian,fragment.bytes.data(),fragment.bytes.size(),fragment.littleEndian));
+}
+
+static bool hasRegister(const std::vector<RegisterMapEntry>& registers, const char* name)
+{
+	for (auto it = registers.begin(); it != registers.end(); it++)
+	{
+		if (it->name == name)
+			return true;
+	}
+	return false;
+}
+
+TEST_CASE_DECL(AGAL, translate)
+{
+	std::stringstream s;
+	_R<AGALTranslation> t = newTranslation(vertexProgram(true),fragmentProgram(true,0));
+	t->waitTranslated();
+	if (t->vertexprogram.find("gl_Position") == tiny_string::npos || t->vertexprogram.find("va0") == tiny_string::npos)
+		s << "unexpected vertex program:" << t->vertexprogram << std::endl;
+	if (t->fragmentprogram.find("gl_FragColor") == tiny_string::npos || t->fragmentprogram.find("fc0") == tiny_string::npos)
+		s << "unexpected fragment program:" << t->fragmentprogram << std::endl;
+	if (!hasRegister(t->vertexattributes,"va0"))
+		s << "va0 is missing in the vertex attributes" << std::endl;
+	if (!hasRegister(t->fragmentregistermap,"fc0"))
+		s << "fc0 is missing in the fragment registers" << std::endl;
+
+	// the byte order of the bytecode doesn't change the result
+	_R<AGALTranslation> bigendian = newTranslation(vertexProgram(false),fragmentProgram(false,0));
+	bigendian->waitTranslated();
+	if (bigendian->vertexprogram != t->vertexprogram || bigendian->fragmentprogram != t->fragmentprogram)
+		s << "big endian bytecode is translated differently" << std::endl;
+
+	// a translation in another thread gives the same results as the shared one
+	tiny_string vertexglsl;
+	tiny_string fragmentglsl;
+	std::vector<SamplerRegister> samplers;
+	std::vector<RegisterMapEntry> vertexregisters;
+	std::vector<RegisterMapEntry> vertexattribs;
+	std::vector<RegisterMapEntry> fragmentregisters;
+	std::vector<RegisterMapEntry> fragmentattribs;
+	if (!t->translate(vertexglsl,fragmentglsl,samplers,vertexregisters,vertexattribs,fragmentregisters,fragmentattribs))
+		s << "translation failed" << std::endl;
+	else if (vertexglsl != t->vertexprogram || fragmentglsl != t->fragmentprogram
+			 || vertexattribs.size() != t->vertexattributes.size() || fragmentregisters.size() != t->fragmentregistermap.size())
+		s << "repeated translation differs" << std::endl;
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(AGAL, cache)
+{
+	std::stringstream s;
+	AGALTranslationCache* cache = AGALTranslationCache::getCache();
+	// constant numbers not used by other tests, so the process wide cache starts without these programs
+	_R<AGALTranslation> a = cache->addTranslation(nullptr,newTranslation(vertexProgram(true),fragmentProgram(true,7)));
+	_R<AGALTranslation> b = cache->addTranslation(nullptr,newTranslation(vertexProgram(true),fragmentProgram(true,7)));
+	_R<AGALTranslation> c = cache->addTranslation(nullptr,newTranslation(vertexProgram(true),fragmentProgram(true,8)));
+	_R<AGALTranslation> d = cache->addTranslation(nullptr,newTranslation(vertexProgram(false),fragmentProgram(false,7)));
+	if (a.getPtr() != b.getPtr())
+		s << "identical bytecode is translated twice" << std::endl;
+	if (a.getPtr() == c.getPtr())
+		s << "different bytecode returned the same translation" << std::endl;
+	if (a.getPtr() == d.getPtr())
+		s << "bytecode with a different byte order returned the same translation" << std::endl;
+
+	// without a SystemState the first thread waiting translates
+	if (!b->tryTranslated())
+		s << "translation is not available" << std::endl;
+	else if (a->fragmentprogram.find("fc7") == tiny_string::npos)
+		s << "unexpected fragment program:" << a->fragmentprogram << std::endl;
+	c->waitTranslated();
+	if (c->fragmentprogram.find("fc8") == tiny_string::npos)
+		s << "unexpected fragment program:" << c->fragmentprogram << std::endl;
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
@@ -0,0 +1,244 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include <lightspark/tiny_string.h>
+#include <lightspark/backends/httpcache.h>
+#include <lightspark/utils/filesystem.h>
+#include <lightspark/utils/path.h>
+
+#include <libtest++/test_runner.h>
+
+#include "macros.h"
+
+#include "httpcache_tests.h"
+
+using namespace lightspark;
+using namespace libtestpp;
+
+namespace fs = FileSystem;
+
+using OutcomeType = Outcome::Type;
+
+// empty cache directory that is removed at the end of a test
+struct TestCacheDir
+{
+	Path path;
+	TestCacheDir():path(fs::tempDirPath() / ("lightspark-httpcache-test-" + std::to_string(getpid())))
+	{
+		fs::removeAll(path);
+		fs::createDirs(path / "objects");
+	}
+	~TestCacheDir() { fs::removeAll(path); }
+	std::string str() const { return path.getStr().raw_buf(); }
+};
+
+static bool store(HTTPCache& cache, HTTPCacheEntry& e, const std::string& content)
+{
+	HTTPCacheWriter* w = cache.createWriter();
+	if (w == nullptr)
+		return false;
+	w->write((const uint8_t*)content.data(),content.size());
+	cache.commit(w,e);
+	return true;
+}
+
+static std::string readFile(const std::string& filename)
+{
+	std::ifstream f(filename.c_str(),std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(f),std::istreambuf_iterator<char>());
+}
+
+TEST_CASE_DECL(HTTPCache, hitMiss)
+{
+	std::stringstream s;
+	TestCacheDir dir;
+	HTTPCache cache(dir.str(),1024*1024);
+	HTTPCacheEntry e;
+	if (cache.lookup("http://example.com/a.swf",e))
+		s << "empty cache returned an entry" << std::endl;
+
+	HTTPCacheEntry a;
+	a.url = "http://example.com/a.swf";
+	a.contentType = "application/x-shockwave-flash";
+	HTTPCacheEntry b;
+	b.url = "http://example.com/b.swf";
+	if (!store(cache,a,"content of a") || !store(cache,b,"content of a"))
+		s << "could not create a writer" << std::endl;
+
+	if (!cache.lookup(a.url,e))
+		s << "stored entry not found" << std::endl;
+	else
+	{
+		if (e.size != 12 || e.contentType != a.contentType)
+			s << "entry has size " << e.size << " and type " << e.contentType << std::endl;
+		if (readFile(cache.getPath(e)) != "content of a")
+			s << "content is '" << readFile(cache.getPath(e)) << "'" << std::endl;
+	}
+	HTTPCacheEntry e2;
+	if (!cache.lookup(b.url,e2))
+		s << "second url not found" << std::endl;
+	else if (e2.object != e.object)
+		s << "identical content is stored twice" << std::endl;
+	if (cache.lookup("http://example.com/c.swf",e))
+		s << "unknown url returned an entry" << std::endl;
+
+	// removing one url keeps the content of the other one
+	cache.remove(a.url);
+	if (cache.lookup(a.url,e))
+		s << "removed entry found" << std::endl;
+	if (!fs::isFile(Path(cache.getPath(e2))))
+		s << "shared content was deleted with one of its entries" << std::endl;
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(HTTPCache, validation)
+{
+	std::stringstream s;
+	TestCacheDir dir;
+	const std::string url = "http://example.com/data.xml";
+	{
+		HTTPCache cache(dir.str(),1024*1024);
+		HTTPCacheEntry e;
+		e.url = url;
+		e.etag = "\"v1\"";
+		e.lastModified = "Mon, 19 Oct 2026 10:00:00 GMT";
+		e.expires = 1000;
+		store(cache,e,"<data/>");
+		// a successful revalidation only changes the expiration time
+		cache.refresh(url,2000);
+	}
+	// the index is reloaded with the validators
+	HTTPCache cache(dir.str(),1024*1024);
+	HTTPCacheEntry e;
+	if (!cache.lookup(url,e))
+		s << "entry not found after reloading the index" << std::endl;
+	else
+	{
+		if (e.etag != "\"v1\"")
+			s << "etag is " << e.etag << std::endl;
+		if (e.lastModified != "Mon, 19 Oct 2026 10:00:00 GMT")
+			s << "last modified is " << e.lastModified << std::endl;
+		if (e.expires != 2000)
+			s << "expires is " << e.expires << ", expected 2000" << std::endl;
+		if (readFile(cache.getPath(e)) != "<data/>")
+			s << "content is '" << readFile(cache.getPath(e)) << "'" << std::endl;
+	}
+
+	// a new response replaces the old entry and its content
+	HTTPCacheEntry n;
+	n.url = url;
+	n.etag = "\"v2\"";
+	store(cache,n,"<data>2</data>");
+	HTTPCacheEntry e2;
+	if (!cache.lookup(url,e2) || e2.etag != "\"v2\"" || readFile(cache.getPath(e2)) != "<data>2</data>")
+		s << "entry was not replaced" << std::endl;
+	if (fs::isFile(Path(cache.getPath(e))))
+		s << "replaced content was not deleted" << std::endl;
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(HTTPCache, eviction)
+{
+	std::stringstream s;
+	TestCacheDir dir;
+	// write an index with known use times, the cache evicts while loading it
+	const char* objects[3] = { "old", "middle", "new" };
+	{
+		std::ofstream index((dir.str()+"/index").c_str());
+		index << "lightspark-httpcache 1\n";
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			std::ofstream((dir.str()+"/objects/"+objects[i]).c_str()) << "0123456789";
+			index << objects[i] << "\t10\t0\t" << (i+1)*100 << "\t\t\t\thttp://example.com/" << objects[i] << "\n";
+		}
+	}
+	std::ifstream reader((dir.str()+"/objects/old").c_str());
+	HTTPCache cache(dir.str(),25);
+	HTTPCacheEntry e;
+	if (cache.lookup("http://example.com/old",e))
+		s << "least recently used entry was not evicted" << std::endl;
+	if (fs::isFile(Path(dir.str()+"/objects/old")))
+		s << "content of the evicted entry was not deleted" << std::endl;
+	std::string content;
+	if (!std::getline(reader,content) || content != "0123456789")
+		s << "open reader lost the content of the evicted entry" << std::endl;
+	// lookup() would change the use times
+	if (!fs::isFile(Path(dir.str()+"/objects/middle")) || !fs::isFile(Path(dir.str()+"/objects/new")))
+		s << "recently used entries were evicted" << std::endl;
+
+	// adding an entry evicts the least recently used one, "middle"
+	HTTPCacheEntry n;
+	n.url = "http://example.com/newest";
+	store(cache,n,"abcdefghij");
+	if (cache.lookup("http://example.com/middle",e))
+		s << "adding an entry didn't evict the least recently used one" << std::endl;
+	if (!cache.lookup("http://example.com/newest",e) || !cache.lookup("http://example.com/new",e))
+		s << "new entries were evicted" << std::endl;
+
+	// content larger than the cache is not stored
+	HTTPCacheEntry big;
+	big.url = "http://example.com/big";
+	store(cache,big,std::string(100,'x'));
+	if (cache.lookup(big.url,e))
+		s << "content larger than the cache was stored" << std::endl;
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(HTTPCache, temporaryFiles)
+{
+	std::stringstream s;
+	TestCacheDir dir;
+	// left behind by an interrupted download and an interrupted index update
+	std::ofstream((dir.str()+"/tmpAbC123").c_str()) << "partial";
+	std::ofstream((dir.str()+"/index.tmp").c_str()) << "lightspark-httpcache 1\n";
+	std::ofstream((dir.str()+"/objects/kept").c_str()) << "0123456789";
+	{
+		HTTPCache cache(dir.str(),1024*1024);
+		if (fs::isFile(Path(dir.str()+"/tmpAbC123")))
+			s << "temporary file of a download was not removed" << std::endl;
+		if (fs::isFile(Path(dir.str()+"/index.tmp")))
+			s << "temporary index was not removed" << std::endl;
+		if (!fs::isFile(Path(dir.str()+"/objects/kept")))
+			s << "stored object was removed" << std::endl;
+		HTTPCacheEntry e;
+		e.url = "http://example.com/a";
+		if (!store(cache,e,"abc") || !cache.lookup(e.url,e))
+			s << "content was not stored after removing the temporary files" << std::endl;
+	}
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
@@ -0,0 +1,35 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef HTTPCACHE_TESTS_H
+#define HTTPCACHE_TESTS_H 1
+
+#include <libtest++/test_runner.h>
+
+#include "macros.h"
+
+using namespace lightspark;
+using namespace libtestpp;
+
+TEST_CASE_DECL(HTTPCache, hitMiss);
+TEST_CASE_DECL(HTTPCache, validation);
+TEST_CASE_DECL(HTTPCache, eviction);
+TEST_CASE_DECL(HTTPCache, temporaryFiles);
+
+#endif /* HTTPCACHE_TESTS_H */
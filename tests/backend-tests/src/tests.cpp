@@ -0,0 +1,78 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2025  mr b0nk 500 (b0nk@b0nk.xyz)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <vector>
+
+#include <libtest++/test_runner.h>
+
+#include "macros.h"
+
+#include "agal_tests.h"
+#include "httpcache_tests.h"
+#include "tests.h"
+#include "yuvconvert_tests.h"
+
+using namespace lightspark;
+using namespace libtestpp;
+
+struct Test
+{
+	const char* category;
+	const char* name;
+	const char* desc;
+	Optional<Outcome>(*runner)();
+};
+
+static constexpr std::array testCases =
+{
+	TEST_CASE(YUVConvert, simdMatchesGeneric, "Tests if the SIMD YUV to ARGB conversions match the generic one bit for bit."),
+	TEST_CASE(YUVConvert, matchesShader, "Tests the YUV to ARGB conversion against the matrices of the GL shader."),
+	TEST_CASE(YUVConvert, compositeSIMDMatchesGeneric, "Tests if the SIMD alpha compositing matches the generic one bit for bit."),
+	TEST_CASE(YUVConvert, compositeExact, "Tests the alpha compositing against the exactly rounded result."),
+	TEST_CASE(AGAL, translate, "Tests the translation of AGAL bytecode to GLSL in both byte orders."),
+	TEST_CASE(AGAL, cache, "Tests that identical AGAL bytecode shares one translation in the cache."),
+	TEST_CASE(HTTPCache, hitMiss, "Tests lookups of stored and unknown URLs and the sharing of identical content."),
+	TEST_CASE(HTTPCache, validation, "Tests that validators and expiration times are kept in the index and updated on revalidation."),
+	TEST_CASE(HTTPCache, eviction, "Tests that the least recently used entries are evicted when the cache is full."),
+	TEST_CASE(HTTPCache, temporaryFiles, "Tests that temporary files of interrupted downloads are removed when the cache is opened."),
+};
+
+std::vector<Trial> addTests(const Arguments& args)
+{
+	std::vector<Trial> tests(testCases.size());
+
+	std::transform
+	(
+		testCases.begin(),
+		testCases.end(),
+		tests.begin(),
+		[](const Test& test)
+		{
+			return Trial::test
+			(
+				test.name,
+				test.runner
+			).with_kind(test.category);
+		}
+	);
+	return tests;
+}
@@ -0,0 +1,247 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+#include <lightspark/tiny_string.h>
+#include <lightspark/platforms/fastpaths.h>
+
+#include <libtest++/test_runner.h>
+
+#include "macros.h"
+
+#include "yuvconvert_tests.h"
+
+using namespace lightspark;
+using namespace libtestpp;
+
+using OutcomeType = Outcome::Type;
+
+// widths that cover the SIMD loops and the scalar tails
+static const uint32_t testWidths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100 };
+
+// deterministic pseudo random bytes, so failures are reproducible
+struct TestRandom
+{
+	uint32_t state;
+	TestRandom():state(0x12345678) {}
+	uint8_t next()
+	{
+		state = state*1664525+1013904223;
+		return state>>24;
+	}
+};
+
+static std::vector<uint8_t> convert(const std::vector<uint8_t>& in, uint32_t width, uint32_t height, YUV_COLORSPACE colorspace, FASTPATH_LEVEL level)
+{
+	std::vector<uint8_t> out(width*height*4);
+	setFastPathLevel(level);
+	fastYUVAToPremultipliedARGB(in.data(),width*4,out.data(),width*4,width,height,colorspace);
+	setFastPathLevel(FASTPATH_AVX2);
+	return out;
+}
+
+static std::vector<uint32_t> composite(const std::vector<uint32_t>& src, const std::vector<uint32_t>& dst, FASTPATH_LEVEL level)
+{
+	std::vector<uint32_t> out(dst);
+	setFastPathLevel(level);
+	fastCompositePremultipliedARGB(src.data(),out.data(),src.size());
+	setFastPathLevel(FASTPATH_AVX2);
+	return out;
+}
+
+// premultiplied source pixels with random, transparent and opaque alpha
+static std::vector<uint32_t> randomPremultiplied(TestRandom& rnd, uint32_t count)
+{
+	std::vector<uint32_t> ret(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t a = i%5 == 0 ? 0 : (i%5 == 1 ? 255 : rnd.next());
+		uint32_t p = a<<24;
+		for (uint32_t shift = 0; shift < 24; shift += 8)
+			p |= (a ? rnd.next()%(a+1) : 0)<<shift;
+		ret[i] = p;
+	}
+	return ret;
+}
+
+static std::vector<uint32_t> randomPixels(TestRandom& rnd, uint32_t count)
+{
+	std::vector<uint32_t> ret(count);
+	for (uint32_t i = 0; i < count; i++)
+		ret[i] = (rnd.next()<<24) | (rnd.next()<<16) | (rnd.next()<<8) | rnd.next();
+	return ret;
+}
+
+TEST_CASE_DECL(YUVConvert, simdMatchesGeneric)
+{
+	std::stringstream s;
+	TestRandom rnd;
+	for (FASTPATH_LEVEL level : { FASTPATH_SSE2, FASTPATH_AVX2 })
+	{
+		if (setFastPathLevel(level) != level)
+			continue;
+		for (YUV_COLORSPACE colorspace : { YUV_BT601, YUV_BT709 })
+		{
+			for (uint32_t width : testWidths)
+			{
+				std::vector<uint8_t> in(width*3*4);
+				for (uint8_t& b : in)
+					b = rnd.next();
+				std::vector<uint8_t> expected = convert(in,width,3,colorspace,FASTPATH_GENERIC);
+				std::vector<uint8_t> actual = convert(in,width,3,colorspace,level);
+				for (size_t i = 0; i < expected.size(); i++)
+				{
+					if (expected[i] != actual[i])
+					{
+						s << "level " << level << ", colorspace " << colorspace << ", width " << width << ": byte " << i << " is " << uint32_t(actual[i]) << ", expected " << uint32_t(expected[i]) << std::endl;
+						break;
+					}
+				}
+			}
+		}
+	}
+	setFastPathLevel(FASTPATH_AVX2);
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(YUVConvert, matchesShader)
+{
+	// the YUVtoRGB matrix of lightspark.frag and its BT.709 counterpart, limited range
+	static const float matrices[2][5] =
+	{
+		{ 1.164383f, 1.596027f, 0.391762f, 0.812968f, 2.017232f },
+		{ 1.164383f, 1.792741f, 0.213249f, 0.532909f, 2.112402f },
+	};
+	std::stringstream s;
+	TestRandom rnd;
+	for (YUV_COLORSPACE colorspace : { YUV_BT601, YUV_BT709 })
+	{
+		const float* m = matrices[colorspace==YUV_BT709 ? 1 : 0];
+		const uint32_t width = 4096;
+		std::vector<uint8_t> in(width*4);
+		for (uint32_t i = 0; i < width; i++)
+		{
+			in[i*4] = rnd.next();
+			in[i*4+1] = rnd.next();
+			in[i*4+2] = rnd.next();
+			in[i*4+3] = 255;
+		}
+		std::vector<uint8_t> out = convert(in,width,1,colorspace,FASTPATH_GENERIC);
+		for (uint32_t i = 0; i < width; i++)
+		{
+			float y = m[0]*(in[i*4]-16.0f);
+			float u = in[i*4+1]-128.0f;
+			float v = in[i*4+2]-128.0f;
+			const float expected[3] = { y+m[4]*u, y-m[2]*u-m[3]*v, y+m[1]*v };
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				float e = std::round(std::fmin(std::fmax(expected[c],0.0f),255.0f));
+				if (std::fabs(out[i*4+c]-e) > 1.0f)
+				{
+					s << "colorspace " << colorspace << ", yuv " << uint32_t(in[i*4]) << ' ' << uint32_t(in[i*4+1]) << ' ' << uint32_t(in[i*4+2]) << ": channel " << c << " is " << uint32_t(out[i*4+c]) << ", expected " << e << std::endl;
+					break;
+				}
+			}
+			if (out[i*4+3] != 255)
+				s << "colorspace " << colorspace << ": alpha is " << uint32_t(out[i*4+3]) << ", expected 255" << std::endl;
+		}
+	}
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(YUVConvert, compositeSIMDMatchesGeneric)
+{
+	std::stringstream s;
+	TestRandom rnd;
+	for (FASTPATH_LEVEL level : { FASTPATH_SSE2, FASTPATH_AVX2 })
+	{
+		if (setFastPathLevel(level) != level)
+			continue;
+		for (uint32_t width : testWidths)
+		{
+			std::vector<uint32_t> src = randomPremultiplied(rnd,width);
+			std::vector<uint32_t> dst = randomPixels(rnd,width);
+			std::vector<uint32_t> expected = composite(src,dst,FASTPATH_GENERIC);
+			std::vector<uint32_t> actual = composite(src,dst,level);
+			for (uint32_t i = 0; i < width; i++)
+			{
+				if (expected[i] != actual[i])
+				{
+					s << "level " << level << ", width " << width << ": pixel " << i << " is " << std::hex << actual[i] << ", expected " << expected[i] << std::dec << std::endl;
+					break;
+				}
+			}
+		}
+	}
+	setFastPathLevel(FASTPATH_AVX2);
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}
+
+TEST_CASE_DECL(YUVConvert, compositeExact)
+{
+	std::stringstream s;
+	// every source alpha against every destination value, the source channels are 0 and alpha
+	std::vector<uint32_t> src;
+	std::vector<uint32_t> dst;
+	for (uint32_t a = 0; a < 256; a++)
+	{
+		for (uint32_t d = 0; d < 256; d++)
+		{
+			src.push_back((a<<24) | (a<<16));
+			dst.push_back((d<<24) | (d<<16) | (d<<8) | d);
+		}
+	}
+	std::vector<uint32_t> out = composite(src,dst,FASTPATH_AVX2);
+	for (size_t i = 0; i < out.size(); i++)
+	{
+		uint32_t a = src[i]>>24;
+		uint32_t d = dst[i]&0xff;
+		uint32_t scaled = uint32_t(std::lround(d*(255-a)/255.0));
+		// blue, green, red, alpha
+		const uint32_t channels[4] = { scaled, scaled, a+scaled, a+scaled };
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint32_t e = std::min(channels[c],255U);
+			uint32_t actual = (out[i]>>(c*8))&0xff;
+			if (actual != e)
+			{
+				s << "alpha " << a << ", destination " << d << ": channel " << c << " is " << actual << ", expected " << e << std::endl;
+				break;
+			}
+		}
+	}
+
+	if (!s.str().empty())
+		return Outcome(Failed { tiny_string(s.str()) });
+	return Outcome(OutcomeType::Passed);
+}